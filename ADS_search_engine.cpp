@@ -3,14 +3,80 @@
 #include <vector>
 #include <fstream>
 #include <filesystem>
+#include <csignal>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
 
 #include "WordCounter.h"
+#include "WordSketch.h"
 #include "utils.h"
 #include "SearchEngine.h"
+#include "IndexProfile.h"
+#include "SearchServer.h"
+#include "HotSwapEngine.h"
+#include "Compactor.h"
+#include "RealtimeIndexer.h"
+#include "IndexStats.h"
+#include "ArchiveReader.h"
 
 using namespace std;
 
 #define CLI_NAME "ADS_search_engine"
+#define MAX_THREADS 1024 ///< The largest number of threads an option accepts
+#define MAX_READ_AHEAD 1024 ///< The largest number of chunks a reader may read ahead
+#define MAX_FANOUT 1024 ///< The largest number of segments a compaction step may merge
+#define MAX_MEGABYTES (1 << 20) ///< The largest size in MB a size option accepts, 1 TB
+
+static SearchServer* running_server = nullptr; ///< The server to stop on SIGINT/SIGTERM.
+static HotSwapEngine* running_engine = nullptr; ///< The engine to reload on SIGHUP.
+
+/**
+ * @brief Signal handler to stop the server gracefully
+ */
+void stop_server(int) {
+    if (running_server) running_server->stop();
+}
+
+/**
+ * @brief Signal handler to reload the published index generation
+ */
+void reload_engine(int) {
+    if (running_engine) running_engine->request_reload();
+}
+
+/**
+ * @brief Parse the maximum edit distance of fuzzy matching
+ * @param arg The argument.
+ * @param fuzzy Set to the edit distance.
+ * @return false if the argument is not 0, 1 or 2, the automaton of larger distances is too large.
+ */
+bool parse_fuzzy(const char* arg, uint32_t& fuzzy) {
+    char* end = nullptr;
+    long edits = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || edits < 0 || edits > 2) return false;
+    fuzzy = static_cast<uint32_t>(edits);
+    return true;
+}
+
+/**
+ * @brief Parse a whole number argument
+ * @param arg The argument.
+ * @param min The smallest value accepted.
+ * @param max The largest value accepted.
+ * @param value Set to the number.
+ * @return false if the argument is not a whole number from min to max, e.g. negative or mistyped.
+ */
+bool parse_number(const char* arg, uint64_t min, uint64_t max, uint64_t& value) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = strtoull(arg, &end, 10);
+    // strtoull negates negative numbers instead of failing
+    if (end == arg || *end != '\0' || errno == ERANGE || strchr(arg, '-') || number < min || number > max) return false;
+    value = number;
+    return true;
+}
 
 /**
  * @brief Print help message
@@ -19,15 +85,50 @@ void print_help() {
     cout << "This program can count, index, and search all the .html files in a directory." << endl;
     cout << "Usage:" << endl;
     cout << "  " CLI_NAME " help" << endl;
-    cout << "  " CLI_NAME " count <target_dir> [-o,--output <output_file>]" << endl;
-    cout << "  " CLI_NAME " index <target_dir> [-l,--large] [-s,--stop <stop_words_file>]" << endl;
+    cout << "  " CLI_NAME " count <target_dir> [-o,--output <output_file>] [-j,--threads <threads>] [-n,--top <n>] [--approximate <MB>]" << endl;
+    cout << "  "          " - Files are counted by <threads> threads (default one per core), only the <n> most frequent words are printed (default all)." << endl;
+    cout << "  "          " - With --approximate, words are counted in about <MB> megabytes: the distinct words are estimated and each count is printed with its maximum overestimate." << endl;
+    cout << "  " CLI_NAME " index <target_dir|archive> [-l,--large] [-s,--stop <stop_words_file>] [-u,--update] [--profile] [--trace <trace_file>] [--readers <readers>] [--read-ahead <chunks>] [--walk-threads <threads>] [--discovery-order] [--split <MB>] [--split-threads <threads>] [--inversion map|sort] [--sort-buffer <MB>]" << endl;
     cout << "  "          " - Large mode can handle larger amounts of data, performing merges on-disk." << endl;
     cout << "  "          " - Normal mode is faster when enough memory is available." << endl;
     cout << "  "          " - You can pass a stop words file to ignore certain words. An example is provided in test/stop_words.txt." << endl;
-    cout << "  " CLI_NAME " search <target_dir> [-t,--threshold <threshold>] # Start interactive mode if no query is passed." << endl;
-    cout << "  " CLI_NAME " search <target_dir> [-q,--query <query>] [-t,--threshold <threshold>]" << endl;
+    cout << "  "          " - Each build is published as a new index generation, running servers switch to it without downtime." << endl;
+    cout << "  "          " - Update mode only indexes files added or modified since the last build, and drops deleted ones." << endl;
+    cout << "  "          " - Files are read ahead by <readers> threads (default 2, 0 reads each file when it is indexed), each holding at most <chunks> chunks of 256 KB (default 4)." << endl;
+    cout << "  "          " - Reading, tokenizing and inverting overlap, the profile reports how long each stage waited for the others." << endl;
+    cout << "  "          " - Directories are listed by <threads> threads (default one per core) while the files found are indexed." << endl;
+    cout << "  "          " - Files are numbered in path order by default, so the same files always give the same index; discovery order numbers them as they are found." << endl;
+    cout << "  "          " - Files over <MB> megabytes (default 16, 0 never) are tokenized by <threads> threads (default one per core), the index is the same." << endl;
+    cout << "  "          " - Sort inversion buffers (term, document) pairs, <MB> megabytes at a time (default 16), and radix sorts them on every core instead of updating a map per token." << endl;
+    cout << "  "          " - An archive (.tar, .jsonl, gzip-compressed or not) is read in one pass into an index of its own, next to it; search, serve or update the archive." << endl;
+    cout << "  " CLI_NAME " compact <target_dir> [--rate <MB/s>] [--fanout <n>]" << endl;
+    cout << "  "          " - Merge the small segments left by updates and drop the postings of deleted files, until nothing is left to merge." << endl;
+    cout << "  "          " - <n> adjacent segments of similar size are merged at once (default 4), the write rate is limited to <MB/s> (default unlimited)." << endl;
+    cout << "  " CLI_NAME " index-stats <target_dir|archive|index_file>" << endl;
+    cout << "  "          " - Report the vocabulary, document frequencies, posting list lengths, doc ID gap entropy and projected size per posting codec." << endl;
+    cout << "  "          " - The index files are streamed once, in constant memory." << endl;
+    cout << "  " CLI_NAME " search <target_dir> [-t,--threshold <threshold>] [-f,--fuzzy <edits>] [--explain] # Start interactive mode if no query is passed." << endl;
+    cout << "  " CLI_NAME " search <target_dir> [-q,--query <query>] [-t,--threshold <threshold>] [-f,--fuzzy <edits>] [--explain] [--offset <offset>] [--limit <limit>]" << endl;
     cout << "  "          " - Threshold is a float number from 0.0 to 1.0." << endl;
     cout << "  "          " - When the threshold is passed, only the top <threshold>*100% of infrequent input terms will be used to search." << endl;
+    cout << "  "          " - When fuzzy is passed (0 to 2, 0 is exact matching), terms not in the index match all terms within that edit distance." << endl;
+    cout << "  "          " - Explain prints, after the results, the terms, posting list reads, intersection steps and stage times." << endl;
+    cout << "  "          " - Offset and limit print one page of the results: the first <offset> are skipped, at most <limit> are printed, then a summary line." << endl;
+    cout << "  " CLI_NAME " search <target_dir> [-b,--batch <queries_file>] [-j,--threads <threads>] [--shared] [-t,--threshold <threshold>] [-f,--fuzzy <edits>]" << endl;
+    cout << "  "          " - Batch mode runs one query per line of the file in parallel and prints the results in input order." << endl;
+    cout << "  "          " - Throughput (QPS) and p50/p99 latencies are reported to stderr at the end." << endl;
+    cout << "  "          " - Shared mode fetches each term once for the whole batch and reports the bytes saved." << endl;
+    cout << "  "          " - Any search mode takes [--stats] to print the memory used by each component of the engine," << endl;
+    cout << "  "          "   and [--memory-limit <MB>] to cap the loaded index plus its caches, terms over the cap are read per query." << endl;
+    cout << "  " CLI_NAME " serve <target_dir> [-S,--socket <socket_path>] [-j,--threads <threads>] [--max-pending <n>] [-t,--threshold <threshold>] [-f,--fuzzy <edits>]" << endl;
+    cout << "  "          " - Load the index once and answer queries on a Unix socket, default <target_dir>/" << BASE_DIR << "/" << SOCKET_FILE_NAME << "." << endl;
+    cout << "  "          " - Requests beyond <n> in flight (default 1024) are rejected with \"Error: server overloaded\"." << endl;
+    cout << "  "          " - A newly published index is swapped in without downtime, checked every [--reload-interval <ms>] (default 1000, 0 to disable) or on SIGHUP." << endl;
+    cout << "  "          " - Segments are compacted in the background every [--compact-interval <ms>] (default 60000, 0 to disable), at most [--compact-rate <MB/s>] (default 16)." << endl;
+    cout << "  "          " - With [--realtime], changed files are searchable at once, and written as a segment every [--flush-size <MB>] (default 16)." << endl;
+    cout << "  "          " - [--memory-limit <MB>] caps the loaded index plus the realtime delta, which is flushed early to stay below it." << endl;
+    cout << "  "          "   Generations over the cap are not swapped in. [--stats] prints the memory used by each component at start." << endl;
+    cout << "  " CLI_NAME " client <target_dir|socket_path> [-q,--query <query>] # Start interactive mode if no query is passed." << endl;
 }
 
 /**
@@ -53,19 +154,46 @@ int main(int argc, char* argv[]) {
 
     // Handle count command
     if (argc >= 2 && strcmp(argv[1], "count") == 0) {
+        unsigned threads = 0; // Default is one thread per core
+        size_t top = 0; // Default is to print all words
+        size_t approximate = 0; // Default is exact counting
         for (int i = 2; i < argc; i++) {
             // If input is -o or --output, get the output path
             if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc) {
                 output = argv[i + 1]; // Get from the next argument
                 i++; // Skip the next argument
             }
+            else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, MAX_THREADS, number)) { // Get number of threads
+                    cout << "Error: Threads must be a number from 0 to " << MAX_THREADS << endl;
+                    return 1;
+                }
+                threads = static_cast<unsigned>(number);
+                i++;
+            }
+            else if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--top") == 0) && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, SIZE_MAX, number)) { // Get number of words to print
+                    cout << "Error: Top must be a number of words, 0 for all" << endl;
+                    return 1;
+                }
+                top = static_cast<size_t>(number);
+                i++;
+            }
+            else if (strcmp(argv[i], "--approximate") == 0 && i + 1 < argc) {
+                approximate = static_cast<size_t>(atof(argv[i + 1]) * 1024 * 1024); // Get memory of the sketch
+                if (approximate == 0) {
+                    cout << "Error: Invalid memory for --approximate" << endl;
+                    return 1;
+                }
+                i++;
+            }
             else {
                 target_dir = argv[i]; // Treat others as target directory
             }
         }
 
-        WordCounter counter; // Create a WordCounter object
-
         // Print error if no target directory specified
         if (target_dir.empty()) {
             cout << "Error: No target directory specified" << endl;
@@ -79,32 +207,29 @@ int main(int argc, char* argv[]) {
         }
 
         vector<string> files = get_files(target_dir); // Get all .html files in the target directory
-        for (const string& file : files) { // Iterate over all files
-            ifstream input(file); // Open the file
-            if (!input.is_open()) { // Handle error if file cannot be opened
+        vector<string> failed;
+        auto print_counts = [&](const auto& counter) {
+            for (const string& file : failed) { // Handle error if file cannot be opened
                 cout << "Warning: Cannot open file " << file << ", ignored" << endl;
-                continue;
             }
-            while (input) { // Iterate over all words in the file
-                string word = tokenize(input);
-                if (word.empty()) { // Handle empty word
-                    continue;
-                }
-                counter.add_word(word); // Add word to the counter
-            }
-            input.close(); // Close the file
-        }
 
-        // Print results based on whether an output file is specified
-        if (output.empty()) {
-            counter.print(cout); // Print to console
+            // Print results based on whether an output file is specified
+            if (output.empty()) {
+                counter.print(cout, top); // Print to console
+            }
+            else {
+                filesystem::path output_path(output);
+                filesystem::create_directories(output_path.parent_path()); // Create output directory
+                ofstream output_file(output); // Open output file
+                counter.print(output_file, top); // Print to file
+                output_file.close(); // Close output file
+            }
+        };
+        if (approximate) {
+            print_counts(WordSketch::count_files(files, approximate, threads, &failed)); // Count in fixed memory
         }
         else {
-            filesystem::path output_path(output);
-            filesystem::create_directories(output_path.parent_path()); // Create output directory
-            ofstream output_file(output); // Open output file
-            counter.print(output_file); // Print to file
-            output_file.close(); // Close output file
+            print_counts(WordCounter::count_files(files, threads, &failed)); // Count in parallel
         }
         return 0;
     }
@@ -112,57 +237,270 @@ int main(int argc, char* argv[]) {
     // Handle index command
     if (argc >= 3 && strcmp(argv[1], "index") == 0) {
         bool large_mode = false; // Default to not using large mode
+        bool update_mode = false; // Default to a full build
+        bool profile_mode = false; // Default to no profile summary
+        string trace_file; // Chrome trace output, none by default
+        IndexPipeline::Options pipeline; // Default read-ahead
+        DirWalker::Options walk; // Default parallel walk, in path order
         StopFilter* stop_filter = nullptr; // Pointer for stop word filter
         for (int i = 2; i < argc; i++) {
             if ((strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--large") == 0)) {
                 large_mode = true; // Set to large mode
             }
+            else if (strcmp(argv[i], "-u") == 0 || strcmp(argv[i], "--update") == 0) {
+                update_mode = true; // Only index changed files
+            }
             else if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--stop") == 0) && i + 1 < argc) {
                 stop_filter = new StopFilter(argv[i + 1]); // Create stop word filter
                 i++;
             }
+            else if (strcmp(argv[i], "--profile") == 0) {
+                profile_mode = true; // Print the time and counters of each phase
+            }
+            else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+                trace_file = argv[i + 1]; // Write a Chrome trace of the build
+                i++;
+            }
+            else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, MAX_THREADS, number)) { // Get the number of reader threads
+                    cout << "Error: Readers must be a number from 0 to " << MAX_THREADS << endl;
+                    return 1;
+                }
+                pipeline.readers = static_cast<unsigned>(number);
+                i++;
+            }
+            else if (strcmp(argv[i], "--read-ahead") == 0 && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 1, MAX_READ_AHEAD, number)) { // Get the number of chunks read ahead
+                    cout << "Error: Read-ahead must be a number from 1 to " << MAX_READ_AHEAD << endl;
+                    return 1;
+                }
+                pipeline.read_ahead = static_cast<size_t>(number);
+                i++;
+            }
+            else if (strcmp(argv[i], "--walk-threads") == 0 && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, MAX_THREADS, number)) { // Get the number of threads listing directories
+                    cout << "Error: Walk threads must be a number from 0 to " << MAX_THREADS << endl;
+                    return 1;
+                }
+                walk.threads = static_cast<unsigned>(number);
+                i++;
+            }
+            else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, MAX_MEGABYTES, number)) { // Get the size of the files tokenized in parallel
+                    cout << "Error: Split size must be a number of MB from 0 to " << MAX_MEGABYTES << endl;
+                    return 1;
+                }
+                pipeline.split_bytes = static_cast<size_t>(number) << 20;
+                i++;
+            }
+            else if (strcmp(argv[i], "--split-threads") == 0 && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, MAX_THREADS, number)) { // Get the number of threads tokenizing a large file
+                    cout << "Error: Split threads must be a number from 0 to " << MAX_THREADS << endl;
+                    return 1;
+                }
+                pipeline.split_threads = static_cast<unsigned>(number);
+                i++;
+            }
+            else if (strcmp(argv[i], "--inversion") == 0 && i + 1 < argc) {
+                if (strcmp(argv[i + 1], "sort") == 0) pipeline.inversion = IndexPipeline::SORT; // Sort (term, document) pairs
+                else if (strcmp(argv[i + 1], "map") == 0) pipeline.inversion = IndexPipeline::MAP;
+                else {
+                    cout << "Error: Unknown inversion " << argv[i + 1] << endl;
+                    return 1;
+                }
+                i++;
+            }
+            else if (strcmp(argv[i], "--sort-buffer") == 0 && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 1, MAX_MEGABYTES, number)) { // Get the size of the pair buffer
+                    cout << "Error: Sort buffer must be a number of MB from 1 to " << MAX_MEGABYTES << endl;
+                    return 1;
+                }
+                pipeline.sort.buffer_pairs = (static_cast<size_t>(number) << 20) / sizeof(uint64_t);
+                i++;
+            }
+            else if (strcmp(argv[i], "--discovery-order") == 0) {
+                walk.order = DirWalker::DISCOVERY; // Number files as they are found
+            }
             else {
                 target_dir = argv[i]; // Treat others as target directory
             }
         }
 
+        IndexProfile profile(!trace_file.empty());
+        unique_ptr<IndexProfile::Activation> activation; // active while the index is built
+        bool profiling = profile_mode || !trace_file.empty();
+        auto report_profile = [&] {
+            activation.reset(); // stop profiling, so the total time is recorded
+            if (profile_mode) profile.write_summary(cout);
+            if (!trace_file.empty() && !profile.write_trace(trace_file)) {
+                cout << "Error: Cannot write trace file " << trace_file << endl;
+                return 1;
+            }
+            return 0;
+        };
+
         filesystem::path dir(target_dir);
         if (!filesystem::exists(dir)) { // Check if target directory exists
             cout << "Error: Target directory does not exist" << endl;
             return 1;
         }
+        if (filesystem::is_regular_file(dir)) {
+            ArchiveReader archive(dir); // check the archive before asking to rebuild
+            if (!archive.is_open()) {
+                cout << "Error: " << archive.error() << endl;
+                return 1;
+            }
+        }
+
+        if (update_mode) {
+            if (profiling) activation = make_unique<IndexProfile::Activation>(profile);
+            if (!SearchEngine::update_index(target_dir, stop_filter, false, pipeline, walk)) return 1; // the error is printed
+            cout << "Index updated" << endl;
+            return report_profile();
+        }
 
         // Check if index already exists
-        if (filesystem::exists(dir / BASE_DIR)) {
-            cout << "Index exists. Delete and rebuild? (y/N): " << flush;
+        if (filesystem::exists(index_folder(dir))) { // An archive has its own index, next to it
+            cout << "Index exists. Rebuild? (y/N): " << flush;
             string ans;
             getline(cin, ans);
-            if (!ans.empty() && (ans[0] == 'y' || ans[0] == 'Y')) {
-                filesystem::remove_all(dir / BASE_DIR); // Remove existing index
-            }
-            else {
+            if (ans.empty() || (ans[0] != 'y' && ans[0] != 'Y')) {
                 return 0; // User chose not to rebuild
             }
+            // The new index is published as a new generation, the old one is kept for running readers
         }
 
         // Generate index based on mode
-        if (large_mode) SearchEngine::gen_index_large(target_dir, stop_filter);
-        else SearchEngine::gen_index(target_dir, stop_filter);
+        if (profiling) activation = make_unique<IndexProfile::Activation>(profile);
+        if (large_mode) SearchEngine::gen_index_large(target_dir, stop_filter, false, pipeline, walk);
+        else SearchEngine::gen_index(target_dir, stop_filter, false, pipeline, walk);
         cout << "Index generated" << endl;
+        return report_profile();
+    }
+
+    // Handle compact command
+    if (argc >= 3 && strcmp(argv[1], "compact") == 0) {
+        SearchEngine::CompactionPolicy policy;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+                policy.rate_limit = static_cast<uint64_t>(atof(argv[i + 1]) * 1024 * 1024); // Get write rate in MB/s
+                i++;
+            }
+            else if (strcmp(argv[i], "--fanout") == 0 && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 2, MAX_FANOUT, number)) { // Get number of segments merged at once
+                    cout << "Error: Fanout must be a number from 2 to " << MAX_FANOUT << endl;
+                    return 1;
+                }
+                policy.fanout = static_cast<size_t>(number);
+                i++;
+            }
+            else {
+                target_dir = argv[i]; // Treat others as target directory
+            }
+        }
+
+        filesystem::path dir(target_dir);
+        if (!filesystem::exists(index_folder(dir))) { // Check if index exists
+            cout << "Error: No index found, please generate index first" << endl;
+            return 1;
+        }
+        size_t steps = 0;
+        while (SearchEngine::compact_index(dir, policy)) steps++; // Merge until the policy is satisfied
+        if (steps == 0) cout << "Nothing to compact" << endl;
+        return 0;
+    }
+
+    // Handle index-stats command
+    if (argc >= 3 && strcmp(argv[1], "index-stats") == 0) {
+        filesystem::path target(argv[2]);
+        vector<filesystem::path> files;
+        if (filesystem::exists(index_folder(target))) {
+            files = SearchEngine::index_files(target); // Every segment of the published generation, of a directory or an archive
+        }
+        else if (filesystem::is_regular_file(target)) {
+            files.push_back(target); // A single index file, e.g. a segment's index.dat
+        }
+        else {
+            cout << "Error: No index found, please generate index first" << endl;
+            return 1;
+        }
+
+        IndexStats stats;
+        for (auto& file : files) {
+            if (!stats.add_file(file)) {
+                cout << "Error: Cannot read index file " << file.string() << endl;
+                return 1;
+            }
+        }
+        stats.print(cout);
         return 0;
     }
 
     // Handle search command
     if (argc >= 3 && strcmp(argv[1], "search") == 0) {
         string query; // Store query string
-        double threshold = 1.0; // Default threshold is 1.0
+        SearchEngine::SearchOptions options; // Default is exact matching with threshold 1.0, all results
+        string batch_file; // Batch mode if not empty
+        unsigned threads = 0; // Default is one thread per core
+        bool shared = false; // Default is to fetch terms per query
+        bool explain = false; // Default is to print only the results
+        bool memory_stats = false; // Default is not to report memory usage
+        uint64_t memory_limit = 0; // Default is no memory limit
         for (int i = 2; i < argc; i++) {
             if ((strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--query") == 0)) {
                 query = argv[i + 1]; // Get query string
                 i++;
             }
             else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threshold") == 0) && i + 1 < argc) {
-                threshold = atof(argv[i + 1]); // Get threshold value
+                options.threshold = atof(argv[i + 1]); // Get threshold value
+                i++;
+            }
+            else if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--fuzzy") == 0) && i + 1 < argc) {
+                if (!parse_fuzzy(argv[i + 1], options.fuzzy)) { // Get maximum edit distance
+                    cout << "Error: Fuzzy edit distance must be 0, 1 or 2" << endl;
+                    return 1;
+                }
+                i++;
+            }
+            else if ((strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--batch") == 0) && i + 1 < argc) {
+                batch_file = argv[i + 1]; // Get queries file
+                i++;
+            }
+            else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, MAX_THREADS, number)) { // Get number of threads
+                    cout << "Error: Threads must be a number from 0 to " << MAX_THREADS << endl;
+                    return 1;
+                }
+                threads = static_cast<unsigned>(number);
+                i++;
+            }
+            else if (strcmp(argv[i], "--shared") == 0) {
+                shared = true; // Share term fetches across the batch
+            }
+            else if (strcmp(argv[i], "--explain") == 0) {
+                explain = true; // Print how each query was evaluated
+            }
+            else if (strcmp(argv[i], "--stats") == 0) {
+                memory_stats = true; // Print the memory used by each component
+            }
+            else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+                memory_limit = static_cast<uint64_t>(atof(argv[i + 1]) * 1024 * 1024); // Get memory limit in MB
+                i++;
+            }
+            else if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc) {
+                options.offset = static_cast<size_t>(atoll(argv[i + 1])); // Get number of results to skip
+                i++;
+            }
+            else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+                options.limit = static_cast<size_t>(atoll(argv[i + 1])); // Get number of results to print
                 i++;
             }
             else {
@@ -177,14 +515,38 @@ int main(int argc, char* argv[]) {
         }
 
         // Check if index exists
-        if (!filesystem::exists(dir / BASE_DIR)) {
+        if (!filesystem::exists(index_folder(dir))) {
             cout << "Error: No index found, please generate index first" << endl;
             return 1;
         }
 
         SearchEngine engine(dir); // Create SearchEngine object
-        if (!query.empty()) {
-            engine.search(query, cout, threshold); // Search based on query string
+        engine.set_memory_limit(memory_limit);
+        if (memory_limit && engine.memory_budget() == 0) {
+            cout << "Error: The index needs " << engine.memory_usage().total() << " bytes of memory, over the memory limit" << endl;
+            return 1;
+        }
+        if (memory_stats) engine.memory_usage().print(cerr); // Keep stdout for the results
+        if (!batch_file.empty()) {
+            ifstream batch_fs(batch_file);
+            if (!batch_fs.is_open()) {
+                cout << "Error: Cannot open queries file " << batch_file << endl;
+                return 1;
+            }
+            vector<string> queries;
+            string line;
+            while (getline(batch_fs, line)) {
+                if (!line.empty()) queries.push_back(line); // One query per line
+            }
+            SearchEngine::BatchStats stats = engine.search_batch(queries, cout, options, threads, shared);
+            stats.print(cerr); // Keep stdout for the results
+            return 0;
+        }
+        else if (!query.empty()) {
+            SearchEngine::QueryExplain explanation;
+            options.explain = explain ? &explanation : nullptr;
+            engine.search(query, cout, options); // Search based on query string
+            if (explain) explanation.print(cout);
             return 0;
         }
         else {
@@ -196,10 +558,163 @@ int main(int argc, char* argv[]) {
                 if (line.empty() || line == "/q") {
                     break; // User chose to exit
                 }
-                engine.search(line, cout, threshold); // Perform search
+                SearchEngine::QueryExplain explanation;
+                options.explain = explain ? &explanation : nullptr;
+                engine.search(line, cout, options); // Perform search
+                if (explain) explanation.print(cout);
+            }
+            return 0;
+        }
+    }
+
+    // Handle serve command
+    if (argc >= 3 && strcmp(argv[1], "serve") == 0) {
+        SearchServer::Options options;
+        long reload_interval = 1000; // Default is to check for a new index every second
+        long compact_interval = 60000; // Default is to look for segments to merge every minute
+        SearchEngine::CompactionPolicy policy;
+        policy.rate_limit = 16 * 1024 * 1024; // Default is to write at most 16 MB/s while serving
+        bool realtime = false; // Default is to only serve published generations
+        RealtimeIndexer::Options realtime_options;
+        bool memory_stats = false; // Default is not to report memory usage
+        uint64_t memory_limit = 0; // Default is no memory limit
+        for (int i = 2; i < argc; i++) {
+            if ((strcmp(argv[i], "-S") == 0 || strcmp(argv[i], "--socket") == 0) && i + 1 < argc) {
+                options.socket_path = argv[i + 1]; // Get socket path
+                i++;
+            }
+            else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+                uint64_t number = 0;
+                if (!parse_number(argv[i + 1], 0, MAX_THREADS, number)) { // Get number of threads
+                    cout << "Error: Threads must be a number from 0 to " << MAX_THREADS << endl;
+                    return 1;
+                }
+                options.threads = static_cast<unsigned>(number);
+                i++;
+            }
+            else if (strcmp(argv[i], "--max-pending") == 0 && i + 1 < argc) {
+                options.max_pending = static_cast<size_t>(atoll(argv[i + 1])); // Get admission limit
+                i++;
+            }
+            else if (strcmp(argv[i], "--reload-interval") == 0 && i + 1 < argc) {
+                reload_interval = atol(argv[i + 1]); // Get reload interval in milliseconds
+                i++;
+            }
+            else if (strcmp(argv[i], "--compact-interval") == 0 && i + 1 < argc) {
+                compact_interval = atol(argv[i + 1]); // Get compaction interval in milliseconds
+                i++;
+            }
+            else if (strcmp(argv[i], "--realtime") == 0) {
+                realtime = true; // Watch the target directory
+            }
+            else if (strcmp(argv[i], "--flush-size") == 0 && i + 1 < argc) {
+                realtime_options.flush_bytes = static_cast<uint64_t>(atof(argv[i + 1]) * 1024 * 1024); // Get flush size in MB
+                i++;
+            }
+            else if (strcmp(argv[i], "--stats") == 0) {
+                memory_stats = true; // Print the memory used by each component
+            }
+            else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+                memory_limit = static_cast<uint64_t>(atof(argv[i + 1]) * 1024 * 1024); // Get memory limit in MB
+                i++;
+            }
+            else if (strcmp(argv[i], "--compact-rate") == 0 && i + 1 < argc) {
+                policy.rate_limit = static_cast<uint64_t>(atof(argv[i + 1]) * 1024 * 1024); // Get compaction write rate in MB/s
+                i++;
+            }
+            else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threshold") == 0) && i + 1 < argc) {
+                options.threshold = atof(argv[i + 1]); // Get threshold value
+                i++;
+            }
+            else if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--fuzzy") == 0) && i + 1 < argc) {
+                if (!parse_fuzzy(argv[i + 1], options.fuzzy)) { // Get maximum edit distance
+                    cout << "Error: Fuzzy edit distance must be 0, 1 or 2" << endl;
+                    return 1;
+                }
+                i++;
+            }
+            else {
+                target_dir = argv[i]; // Treat others as target directory
+            }
+        }
+
+        filesystem::path dir(target_dir);
+        if (!filesystem::exists(index_folder(dir))) { // Check if index exists
+            cout << "Error: No index found, please generate index first" << endl;
+            return 1;
+        }
+        if (options.socket_path.empty()) {
+            options.socket_path = (index_folder(dir) / SOCKET_FILE_NAME).string(); // Default socket path
+        }
+
+        HotSwapEngine engine(dir, memory_limit); // Load the index once
+        if (memory_limit && engine.acquire()->memory_budget() == 0) {
+            cout << "Error: The index needs " << engine.acquire()->memory_usage().total() << " bytes of memory, over the memory limit" << endl;
+            return 1;
+        }
+        if (memory_stats) engine.acquire()->memory_usage().print(cout);
+        engine.watch(chrono::milliseconds(reload_interval)); // Swap in newly published generations
+        Compactor compactor(dir, policy);
+        compactor.start(chrono::milliseconds(compact_interval)); // Merge segments in the background
+        RealtimeIndexer indexer(engine, realtime_options);
+        if (realtime && !indexer.start()) { // Index changed files as they are written
+            return 1;
+        }
+        SearchServer server(engine, options);
+        if (!server.listen()) {
+            return 1;
+        }
+        running_server = &server;
+        running_engine = &engine;
+        signal(SIGINT, stop_server);
+        signal(SIGTERM, stop_server);
+        signal(SIGHUP, reload_engine);
+        cout << "Listening on " << options.socket_path << endl;
+        server.run(); // Serve until interrupted
+        running_server = nullptr;
+        running_engine = nullptr;
+        return 0;
+    }
+
+    // Handle client command
+    if (argc >= 3 && strcmp(argv[1], "client") == 0) {
+        string query; // Store query string
+        for (int i = 2; i < argc; i++) {
+            if ((strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--query") == 0) && i + 1 < argc) {
+                query = argv[i + 1]; // Get query string
+                i++;
+            }
+            else {
+                target_dir = argv[i]; // Treat others as target directory or socket path
+            }
+        }
+
+        filesystem::path socket_path(target_dir);
+        if (filesystem::is_directory(socket_path) || filesystem::is_regular_file(socket_path)) {
+            socket_path = index_folder(socket_path) / SOCKET_FILE_NAME; // Default socket of the directory or archive
+        }
+
+        if (!query.empty()) {
+            if (!SearchServer::query(socket_path.string(), query, cout)) {
+                cout << "Error: Cannot connect to server at " << socket_path.string() << endl;
+                return 1;
             }
             return 0;
         }
+        // Interactive mode
+        while (true) {
+            cout << "Enter query (or '/q' to quit): " << flush;
+            string line;
+            getline(cin, line);
+            if (line.empty() || line == "/q") {
+                break; // User chose to exit
+            }
+            if (!SearchServer::query(socket_path.string(), line, cout)) {
+                cout << "Error: Cannot connect to server at " << socket_path.string() << endl;
+                return 1;
+            }
+        }
+        return 0;
     }
 
     cout << "Unknown command" << endl; // Handle unknown command
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <map>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+/**
+ * @file Benchmark.h
+ * @brief A minimal microbenchmark harness shared by the programs in bench/.
+ *
+ * An operation is a function returning the number of input bytes it processed. It is run
+ * in batches whose size is calibrated to take about min_time / repetitions, and the median
+ * of the repetitions is reported, which is robust against a few noisy runs.
+ *
+ * Heap allocations are counted by the global operator new of the benchmark program, which
+ * increments allocation_count. A program that does not replace operator new reports 0.
+ */
+
+extern std::atomic<uint64_t> allocation_count; ///< The number of heap allocations so far.
+
+/**
+ * @brief Keep the compiler from optimizing away a value computed by a benchmark.
+ * @param value The value.
+ */
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief The result of one benchmark.
+ */
+struct BenchResult {
+    std::string name; ///< The name of the benchmark.
+    uint64_t iterations = 0; ///< The number of operations of one repetition.
+    double ns_per_op = 0; ///< The median time of one operation, in nanoseconds.
+    double bytes_per_second = 0; ///< The input bytes processed per second, 0 if not meaningful.
+    double allocs_per_op = 0; ///< The heap allocations of one operation.
+};
+
+/**
+ * @brief Run a benchmark.
+ * @param name The name of the benchmark.
+ * @param op The operation, returns the number of input bytes it processed.
+ * @param min_time The minimum total time to spend measuring, in seconds.
+ * @param repetitions The number of measured repetitions, the median is reported.
+ * @return The result.
+ */
+inline BenchResult run_benchmark(const std::string& name, const std::function<uint64_t()>& op, double min_time = 0.5, int repetitions = 5) {
+    using clock = std::chrono::steady_clock;
+    op(); // warm up caches and lazily built state
+
+    // calibrate the batch size, doubling it until one batch takes long enough
+    double batch_time = min_time / repetitions;
+    uint64_t iterations = 1;
+    while (true) {
+        auto start = clock::now();
+        for (uint64_t i = 0; i < iterations; i++) op();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds >= batch_time || iterations >= (uint64_t(1) << 30)) break;
+        iterations *= seconds < batch_time / 10 ? 10 : 2;
+    }
+
+    std::vector<double> times;
+    uint64_t bytes = 0, allocs = 0;
+    for (int r = 0; r < repetitions; r++) {
+        uint64_t allocs_before = allocation_count.load(std::memory_order_relaxed);
+        auto start = clock::now();
+        for (uint64_t i = 0; i < iterations; i++) bytes += op();
+        times.push_back(std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations);
+        allocs += allocation_count.load(std::memory_order_relaxed) - allocs_before;
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.ns_per_op = times[times.size() / 2];
+    double bytes_per_op = static_cast<double>(bytes) / (iterations * repetitions);
+    result.bytes_per_second = bytes_per_op * 1e9 / result.ns_per_op;
+    result.allocs_per_op = static_cast<double>(allocs) / (iterations * repetitions);
+    return result;
+}
+
+/**
+ * @brief Print results as a table.
+ * @param results The results.
+ * @param output The output stream.
+ */
+inline void print_results(const std::vector<BenchResult>& results, std::ostream& output) {
+    output << std::left << std::setw(28) << "benchmark" << std::right
+        << std::setw(14) << "ns/op" << std::setw(14) << "MB/s" << std::setw(14) << "allocs/op"
+        << std::setw(14) << "iterations" << std::endl;
+    for (auto& r : results) {
+        output << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << r.ns_per_op
+            << std::setw(14) << r.bytes_per_second / (1024 * 1024)
+            << std::setw(14) << std::setprecision(2) << r.allocs_per_op
+            << std::setw(14) << r.iterations << std::endl;
+    }
+    output.unsetf(std::ios::fixed);
+}
+
+/**
+ * @brief Save results as JSON.
+ * @param results The results.
+ * @param filename The JSON file.
+ *
+ * The format is `{"benchmarks": [{"name": ..., "ns_per_op": ..., ...}, ...]}`.
+ */
+inline void save_results(const std::vector<BenchResult>& results, const std::string& filename) {
+    std::ofstream output(filename);
+    output << "{\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        output << std::setprecision(10)
+            << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << r.ns_per_op << ", \"bytes_per_second\": " << r.bytes_per_second
+            << ", \"allocs_per_op\": " << r.allocs_per_op << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    output << "  ]\n}\n";
+}
+
+/**
+ * @brief Read results saved by save_results.
+ * @param filename The JSON file.
+ * @return The results by name, empty if the file cannot be read.
+ *
+ * This is not a general JSON parser, it only reads the flat objects save_results writes.
+ */
+inline std::map<std::string, BenchResult> load_results(const std::string& filename) {
+    std::map<std::string, BenchResult> results;
+    std::ifstream input(filename);
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    std::string text = buffer.str();
+
+    auto number = [](const std::string& object, const std::string& key) {
+        std::size_t pos = object.find("\"" + key + "\":");
+        return pos == std::string::npos ? 0.0 : std::strtod(object.c_str() + pos + key.size() + 3, nullptr);
+    };
+    std::size_t pos = 0;
+    while ((pos = text.find('{', pos + 1)) != std::string::npos) {
+        std::size_t end = text.find('}', pos);
+        if (end == std::string::npos) break;
+        std::string object = text.substr(pos, end - pos);
+        std::size_t name = object.find("\"name\": \"");
+        if (name != std::string::npos) {
+            BenchResult r;
+            name += 9;
+            r.name = object.substr(name, object.find('"', name) - name);
+            r.iterations = static_cast<uint64_t>(number(object, "iterations"));
+            r.ns_per_op = number(object, "ns_per_op");
+            r.bytes_per_second = number(object, "bytes_per_second");
+            r.allocs_per_op = number(object, "allocs_per_op");
+            results[r.name] = r;
+        }
+        pos = end;
+    }
+    return results;
+}
+
+/**
+ * @brief Compare results with a baseline and print the differences.
+ * @param results The new results.
+ * @param baseline The baseline results by name.
+ * @param tolerance The allowed slowdown, e.g. 0.1 for 10%.
+ * @param output The output stream.
+ * @return The number of regressions: slower than the tolerance, or more allocations per operation.
+ */
+inline int compare_results(const std::vector<BenchResult>& results, const std::map<std::string, BenchResult>& baseline, double tolerance, std::ostream& output) {
+    int regressions = 0;
+    output << std::left << std::setw(28) << "benchmark" << std::right
+        << std::setw(14) << "baseline" << std::setw(14) << "ns/op" << std::setw(10) << "change" << "  status" << std::endl;
+    for (auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            output << std::left << std::setw(28) << r.name << std::right << std::setw(14) << "-"
+                << std::setw(14) << std::fixed << std::setprecision(1) << r.ns_per_op << std::setw(10) << "-" << "  new" << std::endl;
+            continue;
+        }
+        double change = r.ns_per_op / it->second.ns_per_op - 1;
+        bool slower = change > tolerance;
+        bool more_allocs = r.allocs_per_op > it->second.allocs_per_op + 0.5;
+        const char* status = slower ? "REGRESSION" : more_allocs ? "REGRESSION (allocs)" : change < -tolerance ? "faster" : "ok";
+        if (slower || more_allocs) regressions++;
+        output << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << it->second.ns_per_op << std::setw(14) << r.ns_per_op
+            << std::setw(9) << std::showpos << change * 100 << "%" << std::noshowpos << "  " << status << std::endl;
+    }
+    output.unsetf(std::ios::fixed);
+    return regressions;
+}
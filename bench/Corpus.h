@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+/**
+ * @file Corpus.h
+ * @brief A deterministic generator of synthetic HTML corpora, shared by the programs in bench/.
+ *
+ * Words are drawn from a Zipfian distribution over a generated vocabulary, whose first ranks are
+ * common English stop words like in real text. Document lengths follow a log-normal distribution.
+ * Every document is generated from its own seed, so document i is the same whatever the number of
+ * documents, and a corpus is reproduced exactly from its options.
+ */
+
+/**
+ * @brief The options of a synthetic corpus.
+ */
+struct CorpusOptions {
+    uint64_t seed = 42; ///< The random seed.
+    std::size_t documents = 1000; ///< The number of documents, ignored if target_bytes is set.
+    uint64_t target_bytes = 0; ///< If not 0, generate documents until the corpus reaches this size.
+    std::size_t vocabulary = 100000; ///< The number of distinct words.
+    double zipf_exponent = 1.0; ///< The exponent s of the Zipfian distribution, P(rank k) ~ 1 / k^s.
+    double median_words = 600; ///< The median number of words of a document.
+    double length_sigma = 1.0; ///< The sigma of the log-normal distribution of document lengths.
+    double tag_density = 0.1; ///< The probability of a tag after each word.
+    std::size_t docs_per_dir = 1000; ///< The number of documents of each subdirectory.
+};
+
+/**
+ * @brief Generates the documents of a synthetic corpus.
+ */
+class CorpusGenerator {
+public:
+    /**
+     * @brief Construct a generator, building the vocabulary and the Zipfian distribution.
+     * @param options The options of the corpus.
+     */
+    explicit CorpusGenerator(const CorpusOptions& options) : options(options) {
+        static const char* stop_words[] = { "the", "of", "and", "to", "a", "in", "is", "that", "it", "was",
+            "for", "on", "with", "as", "he", "be", "by", "at", "his", "this", "not", "are", "from", "or" };
+        static const char* suffixes[] = { "", "", "", "s", "ing", "ed", "ly", "ness", "ation", "er" };
+        std::mt19937_64 rng(options.seed);
+        std::uniform_int_distribution<int> len_dist(3, 10);
+        for (const char* word : stop_words) {
+            if (words.size() < options.vocabulary) words.push_back(word);
+        }
+        while (words.size() < options.vocabulary) {
+            std::string word(len_dist(rng), 'a');
+            for (char& ch : word) ch = static_cast<char>('a' + rng() % 26);
+            words.push_back(word + suffixes[rng() % 10]); // suffixes give the stemmer some work
+        }
+
+        cdf.reserve(words.size());
+        double sum = 0;
+        for (std::size_t rank = 1; rank <= words.size(); rank++) {
+            sum += 1.0 / std::pow(static_cast<double>(rank), options.zipf_exponent);
+            cdf.push_back(sum);
+        }
+        for (double& p : cdf) p /= sum;
+    }
+
+    /**
+     * @brief Generate a document.
+     * @param index The index of the document.
+     * @return The HTML document.
+     */
+    std::string document(std::size_t index) const {
+        static const char* tags[] = { "p", "b", "i", "em", "a", "span", "div", "h2", "li", "td" };
+        std::mt19937_64 rng(options.seed ^ (0x9E3779B97F4A7C15ull * (index + 1)));
+        std::uniform_real_distribution<double> uniform(0, 1);
+        std::lognormal_distribution<double> length_dist(std::log(options.median_words), options.length_sigma);
+        auto length = static_cast<std::size_t>(length_dist(rng)) + 1;
+
+        std::string html = "<html><head><title>Document " + std::to_string(index) + "</title></head>\n<body>\n";
+        html.reserve(html.size() + length * 9);
+        for (std::size_t i = 0; i < length; i++) {
+            html += word(uniform(rng));
+            if (uniform(rng) < options.tag_density) {
+                const char* tag = tags[rng() % 10];
+                html += rng() % 2 ? "\n<" : " </";
+                html += tag;
+                if (tag[0] == 'a' && rng() % 2) html += " href=\"page" + std::to_string(rng() % 1000) + ".html\"";
+                html += "> ";
+            } else {
+                html += ' ';
+            }
+        }
+        html += "\n</body></html>\n";
+        return html;
+    }
+
+    /**
+     * @brief Generate a query, with the same term frequency skew as the documents.
+     * @param rng The random generator.
+     * @param terms The number of words of the query.
+     * @return The words separated by spaces.
+     */
+    std::string query(std::mt19937_64& rng, std::size_t terms) const {
+        std::uniform_real_distribution<double> uniform(0, 1);
+        std::string text;
+        for (std::size_t i = 0; i < terms; i++) {
+            if (i > 0) text += ' ';
+            text += word(uniform(rng));
+        }
+        return text;
+    }
+
+    /**
+     * @brief Get the path of a document in the corpus.
+     * @param dir The corpus directory.
+     * @param index The index of the document.
+     * @return `dir/dNNNN/docNNNNNNNN.html`.
+     */
+    std::filesystem::path document_path(const std::filesystem::path& dir, std::size_t index) const {
+        char subdir[32], name[32];
+        snprintf(subdir, sizeof(subdir), "d%04zu", index / options.docs_per_dir);
+        snprintf(name, sizeof(name), "doc%08zu.html", index);
+        return dir / subdir / name;
+    }
+
+    /**
+     * @brief Write the corpus.
+     * @param dir The corpus directory, created if needed.
+     * @return The number of documents and the number of bytes written.
+     */
+    std::pair<std::size_t, uint64_t> generate(const std::filesystem::path& dir) const {
+        std::size_t count = 0;
+        uint64_t bytes = 0;
+        while (options.target_bytes ? bytes < options.target_bytes : count < options.documents) {
+            std::filesystem::path path = document_path(dir, count);
+            if (count % options.docs_per_dir == 0) std::filesystem::create_directories(path.parent_path());
+            std::string html = document(count);
+            std::ofstream(path, std::ios::binary) << html;
+            bytes += html.size();
+            count++;
+        }
+        return { count, bytes };
+    }
+
+private:
+    /**
+     * @brief Get the word of a point of the Zipfian distribution.
+     * @param p A uniform number in [0, 1).
+     * @return The word.
+     */
+    const std::string& word(double p) const {
+        std::size_t rank = std::upper_bound(cdf.begin(), cdf.end(), p) - cdf.begin();
+        return words[std::min(rank, words.size() - 1)];
+    }
+
+    CorpusOptions options; ///< The options of the corpus.
+    std::vector<std::string> words; ///< The vocabulary, by rank.
+    std::vector<double> cdf; ///< The cumulative probability of each rank.
+};
+
+/**
+ * @brief Parse a corpus option from the command line.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param i The index of the current argument, advanced past its value if it is a corpus option.
+ * @param options The options to update.
+ * @return Whether the argument is a corpus option.
+ */
+inline bool parse_corpus_option(int argc, char* argv[], int& i, CorpusOptions& options) {
+    if (i + 1 >= argc) return false;
+    std::string arg = argv[i];
+    const char* value = argv[i + 1];
+    if (arg == "--seed") options.seed = std::strtoull(value, nullptr, 10);
+    else if (arg == "--vocabulary") options.vocabulary = std::max<std::size_t>(1, std::strtoull(value, nullptr, 10));
+    else if (arg == "--zipf") options.zipf_exponent = std::atof(value);
+    else if (arg == "--median-words") options.median_words = std::max(1.0, std::atof(value));
+    else if (arg == "--length-sigma") options.length_sigma = std::atof(value);
+    else if (arg == "--tag-density") options.tag_density = std::atof(value);
+    else return false;
+    i++;
+    return true;
+}
+
+/// The usage of the corpus options, see parse_corpus_option.
+#define CORPUS_OPTIONS_USAGE "[--seed n] [--vocabulary n] [--zipf s] [--median-words n] [--length-sigma x] [--tag-density p]"
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * @file Histogram.h
+ * @brief A latency histogram with a bounded relative error, in the style of HdrHistogram.
+ *
+ * Values below 128 have their own bucket. Larger values keep their 7 most significant bits, so
+ * each power of two range is split in 64 buckets and a recorded value is known within 1/64
+ * (1.6%) whatever its magnitude. The histogram has a fixed size of a few thousand counters, so
+ * recording is O(1) and histograms of several threads are merged by adding their counters.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts(BUCKETS, 0) {}
+
+    /**
+     * @brief Record a value.
+     * @param value The value, e.g. a latency in nanoseconds.
+     */
+    void record(uint64_t value) {
+        counts[bucket(value)]++;
+        total++;
+        sum += static_cast<double>(value);
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    /**
+     * @brief Add the values of another histogram.
+     * @param other The other histogram.
+     */
+    void merge(const LatencyHistogram& other) {
+        for (std::size_t i = 0; i < BUCKETS; i++) counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    /**
+     * @brief Get a percentile.
+     * @param percent The percentile, e.g. 99.9.
+     * @return The highest value of the bucket holding the percentile, 0 if the histogram is empty.
+     */
+    uint64_t percentile(double percent) const {
+        if (total == 0) return 0;
+        auto rank = static_cast<uint64_t>(std::ceil(percent / 100 * static_cast<double>(total)));
+        rank = std::max<uint64_t>(1, std::min(rank, total));
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(highest_value(i), max_value);
+        }
+        return max_value;
+    }
+
+    uint64_t count() const { return total; } ///< The number of recorded values.
+    uint64_t min() const { return total ? min_value : 0; } ///< The smallest recorded value.
+    uint64_t max() const { return max_value; } ///< The largest recorded value.
+    double mean() const { return total ? sum / static_cast<double>(total) : 0; } ///< The mean of the recorded values.
+
+private:
+    static constexpr std::size_t SUB_BUCKETS = 64; ///< The number of buckets of each power of two range.
+    static constexpr std::size_t BUCKETS = SUB_BUCKETS * 59; ///< Enough buckets for any uint64_t.
+
+    /**
+     * @brief Get the bucket of a value.
+     * @param value The value.
+     * @return The index of its bucket.
+     */
+    static std::size_t bucket(uint64_t value) {
+        if (value < 2 * SUB_BUCKETS) return static_cast<std::size_t>(value);
+        int shift = 63 - __builtin_clzll(value) - 6; // keep the 7 most significant bits
+        return static_cast<std::size_t>(shift) * SUB_BUCKETS + static_cast<std::size_t>(value >> shift);
+    }
+
+    /**
+     * @brief Get the highest value of a bucket.
+     * @param index The index of the bucket.
+     * @return The highest value mapped to the bucket.
+     */
+    static uint64_t highest_value(std::size_t index) {
+        if (index < 2 * SUB_BUCKETS) return index;
+        std::size_t shift = index / SUB_BUCKETS - 1;
+        uint64_t lowest = static_cast<uint64_t>(index - shift * SUB_BUCKETS) << shift;
+        return lowest + ((uint64_t(1) << shift) - 1);
+    }
+
+    std::vector<uint64_t> counts; ///< The number of values of each bucket.
+    uint64_t total = 0; ///< The number of recorded values.
+    double sum = 0; ///< The sum of the recorded values.
+    uint64_t min_value = UINT64_MAX; ///< The smallest recorded value.
+    uint64_t max_value = 0; ///< The largest recorded value.
+};
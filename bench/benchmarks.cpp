@@ -0,0 +1,190 @@
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include "Benchmark.h"
+#include "FileIndex.h"
+#include "SearchEngine.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+std::atomic<uint64_t> allocation_count{ 0 };
+
+// count every heap allocation of the program, see Benchmark.h
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+/**
+ * @brief Fixed inputs of the benchmarks, generated from a fixed seed.
+ */
+struct Inputs {
+    std::vector<std::string> words; ///< The vocabulary, English-like words of 2 to 12 letters.
+    std::string html; ///< One HTML document of about 64 KB.
+    std::vector<uint32_t> docs1, docs2; ///< Two sorted posting lists sharing about a third of their documents.
+    fs::path dir; ///< A corpus of 200 documents with its index, and two saved index files.
+};
+
+/**
+ * @brief Generate a document from the vocabulary.
+ * @param rng The random generator.
+ * @param words The vocabulary.
+ * @param length The number of words.
+ * @return The document, with a tag every few words.
+ */
+static std::string make_document(std::mt19937& rng, const std::vector<std::string>& words, std::size_t length) {
+    // a skewed choice of words, so some terms are frequent like in real text
+    std::geometric_distribution<std::size_t> word_dist(0.01);
+    std::ostringstream out;
+    out << "<html><body>\n";
+    for (std::size_t i = 0; i < length; i++) {
+        if (i % 12 == 0) out << "<p class=\"text\">";
+        out << words[word_dist(rng) % words.size()] << (i % 12 == 11 ? "</p>\n" : " ");
+    }
+    out << "</body></html>\n";
+    return out.str();
+}
+
+/**
+ * @brief Generate the fixed inputs.
+ * @return The inputs.
+ */
+static Inputs make_inputs() {
+    Inputs in;
+    std::mt19937 rng(42); // fixed seed, so runs are comparable
+    std::uniform_int_distribution<int> len_dist(2, 12);
+    const char* suffixes[] = { "", "s", "ing", "ed", "ly", "ness", "ation" };
+    for (int i = 0; i < 5000; i++) {
+        std::string word(len_dist(rng), 'a');
+        for (char& ch : word) ch = static_cast<char>('a' + rng() % 26);
+        in.words.push_back(word + suffixes[rng() % 7]); // suffixes give the stemmer some work
+    }
+    while (in.html.size() < 64 * 1024) in.html += make_document(rng, in.words, 500);
+
+    for (uint32_t doc = 0; doc < 300000; doc++) {
+        unsigned r = rng() % 6;
+        if (r < 2) in.docs1.push_back(doc);
+        if (r == 1 || r == 2) in.docs2.push_back(doc);
+    }
+
+    in.dir = fs::temp_directory_path() / "ADS_benchmarks";
+    fs::remove_all(in.dir);
+    fs::create_directories(in.dir / "corpus");
+    for (int i = 0; i < 200; i++) {
+        std::ofstream(in.dir / "corpus" / ("doc" + std::to_string(i) + ".html")) << make_document(rng, in.words, 800);
+    }
+    SearchEngine::gen_index(in.dir / "corpus", nullptr, true);
+
+    FileIndex left, right;
+    for (uint32_t i = 0; i < 100; i++) {
+        left.add_file(in.dir / "corpus" / ("doc" + std::to_string(i) + ".html"), i);
+        right.add_file(in.dir / "corpus" / ("doc" + std::to_string(i + 100) + ".html"), i + 100);
+    }
+    left.save(in.dir / "left.dat");
+    right.save(in.dir / "right.dat");
+    std::ofstream(in.dir / "page.html") << in.html;
+    return in;
+}
+
+/**
+ * @brief Microbenchmarks of the indexing and query hot paths.
+ *
+ * Usage: benchmarks [--filter <substring>] [--min-time <seconds>] [--json <output_file>]
+ *                   [--compare <baseline_file>] [--tolerance <percent>]
+ *
+ * With --compare, the results are compared with a file saved by --json, and the exit code is 1
+ * if any benchmark is slower than the tolerance (default 10%) or allocates more.
+ */
+int main(int argc, char* argv[]) {
+    std::string filter, json_file, baseline_file;
+    double min_time = 0.5, tolerance = 10;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) min_time = atof(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_file = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) baseline_file = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--filter <substring>] [--min-time <seconds>] [--json <output_file>] [--compare <baseline_file>] [--tolerance <percent>]" << std::endl;
+            return 1;
+        }
+    }
+
+    Inputs in = make_inputs();
+    SearchEngine engine(in.dir / "corpus");
+    std::size_t next = 0; // rotates over the inputs of per-word benchmarks
+
+    std::vector<std::pair<std::string, std::function<uint64_t()>>> benchmarks = {
+        { "tokenize/64KB", [&] {
+            std::istringstream input(in.html);
+            uint64_t tokens = 0;
+            while (input) tokens += !tokenize(input).empty();
+            keep(tokens);
+            return static_cast<uint64_t>(in.html.size());
+        } },
+        { "stem_word", [&] {
+            const std::string& word = in.words[next++ % in.words.size()];
+            keep(stem_word(word));
+            return static_cast<uint64_t>(word.size());
+        } },
+        { "FileIndex::add_file/64KB", [&] {
+            FileIndex index;
+            index.add_file(in.dir / "page.html", 0);
+            return static_cast<uint64_t>(in.html.size());
+        } },
+        { "FileIndex::merge_files", [&] {
+            FileIndex::merge_files(in.dir / "left.dat", in.dir / "right.dat", in.dir / "merged.dat");
+            return static_cast<uint64_t>(fs::file_size(in.dir / "left.dat") + fs::file_size(in.dir / "right.dat"));
+        } },
+        { "intersect/100K+100K", [&] {
+            keep(intersect(in.docs1, in.docs2));
+            return static_cast<uint64_t>((in.docs1.size() + in.docs2.size()) * sizeof(uint32_t));
+        } },
+        { "SearchEngine::search_word", [&] {
+            const std::string word = stem_word(in.words[next++ % in.words.size()]);
+            FileIndex::Entry entry = engine.search_word(word);
+            keep(entry);
+            return static_cast<uint64_t>(entry.docs.size() * sizeof(uint32_t));
+        } },
+    };
+
+    std::vector<BenchResult> results;
+    for (auto& [name, op] : benchmarks) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) continue;
+        results.push_back(run_benchmark(name, op, min_time));
+    }
+    fs::remove_all(in.dir);
+
+    print_results(results, std::cout);
+    if (!json_file.empty()) save_results(results, json_file);
+    if (!baseline_file.empty()) {
+        std::map<std::string, BenchResult> baseline = load_results(baseline_file);
+        if (baseline.empty()) {
+            std::cerr << "Error: cannot read baseline " << baseline_file << std::endl;
+            return 1;
+        }
+        std::cout << std::endl;
+        int regressions = compare_results(results, baseline, tolerance / 100, std::cout);
+        if (regressions > 0) {
+            std::cout << regressions << " regression(s)" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "Corpus.h"
+#include "SearchEngine.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The measurements of one index build.
+ */
+struct BuildResult {
+    uint64_t corpus_mb = 0; ///< The target corpus size, in MB.
+    std::string mode; ///< gen_index, gen_index_sort (gen_index with SORT inversion) or gen_index_large.
+    std::string status; ///< "ok", or why the build failed.
+    double seconds = 0; ///< The wall time.
+    uint64_t peak_rss = 0; ///< The peak resident set size, in bytes.
+    uint64_t bytes_written = 0; ///< The bytes written by write calls, including temporary files.
+    uint64_t index_size = 0; ///< The size of the index directory after the build.
+};
+
+/**
+ * @brief Get the total size of the files of a directory.
+ * @param dir The directory.
+ * @return The size in bytes, 0 if it does not exist.
+ */
+static uint64_t directory_size(const fs::path& dir) {
+    uint64_t size = 0;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec)) size += it->file_size(ec);
+    }
+    return size;
+}
+
+/**
+ * @brief Read the bytes written by the calling process, from /proc/self/io.
+ * @return The `wchar` counter, 0 if it is not available.
+ */
+static uint64_t written_bytes() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value) {
+        if (key == "wchar:") return value;
+    }
+    return 0;
+}
+
+/**
+ * @brief Build the index of a corpus in a child process and measure it.
+ *
+ * Each build runs in its own process, so its peak RSS is not inflated by earlier builds and a
+ * build that crashes or runs out of memory does not stop the benchmark.
+ *
+ * @param corpus The corpus directory.
+ * @param mode gen_index, gen_index_sort or gen_index_large.
+ * @param memory_limit The address space limit of the build in bytes, 0 for none.
+ * @param timeout The time limit of the build in seconds, 0 for none.
+ * @param result The result to fill.
+ */
+static void measure_build(const fs::path& corpus, const std::string& mode, uint64_t memory_limit, unsigned timeout, BuildResult& result) {
+    fs::remove_all(corpus / BASE_DIR);
+    int fds[2];
+    if (pipe(fds) != 0) {
+        result.status = "pipe failed";
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        if (memory_limit) {
+            rlimit limit{ memory_limit, memory_limit };
+            setrlimit(RLIMIT_AS, &limit);
+        }
+        if (timeout) alarm(timeout);
+        int code = 0;
+        try {
+            IndexPipeline::Options pipeline;
+            if (mode == "gen_index_sort") pipeline.inversion = IndexPipeline::SORT;
+            if (mode == "gen_index_large") SearchEngine::gen_index_large(corpus, nullptr, true);
+            else SearchEngine::gen_index(corpus, nullptr, true, pipeline);
+        } catch (const std::bad_alloc&) {
+            code = 3;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            code = 2;
+        }
+        uint64_t written = written_bytes();
+        if (write(fds[1], &written, sizeof(written)) != sizeof(written)) code = 2;
+        _exit(code);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        result.status = "fork failed";
+        return;
+    }
+
+    uint64_t written = 0;
+    if (read(fds[0], &written, sizeof(written)) != sizeof(written)) written = 0;
+    close(fds[0]);
+    int status = 0;
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.peak_rss = static_cast<uint64_t>(usage.ru_maxrss) * 1024; // ru_maxrss is in KB on Linux
+    result.bytes_written = written;
+    result.index_size = directory_size(corpus / BASE_DIR);
+
+    if (WIFSIGNALED(status)) {
+        int sig = WTERMSIG(status);
+        result.status = sig == SIGALRM ? "timeout" : sig == SIGKILL ? "killed (OOM?)" : "signal " + std::to_string(sig);
+    } else if (WEXITSTATUS(status) == 3) {
+        result.status = "out of memory";
+    } else {
+        result.status = WEXITSTATUS(status) == 0 ? "ok" : "error";
+    }
+}
+
+/**
+ * @brief Save results as JSON.
+ * @param results The results.
+ * @param filename The JSON file.
+ */
+static void save_results(const std::vector<BuildResult>& results, const std::string& filename) {
+    std::ofstream output(filename);
+    output << "{\n  \"builds\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        output << "    {\"corpus_mb\": " << r.corpus_mb << ", \"mode\": \"" << r.mode << "\", \"status\": \"" << r.status
+            << "\", \"seconds\": " << r.seconds << ", \"peak_rss\": " << r.peak_rss
+            << ", \"bytes_written\": " << r.bytes_written << ", \"index_size\": " << r.index_size << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    output << "  ]\n}\n";
+}
+
+/**
+ * @brief Index build scaling benchmark.
+ *
+ * Generates synthetic corpora of increasing sizes (see Corpus.h) and builds their index with
+ * gen_index (with MAP or SORT inversion) and gen_index_large, recording wall time, peak RSS, bytes written and index size,
+ * so it shows where each mode stops scaling.
+ *
+ * Usage: build_bench <work_dir> [--sizes MB,MB,...] [--modes gen_index,gen_index_sort,gen_index_large]
+ *                    [--memory-limit MB] [--timeout seconds] [--json <output_file>] [--keep]
+ *                    [corpus options]
+ *
+ * Corpora are kept in work_dir/corpus-<size>MB and reused by later runs with --keep.
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <work_dir> [--sizes MB,MB,...] [--modes gen_index,gen_index_sort,gen_index_large]"
+            " [--memory-limit MB] [--timeout seconds] [--json <output_file>] [--keep] " CORPUS_OPTIONS_USAGE << std::endl;
+        return 1;
+    }
+    fs::path work_dir = argv[1];
+    std::vector<uint64_t> sizes = { 10, 100, 1024, 10240 };
+    std::vector<std::string> modes = { "gen_index", "gen_index_sort", "gen_index_large" };
+    uint64_t memory_limit = 0;
+    unsigned timeout = 0;
+    std::string json_file;
+    bool keep = false;
+    CorpusOptions options;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizes.clear();
+            std::istringstream list(argv[++i]);
+            std::string size;
+            while (std::getline(list, size, ',')) sizes.push_back(std::strtoull(size.c_str(), nullptr, 10));
+        } else if (strcmp(argv[i], "--modes") == 0 && i + 1 < argc) {
+            modes.clear();
+            std::istringstream list(argv[++i]);
+            std::string mode;
+            while (std::getline(list, mode, ',')) modes.push_back(mode);
+        } else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+            memory_limit = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            timeout = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_file = argv[++i];
+        } else if (strcmp(argv[i], "--keep") == 0) {
+            keep = true;
+        } else if (!parse_corpus_option(argc, argv, i, options)) {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    for (auto& mode : modes) {
+        if (mode != "gen_index" && mode != "gen_index_sort" && mode != "gen_index_large") {
+            std::cerr << "Unknown mode: " << mode << std::endl;
+            return 1;
+        }
+    }
+
+    const uint64_t MB = 1024 * 1024;
+    std::vector<BuildResult> results;
+    std::cout << std::left << std::setw(10) << "corpus" << std::setw(18) << "mode" << std::right
+        << std::setw(10) << "seconds" << std::setw(10) << "MB/s" << std::setw(12) << "peak RSS"
+        << std::setw(12) << "written" << std::setw(12) << "index" << "  status" << std::endl;
+    for (uint64_t size : sizes) {
+        fs::path corpus = work_dir / ("corpus-" + std::to_string(size) + "MB");
+        if (!fs::exists(corpus)) {
+            fs::create_directories(work_dir);
+            // the corpus, its index and the temporary files of gen_index_large
+            uint64_t needed = size * MB * 3;
+            if (fs::space(work_dir).available < needed) {
+                std::cout << std::left << std::setw(10) << std::to_string(size) + " MB" << "skipped, needs "
+                    << needed / MB << " MB of free disk space" << std::endl;
+                continue;
+            }
+            CorpusOptions corpus_options = options;
+            corpus_options.target_bytes = size * MB;
+            CorpusGenerator(corpus_options).generate(corpus);
+        }
+
+        for (auto& mode : modes) {
+            BuildResult result;
+            result.corpus_mb = size;
+            result.mode = mode;
+            measure_build(corpus, mode, memory_limit, timeout, result);
+            std::cout << std::left << std::setw(10) << std::to_string(size) + " MB" << std::setw(18) << mode << std::right
+                << std::fixed << std::setprecision(2) << std::setw(10) << result.seconds
+                << std::setprecision(1) << std::setw(10) << size / result.seconds
+                << std::setw(9) << static_cast<double>(result.peak_rss) / MB << " MB"
+                << std::setw(9) << static_cast<double>(result.bytes_written) / MB << " MB"
+                << std::setw(9) << static_cast<double>(result.index_size) / MB << " MB"
+                << "  " << result.status << std::endl;
+            results.push_back(result);
+        }
+        fs::remove_all(corpus / BASE_DIR);
+        if (!keep) fs::remove_all(corpus);
+    }
+
+    if (!json_file.empty()) save_results(results, json_file);
+    return 0;
+}
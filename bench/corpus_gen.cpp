@@ -0,0 +1,37 @@
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+#include "Corpus.h"
+
+/**
+ * @brief Synthetic corpus generator.
+ *
+ * Writes a deterministic corpus of HTML documents with a Zipfian vocabulary, see Corpus.h.
+ *
+ * Usage: corpus_gen <output_dir> [--docs n | --size MB] [--seed n] [--vocabulary n] [--zipf s]
+ *                   [--median-words n] [--length-sigma x] [--tag-density p]
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output_dir> [--docs n | --size MB] " CORPUS_OPTIONS_USAGE << std::endl;
+        return 1;
+    }
+    CorpusOptions options;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--docs") == 0 && i + 1 < argc) options.documents = std::strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) options.target_bytes = static_cast<uint64_t>(std::atof(argv[++i]) * 1024 * 1024);
+        else if (!parse_corpus_option(argc, argv, i, options)) {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto [documents, bytes] = CorpusGenerator(options).generate(argv[1]);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Generated " << documents << " documents, " << bytes / (1024 * 1024) << " MB in "
+        << seconds << " s" << std::endl;
+    return 0;
+}
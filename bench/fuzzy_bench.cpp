@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#include "LevenshteinAutomaton.h"
+
+/**
+ * @brief Fuzzy matching latency benchmark.
+ *
+ * Builds a synthetic sorted vocabulary, then measures the average latency of intersecting a
+ * Levenshtein automaton with it, compared with computing the edit distance to every term.
+ *
+ * Usage: fuzzy_bench [vocabulary_size] [queries]
+ */
+int main(int argc, char* argv[]) {
+    std::size_t vocab_size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::size_t num_queries = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+    std::mt19937 rng(42); // fixed seed, so runs are comparable
+    std::uniform_int_distribution<int> len_dist(3, 12);
+    std::uniform_int_distribution<int> char_dist('a', 'z');
+
+    std::vector<std::string> terms;
+    terms.reserve(vocab_size);
+    for (std::size_t i = 0; i < vocab_size; i++) {
+        std::string term(len_dist(rng), 'a');
+        for (char& ch : term) ch = static_cast<char>(char_dist(rng));
+        terms.push_back(term);
+    }
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    // queries are vocabulary terms with one random substitution, i.e. typical typos
+    std::vector<std::string> queries;
+    std::uniform_int_distribution<std::size_t> term_dist(0, terms.size() - 1);
+    for (std::size_t i = 0; i < num_queries; i++) {
+        std::string query = terms[term_dist(rng)];
+        query[rng() % query.size()] = static_cast<char>(char_dist(rng));
+        queries.push_back(query);
+    }
+
+    std::cout << "vocabulary: " << terms.size() << " terms, " << queries.size() << " queries" << std::endl;
+    for (uint32_t max_edits : { 1u, 2u }) {
+        std::size_t matches = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto& query : queries) {
+            matches += LevenshteinAutomaton(query, max_edits).intersect(terms).size();
+        }
+        double automaton_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        // the brute force scan is slow, so only run a few queries of it
+        std::size_t brute_queries = std::min<std::size_t>(queries.size(), 10);
+        start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < brute_queries; i++) {
+            for (auto& term : terms) {
+                if (edit_distance(queries[i], term) <= max_edits) matches++;
+            }
+        }
+        double brute_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "max_edits=" << max_edits
+            << " automaton: " << automaton_us / queries.size() << " us/query"
+            << ", brute force: " << brute_us / brute_queries << " us/query"
+            << " (" << matches << " matches)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "Corpus.h"
+#include "Histogram.h"
+#include "SearchEngine.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+/**
+ * @brief A persistent connection to a query server, see SearchServer.
+ */
+class ServerConnection {
+public:
+    /**
+     * @brief Connect to a server.
+     * @param socket_path The path of the server socket.
+     */
+    explicit ServerConnection(const std::string& socket_path) {
+        sockaddr_un addr{};
+        if (socket_path.size() >= sizeof(addr.sun_path)) return;
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    ~ServerConnection() { if (fd >= 0) close(fd); }
+    ServerConnection(const ServerConnection&) = delete;
+    ServerConnection& operator=(const ServerConnection&) = delete;
+
+    bool connected() const { return fd >= 0; } ///< Whether the connection is open.
+
+    /**
+     * @brief Send a query and wait for its whole response.
+     * @param query The query, not empty.
+     * @return false if the connection failed or the server rejected the query.
+     */
+    bool query(const std::string& query) {
+        std::string request = query + "\n";
+        for (std::size_t sent = 0; sent < request.size();) {
+            ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<std::size_t>(n);
+        }
+        response.clear();
+        char buffer[4096];
+        while (response.size() < 2 || response.compare(response.size() - 2, 2, "\n\n") != 0) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            response.append(buffer, static_cast<std::size_t>(n));
+        }
+        return response.compare(0, 6, "Error:") != 0;
+    }
+
+private:
+    int fd = -1; ///< The socket, -1 if not connected.
+    std::string response; ///< The buffer of the last response.
+};
+
+/**
+ * @brief Evict the index files of a target directory from the page cache.
+ * @param dir The target directory.
+ *
+ * Pages still mapped by a running process stay resident, so this makes the next reads cold for
+ * an engine loaded afterwards, but not for a server that already mapped its index.
+ */
+static void evict_index(const fs::path& dir) {
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir / BASE_DIR, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        int fd = open(it->path().c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/**
+ * @brief Print a row of latency percentiles.
+ * @param phase The name of the phase.
+ * @param histogram The latencies of the phase, in nanoseconds.
+ */
+static void print_row(const std::string& phase, const LatencyHistogram& histogram) {
+    auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000; };
+    std::cout << std::left << std::setw(8) << phase << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << histogram.count()
+        << std::setw(10) << histogram.mean() / 1000
+        << std::setw(10) << us(histogram.percentile(50))
+        << std::setw(10) << us(histogram.percentile(90))
+        << std::setw(10) << us(histogram.percentile(99))
+        << std::setw(10) << us(histogram.percentile(99.9))
+        << std::setw(10) << us(histogram.max()) << std::endl;
+}
+
+/**
+ * @brief Write the summary of a phase as a JSON object.
+ * @param output The output stream.
+ * @param phase The name of the phase.
+ * @param histogram The latencies of the phase, in nanoseconds.
+ */
+static void write_json(std::ostream& output, const std::string& phase, const LatencyHistogram& histogram) {
+    output << "    \"" << phase << "\": {\"count\": " << histogram.count() << ", \"mean_ns\": " << histogram.mean()
+        << ", \"p50_ns\": " << histogram.percentile(50) << ", \"p90_ns\": " << histogram.percentile(90)
+        << ", \"p99_ns\": " << histogram.percentile(99) << ", \"p999_ns\": " << histogram.percentile(99.9)
+        << ", \"max_ns\": " << histogram.max() << "}";
+}
+
+/**
+ * @brief End-to-end query latency benchmark.
+ *
+ * Replays a query log at a fixed arrival rate against an in-process engine or a running server
+ * (`serve`), and reports latency percentiles of the cold phase (the first queries after the index
+ * files were evicted from the page cache) and of the warm phase (the rest).
+ *
+ * The load is open loop: query i is due at start + i / rate whether or not earlier queries have
+ * finished, and its latency is measured from that due time. A slow query thus delays the queries
+ * behind it, which a closed loop benchmark would hide (coordinated omission). There must be
+ * enough threads for the rate, queries starting late are counted. A rate of 0 runs a closed loop,
+ * each thread sending its next query as soon as the previous one is answered.
+ *
+ * Usage: query_bench <target_dir> [--server [socket_path]] [--queries <file> | --generate n]
+ *                    [--rate qps] [--count n] [--cold n] [--threads n] [--fuzzy n]
+ *                    [--json <output_file>] [corpus options]
+ *
+ * A query file has one query per line. Generated queries have 1 to 3 words drawn like the words
+ * of corpus_gen documents, so pass the options the corpus was generated with.
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <target_dir> [--server [socket_path]] [--queries <file> | --generate n]"
+            " [--rate qps] [--count n] [--cold n] [--threads n] [--fuzzy n] [--json <output_file>] " CORPUS_OPTIONS_USAGE << std::endl;
+        return 1;
+    }
+    fs::path target_dir = argv[1];
+    std::string query_file, json_file, socket_path;
+    bool server = false;
+    std::size_t generate = 10000, count = 0, cold = 1000;
+    double rate = 100;
+    unsigned threads = 8;
+    SearchEngine::SearchOptions search_options;
+    CorpusOptions options;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0) {
+            server = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') socket_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc) query_file = argv[++i];
+        else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) generate = std::strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = std::atof(argv[++i]);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = std::strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--cold") == 0 && i + 1 < argc) cold = std::strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--fuzzy") == 0 && i + 1 < argc) search_options.fuzzy = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_file = argv[++i];
+        else if (!parse_corpus_option(argc, argv, i, options)) {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (socket_path.empty()) socket_path = (target_dir / BASE_DIR / SOCKET_FILE_NAME).string();
+
+    std::vector<std::string> queries;
+    if (!query_file.empty()) {
+        std::ifstream input(query_file);
+        std::string line;
+        while (std::getline(input, line)) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos) queries.push_back(line);
+        }
+    } else {
+        CorpusGenerator generator(options);
+        std::mt19937_64 rng(options.seed + 1);
+        for (std::size_t i = 0; i < generate; i++) queries.push_back(generator.query(rng, 1 + rng() % 3));
+    }
+    if (queries.empty()) {
+        std::cerr << "Error: no queries" << std::endl;
+        return 1;
+    }
+    if (count == 0) count = queries.size();
+
+    evict_index(target_dir);
+    std::unique_ptr<SearchEngine> engine;
+    if (!server) {
+        auto load_start = clock_type::now();
+        engine = std::make_unique<SearchEngine>(target_dir);
+        if (!engine->is_loaded()) {
+            std::cerr << "Error: no index in " << target_dir << ", run `index` first" << std::endl;
+            return 1;
+        }
+        std::cout << "Loaded the index in "
+            << std::chrono::duration<double, std::milli>(clock_type::now() - load_start).count() << " ms" << std::endl;
+    }
+
+    std::vector<LatencyHistogram> cold_histograms(threads), warm_histograms(threads);
+    std::atomic<std::size_t> next{ 0 }, late{ 0 }, errors{ 0 };
+    auto interval = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(rate > 0 ? 1 / rate : 0));
+    auto start = clock_type::now();
+    auto worker = [&](unsigned t) {
+        std::unique_ptr<ServerConnection> connection;
+        if (server) {
+            connection = std::make_unique<ServerConnection>(socket_path);
+            if (!connection->connected()) {
+                std::cerr << "Error: cannot connect to server at " << socket_path << std::endl;
+                errors++;
+                return;
+            }
+        }
+        std::ostringstream output;
+        for (std::size_t i; (i = next++) < count;) {
+            auto due = rate > 0 ? start + interval * static_cast<long>(i) : clock_type::now();
+            auto now = clock_type::now();
+            if (now < due) std::this_thread::sleep_until(due);
+            else if (now - due > std::chrono::milliseconds(1)) late++; // no thread was free in time
+            const std::string& query = queries[i % queries.size()];
+            if (server) {
+                if (!connection->query(query)) errors++;
+            } else {
+                output.str("");
+                engine->search(query, output, search_options);
+            }
+            auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - due).count();
+            (i < cold ? cold_histograms[t] : warm_histograms[t]).record(static_cast<uint64_t>(latency));
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) workers.emplace_back(worker, t);
+    for (auto& w : workers) w.join();
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    LatencyHistogram cold_total, warm_total, total;
+    for (unsigned t = 0; t < threads; t++) {
+        cold_total.merge(cold_histograms[t]);
+        warm_total.merge(warm_histograms[t]);
+    }
+    total.merge(cold_total);
+    total.merge(warm_total);
+
+    std::cout << (server ? "Server " + socket_path : "In-process engine") << ": " << total.count() << " queries in "
+        << std::fixed << std::setprecision(2) << seconds << " s (" << total.count() / seconds << " q/s, "
+        << (rate > 0 ? "target " + std::to_string(static_cast<long>(rate)) + " q/s" : "closed loop") << "), "
+        << late << " late, " << errors << " errors" << std::endl;
+    std::cout << std::left << std::setw(8) << "phase" << std::right << std::setw(10) << "queries"
+        << std::setw(10) << "mean us" << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+        << std::setw(10) << "p999" << std::setw(10) << "max" << std::endl;
+    print_row("cold", cold_total);
+    print_row("warm", warm_total);
+    print_row("all", total);
+
+    if (!json_file.empty()) {
+        std::ofstream output(json_file);
+        output << "{\n  \"queries\": " << total.count() << ", \"seconds\": " << seconds << ", \"target_rate\": " << rate
+            << ", \"late\": " << late << ", \"errors\": " << errors << ",\n  \"phases\": {\n";
+        write_json(output, "cold", cold_total);
+        output << ",\n";
+        write_json(output, "warm", warm_total);
+        output << ",\n";
+        write_json(output, "all", total);
+        output << "\n  }\n}\n";
+    }
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * @class ArchiveReader
+ * @brief Streams the documents of a tar archive or a JSONL file, in one sequential pass.
+ *
+ * The file is read with large reads into one buffer, and every document is read out of the
+ * buffer in turn, so a corpus of millions of small files costs a few hundred reads instead of
+ * millions of opens. A gzip-compressed file (.tar.gz, .jsonl.gz) is decompressed on the fly if
+ * the build found zlib (HAVE_ZLIB).
+ *
+ * The format is detected from the content:
+ * - A tar archive (ustar, GNU or pax): every regular file with the extension is a document,
+ *   named by its path in the archive. Long GNU and pax names are supported.
+ * - A JSONL file, one JSON object per line: the document is the "text" string of the object
+ *   ("html" or "content" if there is none), named by its "id" ("url" if there is none, the
+ *   line number if neither).
+ *
+ * Document names are "<filename>:<name>", with filename as given to the constructor.
+ */
+class ArchiveReader {
+public:
+    /**
+     * @brief The format of the documents.
+     */
+    enum Format {
+        TAR, ///< A tar archive.
+        JSONL ///< One JSON object per line.
+    };
+
+    /**
+     * @brief Open an archive and detect its format.
+     * @param filename The archive.
+     * @param extension The extension of the tar members to read, e.g. ".html".
+     * @param buffer_bytes The size of the reads.
+     *
+     * If the archive cannot be read, is_open() is false and error() tells why.
+     */
+    explicit ArchiveReader(const std::filesystem::path& filename, const std::string& extension = ".html", std::size_t buffer_bytes = 1 << 20);
+
+    ~ArchiveReader();
+    ArchiveReader(const ArchiveReader&) = delete;
+    ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+    bool is_open() const { return error_message.empty(); } ///< Whether the archive can be read.
+    const std::string& error() const { return error_message; } ///< Why the archive cannot be read, or where it is malformed.
+    Format format() const { return kind; } ///< The format of the archive.
+    uint64_t size() const { return document_size; } ///< The size of the current document.
+
+    /**
+     * @brief Move to the next document, skipping the rest of the current one.
+     * @param name The name of the document, "<filename>:<name>".
+     * @return false at the end of the archive, or if it is malformed, see error().
+     */
+    bool next(std::string& name);
+
+    /**
+     * @brief Read the content of the current document.
+     * @param buffer The buffer to read into.
+     * @param size The size of the buffer.
+     * @return The number of bytes read, less than size only at the end of the document.
+     */
+    std::size_t read(char* buffer, std::size_t size);
+
+private:
+    /**
+     * @brief Refill the buffer from the file.
+     * @return false at the end of the file.
+     */
+    bool fill();
+
+    /**
+     * @brief Take bytes of the (decompressed) file.
+     * @param out Where to copy the bytes, nullptr to skip them.
+     * @param size The number of bytes.
+     * @return The number of bytes taken, less than size only at the end of the file.
+     */
+    uint64_t take(char* out, uint64_t size);
+
+    /**
+     * @brief Take the bytes up to the next newline, which is dropped.
+     * @param line The line.
+     * @return false at the end of the file.
+     */
+    bool take_line(std::string& line);
+
+    bool next_tar(std::string& name); ///< next() for TAR.
+    bool next_jsonl(std::string& name); ///< next() for JSONL.
+
+    std::string filename; ///< The archive, as given.
+    std::string extension; ///< The extension of the tar members to read.
+    std::string error_message; ///< Empty unless the archive cannot be read.
+    Format kind = TAR; ///< The format.
+    int fd = -1; ///< The file, if read without zlib.
+    void* gz = nullptr; ///< The zlib gzFile, if read with zlib.
+    std::vector<char> buffer; ///< The bytes read from the file.
+    std::size_t pos = 0; ///< The next byte of buffer to take.
+    std::size_t end = 0; ///< The end of the bytes in buffer.
+    uint64_t remaining = 0; ///< The bytes of the current tar member not read yet.
+    uint64_t padding = 0; ///< The padding after the current tar member.
+    uint64_t line_number = 0; ///< The number of JSONL lines taken.
+    std::string line; ///< The current JSONL line.
+    std::string document; ///< The content of the current JSONL document.
+    std::size_t document_pos = 0; ///< The next byte of document to read.
+    uint64_t document_size = 0; ///< The size of the current document.
+};
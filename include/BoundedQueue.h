@@ -0,0 +1,84 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+#include <condition_variable>
+
+/**
+ * @class BoundedQueue
+ * @brief A blocking FIFO queue of limited capacity, which measures how long its callers wait.
+ *
+ * push() blocks while the queue is full, so a fast producer is held back by a slow consumer,
+ * and pop() blocks while it is empty. The time spent blocked is added to the caller's counter,
+ * which tells which stage of a pipeline is the bottleneck.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Create an empty queue.
+     * @param capacity The maximum number of queued values, at least 1.
+     */
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+    /**
+     * @brief Add a value, waiting for room if the queue is full.
+     * @param value The value.
+     * @param stalled If not nullptr, the time spent waiting is added to it.
+     * @return false if the queue is closed, the value is then dropped.
+     */
+    bool push(T value, clock::duration* stalled = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (values.size() >= capacity && !closed) {
+            auto start = clock::now();
+            not_full.wait(lock, [this] { return values.size() < capacity || closed; });
+            if (stalled) *stalled += clock::now() - start;
+        }
+        if (closed) return false;
+        values.push_back(std::move(value));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest value, waiting for one if the queue is empty.
+     * @param value The value taken.
+     * @param stalled If not nullptr, the time spent waiting is added to it.
+     * @return false if the queue is closed and empty.
+     */
+    bool pop(T& value, clock::duration* stalled = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (values.empty() && !closed) {
+            auto start = clock::now();
+            not_empty.wait(lock, [this] { return !values.empty() || closed; });
+            if (stalled) *stalled += clock::now() - start;
+        }
+        if (values.empty()) return false;
+        value = std::move(values.front());
+        values.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Close the queue: pushes fail, pops drain the queued values and then fail.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    std::size_t capacity; ///< The maximum number of queued values.
+    std::deque<T> values; ///< The queued values, oldest first.
+    bool closed = false; ///< Set by close().
+    std::mutex mutex; ///< Protects values and closed.
+    std::condition_variable not_full; ///< Signaled when a value is taken or the queue is closed.
+    std::condition_variable not_empty; ///< Signaled when a value is added or the queue is closed.
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <condition_variable>
+
+#include "SearchEngine.h"
+
+/**
+ * @class Compactor
+ * @brief Compacts the segments of an index in a background thread.
+ *
+ * Every interval, the thread runs SearchEngine::compact_index until there is nothing left to
+ * merge. Each step publishes a new generation, which a HotSwapEngine picks up like any other
+ * rebuild. The write rate of the merges is limited by the policy, so queries served by the
+ * same process are not starved of I/O.
+ */
+class Compactor {
+public:
+    /**
+     * @brief Create a compactor, the thread is started by start().
+     * @param dir The target directory, see SearchEngine::SearchEngine.
+     * @param policy The merge policy.
+     */
+    Compactor(const std::filesystem::path& dir, const SearchEngine::CompactionPolicy& policy);
+
+    /**
+     * @brief Stop the thread, after the compaction step in progress, if any.
+     */
+    ~Compactor();
+
+    Compactor(const Compactor&) = delete;
+    Compactor& operator=(const Compactor&) = delete;
+
+    /**
+     * @brief Start the background thread.
+     * @param interval How often to look for segments to merge.
+     */
+    void start(std::chrono::milliseconds interval);
+
+private:
+    std::filesystem::path dir; ///< The target directory.
+    SearchEngine::CompactionPolicy policy; ///< The merge policy.
+    std::thread worker; ///< The background thread, if started.
+    std::mutex mutex; ///< Protects stopping for cv.
+    std::condition_variable cv; ///< Wakes the thread to stop.
+    bool stopping = false; ///< true when the thread should exit.
+};
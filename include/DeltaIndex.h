@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "FileIndex.h"
+#include "Manifest.h"
+#include "StopFilter.h"
+
+class SearchEngine;
+
+/**
+ * @class DeltaIndex
+ * @brief An in-memory index of the files changed since the published generation.
+ *
+ * A delta sits on top of one SearchEngine. Its documents get IDs after the last document of
+ * the engine, and it masks the documents of the engine that were deleted or replaced, so
+ * SearchEngine::search with a delta sees the target directory as it is now.
+ *
+ * A delta is built by a single writer (see RealtimeIndexer) and never modified once shared:
+ * the writer copies the current delta, applies a batch of changes and publishes the copy.
+ * Readers therefore never wait for ingestion.
+ */
+class DeltaIndex {
+public:
+    /**
+     * @brief Create an empty delta on top of an engine.
+     * @param engine The engine holding the published generation.
+     */
+    explicit DeltaIndex(std::shared_ptr<const SearchEngine> engine);
+
+    /**
+     * @brief Get the engine the delta sits on.
+     * @return The engine, queries must use this one together with the delta.
+     */
+    const std::shared_ptr<const SearchEngine>& engine() const { return disk; }
+
+    /**
+     * @brief Get the first document ID of the delta.
+     * @return The number of document IDs of the engine.
+     */
+    uint32_t doc_base() const { return base; }
+
+    /**
+     * @brief Index a new or modified file, replacing its previous version.
+     * @param name The document name, as indexed, e.g. `./a.html`.
+     * @param path The path of the file to read.
+     * @param filter The stop filter of the index, nullptr if none.
+     */
+    void add_file(const std::string& name, const std::filesystem::path& path, StopFilter* filter);
+
+    /**
+     * @brief Remove a deleted file.
+     * @param name The document name, as indexed.
+     */
+    void remove_file(const std::string& name);
+
+    /**
+     * @brief Find the entry of a word in the delta.
+     * @param word The stemmed word.
+     * @return The entry, or nullptr if no buffered document contains the word.
+     */
+    const FileIndex::Entry* find(const std::string& word) const { return index.find(word); }
+
+    /**
+     * @brief Check if a document is masked by the delta.
+     * @param doc A document ID of the engine or of the delta.
+     * @return true if the document was deleted or replaced after it was indexed.
+     */
+    bool is_masked(uint32_t doc) const { return masked.count(doc) > 0; }
+
+    /**
+     * @brief Get the name of a document of the delta.
+     * @param doc The document ID, at least doc_base().
+     * @return The document name.
+     */
+    const std::string& file(uint32_t doc) const { return file_list[doc - base]; }
+
+    /**
+     * @brief Get the in-memory index of the delta.
+     * @return The index, with the postings of masked documents still in it.
+     */
+    const FileIndex& postings() const { return index; }
+
+    /**
+     * @brief Get the names of the documents of the delta.
+     * @return The names, the i-th one is document doc_base() + i.
+     */
+    const std::vector<std::string>& files() const { return file_list; }
+
+    /**
+     * @brief Get the lengths of the documents of the delta.
+     * @return The numbers of tokens indexed, in the order of files().
+     */
+    const std::vector<uint32_t>& lengths() const { return doc_lengths; }
+
+    /**
+     * @brief Get the manifest entries of the documents of the delta.
+     * @return The size and mtime of each file before it was read and the hash of the bytes indexed, in the order of files().
+     */
+    const std::vector<Manifest::Entry>& entries() const { return doc_entries; }
+
+    /**
+     * @brief Get the names of all files changed by the delta.
+     * @return The names of the added, modified and deleted files.
+     */
+    const std::unordered_set<std::string>& changed() const { return touched; }
+
+    /**
+     * @brief Get the size of the buffered files.
+     * @return The total size in bytes of the files indexed into the delta.
+     */
+    uint64_t buffered_bytes() const { return bytes; }
+
+    /**
+     * @brief Estimate the heap memory of the delta.
+     * @return The bytes of its postings, names and masks, see MemoryUsage.
+     */
+    uint64_t memory_usage() const;
+
+    /**
+     * @brief Check if the delta changes nothing.
+     * @return true if no file was added, modified or deleted.
+     */
+    bool empty() const { return touched.empty(); }
+
+private:
+    /**
+     * @brief Mask the current version of a document, in the delta or in the engine.
+     * @param name The document name.
+     */
+    void mask(const std::string& name);
+
+    std::shared_ptr<const SearchEngine> disk; ///< The engine the delta sits on.
+    uint32_t base; ///< The first document ID of the delta.
+    FileIndex index; ///< The postings of the buffered documents.
+    std::vector<std::string> file_list; ///< The names of the buffered documents.
+    std::vector<uint32_t> doc_lengths; ///< The number of tokens indexed from each buffered document.
+    std::vector<Manifest::Entry> doc_entries; ///< The manifest entry of each buffered document.
+    std::unordered_map<std::string, uint32_t> doc_ids; ///< The current buffered document of each name.
+    std::unordered_set<uint32_t> masked; ///< Deleted or replaced documents, of the engine or the delta.
+    std::unordered_set<std::string> touched; ///< The names of all changed files.
+    uint64_t bytes = 0; ///< The total size of the buffered files.
+};
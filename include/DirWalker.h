@@ -0,0 +1,124 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <filesystem>
+#include <condition_variable>
+
+#include "IndexProfile.h"
+#include "ThreadPool.h"
+
+/**
+ * @class DirWalker
+ * @brief Lists the files of a directory tree with several threads, and streams them while listing.
+ *
+ * Every directory is listed by a task of a ThreadPool, which submits a task for each of its
+ * subdirectories, so wide and deep trees are listed in parallel. The files found can be taken
+ * with get() while the walk is still running, e.g. by an IndexPipeline.
+ *
+ * In CANONICAL order, the entries of every directory are sorted by name, and files come out in
+ * the depth-first order of the sorted tree, whatever the filesystem or the timing of the
+ * threads. The same tree then always gives the same list, hence the same document IDs. Files
+ * are released as soon as every directory before them in that order has been listed. In
+ * DISCOVERY order, files come out as soon as they are found, in no particular order.
+ *
+ * Like std::filesystem::recursive_directory_iterator, symbolic links to directories are not
+ * followed. Directories that cannot be listed are skipped.
+ */
+class DirWalker {
+public:
+    /**
+     * @brief The order of the files.
+     */
+    enum Order {
+        CANONICAL, ///< Depth-first, entries of each directory sorted by name.
+        DISCOVERY ///< As found by the threads.
+    };
+
+    /**
+     * @brief The options of the walk.
+     */
+    struct Options {
+        unsigned threads = 0; ///< The number of threads listing directories, 0 means one per hardware thread.
+        Order order = CANONICAL; ///< The order of the files.
+    };
+
+    /**
+     * @brief Start walking a directory.
+     * @param directory The root directory, file paths start with it.
+     * @param extension The extension of the files to list, e.g. ".html".
+     * @param options The options.
+     */
+    DirWalker(const std::filesystem::path& directory, const std::string& extension, const Options& options);
+
+    /**
+     * @brief Wait for the walk to end.
+     */
+    ~DirWalker() = default;
+
+    DirWalker(const DirWalker&) = delete;
+    DirWalker& operator=(const DirWalker&) = delete;
+
+    /**
+     * @brief Get a file, waiting until it is found.
+     * @param i The position of the file in the order of the walk.
+     * @param file The path of the file.
+     * @return false if the walk ended with i files or fewer.
+     */
+    bool get(std::size_t i, std::string& file);
+
+    /**
+     * @brief Get all the files, waiting for the walk to end.
+     * @return The paths of the files, in the order of the walk.
+     */
+    const std::vector<std::string>& files();
+
+private:
+    struct Node;
+
+    /**
+     * @brief An entry of a directory: a matching file, or a subdirectory.
+     */
+    struct Entry {
+        std::string name; ///< The file name.
+        bool directory = false; ///< Whether this is a subdirectory.
+        Node* node = nullptr; ///< The node of the subdirectory.
+    };
+
+    /**
+     * @brief A directory of the tree.
+     */
+    struct Node {
+        std::filesystem::path path; ///< The path of the directory.
+        bool listed = false; ///< Whether entries is set.
+        std::vector<Entry> entries; ///< The entries, in CANONICAL order, released once emitted.
+    };
+
+    /**
+     * @brief List a directory and submit its subdirectories.
+     * @param node The directory.
+     */
+    void list(Node* node);
+
+    /**
+     * @brief Emit the files of the listed prefix of the tree, in CANONICAL order. Requires the lock.
+     */
+    void advance();
+
+    std::string extension; ///< The extension of the listed files.
+    Order order; ///< The order of the files.
+    IndexProfile* profile; ///< The profile active when the walk started, nullptr if none.
+    IndexProfile::clock::time_point start; ///< The start of the walk.
+    std::mutex mutex; ///< Protects the members below.
+    std::condition_variable found_cv; ///< Signaled when files are found or the walk ends.
+    std::deque<Node> nodes; ///< The directories, a deque so nodes never move.
+    std::vector<std::pair<Node*, std::size_t>> cursor; ///< The path of the depth-first emission: each directory and its next entry.
+    std::vector<std::string> found; ///< The files emitted so far.
+    std::size_t pending = 0; ///< The number of directories not listed yet.
+    bool done = false; ///< Whether the walk ended.
+    ThreadPool pool; ///< The threads listing directories, last so it stops before the rest is destroyed.
+};
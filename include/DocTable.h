@@ -0,0 +1,120 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <filesystem>
+
+#include "MappedFile.h"
+
+/**
+ * @class DocTable
+ * @brief The paths and metadata of the documents of a segment, in a compact mapped file.
+ *
+ * The paths are front coded in blocks of BLOCK_SIZE: the first path of a block is stored whole,
+ * each following one as the length of the prefix it shares with the previous path plus the rest.
+ * A path is decoded only when it is asked for, so loading a segment does not materialize its
+ * document list, and printing results decodes only the documents printed.
+ *
+ * The format of the file, all integers in host byte order, is:
+ * - uint32_t magic, count, blocks and a reserved 0.
+ * - count records of 24 bytes: uint64_t size, int64_t mtime, uint32_t length and a reserved 0.
+ * - blocks uint64_t offsets of the blocks, from the start of the paths.
+ * - the paths, each as a varint shared prefix length, a varint suffix length and the suffix.
+ *
+ * Segments written before the table existed only have their list file, the table is then
+ * built in memory from it, without metadata.
+ */
+class DocTable {
+public:
+    static const uint32_t BLOCK_SIZE = 16; ///< The number of paths per front coded block.
+
+    /**
+     * @brief The metadata of a document.
+     */
+    struct Document {
+        uint64_t size = 0; ///< The size of the file in bytes, when it was indexed.
+        int64_t mtime = 0; ///< The modification time of the file, in file clock ticks, see Manifest.
+        uint32_t length = 0; ///< The number of tokens indexed, stop words excluded.
+    };
+
+    DocTable() = default;
+
+    /**
+     * @brief Load the document table of a segment.
+     * @param dir The directory of the segment.
+     *
+     * The table file is mapped. If it is missing or invalid, the table is built from the list file.
+     */
+    explicit DocTable(const std::filesystem::path& dir);
+
+    /**
+     * @brief Write a document table.
+     * @param filename The table file.
+     * @param paths The paths of the documents, empty for documents removed by compaction.
+     * @param documents The metadata of the documents, in the same order.
+     */
+    static void save(const std::filesystem::path& filename, const std::vector<std::string>& paths, const std::vector<Document>& documents);
+
+    /**
+     * @brief Get the number of documents.
+     * @return The number of documents, including deleted ones.
+     */
+    uint32_t size() const { return count; }
+
+    /**
+     * @brief Decode the path of a document.
+     * @param i The index of the document in the table.
+     * @return The path, empty for a document removed by compaction.
+     */
+    std::string path(uint32_t i) const;
+
+    /**
+     * @brief Get the metadata of a document.
+     * @param i The index of the document in the table.
+     * @return The metadata, all 0 if the table was built from a list file.
+     */
+    Document document(uint32_t i) const;
+
+    /**
+     * @brief Get the heap memory of the table.
+     * @return The bytes, 0 unless the table was built from a list file.
+     */
+    uint64_t memory_usage() const;
+
+    /**
+     * @brief Get the size of the mapped table file.
+     * @return The number of bytes mapped, 0 if the table was built from a list file.
+     */
+    std::size_t mapped_size() const { return file.size(); }
+
+    /**
+     * @brief Check how much of the table file is in the page cache.
+     * @return The number of resident pages and the number of pages of the file.
+     */
+    std::pair<std::size_t, std::size_t> residency() const { return file.residency(0, file.size()); }
+
+private:
+    /**
+     * @brief Encode a document table.
+     * @param paths The paths of the documents.
+     * @param documents The metadata of the documents, missing ones are all 0.
+     * @return The bytes of the table file.
+     */
+    static std::string encode(const std::vector<std::string>& paths, const std::vector<Document>& documents);
+
+    /**
+     * @brief Check the header of the table and read its counts.
+     * @return false if the table is truncated or not a document table.
+     */
+    bool open();
+
+    const char* data() const { return file.data() ? file.data() : buffer.data(); } ///< The bytes of the table.
+    std::size_t bytes() const { return file.data() ? file.size() : buffer.size(); } ///< The size of the table.
+
+    MappedFile file; ///< The table file, if it could be mapped.
+    std::string buffer; ///< The table built from a list file, if there is no table file.
+    uint32_t count = 0; ///< The number of documents.
+    uint32_t blocks = 0; ///< The number of front coded blocks.
+};
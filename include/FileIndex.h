@@ -1,207 +1,298 @@
-#pragma once
-
-#include <map>
-#include <vector>
-#include <fstream>
-#include <string>
-#include <cstdint>
-#include <iostream>
-#include <filesystem>
-
-#include "StopFilter.h"
-
-/**
- * @class FileIndex
- * @brief This class implements an inverted file index teached in the ADS course for a mini search engine.
- *
- * The inverted index allows for efficient storage and retrieval of documents based on keywords.
- * It supports adding files and directories, serializing to and from binary files, and **merging
- * multiple indexes without loading all data into memory**, making it suitable for **large datasets**.
- */
-class FileIndex {
-public:
-    /**
-     * @brief Adds the content of a file to the index.
-     *
-     * This function reads tokens from the specified file and updates the index accordingly.
-     * It increments the frequency count of each token and records the document ID in which
-     * the token appears.
-     *
-     * @param filename The name of the file to be added to the index.
-     * @param id The unique identifier for the document being indexed.
-     * @param filter An optional pointer to a StopFilter instance to filter out stop words.
-     */
-    void add_file(const std::filesystem::path& filename, uint32_t id, StopFilter* filter = nullptr);
-
-    /**
-     * @brief Adds all files from a specified directory to the index.
-     *
-     * This function retrieves all files in the specified directory and adds each file's content
-     * to the index using a unique document ID starting from id_start. It supports large datasets
-     * by processing files sequentially instead of loading all file contents into memory.
-     *
-     * @param dir The directory containing files to be indexed.
-     * @param id_start The starting unique identifier for documents. Defaults to 0.
-     * @param filter An optional pointer to a StopFilter instance to filter out stop words.
-     * @return The next available document ID after indexing the files in the directory.
-     */
-    uint32_t add_dir(const std::filesystem::path& dir, uint32_t id_start = 0, StopFilter* filter = nullptr);
-
-    /**
-     * @brief Clears the index.
-     *
-     * This function resets the index by clearing all stored data, preparing the index for
-     * new data to be added. It is essential for memory management, especially when handling
-     * large datasets.
-     */
-    void clear();
-
-    /**
-     * @brief Serializes the index to a binary output stream.
-     *
-     * This function converts the in-memory index into a binary format for storage.
-     * The binary format consists of a size header followed by entries for each word.
-     * Each entry includes the frequency of the word, the length of the word,
-     * the word itself, the number of documents that contain the word,
-     * and the list of document IDs.
-     *
-     * The binary format of the index is as follows:
-     * - uint32_t size: The number of entries in the index.
-     * - Entry[] entries: An array of Entry structures, each containing the serialized data for a word.
-     * - For the binary format of Entry, see the `write_entry` function.
-     *
-     * @param output The output stream to write the serialized index to.
-     */
-    void serialize(std::ostream& output);
-
-    /**
-     * @brief Saves the serialized index to a file.
-     *
-     * This function opens a binary output file stream for the specified filename
-     * and calls the serialize method to write the index to the file.
-     * It ensures that the output file is properly closed after writing.
-     *
-     * @param filename The name of the file where the index will be saved.
-     */
-    void save(const std::filesystem::path& filename);
-
-    /**
-     * @brief Reads a serialized index from a file.
-     *
-     * This function opens a binary input file stream for the specified filename,
-     * calls the deserialize method to read and reconstruct the index,
-     * and ensures the input file is properly closed after reading.
-     *
-     * @param filename The name of the file from which the index will be read.
-     * @return The FileIndex object reconstructed from the file.
-     */
-    static FileIndex deserialize(std::istream& input);
-
-    /**
-     * @brief Reads a serialized index from a file.
-     *
-     * This function opens a binary input file stream for the specified filename,
-     * calls the deserialize method to read and reconstruct the index,
-     * and ensures the input file is properly closed after reading.
-     *
-     * @param filename The name of the file from which the index will be read.
-     * @return The FileIndex object reconstructed from the file.
-     */
-    static FileIndex read(const std::string& filename);
-
-    /**
-     * @brief Prints the index to an output stream.
-     * This function iterates over the index and prints each word and its corresponding entry.
-     * The entry is printed in the format "word(freq): doc1 doc2 ...", where "word" is the word, "freq" is the frequency of the word, and "doc1 doc2 ..." is the list of document IDs that contain the word.
-     * @param output The output stream to which the index will be printed.
-     */
-    void print(std::ostream& output);
-
-    /**
-     * @overload
-     * @brief Prints the index to a file.
-     * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
-     * It ensures that the file is properly closed after printing.
-     * @param filename The name of the file where the index will be printed.
-     */
-    void print(const std::filesystem::path& filename);
-
-    /**
-     * @brief Prints the index to a file.
-     * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
-     * It ensures that the file is properly closed after printing.
-     * @param filename The name of the file where the index will be printed.
-     * @param output The output stream to which the index will be printed.
-     */
-    static void print_file(const std::string& filename, std::ostream& output);
-
-    /**
-     * @brief Merge two indexes from two streams into one stream.
-     * Merge two indexes from two streams into one stream.
-     * This function avoid read all the data into memory.
-     * So it can handle large files.
-     * @param input1 The first input stream.
-     * @param input2 The second input stream.
-     * @param output The output stream.
-     */
-    static void merge_files(
-        const std::filesystem::path& filename1,
-        const std::filesystem::path& filename2,
-        const std::filesystem::path& output_filename
-    );
-
-    /**
-     * @brief Read an entry from the input stream.
-     * Read a word and an entry from the input stream.
-     * @param input The input stream.
-     * @param word The word of the entry.
-     * @param entry The entry to be read.
-     */
-    struct Entry {
-        uint32_t freq;
-        std::vector<uint32_t> docs;
-    };
-
-    /**
-     * @brief Write an entry to the output stream.
-     * Write a word and an entry to the output stream.
-     * The binary format is:
-     * - word_len (uint32_t): length of word
-     * - word (char[word_len]): the word
-     * - freq (uint32_t): frequency of the word
-     * - num_doc (uint32_t): number of documents
-     * - docs (uint32_t[num_doc]): the documents
-     */
-    static bool read_entry(std::istream& input, std::string& word, Entry& entry);
-
-    /**
-     * @brief Print an entry to the output stream.
-     * Print a word and an entry to the output stream.
-     * The format is:
-     * word(freq): doc1 doc2 ...
-     * For example:
-     * hello(3): 1 2 3
-     * hello is the word, 3 is the frequency, 1 2 3 are the documents.
-     *
-     * @param output The output stream.
-     * @param word The word of the entry.
-     * @param entry The entry to be printed.
-     */
-    static void write_entry(std::ostream& output, const std::string& word, const Entry& entry);
-
-    /**
-     * @brief Merge two entries.
-     * Merge two entries into one.
-     * The merged entry has the sum of the frequencies and the union of the documents.
-     * The documents are sorted in ascending order.
-     * @param entry1 The first entry.
-     * @param entry2 The second entry.
-     * @return The merged entry.
-     */
-    static void print_entry(std::ostream& output, const std::string& word, const Entry& entry);
-
-    // Helper function to merge two vectors of file IDs
-    static Entry merge_entries(const Entry& entry1, const Entry& entry2);
-private:
-    std::map<std::string, Entry> index; ///< The index of words and their frequencies and documents.
-};
+#pragma once
+
+#include <map>
+#include <vector>
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <filesystem>
+
+#include "StopFilter.h"
+#include "TermDictionary.h"
+
+/**
+ * @class FileIndex
+ * @brief This class implements an inverted file index teached in the ADS course for a mini search engine.
+ *
+ * The inverted index allows for efficient storage and retrieval of documents based on keywords.
+ * It supports adding files and directories, serializing to and from binary files, and **merging
+ * multiple indexes without loading all data into memory**, making it suitable for **large datasets**.
+ */
+class FileIndex {
+public:
+    /**
+     * @brief Adds the content of a file to the index.
+     *
+     * This function reads tokens from the specified file and updates the index accordingly.
+     * It increments the frequency count of each token and records the document ID in which
+     * the token appears.
+     *
+     * @param filename The name of the file to be added to the index.
+     * @param id The unique identifier for the document being indexed.
+     * @param filter An optional pointer to a StopFilter instance to filter out stop words.
+     * @param hash If not nullptr, the Manifest::hash_bytes hash it holds is extended with the bytes read.
+     * @return The number of tokens added, stop words excluded, i.e. the length of the document.
+     */
+    uint32_t add_file(const std::filesystem::path& filename, uint32_t id, StopFilter* filter = nullptr, uint64_t* hash = nullptr);
+
+    /**
+     * @brief Adds one occurrence of a token to the index.
+     *
+     * The tokens of a document must be added before those of any later document, so the
+     * posting lists stay sorted.
+     *
+     * @param token The stemmed token.
+     * @param id The unique identifier of the document containing the token.
+     * @param count The number of occurrences to add.
+     */
+    void add_token(const std::string& token, uint32_t id, uint32_t count = 1);
+
+    /**
+     * @brief Adds all files from a specified directory to the index.
+     *
+     * This function retrieves all files in the specified directory and adds each file's content
+     * to the index using a unique document ID starting from id_start. It supports large datasets
+     * by processing files sequentially instead of loading all file contents into memory.
+     *
+     * @param dir The directory containing files to be indexed.
+     * @param id_start The starting unique identifier for documents. Defaults to 0.
+     * @param filter An optional pointer to a StopFilter instance to filter out stop words.
+     * @return The next available document ID after indexing the files in the directory.
+     */
+    uint32_t add_dir(const std::filesystem::path& dir, uint32_t id_start = 0, StopFilter* filter = nullptr);
+
+    /**
+     * @brief Clears the index.
+     *
+     * This function resets the index by clearing all stored data, preparing the index for
+     * new data to be added. It is essential for memory management, especially when handling
+     * large datasets.
+     */
+    void clear();
+
+    /**
+     * @brief Serializes the index to a binary output stream.
+     *
+     * This function converts the in-memory index into a binary format for storage.
+     * The binary format consists of a size header followed by entries for each word.
+     * Each entry includes the frequency of the word, the length of the word,
+     * the word itself, the number of documents that contain the word,
+     * and the list of document IDs.
+     *
+     * The binary format of the index is as follows:
+     * - uint32_t size: The number of entries in the index.
+     * - Entry[] entries: An array of Entry structures, each containing the serialized data for a word.
+     * - For the binary format of Entry, see the `write_entry` function.
+     *
+     * @param output The output stream to write the serialized index to.
+     */
+    void serialize(std::ostream& output) const;
+
+    /**
+     * @brief Saves the serialized index to a file.
+     *
+     * This function opens a binary output file stream for the specified filename
+     * and calls the serialize method to write the index to the file.
+     * It ensures that the output file is properly closed after writing.
+     *
+     * @param filename The name of the file where the index will be saved.
+     */
+    void save(const std::filesystem::path& filename) const;
+
+    /**
+     * @brief Saves the index as a run of term IDs, for merge_runs.
+     *
+     * A run has the layout of an index file, except that each entry starts with the ID of its
+     * word in the dictionary instead of the word, and entries are sorted by ID:
+     * - uint32_t size: The number of entries.
+     * - Entry[] entries: id (uint32_t), freq (uint32_t), num_doc (uint32_t), docs (uint32_t[num_doc]).
+     *
+     * @param filename The name of the run file.
+     * @param dictionary The dictionary, new words are added to it.
+     */
+    void save_run(const std::filesystem::path& filename, TermDictionary& dictionary) const;
+
+    /**
+     * @brief Reads a serialized index from a file.
+     *
+     * This function opens a binary input file stream for the specified filename,
+     * calls the deserialize method to read and reconstruct the index,
+     * and ensures the input file is properly closed after reading.
+     *
+     * @param filename The name of the file from which the index will be read.
+     * @return The FileIndex object reconstructed from the file.
+     */
+    static FileIndex deserialize(std::istream& input);
+
+    /**
+     * @brief Reads a serialized index from a file.
+     *
+     * This function opens a binary input file stream for the specified filename,
+     * calls the deserialize method to read and reconstruct the index,
+     * and ensures the input file is properly closed after reading.
+     *
+     * @param filename The name of the file from which the index will be read.
+     * @return The FileIndex object reconstructed from the file.
+     */
+    static FileIndex read(const std::string& filename);
+
+    /**
+     * @brief Prints the index to an output stream.
+     * This function iterates over the index and prints each word and its corresponding entry.
+     * The entry is printed in the format "word(freq): doc1 doc2 ...", where "word" is the word, "freq" is the frequency of the word, and "doc1 doc2 ..." is the list of document IDs that contain the word.
+     * @param output The output stream to which the index will be printed.
+     */
+    void print(std::ostream& output);
+
+    /**
+     * @overload
+     * @brief Prints the index to a file.
+     * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
+     * It ensures that the file is properly closed after printing.
+     * @param filename The name of the file where the index will be printed.
+     */
+    void print(const std::filesystem::path& filename);
+
+    /**
+     * @brief Prints the index to a file.
+     * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
+     * It ensures that the file is properly closed after printing.
+     * @param filename The name of the file where the index will be printed.
+     * @param output The output stream to which the index will be printed.
+     */
+    static void print_file(const std::string& filename, std::ostream& output);
+
+    /**
+     * @brief Merge two indexes from two streams into one stream.
+     * Merge two indexes from two streams into one stream.
+     * This function avoid read all the data into memory.
+     * So it can handle large files.
+     * @param input1 The first input stream.
+     * @param input2 The second input stream.
+     * @param output The output stream.
+     * @param on_write Called with the size of each entry written, e.g. to throttle the merge. Optional.
+     */
+    static void merge_files(
+        const std::filesystem::path& filename1,
+        const std::filesystem::path& filename2,
+        const std::filesystem::path& output_filename,
+        const std::function<void(std::size_t)>& on_write = nullptr
+    );
+
+    /**
+     * @brief Merge two runs saved by save_run into one run.
+     * Like merge_files, but entries are matched by comparing term IDs, and only IDs are copied.
+     * @param filename1 The first run.
+     * @param filename2 The second run.
+     * @param output_filename The merged run.
+     * @param on_write Called with the size of each entry written, e.g. to throttle the merge. Optional.
+     */
+    static void merge_runs(
+        const std::filesystem::path& filename1,
+        const std::filesystem::path& filename2,
+        const std::filesystem::path& output_filename,
+        const std::function<void(std::size_t)>& on_write = nullptr
+    );
+
+    /**
+     * @brief Write a run as an index file, its words in lexicographic order.
+     * The run is mapped and its entries are copied in the order of dictionary.sorted_ids(), with
+     * each ID replaced by its word, so the index file is the same as with merge_files.
+     * @param run The run, e.g. all the runs of a build merged by merge_runs.
+     * @param dictionary The dictionary of the run.
+     * @param output_filename The index file.
+     */
+    static void run_to_index(const std::filesystem::path& run, const TermDictionary& dictionary, const std::filesystem::path& output_filename);
+
+    /**
+     * @brief Read an entry from the input stream.
+     * Read a word and an entry from the input stream.
+     * @param input The input stream.
+     * @param word The word of the entry.
+     * @param entry The entry to be read.
+     */
+    struct Entry {
+        uint32_t freq = 0; ///< The total frequency of the word.
+        std::vector<uint32_t> docs; ///< The sorted IDs of the documents containing the word.
+    };
+
+    /**
+     * @brief Adds the postings of a word, after those it already has.
+     *
+     * Adding words in lexicographic order costs no search of the index, see SortInverter.
+     *
+     * @param word The stemmed word.
+     * @param entry The frequency and the documents of the word, the documents must not be before those it already has.
+     */
+    void add_entry(const std::string& word, Entry&& entry);
+
+    /**
+     * @brief Write an entry to the output stream.
+     * Write a word and an entry to the output stream.
+     * The binary format is:
+     * - word_len (uint32_t): length of word
+     * - word (char[word_len]): the word
+     * - freq (uint32_t): frequency of the word
+     * - num_doc (uint32_t): number of documents
+     * - docs (uint32_t[num_doc]): the documents
+     */
+    static bool read_entry(std::istream& input, std::string& word, Entry& entry);
+
+    /**
+     * @brief Decode an entry from memory, e.g. from a memory-mapped index file.
+     * The binary format is the same as read_entry.
+     * @param data The start of the entry.
+     * @param size The number of bytes available from data.
+     * @param word The word of the entry.
+     * @param entry The entry to be decoded.
+     * @return The number of bytes the entry takes, or 0 if it is truncated.
+     */
+    static std::size_t decode_entry(const char* data, std::size_t size, std::string& word, Entry& entry);
+
+    /**
+     * @brief Print an entry to the output stream.
+     * Print a word and an entry to the output stream.
+     * The format is:
+     * word(freq): doc1 doc2 ...
+     * For example:
+     * hello(3): 1 2 3
+     * hello is the word, 3 is the frequency, 1 2 3 are the documents.
+     *
+     * @param output The output stream.
+     * @param word The word of the entry.
+     * @param entry The entry to be printed.
+     */
+    static void write_entry(std::ostream& output, const std::string& word, const Entry& entry);
+
+    /**
+     * @brief Merge two entries.
+     * Merge two entries into one.
+     * The merged entry has the sum of the frequencies and the union of the documents.
+     * The documents are sorted in ascending order.
+     * @param entry1 The first entry.
+     * @param entry2 The second entry.
+     * @return The merged entry.
+     */
+    static void print_entry(std::ostream& output, const std::string& word, const Entry& entry);
+
+    // Helper function to merge two vectors of file IDs
+    static Entry merge_entries(const Entry& entry1, const Entry& entry2);
+
+    /**
+     * @brief Finds the entry of a word.
+     *
+     * @param word The word to look up.
+     * @return A pointer to the entry, or nullptr if the word is not in the index.
+     */
+    const Entry* find(const std::string& word) const;
+
+    /**
+     * @brief Estimate the heap memory of the index.
+     * @return The bytes of the words, the posting lists and the map nodes, see MemoryUsage.
+     */
+    uint64_t memory_usage() const;
+private:
+    std::map<std::string, Entry> index; ///< The index of words and their frequencies and documents.
+};
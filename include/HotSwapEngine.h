@@ -0,0 +1,110 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <condition_variable>
+
+#include "SearchEngine.h"
+#include "DeltaIndex.h"
+
+/**
+ * @class HotSwapEngine
+ * @brief Keeps a long-running process on the newest published index generation.
+ *
+ * Readers call acquire() to get the current SearchEngine and run their query on it. A reload
+ * loads the new generation in the background and then swaps the pointer atomically, so queries
+ * never wait for a load. Queries already running keep their reference and finish on the old
+ * generation, which is reclaimed when its last reader drops the reference.
+ *
+ * A RealtimeIndexer may publish a DeltaIndex of the files changed since the generation was
+ * published. search() then answers from the delta and the engine it was built on, which are
+ * always consistent, even while the engine is being swapped.
+ */
+class HotSwapEngine {
+public:
+    /**
+     * @brief Load the generation currently published for a target directory.
+     * @param dir The target directory, see SearchEngine::SearchEngine.
+     * @param memory_limit The memory ceiling of every loaded engine, see SearchEngine::set_memory_limit. 0 for no limit.
+     */
+    explicit HotSwapEngine(const std::filesystem::path& dir, uint64_t memory_limit = 0);
+
+    /**
+     * @brief Stop the watcher thread, if any.
+     */
+    ~HotSwapEngine();
+
+    HotSwapEngine(const HotSwapEngine&) = delete;
+    HotSwapEngine& operator=(const HotSwapEngine&) = delete;
+
+    /**
+     * @brief Get the current engine.
+     * @return A reference that keeps its generation alive while it is held.
+     */
+    std::shared_ptr<const SearchEngine> acquire() const;
+
+    /**
+     * @brief Run a query on the current engine and delta.
+     * @param query The query, see SearchEngine::search.
+     * @param output The output stream to write the result to.
+     * @param options The options of the query, see SearchEngine::search. Its delta is replaced by the current one.
+     */
+    void search(const std::string& query, std::ostream& output, const SearchEngine::SearchOptions& options = SearchEngine::SearchOptions()) const;
+
+    /**
+     * @brief Get the current delta.
+     * @return The delta, nullptr if none was published.
+     */
+    std::shared_ptr<const DeltaIndex> acquire_delta() const;
+
+    /**
+     * @brief Publish a new delta, replacing the current one.
+     * @param delta The delta, nullptr to remove it.
+     */
+    void publish_delta(std::shared_ptr<const DeltaIndex> delta);
+
+    /**
+     * @brief Get the target directory.
+     * @return The target directory.
+     */
+    const std::filesystem::path& target() const { return dir; }
+
+    /**
+     * @brief Load and swap in the published generation if it differs from the current one.
+     * @return true if a new generation was swapped in.
+     *
+     * The current engine keeps serving queries while the new one loads. If the new generation
+     * cannot be loaded, or does not fit in the memory limit, the current engine is kept.
+     */
+    bool reload();
+
+    /**
+     * @brief Start a background thread that reloads when a new generation is published.
+     * @param interval How often to check the CURRENT pointer file, 0 to only reload on request_reload().
+     */
+    void watch(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Ask the watcher thread to reload as soon as possible.
+     *
+     * This only sets a flag, so it is safe to call from a signal handler (e.g. SIGHUP).
+     */
+    void request_reload() { reload_requested = true; }
+
+private:
+    std::filesystem::path dir; ///< The target directory.
+    uint64_t memory_limit; ///< The memory ceiling of every loaded engine, 0 for no limit.
+    std::filesystem::path rejected; ///< The last generation over the memory limit, not loaded again.
+    std::shared_ptr<const SearchEngine> engine; ///< The current engine, only accessed with std::atomic_load/store.
+    std::shared_ptr<const DeltaIndex> delta; ///< The current delta, only accessed with std::atomic_load/store.
+    std::mutex reload_mutex; ///< Serializes reloads.
+    std::thread watcher; ///< The watcher thread, if started.
+    std::mutex watcher_mutex; ///< Protects stopping for watcher_cv.
+    std::condition_variable watcher_cv; ///< Wakes the watcher thread to stop.
+    bool stopping = false; ///< true when the watcher thread should exit.
+    std::atomic<bool> reload_requested{ false }; ///< Set by request_reload().
+};
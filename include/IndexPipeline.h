@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "ArchiveReader.h"
+#include "FileIndex.h"
+#include "Manifest.h"
+#include "SortInverter.h"
+#include "StopFilter.h"
+
+/**
+ * @class IndexPipeline
+ * @brief Indexes files in three overlapping stages: reading, tokenizing and inverting.
+ *
+ * Reader threads read the files ahead, in chunks, into buffers that are recycled once tokenized.
+ * A tokenizer thread turns the chunks of each file into stemmed, stop-filtered tokens, in
+ * batches, and the calling thread adds the batches to the index. The stages are connected by
+ * BoundedQueue, so a stage that runs ahead is held back when its buffers are used up, and the
+ * memory of the pipeline is fixed by its Options.
+ *
+ * A file larger than Options::split_bytes would hold the whole build on the tokenizer thread,
+ * so it is tokenized by several threads instead, a window of that size at a time, and its
+ * distinct tokens are sent to the inverter with their counts.
+ *
+ * Files are tokenized and inverted in input order, so the index is the same as adding every
+ * file with FileIndex::add_file. With SORT inversion, the tokens go to a SortInverter, whose
+ * posting lists are moved into the index when run() returns. The time each stage waits for its neighbours is reported in
+ * Stats, and in the stall phases of the active IndexProfile.
+ */
+class IndexPipeline {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief How the tokens are inverted.
+     */
+    enum Inversion {
+        MAP, ///< FileIndex::add_token, a tree lookup per token.
+        SORT ///< A SortInverter, sorting (term ID, document ID) pairs.
+    };
+
+    /**
+     * @brief The options of the pipeline.
+     */
+    struct Options {
+        unsigned readers = 2; ///< The number of reader threads, 0 to index every file with FileIndex::add_file.
+        std::size_t read_ahead = 4; ///< The number of chunk buffers of each reader.
+        std::size_t chunk_bytes = 1 << 18; ///< The size of a chunk buffer.
+        std::size_t batch_tokens = 1 << 12; ///< The number of tokens of a batch.
+        std::size_t batches = 4; ///< The number of token batches between the tokenizer and the inverter.
+        std::size_t split_bytes = 1 << 24; ///< Files larger than this are tokenized by several threads, in windows of this size, 0 never splits.
+        unsigned split_threads = 0; ///< The number of threads tokenizing a large file, 0 means one per hardware thread.
+        Inversion inversion = MAP; ///< How the tokens are inverted, readers = 0 always uses MAP.
+        SortInverter::Options sort; ///< The options of SORT inversion.
+    };
+
+    /**
+     * @brief What the pipeline did, and how long its stages waited.
+     */
+    struct Stats {
+        uint64_t files = 0; ///< The number of files read, including those that cannot be opened.
+        uint64_t bytes = 0; ///< The number of bytes read.
+        uint64_t split_files = 0; ///< The number of files tokenized by several threads.
+        uint64_t sorts = 0; ///< The number of times the SortInverter sorted its buffer.
+        clock::duration read_stall{}; ///< The time readers waited for a free buffer, summed over readers.
+        clock::duration tokenize_input_stall{}; ///< The time the tokenizer waited for a chunk.
+        clock::duration tokenize_output_stall{}; ///< The time the tokenizer waited for a free batch.
+        clock::duration invert_stall{}; ///< The time the inverter waited for a batch.
+    };
+
+    /**
+     * @brief Create a pipeline.
+     * @param index The index the files are added to.
+     * @param filter The stop filter, nullptr if no stop filter is needed.
+     * @param options The options.
+     */
+    IndexPipeline(FileIndex& index, StopFilter* filter, const Options& options);
+
+    /**
+     * @brief Gets the file at a position of the input, waiting until it is known if needed.
+     *
+     * Called with i = 0, 1, ... from several threads; returns false if there are i files or
+     * fewer. A DirWalker can stream the files of a directory while they are indexed.
+     */
+    using FileSource = std::function<bool(std::size_t i, std::string& file)>;
+
+    /**
+     * @brief Called on the calling thread after each file is added to the index, in input order,
+     * with its position in the input, its path and its number of tokens, stop words excluded.
+     * With SORT inversion, the index only gets the postings of the files when run() returns.
+     *
+     * The entry has the document ID, the size and mtime of the file when it was opened, and the
+     * hash of the bytes indexed, so it matches the postings even if the file changed since.
+     * Archive members have no mtime.
+     */
+    using DocumentCallback = std::function<void(uint32_t i, const std::string& file, uint32_t length, const Manifest::Entry& entry)>;
+
+    /**
+     * @brief Index files.
+     * @param source The files, a file that cannot be opened is indexed as an empty document.
+     * @param first_id The document ID of the first file, the others follow.
+     * @param on_document Called after each file is added to the index.
+     * @return The statistics of the run.
+     */
+    Stats run(const FileSource& source, uint32_t first_id, const DocumentCallback& on_document);
+
+    /**
+     * @brief Index a list of files.
+     * @param files The files, a file that cannot be opened is indexed as an empty document.
+     * @param first_id The document ID of the first file, the others follow.
+     * @param on_document Called after each file is added to the index.
+     * @return The statistics of the run.
+     */
+    Stats run(const std::vector<std::string>& files, uint32_t first_id, const DocumentCallback& on_document);
+
+    /**
+     * @brief Index the documents of an archive.
+     * @param archive The archive, read by one reader thread whatever Options::readers.
+     * @param first_id The document ID of the first document, the others follow.
+     * @param on_document Called after each document is added to the index.
+     * @return The statistics of the run.
+     */
+    Stats run(ArchiveReader& archive, uint32_t first_id, const DocumentCallback& on_document);
+
+    class Input; ///< Where the readers take the documents from: files or an archive.
+
+private:
+    /**
+     * @brief Run the stages of the pipeline.
+     * @param input The files and their contents.
+     * @param first_id The document ID of the first file, the others follow.
+     * @param on_document Called after each file is added to the index.
+     * @return The statistics of the run.
+     */
+    Stats run(Input& input, uint32_t first_id, const DocumentCallback& on_document);
+
+    FileIndex& index; ///< The index the files are added to.
+    StopFilter* filter; ///< The stop filter, nullptr if none.
+    Options options; ///< The options.
+};
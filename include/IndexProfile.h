@@ -0,0 +1,227 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <filesystem>
+
+/**
+ * @class IndexProfile
+ * @brief Counters and timers of the phases of an index build, with an optional trace timeline.
+ *
+ * A profile is made active for the duration of a build with an IndexProfile::Activation. While it
+ * is active, the directory walk, FileIndex::add_file, IndexPipeline, FileIndex::save and
+ * FileIndex::merge_files record their time and counts into it, from any thread. When no profile
+ * is active the instrumentation only costs one atomic load per file, save or merge.
+ *
+ * Times of the phases are summed over all threads. With tracing enabled, every file, save and
+ * merge is also recorded as an event of a Chrome trace (chrome://tracing or https://ui.perfetto.dev).
+ */
+class IndexProfile {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief The phases of an index build.
+     */
+    enum Phase {
+        WALK, ///< Listing the files of the directory (get_files).
+        READ, ///< Reading file contents.
+        TOKENIZE, ///< Splitting the contents into tokens and skipping HTML tags.
+        STEM, ///< Stemming tokens.
+        STOP_FILTER, ///< Filtering stop words.
+        INVERT, ///< Adding tokens to the in-memory inverted index.
+        SERIALIZE, ///< Writing index files.
+        MERGE, ///< Merging index files.
+        READ_STALL, ///< Reader threads of an IndexPipeline waiting for a free buffer.
+        TOKENIZE_STALL, ///< The tokenizer of an IndexPipeline waiting for a chunk or a free batch.
+        INVERT_STALL, ///< The inverter of an IndexPipeline waiting for a batch of tokens.
+        PHASES ///< The number of phases.
+    };
+
+    /**
+     * @brief The counters of an index build.
+     */
+    enum Counter {
+        FILES, ///< The number of indexed files.
+        BYTES_READ, ///< The bytes read from indexed files.
+        TOKENS, ///< The number of tokens, stop words included.
+        STOP_WORDS, ///< The number of tokens dropped by the stop filter.
+        UNIQUE_TERMS, ///< The number of terms of the final index.
+        MERGES, ///< The number of index file merges.
+        BYTES_WRITTEN, ///< The bytes of index files written, temporary files included.
+        COUNTERS ///< The number of counters.
+    };
+
+    /**
+     * @brief Accumulates the time of fine-grained phases in a single thread.
+     *
+     * Each lap attributes the time since the previous lap to a phase, so consecutive phases cost
+     * one clock read each. Times are added to the profile when the laps are destroyed. All calls
+     * are no-ops if the profile is nullptr.
+     */
+    class Laps {
+    public:
+        explicit Laps(IndexProfile* profile) : profile(profile), last(profile ? clock::now() : clock::time_point()) {}
+        ~Laps();
+        Laps(const Laps&) = delete;
+        Laps& operator=(const Laps&) = delete;
+
+        /**
+         * @brief Attribute the time since the previous lap to a phase.
+         * @param phase The phase.
+         */
+        void lap(Phase phase) {
+            if (!profile) return;
+            clock::time_point now = clock::now();
+            times[phase] += now - last;
+            last = now;
+        }
+
+        /**
+         * @brief Count events of the profiled build.
+         * @param counter The counter.
+         * @param value The value to add.
+         */
+        void count(Counter counter, uint64_t value = 1) {
+            if (profile) counts[counter] += value;
+        }
+
+        /**
+         * @brief Start the next lap now, without attributing the time since the previous lap.
+         *
+         * For time already recorded otherwise, e.g. by a Scope.
+         */
+        void skip() {
+            if (profile) last = clock::now();
+        }
+
+    private:
+        IndexProfile* profile; ///< The profile, nullptr if not profiling.
+        clock::time_point last; ///< The time of the previous lap.
+        std::array<clock::duration, PHASES> times{}; ///< The time of each phase.
+        std::array<uint64_t, COUNTERS> counts{}; ///< The counters.
+    };
+
+    /**
+     * @brief Times a coarse phase, like a whole file or merge, on the active profile.
+     *
+     * The time is added to the phase, and recorded as a trace event if the profile is tracing.
+     */
+    class Scope {
+    public:
+        /**
+         * @brief Start timing.
+         * @param phase The phase.
+         * @param name The name of the trace event, the name of the phase if empty.
+         */
+        explicit Scope(Phase phase, const std::string& name = "");
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        IndexProfile* profile; ///< The active profile, nullptr if not profiling.
+        Phase phase; ///< The phase.
+        std::string name; ///< The name of the trace event.
+        clock::time_point start; ///< The start time.
+    };
+
+    /**
+     * @brief Makes a profile the active one, until destroyed.
+     */
+    class Activation {
+    public:
+        explicit Activation(IndexProfile& profile);
+        ~Activation();
+        Activation(const Activation&) = delete;
+        Activation& operator=(const Activation&) = delete;
+
+    private:
+        IndexProfile& profile; ///< The activated profile.
+        IndexProfile* previous; ///< The profile active before.
+        clock::time_point start; ///< The activation time.
+    };
+
+    /**
+     * @brief Construct an empty profile.
+     * @param trace Whether to record trace events.
+     */
+    explicit IndexProfile(bool trace = false);
+
+    /**
+     * @brief Get the active profile.
+     * @return The profile, nullptr if none is active.
+     */
+    static IndexProfile* active() { return current.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Get the name of a phase.
+     * @param phase The phase.
+     * @return The name, e.g. "stop_filter".
+     */
+    static const char* phase_name(Phase phase);
+
+    /**
+     * @brief Get the name of a counter.
+     * @param counter The counter.
+     * @return The name, e.g. "bytes_read".
+     */
+    static const char* counter_name(Counter counter);
+
+    void add_time(Phase phase, clock::duration time); ///< Add time to a phase.
+    void add(Counter counter, uint64_t value); ///< Add to a counter.
+    void set(Counter counter, uint64_t value); ///< Set a counter.
+    clock::duration time(Phase phase) const; ///< Get the time of a phase.
+    uint64_t count(Counter counter) const; ///< Get a counter.
+
+    /**
+     * @brief Record a trace event, if tracing.
+     * @param name The name of the event.
+     * @param category The category of the event, e.g. the name of a phase.
+     * @param start The start time.
+     * @param end The end time.
+     */
+    void trace_event(const std::string& name, const char* category, clock::time_point start, clock::time_point end);
+
+    bool is_tracing() const { return tracing; } ///< Whether trace events are recorded.
+
+    /**
+     * @brief Write the summary of the build as JSON.
+     * @param output The output stream.
+     */
+    void write_summary(std::ostream& output) const;
+
+    /**
+     * @brief Write the trace events in the Chrome trace event format.
+     * @param filename The trace file.
+     * @return false if the file cannot be written.
+     */
+    bool write_trace(const std::filesystem::path& filename) const;
+
+private:
+    /**
+     * @brief A complete trace event.
+     */
+    struct Event {
+        std::string name; ///< The name of the event.
+        const char* category; ///< The category of the event.
+        uint32_t thread; ///< The small ID of the thread.
+        int64_t start_us; ///< The start time, in microseconds since the profile was created.
+        int64_t duration_us; ///< The duration, in microseconds.
+    };
+
+    static std::atomic<IndexProfile*> current; ///< The active profile.
+    bool tracing; ///< Whether trace events are recorded.
+    clock::time_point origin; ///< The creation time, the origin of trace timestamps.
+    std::atomic<int64_t> total_ns{ 0 }; ///< The total time the profile was active.
+    std::array<std::atomic<int64_t>, PHASES> times{}; ///< The time of each phase, in nanoseconds.
+    std::array<std::atomic<uint64_t>, COUNTERS> counters{}; ///< The counters.
+    mutable std::mutex events_mutex; ///< Protects events.
+    std::vector<Event> events; ///< The trace events.
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <map>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <filesystem>
+
+/**
+ * @class IndexStats
+ * @brief Statistics of the layout of index files, gathered in one streaming pass.
+ *
+ * Each index file added with add_file() is read sequentially in fixed-size chunks, so the
+ * memory used does not depend on the size of the index: only one count per distinct document
+ * frequency is kept, and there are at most about sqrt(2 * postings) of them.
+ *
+ * Besides the vocabulary and the distribution of document frequencies, the size of the posting
+ * lists is projected under each codec of IndexStats::Codec, computed on the document ID gaps.
+ * Segments added one by one are summed, a term held by several segments counts once per segment.
+ */
+class IndexStats {
+public:
+    /**
+     * @brief The posting list encodings the sizes are projected for.
+     */
+    enum Codec {
+        RAW, ///< The current format, a uint32_t per document ID.
+        VBYTE, ///< Gaps in 7-bit groups, the high bit of each byte marking continuation.
+        GAMMA, ///< Elias gamma coded gaps, padded to a byte per posting list.
+        BITPACK, ///< Blocks of 128 gaps packed with the bit width of the largest, one byte of width per block.
+        CODECS ///< The number of codecs.
+    };
+
+    /**
+     * @brief Get the name of a codec.
+     * @param codec The codec.
+     * @return The name, e.g. "vbyte".
+     */
+    static const char* codec_name(Codec codec);
+
+    /**
+     * @brief Add the entries of an index file.
+     * @param filename The index file, in the format written by FileIndex::serialize.
+     * @return false if the file cannot be read or is truncated, the entries read so far are kept.
+     */
+    bool add_file(const std::filesystem::path& filename);
+
+    /**
+     * @brief Print the statistics.
+     * @param output The output stream to print to.
+     */
+    void print(std::ostream& output) const;
+
+    uint64_t terms() const { return term_count; } ///< The number of entries.
+    uint64_t postings() const { return posting_count; } ///< The number of document IDs of all posting lists.
+    uint64_t occurrences() const { return occurrence_count; } ///< The sum of term frequencies.
+    uint64_t file_bytes() const { return total_bytes; } ///< The size of the index files.
+    const std::map<uint32_t, uint64_t>& doc_freqs() const { return df_terms; } ///< The number of terms of each document frequency.
+
+    /**
+     * @brief Get a percentile of the document frequencies.
+     * @param percent The percentile, e.g. 99.
+     * @return The document frequency, 0 if there are no terms.
+     */
+    uint32_t doc_freq_percentile(double percent) const;
+
+    /**
+     * @brief Get the bytes of the entries of the terms with the longest posting lists.
+     * @param ratio The ratio of terms, e.g. 0.01 for the top 1%.
+     * @return The bytes of their entries in the current format.
+     */
+    uint64_t top_bytes(double ratio) const;
+
+    /**
+     * @brief Get the entropy of the document ID gaps.
+     * @return The bits per gap, assuming gaps of the same bit length are equally likely.
+     */
+    double gap_entropy() const;
+
+    /**
+     * @brief Get the projected size of the index files under a codec.
+     * @param codec The codec of the posting lists.
+     * @return The bytes, the words and the other fields of the entries staying as they are.
+     */
+    uint64_t projected_size(Codec codec) const;
+
+private:
+    static constexpr std::size_t BLOCK = 128; ///< The number of gaps of a BITPACK block.
+
+    /**
+     * @brief The encoding state of the posting list being read.
+     */
+    struct List {
+        uint64_t last = 0; ///< One more than the previous document ID, 0 at the start of the list.
+        uint64_t gamma_bits = 0; ///< The bits of the list under GAMMA.
+        std::array<uint64_t, BLOCK> block{}; ///< The gaps of the current BITPACK block.
+        std::size_t block_size = 0; ///< The number of gaps in block.
+    };
+
+    /**
+     * @brief Account for a document ID of a posting list.
+     * @param list The posting list.
+     * @param doc The document ID, larger than the previous one.
+     */
+    void add_doc(List& list, uint32_t doc);
+
+    /**
+     * @brief Account for the end of a posting list.
+     * @param list The posting list.
+     */
+    void end_list(List& list);
+
+    /**
+     * @brief Account for a BITPACK block.
+     * @param list The posting list whose block is written.
+     */
+    void flush_block(List& list);
+
+    uint64_t file_count = 0; ///< The number of index files added.
+    uint64_t total_bytes = 0; ///< The size of the index files.
+    uint64_t term_count = 0; ///< The number of entries.
+    uint64_t posting_count = 0; ///< The number of document IDs.
+    uint64_t occurrence_count = 0; ///< The sum of term frequencies.
+    uint64_t word_bytes = 0; ///< The bytes of the words.
+    std::map<uint32_t, uint64_t> df_terms; ///< The number of terms of each document frequency.
+    std::map<uint32_t, uint64_t> df_word_bytes; ///< The bytes of the words of the terms of each document frequency.
+    std::array<uint64_t, 34> gap_bits{}; ///< The number of gaps of each bit length, up to 33 for the first gap of document ID 2^32-1.
+    std::array<uint64_t, CODECS> codec_bytes{}; ///< The bytes of the posting lists under each codec.
+};
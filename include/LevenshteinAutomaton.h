@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+/**
+ * @class LevenshteinAutomaton
+ * @brief A Levenshtein automaton that accepts all strings within a bounded edit distance of a word.
+ *
+ * A state of the automaton is one row of the classic edit distance table, with every value
+ * capped at max_edits + 1. Feeding a character produces the next row. A state is dead when
+ * no continuation can bring the distance back within max_edits, which lets the lexicon
+ * intersection skip every term sharing a dead prefix instead of comparing each of them.
+ */
+class LevenshteinAutomaton {
+public:
+    using State = std::vector<uint32_t>; ///< One row of the edit distance table.
+
+    /**
+     * @brief Construct an automaton for a word.
+     * @param word The word to match against.
+     * @param max_edits The maximum edit distance accepted, usually 1 or 2.
+     */
+    LevenshteinAutomaton(const std::string& word, uint32_t max_edits);
+
+    /**
+     * @brief Get the start state, which corresponds to the empty prefix.
+     * @return The start state.
+     */
+    State start() const;
+
+    /**
+     * @brief Feed a character to the automaton.
+     * @param state The current state.
+     * @param ch The character to feed.
+     * @return The next state.
+     */
+    State step(const State& state, char ch) const;
+
+    /**
+     * @brief Check if the string read so far is accepted.
+     * @param state The current state.
+     * @return true if the edit distance is within max_edits.
+     */
+    bool is_match(const State& state) const;
+
+    /**
+     * @brief Check if any continuation of the string read so far can be accepted.
+     * @param state The current state.
+     * @return false if the state is dead.
+     */
+    bool can_match(const State& state) const;
+
+    /**
+     * @brief Get the edit distance between the word and the string read so far.
+     * @param state The current state.
+     * @return The edit distance, or max_edits + 1 if it exceeds max_edits.
+     */
+    uint32_t distance(const State& state) const;
+
+    /**
+     * @brief Intersect the automaton with a sorted lexicon.
+     * @param terms The lexicon, must be sorted in ascending order.
+     * @return The (index in terms, edit distance) pairs of all accepted terms, in lexicon order.
+     *
+     * The lexicon is walked like a trie: the states of the common prefix with the previous term
+     * are reused, and when a prefix becomes dead all terms starting with it are skipped
+     * with a binary search.
+     */
+    std::vector<std::pair<std::size_t, uint32_t>> intersect(const std::vector<std::string>& terms) const;
+
+private:
+    std::string word; ///< The word to match against.
+    uint32_t max_edits; ///< The maximum edit distance accepted.
+};
+
+/**
+ * @brief Compute the edit distance between two strings directly.
+ * @param a The first string.
+ * @param b The second string.
+ * @return The Levenshtein distance between a and b.
+ *
+ * This is the brute force reference used by tests and benchmarks.
+ */
+uint32_t edit_distance(const std::string& a, const std::string& b);
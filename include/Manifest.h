@@ -0,0 +1,81 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * @class Manifest
+ * @brief The list of documents in an index generation, used to detect changed files.
+ *
+ * Every indexed file is recorded with its document ID, size, modification time and a hash
+ * of its content. An incremental update compares the files on disk with the manifest:
+ * a file whose size and mtime are unchanged is assumed unchanged, otherwise its hash decides.
+ */
+class Manifest {
+public:
+    /**
+     * @brief The record of one indexed file.
+     */
+    struct Entry {
+        uint32_t doc = 0; ///< The document ID of the file.
+        uint64_t size = 0; ///< The size of the file in bytes.
+        int64_t mtime = 0; ///< The modification time of the file, in file clock ticks.
+        uint64_t hash = 0; ///< The FNV-1a hash of the file content.
+    };
+
+    static constexpr uint64_t HASH_BASIS = 14695981039346656037ULL; ///< The hash of no bytes, see hash_bytes.
+
+    /**
+     * @brief Record the current state of a file.
+     * @param path The file.
+     * @param doc The document ID of the file.
+     * @return The entry of the file.
+     */
+    static Entry stat_file(const std::filesystem::path& path, uint32_t doc);
+
+    /**
+     * @brief Record the size and modification time of a file, before it is read.
+     * @param path The file.
+     * @param doc The document ID of the file.
+     * @return The entry of the file, with the hash of no bytes; size and mtime are 0 if the file cannot be stat'ed.
+     *
+     * The hash is then added to with hash_bytes as the file is read, so the entry describes
+     * the content that was indexed even if the file changes afterwards.
+     */
+    static Entry stat_only(const std::filesystem::path& path, uint32_t doc);
+
+    /**
+     * @brief Add bytes to a hash.
+     * @param hash The hash of the bytes before, HASH_BASIS at the start of a file.
+     * @param data The bytes.
+     * @param size The number of bytes.
+     * @return The 64-bit FNV-1a hash of the bytes before followed by these ones.
+     */
+    static uint64_t hash_bytes(uint64_t hash, const char* data, std::size_t size);
+
+    /**
+     * @brief Hash the content of a file.
+     * @param path The file.
+     * @return The 64-bit FNV-1a hash of the content.
+     */
+    static uint64_t hash_file(const std::filesystem::path& path);
+
+    /**
+     * @brief Read a manifest file.
+     * @param filename The manifest file.
+     * @return The manifest, empty if the file does not exist.
+     */
+    static Manifest read(const std::filesystem::path& filename);
+
+    /**
+     * @brief Save the manifest to a file.
+     * @param filename The manifest file.
+     *
+     * The format is one line per file: `doc size mtime hash path`, with the path last so it may contain spaces.
+     */
+    void save(const std::filesystem::path& filename) const;
+
+    std::map<std::string, Entry> files; ///< The indexed files by path.
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <filesystem>
+
+/**
+ * @class MappedFile
+ * @brief A read-only memory mapping of a whole file.
+ *
+ * The mapping stays valid after the file is unlinked or replaced, so a reader holding a
+ * MappedFile keeps seeing the version of the file it opened.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    /**
+     * @brief Map a file.
+     * @param filename The file to map.
+     *
+     * If the file cannot be opened or mapped, the mapping is empty.
+     */
+    explicit MappedFile(const std::filesystem::path& filename);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * @brief Get the mapped bytes.
+     * @return The start of the mapping, nullptr if it is empty.
+     */
+    const char* data() const { return bytes; }
+
+    /**
+     * @brief Get the size of the mapping.
+     * @return The number of bytes mapped.
+     */
+    std::size_t size() const { return length; }
+
+    /**
+     * @brief Check which pages of a range are in the page cache, without touching them.
+     * @param offset The offset of the range.
+     * @param count The number of bytes of the range.
+     * @return The number of resident pages and the number of pages of the range.
+     */
+    std::pair<std::size_t, std::size_t> residency(std::size_t offset, std::size_t count) const;
+
+private:
+    const char* bytes = nullptr; ///< The start of the mapping.
+    std::size_t length = 0; ///< The number of bytes mapped.
+};
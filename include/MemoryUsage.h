@@ -0,0 +1,106 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @struct MemoryUsage
+ * @brief The memory used by the components of a SearchEngine, in bytes.
+ *
+ * Heap sizes are estimated from the sizes and capacities of the containers, with the node
+ * layout of libstdc++: they do not include allocator overhead, but they follow the real usage
+ * closely enough to decide what to evict. Index files are mapped, so their pages live in the
+ * page cache, which the kernel can reclaim; they are reported apart from the heap.
+ */
+struct MemoryUsage {
+    std::vector<std::pair<std::string, uint64_t>> components; ///< The (name, heap bytes) of each component.
+    uint64_t mapped = 0; ///< The bytes of the mapped index files.
+    uint64_t resident = 0; ///< The bytes of the mapped index files currently in the page cache.
+
+    /**
+     * @brief Add the heap bytes of a component.
+     * @param name The name of the component, e.g. "lexicon".
+     * @param bytes The heap bytes.
+     */
+    void add(const std::string& name, uint64_t bytes) { components.push_back({ name, bytes }); }
+
+    /**
+     * @brief Get the heap bytes of all components.
+     * @return The sum of the components.
+     */
+    uint64_t total() const;
+
+    /**
+     * @brief Print the usage of every component, the total and the mapped index files.
+     * @param output The output stream to print to.
+     */
+    void print(std::ostream& output) const;
+};
+
+/**
+ * @brief Estimate the heap bytes owned by a value, excluding the value itself.
+ *
+ * Overloads cover the containers used by the engine, recursing into their elements.
+ * Values without heap storage own nothing.
+ */
+template <typename T>
+uint64_t heap_size(const T&) { return 0; }
+inline uint64_t heap_size(const std::string& text);
+template <typename A, typename B>
+uint64_t heap_size(const std::pair<A, B>& pair);
+template <typename T>
+uint64_t heap_size(const std::vector<T>& vec);
+inline uint64_t heap_size(const std::vector<bool>& vec);
+template <typename K, typename V, typename C>
+uint64_t heap_size(const std::map<K, V, C>& map);
+template <typename K, typename V, typename H, typename E>
+uint64_t heap_size(const std::unordered_map<K, V, H, E>& map);
+template <typename K, typename H, typename E>
+uint64_t heap_size(const std::unordered_set<K, H, E>& set);
+
+inline uint64_t heap_size(const std::string& text) {
+    return text.capacity() > 15 ? text.capacity() + 1 : 0; // shorter strings are stored inline
+}
+
+template <typename A, typename B>
+uint64_t heap_size(const std::pair<A, B>& pair) {
+    return heap_size(pair.first) + heap_size(pair.second);
+}
+
+template <typename T>
+uint64_t heap_size(const std::vector<T>& vec) {
+    uint64_t bytes = vec.capacity() * sizeof(T);
+    for (const T& value : vec) bytes += heap_size(value);
+    return bytes;
+}
+
+inline uint64_t heap_size(const std::vector<bool>& vec) {
+    return (vec.capacity() + 7) / 8;
+}
+
+template <typename K, typename V, typename C>
+uint64_t heap_size(const std::map<K, V, C>& map) {
+    uint64_t bytes = map.size() * (32 + sizeof(std::pair<const K, V>)); // color, parent, left and right
+    for (const auto& value : map) bytes += heap_size(value.first) + heap_size(value.second);
+    return bytes;
+}
+
+template <typename K, typename V, typename H, typename E>
+uint64_t heap_size(const std::unordered_map<K, V, H, E>& map) {
+    uint64_t bytes = map.bucket_count() * sizeof(void*) + map.size() * (sizeof(void*) + sizeof(std::size_t) + sizeof(std::pair<const K, V>));
+    for (const auto& value : map) bytes += heap_size(value.first) + heap_size(value.second);
+    return bytes;
+}
+
+template <typename K, typename H, typename E>
+uint64_t heap_size(const std::unordered_set<K, H, E>& set) {
+    uint64_t bytes = set.bucket_count() * sizeof(void*) + set.size() * (sizeof(void*) + sizeof(std::size_t) + sizeof(K));
+    for (const auto& value : set) bytes += heap_size(value);
+    return bytes;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <set>
+#include <map>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+#include "HotSwapEngine.h"
+#include "DeltaIndex.h"
+
+/**
+ * @class RealtimeIndexer
+ * @brief Makes changed files searchable within moments, without a rebuild.
+ *
+ * A background thread watches the target directory with inotify. Changed .html files are
+ * collected for a short debounce period, then indexed into a copy of the current DeltaIndex,
+ * which is published to the HotSwapEngine in one atomic store. Queries never wait for this.
+ *
+ * When the buffered files exceed a size limit, or the delta exceeds the memory left under the
+ * memory limit of its engine (SearchEngine::memory_budget), the delta is written to disk as a new segment
+ * (SearchEngine::flush_delta), the engine is reloaded and an empty delta replaces the full one.
+ * If another process publishes a generation (a rebuild, an update or a compaction), the delta
+ * is rebuilt on top of it from the files it changed.
+ */
+class RealtimeIndexer {
+public:
+    /**
+     * @brief Options of the indexer.
+     */
+    struct Options {
+        uint64_t flush_bytes = 16 * 1024 * 1024; ///< Flush the delta once its files total this many bytes.
+        std::chrono::milliseconds debounce{ 50 }; ///< Wait this long without events before indexing a batch.
+    };
+
+    /**
+     * @brief Create an indexer for an engine, the thread is started by start().
+     * @param engine The engine to publish deltas to, it must outlive the indexer.
+     * @param options The options of the indexer.
+     */
+    RealtimeIndexer(HotSwapEngine& engine, const Options& options);
+
+    /**
+     * @brief Stop the thread and flush the delta, if it changes anything.
+     */
+    ~RealtimeIndexer();
+
+    RealtimeIndexer(const RealtimeIndexer&) = delete;
+    RealtimeIndexer& operator=(const RealtimeIndexer&) = delete;
+
+    /**
+     * @brief Start watching the target directory.
+     * @return false if inotify is not available, the reason is printed to stderr.
+     */
+    bool start();
+
+private:
+    void run(); ///< The main loop of the thread.
+    void add_watches(const std::string& name); ///< Watch a directory and its subdirectories, queueing their files.
+    void read_events(); ///< Read the pending inotify events into changes.
+    void apply(); ///< Index the queued changes into a new delta and publish it.
+    void flush(); ///< Write the delta to disk as a segment and start an empty one.
+    void rebase(); ///< Rebuild the delta on top of the current engine.
+
+    HotSwapEngine& hot; ///< The engine to publish deltas to.
+    Options options; ///< The options of the indexer.
+    std::filesystem::path dir; ///< The absolute target directory.
+    std::shared_ptr<DeltaIndex> delta; ///< The latest delta, only used by the thread once started.
+    std::set<std::string> changes; ///< The names of the files changed since the last batch.
+    std::chrono::steady_clock::time_point last_event; ///< When the last event was read.
+    int inotify_fd = -1; ///< The inotify instance.
+    std::map<int, std::string> watches; ///< The directory name of each watch descriptor, e.g. `./sub`.
+    std::thread worker; ///< The background thread, if started.
+    std::atomic<bool> stopping{ false }; ///< true when the thread should exit.
+    std::filesystem::path budget_generation; ///< The generation budget was computed for.
+    uint64_t budget = UINT64_MAX; ///< The memory budget of its engine, see SearchEngine::memory_budget.
+};
@@ -1,76 +1,522 @@
-#include <string>
-#include <cstdint>
-#include <unordered_map>
-#include <vector>
-#include <filesystem>
-
-#include "FileIndex.h"
-#include "StopFilter.h"
-
-class SearchEngine {
-public:
-    using Offset = uint32_t;
-
-    /**
-     * @brief Construct a new Search Engine:: Search Engine object
-     * @param dir The target directory to search in.
-     *
-     * This directory should contain a index folder built using SearchEngine::gen_index(_large).
-     * The index folder's name is specified by macro BASE_DIR in utils.h.
-     */
-    SearchEngine(const std::filesystem::path& dir);
-
-    ~SearchEngine() { delete stop_filter; } // delete stop_filter to avoid memory leak
-
-    /**
-     * @brief Search for a word in the index.
-     * @param word The word to search for.
-     * @param output The output stream to write the result to.
-     * @param threshold The threshold for the search result.
-     *
-     * Threshold is a ratio from 0.0 to 1.0. It represents the percentage of terms that should be used in searching. Default value is 1.0
-     * For example, if threshold is 0.8, only the top 80% less frequent terms will be used in searching.
-     */
-    void search(const std::string& query, std::ostream& output, double threshold = 1.0) const;
-
-    /**
-     * @brief Search for a word in the index.
-     * @param word The word to search for.
-     * @param output The output stream to write the result to.
-     * @return The entry of the word in the index. Retrived from the file.
-     */
-    FileIndex::Entry search_word(const std::string& word, std::ostream& output) const;
-
-    /**
-     * @brief Generate an index for the target directory.
-     * @param dir The target directory to index.
-     * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
-     * @param quiet If true, do not print any output to stdout.
-     */
-    static void gen_index(const std::filesystem::path& dir, StopFilter* stop_filter = nullptr, bool quiet = false);
-
-    /**
-     * @brief BONUS: Generate an index for the target directory, but do most operations on dick to prevent running out of memory.
-     * @param dir The target directory to index.
-     * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
-     * @param quiet If true, do not print any output to stdout.
-     */
-    static void gen_index_large(const std::filesystem::path& dir, StopFilter* stop_filter = nullptr, bool quiet = false);
-private:
-    /**
-     * @brief Merge the index files generated by gen_index_large.
-     * @param dir The target directory to index.
-     * @param l The left index of the range to merge.
-     * @param r The right index of the range to merge.
-     * @param quiet If true, do not print any output to stdout.
-     *
-     * Merge a series of index file to one. The algorithm is similar to merge sort.
-     * It uses recursion to split the range into two halves and merge them.
-     */
-    static void merge_index(const std::filesystem::path& dir, std::size_t l, std::size_t r, bool quiet = false);
-
-    std::filesystem::path dir; ///< The target directory to search in.
-    std::vector<std::string> file_list; ///< The list of files in the target directory.
-    std::unordered_map <std::string, Offset> words; ///< The map of words to their offsets in the index file.
-    StopFilter* stop_filter; ///< The stop filter to use.
-};
\ No newline at end of file
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <filesystem>
+
+#include "DirWalker.h"
+#include "FileIndex.h"
+#include "IndexPipeline.h"
+#include "StopFilter.h"
+#include "Segment.h"
+#include "Throttle.h"
+#include "MemoryUsage.h"
+
+class DeltaIndex;
+
+/**
+ * @class SearchEngine
+ * @brief Answers queries from the index built by gen_index(_large).
+ *
+ * All query methods are const and only read state loaded by the constructor, including a
+ * read-only mapping of the index file, so a SearchEngine can be shared by any number of threads
+ * calling search() concurrently, as long as each thread writes to its own output stream.
+ *
+ * A SearchEngine is a snapshot of the index generation published when it was constructed.
+ * Rebuilding the index publishes a new generation and never modifies this one, see HotSwapEngine
+ * for switching a long-running process to the new generation.
+ *
+ * A generation is made of one or more immutable segments (see Segment): a full build writes
+ * one, every incremental update adds one for the added and modified files. Queries run across
+ * all segments, and documents deleted or replaced since are masked by per-segment deletion
+ * bitmaps. compact_index merges small segments and drops the postings of deleted documents.
+ */
+class SearchEngine {
+public:
+    using Offset = uint32_t;
+
+    /**
+     * @brief Statistics of a batch of queries run by search_batch.
+     */
+    struct BatchStats {
+        std::size_t queries = 0; ///< The number of queries run.
+        unsigned threads = 0; ///< The number of worker threads used.
+        double seconds = 0; ///< The wall time of the whole batch.
+        std::vector<double> latencies; ///< The latency of each query in milliseconds, in input order.
+        bool shared = false; ///< true if the terms were fetched once for the whole batch.
+        uint64_t bytes_read = 0; ///< The index bytes read in shared mode.
+        uint64_t per_query_bytes = 0; ///< The index bytes the per-query path would read for the same batch.
+        uint64_t cache_bytes = 0; ///< The memory of the shared entries in shared mode.
+        std::size_t spilled_terms = 0; ///< The terms left out of the shared entries by the memory limit, read per query instead.
+
+        /**
+         * @brief Get the throughput of the batch.
+         * @return The number of queries per second.
+         */
+        double qps() const;
+
+        /**
+         * @brief Get a latency percentile.
+         * @param p The percentile, from 0.0 to 100.0.
+         * @return The latency in milliseconds.
+         */
+        double percentile(double p) const;
+
+        /**
+         * @brief Print the throughput, the p50/p99 latencies and, in shared mode, the bytes read.
+         * @param output The output stream to print to.
+         */
+        void print(std::ostream& output) const;
+    };
+
+    /**
+     * @brief How a query was evaluated, filled by search() in explain mode.
+     */
+    struct QueryExplain {
+        /**
+         * @brief The lookup of one query word.
+         */
+        struct Term {
+            std::string word; ///< The stemmed query word.
+            std::vector<std::string> terms; ///< The indexed terms it stands for, more than one if fuzzy matched.
+            uint32_t doc_freq = 0; ///< The number of documents of its posting list.
+            uint32_t freq = 0; ///< The number of occurrences.
+            std::size_t lists = 0; ///< The number of posting lists decoded, one per segment holding a term.
+            uint64_t bytes_read = 0; ///< The bytes of the index decoded.
+            std::size_t pages = 0; ///< The pages of the index the posting lists span.
+            std::size_t resident_pages = 0; ///< The pages already in the page cache (cache hits).
+            double lookup_ms = 0; ///< The time to find and decode its posting lists.
+        };
+
+        /**
+         * @brief One step of the evaluation.
+         */
+        struct Step {
+            std::string word; ///< The query word intersected at this step.
+            std::size_t results = 0; ///< The number of results after the step.
+        };
+
+        std::vector<Term> terms; ///< The query words, in query order.
+        std::vector<Step> steps; ///< The evaluation steps, in evaluation order (ascending frequency).
+        std::vector<std::string> ignored; ///< The words ignored due to the threshold.
+        std::size_t masked = 0; ///< The documents dropped because they were deleted or changed.
+        double parse_ms = 0; ///< The time to tokenize, stem and stop filter the query.
+        double expand_ms = 0; ///< The time to check the lexicon and fuzzy match the words.
+        double lookup_ms = 0; ///< The time to find and decode the posting lists.
+        double evaluate_ms = 0; ///< The time to sort and intersect the posting lists.
+        double output_ms = 0; ///< The time to print the results.
+        double total_ms = 0; ///< The wall time of the whole query.
+
+        /**
+         * @brief Print the explanation.
+         * @param output The output stream to print to.
+         */
+        void print(std::ostream& output) const;
+    };
+
+    /**
+     * @brief The options of a query, see search().
+     */
+    struct SearchOptions {
+        double threshold = 1.0; ///< The ratio of the query words used, the least frequent first.
+        uint32_t fuzzy = 0; ///< The maximum edit distance for words that are not indexed, 0 to disable.
+        const DeltaIndex* delta = nullptr; ///< The files changed since the generation was published, nullptr if none.
+        QueryExplain* explain = nullptr; ///< If not nullptr, filled with the evaluation of the query.
+        std::size_t offset = 0; ///< The number of results to skip.
+        std::size_t limit = 0; ///< The maximum number of results to print, 0 for all.
+    };
+
+    /**
+     * @brief The merge policy of compact_index.
+     */
+    struct CompactionPolicy {
+        std::size_t fanout = 4; ///< Merge this many adjacent segments of the same size tier, also the size ratio between tiers.
+        uint64_t min_segment_size = 1 << 20; ///< Index files smaller than this (in bytes) are all in the lowest tier.
+        double max_deleted = 0.2; ///< Rewrite a segment alone once more than this ratio of its documents is deleted.
+        uint64_t rate_limit = 0; ///< The maximum write rate in bytes per second, 0 for unlimited.
+    };
+
+    /**
+     * @brief Construct a new Search Engine:: Search Engine object
+     * @param dir The target directory to search in, or an indexed archive.
+     *
+     * This directory should contain a index folder built using SearchEngine::gen_index(_large).
+     * The index folder's name is specified by macro BASE_DIR in utils.h, see index_folder().
+     */
+    SearchEngine(const std::filesystem::path& dir);
+
+    ~SearchEngine() { delete stop_filter; } // delete stop_filter to avoid memory leak
+
+    SearchEngine(const SearchEngine&) = delete; // stop_filter is owned
+    SearchEngine& operator=(const SearchEngine&) = delete;
+
+    /**
+     * @brief Get the generation directory this engine was loaded from.
+     * @return The directory holding the index files, see index_dir() in utils.h.
+     */
+    const std::filesystem::path& index_path() const { return generation_dir; }
+
+    /**
+     * @brief Check if the index files were loaded.
+     * @return false if an index file is missing or cannot be mapped.
+     */
+    bool is_loaded() const;
+
+    /**
+     * @brief Get the number of document IDs of the index.
+     * @return One more than the largest document ID, including deleted documents.
+     */
+    uint32_t document_count() const { return documents; }
+
+    /**
+     * @brief Get the path of a document.
+     * @param doc The document ID, must be less than document_count().
+     * @return The path, as indexed, empty for a document removed by compaction.
+     *
+     * The path is decoded from the document table of its segment, see DocTable.
+     */
+    std::string file(uint32_t doc) const;
+
+    /**
+     * @brief Estimate the memory used by the engine.
+     * @return The heap bytes of each component, and the mapped and resident bytes of the index files.
+     *
+     * This walks all loaded structures, so it takes about as long as a scan of the lexicon.
+     */
+    MemoryUsage memory_usage() const;
+
+    /**
+     * @brief Set the memory ceiling of the engine.
+     * @param bytes The maximum heap bytes of the loaded index plus its caches and buffers, 0 for no limit.
+     *
+     * The loaded index itself cannot shrink, the limit bounds what comes on top of it: the shared
+     * entries of search_batch, and the delta of a RealtimeIndexer, see memory_budget().
+     */
+    void set_memory_limit(uint64_t bytes) { memory_ceiling = bytes; }
+
+    /**
+     * @brief Get the memory ceiling of the engine.
+     * @return The maximum heap bytes, 0 for no limit.
+     */
+    uint64_t memory_limit() const { return memory_ceiling; }
+
+    /**
+     * @brief Get the memory left for caches and buffers under the ceiling.
+     * @return The limit minus the memory of the loaded index, 0 if it is already over the limit,
+     * UINT64_MAX if there is no limit.
+     */
+    uint64_t memory_budget() const;
+
+    /**
+     * @brief Find the live document of a file.
+     * @param name The document name, as indexed, e.g. `./a.html`.
+     * @param doc The document ID, if found.
+     * @return true if the file is indexed and not deleted.
+     *
+     * The map of names to documents is built on the first call, searching does not need it.
+     */
+    bool find_document(const std::string& name, uint32_t& doc) const;
+
+    /**
+     * @brief Get the stop filter the index was built with.
+     * @return The stop filter, nullptr if none.
+     */
+    StopFilter* stop_words() const { return stop_filter; }
+
+    /**
+     * @brief Search for a word in the index with the default options.
+     * @param query The query string.
+     * @param output The output stream to write the result to.
+     */
+    void search(const std::string& query, std::ostream& output) const;
+
+    /**
+     * @brief Search for a word in the index.
+     * @param query The query string.
+     * @param output The output stream to write the result to.
+     * @param options The threshold, fuzzy distance, delta, explanation and page of the query.
+     *
+     * Threshold is a ratio from 0.0 to 1.0. It represents the percentage of terms that should be used in searching. Default value is 1.0
+     * For example, if threshold is 0.8, only the top 80% less frequent terms will be used in searching.
+     *
+     * Fuzzy is the maximum edit distance (usually 1 or 2) used for terms that are not in the index.
+     * Such a term is replaced by all indexed terms within that distance, and the best one is suggested.
+     * Default value is 0, which disables fuzzy matching.
+     *
+     * A delta built on top of this engine (see DeltaIndex) adds the files changed since the
+     * generation was published: its postings are appended and the documents it masks are dropped.
+     *
+     * If explain is not nullptr, it is filled with the terms, posting list reads, evaluation steps
+     * and stage times of the query. Otherwise nothing is measured.
+     *
+     * Offset and limit select a page of the results: the first offset results are skipped and at
+     * most limit are printed, followed by a "Results <first>-<last> of <total>." line. Only the
+     * printed results have their paths decoded. With both 0, all results are printed, without the line.
+     */
+    void search(const std::string& query, std::ostream& output, const SearchOptions& options) const;
+
+    /**
+     * @brief Run a batch of queries in parallel.
+     * @param queries The queries to run.
+     * @param output The output stream to write the results to, in input order.
+     * @param options The options of every query, see search().
+     * @param threads The number of worker threads, 0 means one per hardware thread.
+     * @param shared If true, fetch each term once for the whole batch instead of once per query.
+     * @return The throughput and latency statistics of the batch.
+     *
+     * Queries are fanned out over a work-stealing thread pool. Each query writes to its own buffer,
+     * and the buffers are written to output in input order, each preceded by a "Query: <query>" line.
+     * The explain option is ignored, the statistics of the batch are returned instead.
+     *
+     * In shared mode, all queries are parsed first, then the union of their terms is fetched from the
+     * index exactly once, in on-disk offset order, and finally every query is evaluated against the
+     * shared entries. The latency of a query then excludes the shared fetch.
+     */
+    BatchStats search_batch(
+        const std::vector<std::string>& queries,
+        std::ostream& output,
+        const SearchOptions& options,
+        unsigned threads = 0,
+        bool shared = false
+    ) const;
+
+    /**
+     * @brief Search for a word in the index.
+     * @param word The word to search for.
+     * @param stats If not nullptr, the posting lists, bytes and pages read are added to it.
+     * @return The entry of the word in the index. Retrived from the file.
+     */
+    FileIndex::Entry search_word(const std::string& word, QueryExplain::Term* stats = nullptr) const;
+
+    /**
+     * @brief A term of the index that is close to a query term.
+     */
+    struct FuzzyMatch {
+        std::string word; ///< The indexed term.
+        uint32_t distance; ///< The edit distance to the query term.
+        uint32_t doc_freq; ///< The number of documents that contain the term.
+    };
+
+    /**
+     * @brief Find all indexed terms within an edit distance of a word.
+     * @param word The stemmed word to match.
+     * @param max_edits The maximum edit distance, usually 1 or 2.
+     * @return The matching terms, ranked by document frequency (descending), then by edit distance.
+     *
+     * A Levenshtein automaton is intersected with the sorted lexicon, so only the branches
+     * of the lexicon that can still match are visited.
+     */
+    std::vector<FuzzyMatch> fuzzy_search(const std::string& word, uint32_t max_edits) const;
+
+    /**
+     * @brief Suggest a correction for a word ("did you mean").
+     * @param word The stemmed word to correct.
+     * @param max_edits The maximum edit distance, usually 1 or 2.
+     * @return The best ranked fuzzy match, or an empty string if there is none.
+     */
+    std::string suggest(const std::string& word, uint32_t max_edits) const;
+
+    /**
+     * @brief Generate an index for the target directory.
+     * @param dir The target directory to index, or a tar or JSONL archive, see ArchiveReader.
+     * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
+     * @param quiet If true, do not print any output to stdout.
+     * @param pipeline The options of the indexing pipeline, see IndexPipeline.
+     * @param walk The options of the directory walk, see DirWalker.
+     *
+     * The index of an archive is written next to it, to its own index folder (see index_folder() in
+     * utils.h), and searched by passing the archive as the target. If the archive is malformed, the
+     * error is printed and nothing is published.
+     * If an IndexProfile is active, the time and counters of each phase are recorded into it.
+     */
+    static void gen_index(const std::filesystem::path& dir, StopFilter* stop_filter = nullptr, bool quiet = false,
+        const IndexPipeline::Options& pipeline = IndexPipeline::Options(), const DirWalker::Options& walk = DirWalker::Options());
+
+    /**
+     * @brief BONUS: Generate an index for the target directory, but do most operations on dick to prevent running out of memory.
+     * @param dir The target directory to index, or an archive, as for gen_index.
+     * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
+     * @param quiet If true, do not print any output to stdout.
+     * @param pipeline The options of the indexing pipeline, see IndexPipeline. Files are always inverted with MAP.
+     * @param walk The options of the directory walk, see DirWalker.
+     *
+     * If an IndexProfile is active, the time and counters of each phase are recorded into it.
+     */
+    static void gen_index_large(const std::filesystem::path& dir, StopFilter* stop_filter = nullptr, bool quiet = false,
+        const IndexPipeline::Options& pipeline = IndexPipeline::Options(), const DirWalker::Options& walk = DirWalker::Options());
+
+    /**
+     * @brief Incrementally update the index of the target directory.
+     * @param dir The target directory to index.
+     * @param stop_filter The stop filter for a full build, used only if there is no index to update.
+     * @param quiet If true, do not print any output to stdout.
+     * @param pipeline The options of the indexing pipeline, see IndexPipeline.
+     * @param walk The options of the directory walk, see DirWalker.
+     *
+     * Only added and modified files are indexed, into a new segment, using the stop words of
+     * the existing index. Falls back to gen_index if there is no index to update, or if dir is an archive.
+     * If another writer publishes first, the update is discarded and done again, a few times at most.
+     * @return false if every attempt lost to another writer, the error is printed unless quiet.
+     */
+    static bool update_index(const std::filesystem::path& dir, StopFilter* stop_filter = nullptr, bool quiet = false,
+        const IndexPipeline::Options& pipeline = IndexPipeline::Options(), const DirWalker::Options& walk = DirWalker::Options());
+
+    /**
+     * @brief Run one compaction step on the index of the target directory.
+     * @param dir The target directory.
+     * @param policy The merge policy.
+     * @param quiet If true, do not print any output to stdout.
+     * @return true if a compacted generation was published, false if there was nothing to do.
+     *
+     * The postings of deleted documents are dropped, but term frequencies are kept as they are,
+     * occurrences in deleted documents included, since term counts per document are not stored.
+     * Queries order and threshold terms by frequency, so they give the same results before and
+     * after a compaction.
+     */
+    static bool compact_index(const std::filesystem::path& dir, const CompactionPolicy& policy, bool quiet = false);
+
+    /**
+     * @brief List the index files of the published generation of a target directory.
+     * @param dir The target directory.
+     * @return The index file of every segment, in document ID order.
+     */
+    static std::vector<std::filesystem::path> index_files(const std::filesystem::path& dir);
+
+    /**
+     * @brief Write a delta to disk as a new segment and publish it.
+     * @param dir The target directory.
+     * @param delta The delta, built on top of the published generation.
+     * @return false if another generation was published since the engine of the delta was loaded.
+     */
+    static bool flush_delta(const std::filesystem::path& dir, const DeltaIndex& delta);
+private:
+    /**
+     * @brief Compare the files on disk with the published generation once, and publish the changes.
+     * @param dir The target directory to index.
+     * @param stop_filter The stop filter for a full build, used only if there is no index to update.
+     * @param quiet If true, do not print any output to stdout.
+     * @param pipeline The options of the indexing pipeline, see IndexPipeline.
+     * @param walk The options of the directory walk, see DirWalker.
+     * @return false if another generation was published meanwhile, the new generation is then removed.
+     */
+    static bool update_once(const std::filesystem::path& dir, StopFilter* stop_filter, bool quiet, const IndexPipeline::Options& pipeline,
+        const DirWalker::Options& walk);
+
+    /**
+     * @brief Merge the index files generated by gen_index_large.
+     * @param base The directory holding the index files.
+     * @param l The left index of the range to merge.
+     * @param r The right index of the range to merge.
+     * @param quiet If true, do not print any output to stdout.
+     * @param throttle Limits the write rate of the merge, nullptr for no limit.
+     * @param runs If true, the files are runs of term IDs (FileIndex::save_run) instead of index files.
+     *
+     * Merge a series of index file to one. The algorithm is similar to merge sort.
+     * It uses recursion to split the range into two halves and merge them.
+     */
+    static void merge_index(const std::filesystem::path& base, std::size_t l, std::size_t r, bool quiet = false, Throttle* throttle = nullptr,
+        bool runs = false);
+
+    /**
+     * @brief Create a new, empty generation directory.
+     * @param base The index folder, i.e. `<target_dir>/<BASE_DIR>`.
+     * @return The path of the new generation directory.
+     */
+    static std::filesystem::path begin_generation(const std::filesystem::path& base);
+
+    /**
+     * @brief Publish a complete generation and remove old ones.
+     * @param base The index folder, i.e. `<target_dir>/<BASE_DIR>`.
+     * @param generation The generation directory to publish.
+     * @param expected The name of the generation the new one was derived from, empty to publish unconditionally.
+     * @return false if expected is not the published generation any more, the new generation is then removed.
+     *
+     * The CURRENT pointer file is replaced atomically and durably, so readers see either the old or the new
+     * generation. Generations older than the published one are removed, except the previously published one.
+     */
+    static bool publish_generation(const std::filesystem::path& base, const std::filesystem::path& generation, const std::string& expected = "");
+
+    /**
+     * @brief Read the segment list of a generation.
+     * @param generation The generation directory.
+     * @return The (segment directory name, first document ID) pairs, in document ID order.
+     */
+    static std::vector<std::pair<std::string, uint32_t>> read_segments(const std::filesystem::path& generation);
+
+    /**
+     * @brief Write the segment list of a generation.
+     * @param generation The generation directory.
+     * @param segment_list The (segment directory name, first document ID) pairs, in document ID order.
+     */
+    static void write_segments(const std::filesystem::path& generation, const std::vector<std::pair<std::string, uint32_t>>& segment_list);
+
+    /**
+     * @brief Check if a document is masked by the deletion bitmap of its segment.
+     * @param doc The document ID.
+     * @return true if the document was deleted or replaced.
+     */
+    bool is_deleted(uint32_t doc) const;
+
+    /**
+     * @brief Find the segment of a document.
+     * @param doc The document ID.
+     * @return The segment whose range holds doc, nullptr if none.
+     */
+    const Segment* segment_of(uint32_t doc) const;
+
+    /**
+     * @brief List the generation directories of an index folder.
+     * @param base The index folder, i.e. `<target_dir>/<BASE_DIR>`.
+     * @return The (number, directory name) pairs of all generations.
+     */
+    static std::vector<std::pair<uint64_t, std::string>> list_generations(const std::filesystem::path& base);
+
+    /**
+     * @brief Split a query into stemmed words.
+     * @param query The query string.
+     * @param output The output stream to report ignored stop words to.
+     * @return The stemmed words of the query, stop words removed.
+     */
+    std::vector<std::string> parse_query(const std::string& query, std::ostream& output) const;
+
+    /**
+     * @brief Get the indexed terms a query word stands for.
+     * @param word The stemmed query word.
+     * @param fuzzy The maximum edit distance for a word that is not indexed, 0 to disable.
+     * @param output The output stream to write the "did you mean" suggestion to.
+     * @return The word itself, or its fuzzy matches if it is not indexed and fuzzy is enabled.
+     */
+    std::vector<std::string> expand_term(const std::string& word, uint32_t fuzzy, std::ostream& output) const;
+
+    /**
+     * @brief Merge the word lists of all segments into the lexicon, on the first call only.
+     */
+    void load_lexicon() const;
+
+    /**
+     * @brief Intersect the entries of the query words and print the matching files.
+     * @param entries The (word, entry) pairs of the query.
+     * @param output The output stream to write the result to.
+     * @param options The threshold, delta the entries include, explanation and page, see search().
+     */
+    void evaluate(std::vector<std::pair<std::string, FileIndex::Entry>>& entries, std::ostream& output, const SearchOptions& options) const;
+
+    std::filesystem::path dir; ///< The target directory to search in.
+    std::filesystem::path generation_dir; ///< The generation directory the index was loaded from.
+    std::vector<std::unique_ptr<Segment>> segments; ///< The segments of the generation, in doc ID order.
+    uint32_t documents = 0; ///< The number of document IDs of the segments.
+    mutable std::unordered_map<std::string, uint32_t> doc_ids; ///< The live document of each file, built by the first find_document().
+    mutable std::once_flag doc_ids_once; ///< Builds doc_ids once.
+    mutable std::atomic<bool> doc_ids_built{ false }; ///< Set when doc_ids is built, for memory_usage().
+    mutable std::vector<std::string> lexicon; ///< All indexed words in ascending order, built by the first fuzzy lookup.
+    mutable std::vector<uint32_t> doc_freqs; ///< The document frequency of each word in the lexicon.
+    mutable std::once_flag lexicon_once; ///< Builds lexicon and doc_freqs once.
+    mutable std::atomic<bool> lexicon_built{ false }; ///< Set when the lexicon is built, for memory_usage().
+    StopFilter* stop_filter; ///< The stop filter to use.
+    uint64_t memory_ceiling = 0; ///< The maximum heap bytes, 0 for no limit.
+};
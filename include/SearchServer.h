@@ -0,0 +1,131 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+#include "HotSwapEngine.h"
+#include "ThreadPool.h"
+
+/**
+ * @class SearchServer
+ * @brief A long-running local query server, so the index is loaded once for many queries.
+ *
+ * The server listens on a Unix domain socket. A single event loop thread (epoll) accepts
+ * connections and reads requests, and a bounded pool of worker threads runs the queries on
+ * a shared engine. Every query runs on the generation current when it starts, so the engine
+ * can be hot-swapped while the server runs.
+ *
+ * The protocol is line based: a request is one query per line, and the response is the
+ * output of SearchEngine::search followed by an empty line. Clients may pipeline several
+ * requests on one connection, responses are always sent in request order. When more than
+ * max_pending queries are in flight, new requests are rejected at once with an
+ * "Error: server overloaded" response instead of queueing without bound.
+ */
+class SearchServer {
+public:
+    /**
+     * @brief Options of the server.
+     */
+    struct Options {
+        std::string socket_path; ///< The path of the Unix domain socket.
+        unsigned threads = 0; ///< The number of worker threads, 0 means one per hardware thread.
+        std::size_t max_pending = 1024; ///< The maximum number of queries in flight (admission control).
+        double threshold = 1.0; ///< The threshold passed to SearchEngine::search.
+        uint32_t fuzzy = 0; ///< The maximum edit distance passed to SearchEngine::search.
+    };
+
+    /**
+     * @brief Construct a server for an engine.
+     * @param engine The engine to answer queries with, it must outlive the server.
+     * @param options The options of the server.
+     */
+    SearchServer(const HotSwapEngine& engine, const Options& options);
+
+    /**
+     * @brief Close all connections and remove the socket file.
+     */
+    ~SearchServer();
+
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+
+    /**
+     * @brief Create the socket and start listening.
+     * @return false if the socket cannot be created, the reason is printed to stderr.
+     */
+    bool listen();
+
+    /**
+     * @brief Run the event loop until stop() is called.
+     */
+    void run();
+
+    /**
+     * @brief Ask the event loop to exit.
+     *
+     * This only sets a flag and writes to an eventfd, so it is safe to call from a signal handler
+     * or from another thread.
+     */
+    void stop();
+
+    /**
+     * @brief Client mode: send one query to a server and print the response.
+     * @param socket_path The path of the server socket.
+     * @param query The query to send.
+     * @param output The output stream to print the response to.
+     * @return false if the server cannot be reached.
+     */
+    static bool query(const std::string& socket_path, const std::string& query, std::ostream& output);
+
+private:
+    /**
+     * @brief The state of one client connection.
+     */
+    struct Connection {
+        int fd; ///< The socket of the connection.
+        std::string in; ///< Bytes received but not yet parsed into requests.
+        std::string out; ///< Bytes of responses not yet sent.
+        uint64_t next_seq = 0; ///< The sequence number of the next request.
+        uint64_t next_send = 0; ///< The sequence number of the next response to send.
+        std::map<uint64_t, std::string> ready; ///< Finished responses waiting for earlier ones.
+        std::size_t in_flight = 0; ///< The number of requests running on the workers.
+        bool eof = false; ///< true if the client closed its side.
+        bool registered = true; ///< true if the socket is registered in epoll.
+    };
+
+    /**
+     * @brief A response produced by a worker.
+     */
+    struct Completion {
+        uint64_t conn; ///< The id of the connection.
+        uint64_t seq; ///< The sequence number of the request.
+        std::string response; ///< The response.
+    };
+
+    void accept_connections(); ///< Accept all pending connections.
+    void read_requests(uint64_t id); ///< Read from a connection and dispatch complete requests.
+    void dispatch(uint64_t id, Connection& conn, const std::string& request); ///< Run one request or reject it.
+    void drain_completions(); ///< Move worker results to their connections.
+    void flush(uint64_t id); ///< Queue ready responses in order and write as much as possible.
+    void update_events(uint64_t id, Connection& conn); ///< Update the epoll interest of a connection.
+    void close_connection(uint64_t id); ///< Close a connection and forget it.
+
+    const HotSwapEngine& engine; ///< The engine answering queries.
+    Options options; ///< The options of the server.
+    int listen_fd = -1; ///< The listening socket.
+    int epoll_fd = -1; ///< The epoll instance of the event loop.
+    int wake_fd = -1; ///< An eventfd used by workers and stop() to wake the event loop.
+    std::atomic<bool> stopping{ false }; ///< true when the event loop should exit.
+    std::unordered_map<uint64_t, Connection> connections; ///< Open connections by id, only used by the event loop.
+    uint64_t next_id = 1; ///< The id of the next connection, ids are never reused.
+    std::size_t in_flight = 0; ///< The number of requests running on the workers.
+    std::mutex completions_mutex; ///< Protects completions.
+    std::vector<Completion> completions; ///< Results produced by workers, not yet drained.
+    ThreadPool pool; ///< The workers, declared last so they stop before the rest is destroyed.
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <filesystem>
+#include <unordered_map>
+
+#include "DocTable.h"
+#include "FileIndex.h"
+#include "MappedFile.h"
+#include "MemoryUsage.h"
+
+/**
+ * @class Segment
+ * @brief An immutable part of an index, covering a contiguous range of document IDs.
+ *
+ * A segment is a directory with an index file and a document table, as written by a full build.
+ * The index file stores global document IDs, the document table holds the paths of the documents
+ * doc_base, doc_base + 1, ... of the segment. Segments written before the document table existed
+ * have a list file instead, see DocTable. Segments are never modified once written,
+ * so several index generations can share them.
+ *
+ * Documents deleted or replaced after the segment was written are masked by a deletion
+ * bitmap, which belongs to the generation: each generation stores the bitmaps of its segments.
+ * Compaction drops the postings of deleted documents and leaves their path in the document table
+ * empty, so document IDs never change.
+ */
+class Segment {
+public:
+    using Offset = uint32_t;
+
+    /**
+     * @brief Load a segment.
+     * @param path The directory of the segment.
+     * @param doc_base The first document ID of the segment.
+     * @param deletions The deletion bitmap file of the segment, empty or missing if nothing is deleted.
+     */
+    Segment(const std::filesystem::path& path, uint32_t doc_base, const std::filesystem::path& deletions = {});
+
+    /**
+     * @brief Get the directory of the segment.
+     * @return The directory of the segment.
+     */
+    const std::filesystem::path& path() const { return dir; }
+
+    /**
+     * @brief Get the first document ID of the segment.
+     * @return The first document ID.
+     */
+    uint32_t doc_base() const { return base; }
+
+    /**
+     * @brief Get the documents of the segment.
+     * @return The table, its i-th document is document doc_base() + i.
+     */
+    const DocTable& documents() const { return docs; }
+
+    /**
+     * @brief Get the path of a document of the segment.
+     * @param doc The global document ID, must be in the range of the segment.
+     * @return The path, empty for a document removed by compaction.
+     */
+    std::string file(uint32_t doc) const { return docs.path(doc - base); }
+
+    /**
+     * @brief Get the number of document IDs the segment covers.
+     * @return The number of document IDs, including deleted documents.
+     */
+    uint32_t size() const { return docs.size(); }
+
+    /**
+     * @brief Check if a document of the segment is deleted.
+     * @param doc The global document ID, must be in the range of the segment.
+     * @return true if the document is masked by the deletion bitmap.
+     */
+    bool is_deleted(uint32_t doc) const { return !deleted.empty() && deleted[doc - base]; }
+
+    /**
+     * @brief Get the deletion bitmap.
+     * @return One flag per document of the segment, empty if nothing is deleted.
+     */
+    const std::vector<bool>& deletions() const { return deleted; }
+
+    /**
+     * @brief Get the number of deleted documents.
+     * @return The number of documents masked by the deletion bitmap.
+     */
+    uint32_t deleted_count() const { return deleted_docs; }
+
+    /**
+     * @brief Get the size of the index file.
+     * @return The size of the index file in bytes.
+     */
+    std::size_t index_size() const { return index.size(); }
+
+    /**
+     * @brief Check if the index file was loaded.
+     * @return false if the index file is missing or cannot be mapped.
+     */
+    bool is_loaded() const { return index.data() != nullptr; }
+
+    /**
+     * @brief Find the offset of a word's entry in the index file.
+     * @param word The word to find.
+     * @param offset The offset of the entry, if found.
+     * @return true if the word is in the segment.
+     */
+    bool find(const std::string& word, Offset& offset) const;
+
+    /**
+     * @brief Decode the entry at an offset of the index file.
+     * @param offset The offset of the entry.
+     * @param entry The decoded entry.
+     * @return The number of bytes the entry takes in the index file.
+     */
+    std::size_t read(Offset offset, FileIndex::Entry& entry) const;
+
+    /**
+     * @brief Check how much of the entry at an offset is in the page cache.
+     * @param offset The offset of the entry.
+     * @return The number of resident pages and the number of pages of the entry.
+     *
+     * Call this before read(), which brings the pages in.
+     */
+    std::pair<std::size_t, std::size_t> residency(Offset offset) const;
+
+    /**
+     * @brief List the words of the segment with their document frequencies.
+     * @return The (word, document frequency) pairs, in ascending order of words.
+     */
+    std::vector<std::pair<std::string, uint32_t>> terms() const;
+
+    /**
+     * @brief Save a deletion bitmap.
+     * @param filename The bitmap file.
+     * @param deleted One flag per document of the segment.
+     *
+     * The format is the number of flags (uint32_t) followed by the flags packed 8 per byte.
+     */
+    static void save_deletions(const std::filesystem::path& filename, const std::vector<bool>& deleted);
+
+    /**
+     * @brief Read a deletion bitmap.
+     * @param filename The bitmap file.
+     * @return The flags, empty if the file does not exist.
+     */
+    static std::vector<bool> read_deletions(const std::filesystem::path& filename);
+
+    /**
+     * @brief Estimate the memory of the segment.
+     * @return The heap bytes of its "words", "files" and "deletions", and its mapped and resident bytes.
+     */
+    MemoryUsage memory_usage() const;
+
+private:
+    std::filesystem::path dir; ///< The directory of the segment.
+    uint32_t base; ///< The first document ID of the segment.
+    DocTable docs; ///< The paths and metadata of the documents of the segment.
+    MappedFile index; ///< The index file, mapped read-only for the lifetime of the segment.
+    std::unordered_map<std::string, Offset> words; ///< The map of words to their offsets in the index file.
+    std::vector<bool> deleted; ///< The deletion bitmap, empty if nothing is deleted.
+    uint32_t deleted_docs = 0; ///< The number of set flags in deleted.
+};
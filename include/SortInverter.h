@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "FileIndex.h"
+#include "TermDictionary.h"
+#include "ThreadPool.h"
+
+/**
+ * @class SortInverter
+ * @brief Builds posting lists by sorting (term ID, document ID) pairs, instead of appending to a map.
+ *
+ * Each token is numbered by a TermDictionary, and the first occurrence of a term in a document
+ * appends one pair to a flat buffer. When the buffer is full, it is sorted by term ID with a
+ * parallel LSD radix sort, and each term's documents are appended to its posting list in one
+ * go. The radix sort is stable, and documents are added in order, so the lists stay sorted.
+ *
+ * Adding a token is a hash lookup and a sequential write, instead of a walk down a tree of
+ * string keys, and the sort scans the buffer in a few streaming passes on every core.
+ * finish() moves the posting lists into a FileIndex, in lexicographic order of their terms, so
+ * the index is the same as with FileIndex::add_token.
+ */
+class SortInverter {
+public:
+    /**
+     * @brief The options of the inverter.
+     */
+    struct Options {
+        std::size_t buffer_pairs = 1 << 21; ///< The number of pairs buffered before each sort.
+        unsigned threads = 0; ///< The number of threads sorting, 0 means one per hardware thread.
+    };
+
+    /**
+     * @brief Create an empty inverter.
+     * @param options The options.
+     */
+    explicit SortInverter(const Options& options);
+
+    SortInverter(const SortInverter&) = delete;
+    SortInverter& operator=(const SortInverter&) = delete;
+
+    /**
+     * @brief Adds occurrences of a token, as FileIndex::add_token.
+     *
+     * The tokens of a document must be added before those of any later document.
+     *
+     * @param token The stemmed token.
+     * @param id The unique identifier of the document containing the token.
+     * @param count The number of occurrences to add.
+     */
+    void add_token(const std::string& token, uint32_t id, uint32_t count = 1);
+
+    /**
+     * @brief Move the posting lists built so far into an index, and start over empty.
+     * @param index The index, the documents added must be later than those it holds.
+     */
+    void finish(FileIndex& index);
+
+    /**
+     * @brief Get the number of times the buffer was sorted.
+     */
+    uint64_t sorts() const { return sort_count; }
+
+    /**
+     * @brief Sort (term ID, document ID) pairs by term ID, with a parallel and stable LSD radix sort.
+     * @param pairs The pairs, the term ID in the high 32 bits, sorted in place.
+     * @param scratch A buffer, resized to the size of pairs and clobbered.
+     * @param key_bits The number of significant bits of the term IDs.
+     * @param pool The threads sorting, each takes a block of the pairs.
+     *
+     * Each pass sorts by one byte of the term IDs: every thread counts the bytes of its block,
+     * the counts give every thread its offset in each bucket, then every thread moves its block
+     * to those offsets. Passes where all pairs have the same byte are skipped.
+     */
+    static void radix_sort(std::vector<uint64_t>& pairs, std::vector<uint64_t>& scratch, unsigned key_bits, ThreadPool& pool);
+
+private:
+    /**
+     * @brief Sort the buffer and append its pairs to the posting lists.
+     */
+    void flush();
+
+    std::size_t buffer_pairs; ///< The capacity of the buffer.
+    TermDictionary dictionary; ///< The IDs of the terms.
+    std::vector<uint32_t> freqs; ///< The total frequency of each term ID.
+    std::vector<uint32_t> last_docs; ///< The last document of each term ID, so a term gives one pair per document.
+    std::vector<std::vector<uint32_t>> postings; ///< The sorted posting list of each term ID.
+    std::vector<uint64_t> pairs; ///< The buffer of pairs not sorted yet.
+    std::vector<uint64_t> scratch; ///< The other buffer of the radix sort.
+    uint64_t sort_count = 0; ///< The number of sorts.
+    ThreadPool pool; ///< The threads sorting the buffer.
+};
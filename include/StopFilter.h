@@ -1,45 +1,64 @@
-#pragma once
-
-#include <unordered_set>
-#include <string>
-#include <iostream>
-#include <filesystem>
-
-/**
- * @class StopFilter
- * @brief A class to filter out stop words from a text.
- *
- * The StopFilter class provides functionality to load a list of stop words
- * from a file and check whether a given word is a stop word.
- */
-class StopFilter {
-private:
-    std::unordered_set<std::string> stop_words; ///< A set to store stop words.
-
-public:
-    /**
-     * @brief Constructor to load stop words from a file.
-     * @param stop_words_file The path to the file containing stop words.
-     *
-     * This constructor reads the stop words from the specified file and
-     * stores them in a set for quick lookup.
-     */
-    StopFilter(const std::filesystem::path& stop_words_file);
-
-    /**
-     * @brief Check if a word is a stop word.
-     * @param word The word to check.
-     * @return true if the word is a stop word, false otherwise.
-     *
-     * This method returns true if the word is found in the stop words set
-     * or if the word's length is less than 3 characters.
-     */
-    bool is_stop(const std::string& word) const;
-
-    /**
-     * @brief Print the stop words set.
-     * @param output The output stream to print to.
-     * This method prints the stop words set to the specified output stream.
-     */
-    void print(std::ostream& output) const;
-};
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <iostream>
+#include <filesystem>
+
+/**
+ * @class StopFilter
+ * @brief A class to filter out stop words from a text.
+ *
+ * The StopFilter class provides functionality to load a list of stop words
+ * from a file and check whether a given word is a stop word.
+ *
+ * The words are looked up by std::string_view, so checking a token never copies it. Most
+ * tokens are not stop words: a Bloom filter rejects nearly all of them with two bit tests,
+ * and the others are found in an open addressing table built once when loading.
+ */
+class StopFilter {
+private:
+    /**
+     * @brief Hash a word for the table and the Bloom filter.
+     */
+    static uint64_t hash(std::string_view word);
+
+    std::vector<std::string> stop_words; ///< The stop words, in the order of the file.
+    std::vector<uint32_t> table; ///< The open addressing table, 1 + the index of a word in stop_words, 0 for an empty slot.
+    std::vector<uint64_t> bloom; ///< The Bloom filter, two bits set per stop word.
+
+public:
+    /**
+     * @brief Constructor to load stop words from a file.
+     * @param stop_words_file The path to the file containing stop words.
+     *
+     * This constructor reads the stop words from the specified file and
+     * stores them in a set for quick lookup.
+     */
+    StopFilter(const std::filesystem::path& stop_words_file);
+
+    /**
+     * @brief Check if a word is a stop word.
+     * @param word The word to check.
+     * @return true if the word is a stop word, false otherwise.
+     *
+     * This method returns true if the word is found in the stop words set
+     * or if the word's length is less than 3 characters.
+     */
+    bool is_stop(std::string_view word) const;
+
+    /**
+     * @brief Print the stop words set.
+     * @param output The output stream to print to.
+     * This method prints the stop words set to the specified output stream.
+     */
+    void print(std::ostream& output) const;
+
+    /**
+     * @brief Estimate the heap memory of the stop words set.
+     * @return The bytes, see MemoryUsage.
+     */
+    uint64_t memory_usage() const;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * @class TermDictionary
+ * @brief Assigns an integer ID to every distinct term of a build, in order of first occurrence.
+ *
+ * The runs of gen_index_large store term IDs instead of terms (FileIndex::save_run), so merges
+ * compare integers and copy 4 bytes per entry instead of the term. The terms are written once,
+ * by FileIndex::run_to_index, in lexicographic order: sorted_ids() maps each lexicographic rank
+ * to the ID of the term.
+ */
+class TermDictionary {
+public:
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary&) = delete; // terms points into ids
+    TermDictionary& operator=(const TermDictionary&) = delete;
+
+    /**
+     * @brief Get the ID of a term, assigning the next one if it is new.
+     * @param term The term.
+     * @return The ID of the term.
+     */
+    uint32_t id(const std::string& term);
+
+    /**
+     * @brief Get the term of an ID.
+     * @param id An ID returned by id().
+     * @return The term.
+     */
+    const std::string& term(uint32_t id) const { return *terms[id]; }
+
+    /**
+     * @brief Get the number of terms.
+     */
+    std::size_t size() const { return terms.size(); }
+
+    /**
+     * @brief Get the IDs in lexicographic order of their terms.
+     * @return The ID of the term of each lexicographic rank.
+     */
+    std::vector<uint32_t> sorted_ids() const;
+
+    /**
+     * @brief Remove all terms, IDs start from 0 again.
+     */
+    void clear();
+
+    /**
+     * @brief Estimate the heap memory of the dictionary.
+     * @return The bytes of the terms, the hash table and the ID table, see MemoryUsage.
+     */
+    uint64_t memory_usage() const;
+
+private:
+    std::unordered_map<std::string, uint32_t> ids; ///< The ID of each term.
+    std::vector<const std::string*> terms; ///< The term of each ID, pointing into the keys of ids.
+};
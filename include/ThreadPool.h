@@ -0,0 +1,94 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * @class ThreadPool
+ * @brief A fixed size work-stealing thread pool.
+ *
+ * Every worker owns a task queue. Tasks are distributed round robin over the queues, a worker
+ * takes tasks from the back of its own queue and, when it runs dry, steals from the front
+ * of the other queues. This keeps all workers busy even when task costs are very uneven.
+ *
+ * A task that throws does not stop its worker: the first exception is kept and rethrown by
+ * the next wait().
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Start the worker threads.
+     * @param threads The number of worker threads, 0 means one per hardware thread.
+     */
+    explicit ThreadPool(unsigned threads = 0);
+
+    /**
+     * @brief Wait for all submitted tasks, then stop the worker threads.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Submit a task to the pool.
+     * @param task The task to run.
+     *
+     * A task submitted from a worker thread goes to that worker's own queue.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Block until all submitted tasks have finished.
+     *
+     * If a task threw since the last wait(), the first exception is rethrown, once every task
+     * has finished.
+     */
+    void wait();
+
+    /**
+     * @brief Get the number of worker threads.
+     * @return The number of worker threads.
+     */
+    std::size_t size() const { return threads.size(); }
+
+private:
+    /**
+     * @brief The task queue owned by one worker.
+     */
+    struct Queue {
+        std::deque<std::function<void()>> tasks; ///< The pending tasks.
+        std::mutex mutex; ///< Protects tasks.
+    };
+
+    /**
+     * @brief The main loop of a worker thread.
+     * @param id The index of the worker.
+     */
+    void run(std::size_t id);
+
+    /**
+     * @brief Take a task, from the worker's own queue first, otherwise steal one.
+     * @param id The index of the worker.
+     * @param task The task taken.
+     * @return true if a task was taken.
+     */
+    bool take(std::size_t id, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Queue>> queues; ///< One task queue per worker.
+    std::vector<std::thread> threads; ///< The worker threads.
+    std::mutex mutex; ///< Protects the counters below.
+    std::condition_variable work_cv; ///< Signaled when a task is submitted or the pool stops.
+    std::condition_variable done_cv; ///< Signaled when the last pending task finishes.
+    std::size_t queued = 0; ///< The number of tasks waiting in the queues.
+    std::size_t pending = 0; ///< The number of tasks submitted but not finished.
+    std::size_t next_queue = 0; ///< The queue for the next task submitted from outside the pool.
+    bool stopping = false; ///< true when the workers should exit.
+    std::exception_ptr error; ///< The first exception thrown by a task since the last wait().
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @class Throttle
+ * @brief Limits the rate of background I/O, so it does not compete with queries.
+ *
+ * The caller reports the bytes it has written with consume(), which sleeps whenever the
+ * total is ahead of the configured rate. Short bursts up to one tenth of a second of budget
+ * are allowed, so small writes do not sleep one by one.
+ */
+class Throttle {
+public:
+    /**
+     * @brief Create a throttle.
+     * @param bytes_per_second The maximum rate, 0 means unlimited.
+     */
+    explicit Throttle(uint64_t bytes_per_second = 0);
+
+    /**
+     * @brief Account for bytes written, and sleep if the rate is exceeded.
+     * @param bytes The number of bytes written since the last call.
+     */
+    void consume(std::size_t bytes);
+
+private:
+    uint64_t rate; ///< The maximum rate in bytes per second, 0 means unlimited.
+    uint64_t total = 0; ///< The bytes consumed since start.
+    std::chrono::steady_clock::time_point start; ///< When the throttle was created.
+};
@@ -1,36 +1,103 @@
-#pragma once
-
-#include <string>
-#include <unordered_map>
-#include <iostream>
-
-/**
- * @class WordCounter
- * @brief A class to count occurrences of words.
- *
- * The WordCounter class provides methods to add words and print their counts.
- */
-class WordCounter {
-public:
-    using Entry = std::pair<std::string, int>; ///< Type alias for a word and its count.
-
-    /**
-     * @brief Add a word to the counter.
-     * @param word The word to be added to the counter.
-     *
-     * This method increments the count of the specified word.
-     */
-    void add_word(const std::string& word);
-
-
-    /**
-     * @brief Print the word count result.
-     * @param output The output stream to print the results.
-     *
-     * This method prints the words and their corresponding counts in
-     * descending order of frequency.
-     */
-    void print(std::ostream& output);
-private:
-    std::unordered_map<std::string, int> word_count;  ///< A map to store word counts.
-};
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <iostream>
+
+/**
+ * @class WordCounter
+ * @brief A class to count occurrences of words.
+ *
+ * The WordCounter class provides methods to add words and print their counts.
+ *
+ * The counts are split in shards by the hash of the word, each with its own lock, so several
+ * threads can merge their counts at once (see count_files). Printing selects only the words
+ * it needs, so asking for the top N words of a huge vocabulary does not sort all of it.
+ */
+class WordCounter {
+public:
+    using Entry = std::pair<std::string, uint64_t>; ///< Type alias for a word and its count.
+
+    /**
+     * @brief Create an empty counter.
+     * @param shards The number of shards, at least 1.
+     */
+    explicit WordCounter(std::size_t shards = 1);
+
+    /**
+     * @brief Add a word to the counter.
+     * @param word The word to be added to the counter.
+     *
+     * This method increments the count of the specified word. It is not thread safe,
+     * threads should count locally and use add_counts.
+     */
+    void add_word(const std::string& word);
+
+    /**
+     * @brief Add the words of a file to the counter.
+     * @param filename The file to tokenize.
+     * @return false if the file cannot be opened.
+     */
+    bool add_file(const std::string& filename);
+
+    /**
+     * @brief Count the words of files with several threads.
+     * @param files The files to tokenize.
+     * @param threads The number of threads, 0 means one per hardware thread.
+     * @param failed If not nullptr, the files that cannot be opened are added to it, in input order.
+     * @return The counter, with one shard per thread.
+     */
+    static WordCounter count_files(const std::vector<std::string>& files, unsigned threads = 0, std::vector<std::string>* failed = nullptr);
+
+    /**
+     * @brief Get the number of distinct words.
+     * @return The number of words counted.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Get the most frequent words.
+     * @param n The number of words, 0 for all of them.
+     * @return The words and their counts, in descending order of frequency, ties in ascending order of words.
+     */
+    std::vector<Entry> top(std::size_t n = 0) const;
+
+    /**
+     * @brief Print the word count result.
+     * @param output The output stream to print the results.
+     * @param n The number of words to print, 0 for all of them.
+     *
+     * This method prints the words and their corresponding counts in
+     * descending order of frequency.
+     */
+    void print(std::ostream& output, std::size_t n = 0) const;
+private:
+    /**
+     * @brief The words of one range of hashes.
+     */
+    struct Shard {
+        std::unordered_map<std::string, uint64_t> counts; ///< The count of each word.
+        std::mutex mutex; ///< Protects counts in add_counts.
+    };
+
+    /**
+     * @brief Merge counts made by one thread, and clear them.
+     * @param local The counts, one map per shard as split by shard_of.
+     *
+     * Each shard is locked once, so threads merging at the same time rarely wait.
+     */
+    void add_counts(std::vector<std::unordered_map<std::string, uint64_t>>& local);
+
+    /**
+     * @brief Get the shard of a word.
+     * @param word The word.
+     * @return The index of its shard.
+     */
+    std::size_t shard_of(const std::string& word) const;
+
+    std::vector<std::unique_ptr<Shard>> shards; ///< The shards, a word is in exactly one of them.
+};
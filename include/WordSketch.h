@@ -0,0 +1,133 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @class WordSketch
+ * @brief Approximate word counts in a fixed amount of memory.
+ *
+ * The most frequent words are tracked with the Space-Saving algorithm: a fixed number of
+ * counters, where a word without a counter takes over the smallest one and inherits its count.
+ * A reported count is never below the true count, and exceeds it by at most the error reported
+ * with it, which is itself at most tokens() / capacity(). Any word more frequent than that is
+ * guaranteed to have a counter.
+ *
+ * The number of distinct words is estimated with HyperLogLog, with a relative standard error
+ * of 1.04 / sqrt(registers).
+ */
+class WordSketch {
+public:
+    /**
+     * @brief An approximate count.
+     */
+    struct Entry {
+        std::string word; ///< The word.
+        uint64_t count; ///< The estimated count, at least the true count.
+        uint64_t error; ///< The maximum overestimate, the true count is at least count - error.
+    };
+
+    /**
+     * @brief Create an empty sketch.
+     * @param memory_bytes The memory of the sketch, split between the counters and the HyperLogLog registers.
+     */
+    explicit WordSketch(std::size_t memory_bytes);
+
+    WordSketch(const WordSketch&) = delete; // the index points into the counters
+    WordSketch& operator=(const WordSketch&) = delete;
+    WordSketch(WordSketch&&) = default;
+
+    /**
+     * @brief Count a word.
+     * @param word The word.
+     * @param count The number of occurrences.
+     */
+    void add_word(std::string_view word, uint64_t count = 1);
+
+    /**
+     * @brief Count the words of files with several threads.
+     * @param files The files to tokenize.
+     * @param memory_bytes The memory of the sketch, see WordSketch().
+     * @param threads The number of threads, 0 means one per hardware thread.
+     * @param failed If not nullptr, the files that cannot be opened are added to it, in input order.
+     * @return The sketch.
+     */
+    static WordSketch count_files(const std::vector<std::string>& files, std::size_t memory_bytes, unsigned threads = 0, std::vector<std::string>* failed = nullptr);
+
+    uint64_t tokens() const { return total; } ///< The number of words counted.
+    std::size_t capacity() const { return counters.capacity(); } ///< The number of counters.
+    std::size_t registers() const { return hll.size(); } ///< The number of HyperLogLog registers.
+
+    /**
+     * @brief Estimate the number of distinct words.
+     * @return The estimate, see distinct_error() for its accuracy.
+     */
+    double distinct() const;
+
+    /**
+     * @brief Get the relative standard error of distinct().
+     * @return The error, e.g. 0.008 for 0.8%.
+     */
+    double distinct_error() const;
+
+    /**
+     * @brief Get the most frequent words.
+     * @param n The number of words, 0 for all tracked words.
+     * @return The words with their estimated counts and errors, in descending order of counts, ties in ascending order of words.
+     */
+    std::vector<Entry> top(std::size_t n = 0) const;
+
+    /**
+     * @brief Estimate the heap memory of the sketch.
+     * @return The bytes, see MemoryUsage.
+     */
+    uint64_t memory_usage() const;
+
+    /**
+     * @brief Print the number of words, the distinct words and the top words with their errors.
+     * @param output The output stream to print the results.
+     * @param n The number of words to print, 0 for all tracked words.
+     *
+     * Each line is `word: count (error <= e)`, the true count is between count - e and count.
+     */
+    void print(std::ostream& output, std::size_t n = 0) const;
+
+private:
+    /**
+     * @brief A Space-Saving counter.
+     */
+    struct Counter {
+        std::string word; ///< The word counted.
+        uint64_t count; ///< The count, including error.
+        uint64_t error; ///< The count inherited when the word took the counter over.
+        uint32_t position; ///< The position of the counter in heap.
+    };
+
+    /**
+     * @brief Restore the heap order around a counter whose count grew.
+     * @param position The position of the counter in heap.
+     */
+    void sift_down(std::size_t position);
+
+    /**
+     * @brief Restore the heap order around a new counter.
+     * @param position The position of the counter in heap.
+     */
+    void sift_up(std::size_t position);
+
+    /**
+     * @brief Swap two positions of the heap.
+     */
+    void swap_heap(std::size_t a, std::size_t b);
+
+    std::vector<Counter> counters; ///< The counters, never reallocated, so index can point into them.
+    std::vector<uint32_t> heap; ///< The counters as a min-heap by count.
+    std::unordered_map<std::string_view, uint32_t> index; ///< The counter of each tracked word.
+    std::vector<uint8_t> hll; ///< The HyperLogLog registers.
+    unsigned hll_bits; ///< log2 of the number of registers.
+    uint64_t total = 0; ///< The number of words counted.
+};
@@ -1,62 +1,143 @@
-#pragma once
-
-#include <string>
-#include <vector>
-#include <iostream>
-#include <filesystem>
-
-// Define constants for directory and file names
-#define BASE_DIR (".ADS_search_engine") ///< Base directory for the search engine, e.g. the index for `target_dir` will be stored in `target_dir/<BASE_DIR>`
-#define INDEX_FILE_NAME ("index.dat")   ///< Index file name
-#define LIST_FILE_NAME ("list.txt")     ///< List file name
-#define STOP_FILE_NAME ("stop_wrods.txt") ///< Stop words file name
-
-/**
- * @brief Get all files from a specified directory with a given extension.
- *
- * This function retrieves all files with the specified extension from
- * the provided directory and its subdirectories.
- *
- * @param directory The path to the directory to search.
- * @param extension The file extension to filter by (default is ".html").
- * @return A vector containing the paths of the found files.
- */
-std::vector<std::string> get_files(
-    const std::filesystem::path& directory,
-    const std::string& extension = ".html"
-);
-
-/**
- * @brief Stem a word to its base form.
- *
- * This function takes a word as input and converts it to its
- * lowercase stemmed form.
- * It uses the Porter stemming algorithm to achieve this.
- *
- * @param word The word to stem.
- * @return The stemmed version of the word.
- */
-std::string stem_word(const std::string& word);
-
-/**
- * @brief Tokenize a string into words.
- *
- * This function reads input from a stream and extracts a single
- * token (word) while skipping over HTML tags.
- *
- * @param input The input stream to read from.
- * @return The tokenized word in stemmed form.
- */
-std::string tokenize(std::istream& input);
-
-/**
- * @brief Intersect two **aescending** vectors of unsigned 32-bit integers.
- *
- * This function finds the intersection of two **aescending** vectors of unsigned
- * 32-bit integers and returns the result as a new vector.
- *
- * @param vec1 The first vector to intersect, must be **aescending**.
- * @param vec2 The second vector to intersect, must be **aescending**.
- * @return A new aescending vector containing the intersection of vec1 and vec2.
- */
-std::vector<uint32_t> intersect(const std::vector<uint32_t>& vec1, const std::vector<uint32_t>& vec2);
\ No newline at end of file
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <filesystem>
+
+// Define constants for directory and file names
+#define BASE_DIR (".ADS_search_engine") ///< Base directory for the search engine, e.g. the index for `target_dir` will be stored in `target_dir/<BASE_DIR>`
+#define INDEX_FILE_NAME ("index.dat")   ///< Index file name
+#define LIST_FILE_NAME ("list.txt")     ///< List file name, only in indexes written before the document table
+#define DOCS_FILE_NAME ("docs.dat")     ///< Document table file name, the paths and metadata of the documents, see DocTable
+#define STOP_FILE_NAME ("stop_wrods.txt") ///< Stop words file name
+#define SOCKET_FILE_NAME ("search.sock") ///< Default Unix socket name of the query server
+#define CURRENT_FILE_NAME ("CURRENT")   ///< Pointer file holding the name of the published index generation
+#define GENERATION_PREFIX ("gen-")      ///< Prefix of index generation directories, e.g. `<BASE_DIR>/gen-3`
+#define MANIFEST_FILE_NAME ("manifest.txt") ///< Manifest file name, the indexed files with their size, mtime and hash
+#define SEGMENTS_FILE_NAME ("SEGMENTS") ///< Segment list of a generation built by an incremental update
+#define DELETIONS_SUFFIX (".del")       ///< Suffix of the deletion bitmap of a segment in a generation, e.g. `gen-3/gen-1.del`
+#define LOCK_FILE_NAME ("LOCK")         ///< Lock file serializing index writers when publishing
+
+/**
+ * @brief Get all files from a specified directory with a given extension.
+ *
+ * This function retrieves all files with the specified extension from
+ * the provided directory and its subdirectories, in canonical order
+ * (depth-first, the entries of every directory sorted by name).
+ *
+ * @param directory The path to the directory to search.
+ * @param extension The file extension to filter by (default is ".html").
+ * @return A vector containing the paths of the found files.
+ */
+std::vector<std::string> get_files(
+    const std::filesystem::path& directory,
+    const std::string& extension = ".html"
+);
+
+/**
+ * @brief Get the index folder of a target.
+ *
+ * Every archive has an index of its own, next to it, so indexing it leaves the index of its
+ * directory and of the other archives there alone.
+ *
+ * @param target The target directory, or an archive.
+ * @return `target/<BASE_DIR>` for a directory, `<archive><BASE_DIR>` for an archive, e.g. `pages.tar.gz.ADS_search_engine`.
+ */
+std::filesystem::path index_folder(const std::filesystem::path& target);
+
+/**
+ * @brief Get the directory holding the published generation of an index folder.
+ * @param base The index folder, see index_folder().
+ * @return `base/<generation>`, or `base` if no generation is published.
+ */
+std::filesystem::path published_generation(const std::filesystem::path& base);
+
+/**
+ * @brief Get the directory holding the published index of a target directory.
+ *
+ * Builders publish every index to a new generation directory inside BASE_DIR and then
+ * atomically replace the CURRENT pointer file with its name. Indexes built before
+ * generations existed keep their files directly in BASE_DIR.
+ *
+ * @param dir The target directory, or an archive.
+ * @return `index_folder(dir)/<generation>`, or `index_folder(dir)` if no generation is published.
+ */
+std::filesystem::path index_dir(const std::filesystem::path& dir);
+
+/**
+ * @brief Stem a word to its base form.
+ *
+ * This function takes a word as input and converts it to its
+ * lowercase stemmed form.
+ * It uses the Porter stemming algorithm to achieve this.
+ *
+ * @param word The word to stem.
+ * @return The stemmed version of the word.
+ */
+std::string stem_word(const std::string& word);
+
+/**
+ * @brief Stem a word in place.
+ *
+ * This is stem_word() without the copy, so stemming a token read into a
+ * reused buffer does not allocate.
+ *
+ * @param word The word to stem, replaced by its stemmed version.
+ */
+void stem_in_place(std::string& word);
+
+/**
+ * @brief Tokenize a string into words.
+ *
+ * This function reads input from a stream and extracts a single
+ * token (word) while skipping over HTML tags.
+ *
+ * @param input The input stream to read from.
+ * @return The tokenized word in stemmed form.
+ */
+std::string tokenize(std::istream& input);
+
+/**
+ * @brief Read the next stemmed token from a stream into a buffer.
+ *
+ * The buffer keeps its capacity from one token to the next, so a loop
+ * reusing it allocates only for tokens longer than any before.
+ *
+ * @param input The input stream to read from.
+ * @param token The buffer, replaced by the token in stemmed form.
+ * @return false at the end of the input, when the buffer is left empty.
+ */
+bool tokenize(std::istream& input, std::string& token);
+
+/**
+ * @brief Read the next token from a stream, without stemming it.
+ *
+ * This is tokenize() without the stemming step, for callers that
+ * time or skip the two steps separately.
+ *
+ * @param input The input stream to read from.
+ * @return The token as it appears in the input, empty at the end of the input.
+ */
+std::string next_token(std::istream& input);
+
+/**
+ * @brief Read the next token from a stream into a buffer, without stemming it.
+ *
+ * @param input The input stream to read from.
+ * @param token The buffer, replaced by the token, see tokenize(std::istream&, std::string&).
+ * @return false at the end of the input, when the buffer is left empty.
+ */
+bool next_token(std::istream& input, std::string& token);
+
+/**
+ * @brief Intersect two **aescending** vectors of unsigned 32-bit integers.
+ *
+ * This function finds the intersection of two **aescending** vectors of unsigned
+ * 32-bit integers and returns the result as a new vector.
+ *
+ * @param vec1 The first vector to intersect, must be **aescending**.
+ * @param vec2 The second vector to intersect, must be **aescending**.
+ * @return A new aescending vector containing the intersection of vec1 and vec2.
+ */
+std::vector<uint32_t> intersect(const std::vector<uint32_t>& vec1, const std::vector<uint32_t>& vec2);
@@ -0,0 +1,405 @@
+#include "ArchiveReader.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+    const std::size_t BLOCK = 512; ///< The size of a tar block.
+
+    /**
+     * @brief Parse a numeric field of a tar header: octal, or base-256 if its high bit is set.
+     */
+    uint64_t tar_number(const char* field, std::size_t size) {
+        uint64_t value = 0;
+        if (static_cast<unsigned char>(field[0]) & 0x80) {
+            for (std::size_t i = 1; i < size; i++) value = (value << 8) | static_cast<unsigned char>(field[i]);
+            return value;
+        }
+        for (std::size_t i = 0; i < size && field[i]; i++) {
+            if (field[i] >= '0' && field[i] <= '7') value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+        }
+        return value;
+    }
+
+    /**
+     * @brief Check the checksum of a tar header, computed with the checksum field as spaces.
+     */
+    bool tar_checksum(const char* header) {
+        uint64_t sum = 0;
+        for (std::size_t i = 0; i < BLOCK; i++) {
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+        }
+        return sum == tar_number(header + 148, 8);
+    }
+
+    /**
+     * @brief Get a NUL-terminated field of a tar header.
+     */
+    std::string tar_string(const char* field, std::size_t size) {
+        return std::string(field, strnlen(field, size));
+    }
+
+    /**
+     * @brief Append a code point in UTF-8.
+     */
+    void put_utf8(std::string& out, uint32_t code) {
+        if (code < 0x80) {
+            out.push_back(static_cast<char>(code));
+        }
+        else if (code < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+        else if (code < 0x10000) {
+            out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+        else {
+            out.push_back(static_cast<char>(0xf0 | (code >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+    }
+
+    /**
+     * @brief A minimal scanner of one JSON object per line, which only decodes the strings it is asked for.
+     */
+    class JsonLine {
+    public:
+        explicit JsonLine(const std::string& text) : text(text) {}
+
+        void skip_space() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) pos++;
+        }
+
+        bool consume(char ch) {
+            skip_space();
+            if (pos >= text.size() || text[pos] != ch) return false;
+            pos++;
+            return true;
+        }
+
+        /**
+         * @brief Decode a string, the scanner being at its opening quote.
+         * @param out The decoded string, nullptr to skip it.
+         */
+        bool string(std::string* out) {
+            if (!consume('"')) return false;
+            if (out) out->clear();
+            while (pos < text.size()) {
+                char ch = text[pos++];
+                if (ch == '"') return true;
+                if (ch != '\\') {
+                    if (out) out->push_back(ch);
+                    continue;
+                }
+                if (pos >= text.size()) return false;
+                char escape = text[pos++];
+                if (escape == 'u') {
+                    uint32_t code;
+                    if (!hex4(code)) return false;
+                    if (code >= 0xd800 && code < 0xdc00 && pos + 1 < text.size() && text[pos] == '\\' && text[pos + 1] == 'u') {
+                        pos += 2;
+                        uint32_t low;
+                        if (!hex4(low)) return false;
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    if (out) put_utf8(*out, code);
+                    continue;
+                }
+                const char* from = "\"\\/bfnrt";
+                const char* to = "\"\\/\b\f\n\r\t";
+                const char* found = strchr(from, escape);
+                if (!found || !escape) return false;
+                if (out) out->push_back(to[found - from]);
+            }
+            return false;
+        }
+
+        /**
+         * @brief Skip a value of any type, or copy the text of a scalar.
+         * @param out The text of a number, true, false or null, nullptr to skip it.
+         */
+        bool value(std::string* out) {
+            skip_space();
+            if (pos >= text.size()) return false;
+            char ch = text[pos];
+            if (ch == '"') return string(out);
+            if (ch == '{' || ch == '[') {
+                char close = ch == '{' ? '}' : ']';
+                pos++;
+                if (consume(close)) return true;
+                do {
+                    if (close == '}' && (!string(nullptr) || !consume(':'))) return false;
+                    if (!value(nullptr)) return false;
+                } while (consume(','));
+                return consume(close);
+            }
+            std::size_t start = pos;
+            while (pos < text.size() && !strchr(",}] \t\r", text[pos])) pos++;
+            if (pos == start) return false;
+            if (out) out->assign(text, start, pos - start);
+            return true;
+        }
+
+    private:
+        bool hex4(uint32_t& code) {
+            if (pos + 4 > text.size()) return false;
+            code = 0;
+            for (int i = 0; i < 4; i++) {
+                char ch = text[pos++];
+                code <<= 4;
+                if (ch >= '0' && ch <= '9') code |= ch - '0';
+                else if (ch >= 'a' && ch <= 'f') code |= ch - 'a' + 10;
+                else if (ch >= 'A' && ch <= 'F') code |= ch - 'A' + 10;
+                else return false;
+            }
+            return true;
+        }
+
+        const std::string& text; ///< The line.
+        std::size_t pos = 0; ///< The next character.
+    };
+}
+
+/**
+ * @brief Open an archive and detect its format.
+ * @param filename The archive.
+ * @param extension The extension of the tar members to read, e.g. ".html".
+ * @param buffer_bytes The size of the reads.
+ *
+ * If the archive cannot be read, is_open() is false and error() tells why.
+ */
+ArchiveReader::ArchiveReader(const std::filesystem::path& filename, const std::string& extension, std::size_t buffer_bytes)
+    : filename(filename.string()), extension(extension), buffer(std::max<std::size_t>(buffer_bytes, BLOCK)) {
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_message = "Cannot open " + this->filename;
+        return;
+    }
+#ifdef HAVE_ZLIB
+    gz = gzdopen(fd, "rb"); // reads plain files as they are
+    if (!gz) {
+        error_message = "Cannot open " + this->filename;
+        return;
+    }
+    fd = -1; // closed with gz
+    gzbuffer(static_cast<gzFile>(gz), static_cast<unsigned>(std::min<std::size_t>(buffer.size(), 1 << 30)));
+#else
+    unsigned char magic[2] = { 0, 0 };
+    if (::pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        error_message = this->filename + " is compressed, but this build has no zlib";
+        return;
+    }
+#endif
+
+    // JSONL starts with an object, a tar archive with a valid header
+    while (pos == end && fill()) {}
+    std::size_t first = pos;
+    while (first < end && isspace(static_cast<unsigned char>(buffer[first]))) first++;
+    while (end - pos < BLOCK && fill()) {}
+    if (first < end && buffer[first] == '{') kind = JSONL;
+    else if (end - pos >= BLOCK && tar_checksum(&buffer[pos])) kind = TAR;
+    else if (end == pos) kind = TAR; // empty, no documents
+    else error_message = this->filename + " is neither a tar archive nor a JSONL file";
+}
+
+ArchiveReader::~ArchiveReader() {
+#ifdef HAVE_ZLIB
+    if (gz) gzclose(static_cast<gzFile>(gz));
+#endif
+    if (fd >= 0) ::close(fd);
+}
+
+/**
+ * @brief Refill the buffer from the file.
+ * @return false at the end of the file.
+ *
+ * The bytes not taken yet are moved to the start of the buffer first.
+ */
+bool ArchiveReader::fill() {
+    if (pos > 0) {
+        memmove(buffer.data(), buffer.data() + pos, end - pos);
+        end -= pos;
+        pos = 0;
+    }
+    if (end == buffer.size()) return true;
+    long got = -1;
+#ifdef HAVE_ZLIB
+    if (gz) got = gzread(static_cast<gzFile>(gz), buffer.data() + end, static_cast<unsigned>(buffer.size() - end));
+#endif
+    if (fd >= 0) got = static_cast<long>(::read(fd, buffer.data() + end, buffer.size() - end));
+    if (got <= 0) return false;
+    end += static_cast<std::size_t>(got);
+    return true;
+}
+
+/**
+ * @brief Take bytes of the (decompressed) file.
+ * @param out Where to copy the bytes, nullptr to skip them.
+ * @param size The number of bytes.
+ * @return The number of bytes taken, less than size only at the end of the file.
+ */
+uint64_t ArchiveReader::take(char* out, uint64_t size) {
+    uint64_t taken = 0;
+    while (taken < size) {
+        if (pos == end && !fill()) break;
+        std::size_t n = static_cast<std::size_t>(std::min<uint64_t>(size - taken, end - pos));
+        if (out) memcpy(out + taken, buffer.data() + pos, n);
+        pos += n;
+        taken += n;
+    }
+    return taken;
+}
+
+/**
+ * @brief Take the bytes up to the next newline, which is dropped.
+ * @param line The line.
+ * @return false at the end of the file.
+ */
+bool ArchiveReader::take_line(std::string& line) {
+    line.clear();
+    while (true) {
+        if (pos == end && !fill()) return !line.empty();
+        const char* start = buffer.data() + pos;
+        const char* newline = static_cast<const char*>(memchr(start, '\n', end - pos));
+        std::size_t n = newline ? static_cast<std::size_t>(newline - start) : end - pos;
+        line.append(start, n);
+        pos += n;
+        if (newline) {
+            pos++;
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Move to the next document, skipping the rest of the current one.
+ * @param name The name of the document, "<filename>:<name>".
+ * @return false at the end of the archive, or if it is malformed, see error().
+ */
+bool ArchiveReader::next(std::string& name) {
+    if (!is_open()) return false;
+    return kind == TAR ? next_tar(name) : next_jsonl(name);
+}
+
+/**
+ * @brief next() for TAR.
+ *
+ * GNU long names ('L') and pax "path" records ('x') name the entry that follows them.
+ * Directories, links and other members without the extension are skipped.
+ */
+bool ArchiveReader::next_tar(std::string& name) {
+    std::string long_name;
+    while (true) {
+        uint64_t skip = remaining + padding;
+        remaining = padding = 0;
+        char header[BLOCK];
+        bool skipped = take(nullptr, skip) == skip;
+        uint64_t got = skipped ? take(header, BLOCK) : 0;
+        if (skipped && got == 0) return false; // no end blocks
+        if (got < BLOCK) {
+            error_message = filename + " is truncated";
+            return false;
+        }
+        if (std::all_of(header, header + BLOCK, [](char c) { return c == 0; })) return false; // end of archive
+        if (!tar_checksum(header)) {
+            error_message = filename + " has a corrupt tar header";
+            return false;
+        }
+        uint64_t size = tar_number(header + 124, 12);
+        char type = header[156];
+        remaining = size;
+        padding = (BLOCK - size % BLOCK) % BLOCK;
+        if (type == 'L' || type == 'x') {
+            std::string data(static_cast<std::size_t>(size), '\0');
+            remaining -= take(&data[0], size);
+            if (type == 'L') {
+                long_name = data.c_str();
+            }
+            for (std::size_t at = 0; type == 'x' && at < data.size();) { // records "<length> <key>=<value>\n"
+                std::size_t space = data.find(' ', at);
+                uint64_t length = strtoull(data.c_str() + at, nullptr, 10);
+                if (space == std::string::npos || length == 0 || at + length > data.size()) break;
+                std::string record = data.substr(space + 1, at + length - space - 2);
+                if (record.compare(0, 5, "path=") == 0) long_name = record.substr(5);
+                at += length;
+            }
+            continue;
+        }
+        std::string path = long_name;
+        long_name.clear();
+        if (path.empty()) {
+            std::string prefix = memcmp(header + 257, "ustar", 5) == 0 ? tar_string(header + 345, 155) : "";
+            path = (prefix.empty() ? "" : prefix + "/") + tar_string(header, 100);
+        }
+        if ((type != '0' && type != '\0' && type != '7') || std::filesystem::path(path).extension() != extension) continue;
+        name = filename + ":" + path;
+        document_size = size;
+        return true;
+    }
+}
+
+/**
+ * @brief next() for JSONL.
+ *
+ * Blank lines are skipped. A line that is not a JSON object is an error.
+ */
+bool ArchiveReader::next_jsonl(std::string& name) {
+    while (take_line(line)) {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        JsonLine json(line);
+        std::string id, url, key, text, html, content;
+        bool ok = json.consume('{');
+        if (ok && !json.consume('}')) {
+            do {
+                ok = json.string(&key) && json.consume(':');
+                if (!ok) break;
+                std::string* out = key == "id" ? &id : key == "url" ? &url : key == "text" ? &text
+                    : key == "html" ? &html : key == "content" ? &content : nullptr;
+                ok = json.value(out);
+            } while (ok && json.consume(','));
+            ok = ok && json.consume('}');
+        }
+        if (!ok) {
+            error_message = filename + ":" + std::to_string(line_number) + " is not a JSON object";
+            return false;
+        }
+        document = !text.empty() ? std::move(text) : !html.empty() ? std::move(html) : std::move(content);
+        document_pos = 0;
+        document_size = document.size();
+        name = filename + ":" + (!id.empty() ? id : !url.empty() ? url : std::to_string(line_number));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Read the content of the current document.
+ * @param buffer The buffer to read into.
+ * @param size The size of the buffer.
+ * @return The number of bytes read, less than size only at the end of the document.
+ */
+std::size_t ArchiveReader::read(char* buffer, std::size_t size) {
+    if (kind == JSONL) {
+        std::size_t n = std::min(size, document.size() - document_pos);
+        memcpy(buffer, document.data() + document_pos, n);
+        document_pos += n;
+        return n;
+    }
+    uint64_t n = take(buffer, std::min<uint64_t>(size, remaining));
+    remaining -= n;
+    return static_cast<std::size_t>(n);
+}
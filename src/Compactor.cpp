@@ -0,0 +1,49 @@
+#include "Compactor.h"
+
+#include <iostream>
+
+/**
+ * @brief Create a compactor, the thread is started by start().
+ * @param dir The target directory, see SearchEngine::SearchEngine.
+ * @param policy The merge policy.
+ */
+Compactor::Compactor(const std::filesystem::path& dir, const SearchEngine::CompactionPolicy& policy)
+    : dir(std::filesystem::absolute(dir)), policy(policy) {}
+
+/**
+ * @brief Stop the thread, after the compaction step in progress, if any.
+ */
+Compactor::~Compactor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+/**
+ * @brief Start the background thread.
+ * @param interval How often to look for segments to merge.
+ *
+ * A failing step (e.g. the disk is full) is reported to stderr and retried at the next interval.
+ */
+void Compactor::start(std::chrono::milliseconds interval) {
+    if (worker.joinable() || interval.count() <= 0) return;
+    worker = std::thread([this, interval] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!cv.wait_for(lock, interval, [this] { return stopping; })) {
+            lock.unlock(); // do not hold the lock while merging
+            try {
+                while (SearchEngine::compact_index(dir, policy, true)) {
+                    std::lock_guard<std::mutex> guard(mutex);
+                    if (stopping) break;
+                }
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Compaction failed: " << e.what() << std::endl;
+            }
+            lock.lock();
+        }
+    });
+}
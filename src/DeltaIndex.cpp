@@ -0,0 +1,63 @@
+#include "DeltaIndex.h"
+
+#include "SearchEngine.h"
+#include "MemoryUsage.h"
+
+/**
+ * @brief Create an empty delta on top of an engine.
+ * @param engine The engine holding the published generation.
+ */
+DeltaIndex::DeltaIndex(std::shared_ptr<const SearchEngine> engine)
+    : disk(std::move(engine)), base(disk->document_count()) {}
+
+/**
+ * @brief Index a new or modified file, replacing its previous version.
+ * @param name The document name, as indexed, e.g. `./a.html`.
+ * @param path The path of the file to read.
+ * @param filter The stop filter of the index, nullptr if none.
+ */
+void DeltaIndex::add_file(const std::string& name, const std::filesystem::path& path, StopFilter* filter) {
+    mask(name);
+    uint32_t doc = base + static_cast<uint32_t>(file_list.size());
+    Manifest::Entry entry = Manifest::stat_only(path, doc); // before reading, so a later change shows in the mtime
+    doc_lengths.push_back(index.add_file(path, doc, filter, &entry.hash)); // doc is larger than every ID so far, so postings stay sorted
+    doc_entries.push_back(entry);
+    file_list.push_back(name);
+    doc_ids[name] = doc;
+    touched.insert(name);
+    bytes += entry.size;
+}
+
+/**
+ * @brief Remove a deleted file.
+ * @param name The document name, as indexed.
+ */
+void DeltaIndex::remove_file(const std::string& name) {
+    mask(name);
+    doc_ids.erase(name);
+    touched.insert(name);
+}
+
+/**
+ * @brief Mask the current version of a document, in the delta or in the engine.
+ * @param name The document name.
+ */
+void DeltaIndex::mask(const std::string& name) {
+    auto it = doc_ids.find(name);
+    if (it != doc_ids.end()) {
+        masked.insert(it->second); // an earlier buffered version
+        return;
+    }
+    uint32_t doc;
+    if (!touched.count(name) && disk->find_document(name, doc)) {
+        masked.insert(doc); // the indexed version
+    }
+}
+
+/**
+ * @brief Estimate the heap memory of the delta.
+ * @return The bytes of its postings, names and masks, see MemoryUsage.
+ */
+uint64_t DeltaIndex::memory_usage() const {
+    return index.memory_usage() + heap_size(file_list) + heap_size(doc_lengths) + heap_size(doc_entries) + heap_size(doc_ids) + heap_size(masked) + heap_size(touched);
+}
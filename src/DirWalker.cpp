@@ -0,0 +1,128 @@
+#include "DirWalker.h"
+
+#include <iostream>
+#include <algorithm>
+
+/**
+ * @brief Start walking a directory.
+ * @param directory The root directory, file paths start with it.
+ * @param extension The extension of the files to list, e.g. ".html".
+ * @param options The options.
+ *
+ * If the directory does not exist, an error is printed and the walk ends with no files.
+ */
+DirWalker::DirWalker(const std::filesystem::path& directory, const std::string& extension, const Options& options)
+    : extension(extension), order(options.order), profile(IndexProfile::active()), start(IndexProfile::clock::now()), pool(options.threads) {
+    if (!std::filesystem::exists(directory)) {
+        std::cerr << "目录不存在: " << directory << std::endl; // Directory does not exist
+        done = true;
+        return;
+    }
+    nodes.push_back({ directory, false, {} });
+    Node* root = &nodes.back();
+    cursor.push_back({ root, 0 });
+    pending = 1;
+    pool.submit([this, root] { list(root); });
+}
+
+/**
+ * @brief List a directory and submit its subdirectories.
+ * @param node The directory.
+ *
+ * The directory is read without the lock, then its entries are published under it.
+ */
+void DirWalker::list(Node* node) {
+    IndexProfile::Laps laps(profile);
+    std::vector<Entry> entries;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(node->path, error), end; !error && it != end; it.increment(error)) {
+        std::error_code type_error; // an entry removed meanwhile is neither
+        if (it->is_directory(type_error) && !it->is_symlink(type_error)) {
+            entries.push_back({ it->path().filename().string(), true, nullptr });
+        }
+        else if (it->is_regular_file(type_error) && it->path().extension() == extension) {
+            entries.push_back({ it->path().filename().string(), false, nullptr });
+        }
+    }
+    if (order == CANONICAL) {
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    }
+    laps.lap(IndexProfile::WALK);
+
+    std::vector<Node*> children;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Entry& entry : entries) {
+            if (entry.directory) {
+                nodes.push_back({ node->path / entry.name, false, {} });
+                entry.node = &nodes.back();
+                children.push_back(entry.node);
+            }
+            else if (order == DISCOVERY) {
+                found.push_back((node->path / entry.name).string());
+            }
+        }
+        pending += children.size();
+        pending--;
+        if (order == CANONICAL) {
+            node->entries = std::move(entries);
+            node->listed = true;
+            advance();
+        }
+        if (pending == 0) {
+            done = true; // every directory is listed, so advance() emitted every file
+            if (profile && profile->is_tracing()) {
+                const char* name = IndexProfile::phase_name(IndexProfile::WALK);
+                profile->trace_event(name, name, start, IndexProfile::clock::now());
+            }
+        }
+    }
+    found_cv.notify_all();
+    for (Node* child : children) pool.submit([this, child] { list(child); });
+}
+
+/**
+ * @brief Emit the files of the listed prefix of the tree, in CANONICAL order. Requires the lock.
+ *
+ * The emission stops at the first directory not listed yet, and resumes when it is. The
+ * entries of a directory are released once all of them are emitted.
+ */
+void DirWalker::advance() {
+    while (!cursor.empty()) {
+        auto [node, next] = cursor.back();
+        if (!node->listed) return;
+        if (next == node->entries.size()) {
+            std::vector<Entry>().swap(node->entries);
+            cursor.pop_back();
+            continue;
+        }
+        cursor.back().second++;
+        const Entry& entry = node->entries[next];
+        if (entry.directory) cursor.push_back({ entry.node, 0 });
+        else found.push_back((node->path / entry.name).string());
+    }
+}
+
+/**
+ * @brief Get a file, waiting until it is found.
+ * @param i The position of the file in the order of the walk.
+ * @param file The path of the file.
+ * @return false if the walk ended with i files or fewer.
+ */
+bool DirWalker::get(std::size_t i, std::string& file) {
+    std::unique_lock<std::mutex> lock(mutex);
+    found_cv.wait(lock, [this, i] { return i < found.size() || done; });
+    if (i >= found.size()) return false;
+    file = found[i];
+    return true;
+}
+
+/**
+ * @brief Get all the files, waiting for the walk to end.
+ * @return The paths of the files, in the order of the walk.
+ */
+const std::vector<std::string>& DirWalker::files() {
+    std::unique_lock<std::mutex> lock(mutex);
+    found_cv.wait(lock, [this] { return done; });
+    return found;
+}
@@ -0,0 +1,182 @@
+#include "DocTable.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include "MemoryUsage.h"
+#include "utils.h"
+
+namespace {
+    const uint32_t MAGIC = 0x44534441; ///< "ADSD" in little-endian.
+    const std::size_t HEADER_BYTES = 4 * sizeof(uint32_t); ///< magic, count, blocks, reserved.
+    const std::size_t RECORD_BYTES = 24; ///< size, mtime, length, reserved.
+
+    /**
+     * @brief Append an unsigned integer, 7 bits per byte, low bits first.
+     */
+    void put_varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    /**
+     * @brief Read an unsigned integer written by put_varint.
+     * @return The value, the position is moved past it.
+     */
+    uint64_t get_varint(const char*& pos, const char* end) {
+        uint64_t value = 0;
+        for (unsigned shift = 0; pos < end && shift < 64; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*pos++);
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return value;
+    }
+
+    /**
+     * @brief Append the bytes of a value in host byte order.
+     */
+    template <typename T>
+    void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
+
+/**
+ * @brief Load the document table of a segment.
+ * @param dir The directory of the segment.
+ *
+ * The table file is mapped. If it is missing or invalid, the table is built from the list file.
+ */
+DocTable::DocTable(const std::filesystem::path& dir) {
+    file = MappedFile(dir / DOCS_FILE_NAME);
+    if (open()) return;
+    file = MappedFile();
+    std::vector<std::string> paths;
+    std::string line;
+    std::ifstream list_fs(dir / LIST_FILE_NAME);
+    while (std::getline(list_fs, line)) paths.push_back(line); // empty lines are documents removed by compaction
+    buffer = encode(paths, {});
+    open();
+}
+
+/**
+ * @brief Check the header of the table and read its counts.
+ * @return false if the table is truncated or not a document table.
+ */
+bool DocTable::open() {
+    uint32_t header[4] = { 0, 0, 0, 0 };
+    if (bytes() < HEADER_BYTES) return false;
+    memcpy(header, data(), HEADER_BYTES);
+    if (header[0] != MAGIC) return false;
+    uint64_t paths = HEADER_BYTES + uint64_t(header[1]) * RECORD_BYTES + uint64_t(header[2]) * sizeof(uint64_t);
+    if (paths > bytes() || header[2] != (header[1] + BLOCK_SIZE - 1) / BLOCK_SIZE) return false;
+    count = header[1];
+    blocks = header[2];
+    return true;
+}
+
+/**
+ * @brief Encode a document table.
+ * @param paths The paths of the documents.
+ * @param documents The metadata of the documents, missing ones are all 0.
+ * @return The bytes of the table file.
+ */
+std::string DocTable::encode(const std::vector<std::string>& paths, const std::vector<Document>& documents) {
+    uint32_t count = static_cast<uint32_t>(paths.size());
+    uint32_t blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::string out;
+    put(out, MAGIC);
+    put(out, count);
+    put(out, blocks);
+    put(out, uint32_t{ 0 });
+    for (uint32_t i = 0; i < count; i++) {
+        Document document = i < documents.size() ? documents[i] : Document();
+        put(out, document.size);
+        put(out, document.mtime);
+        put(out, document.length);
+        put(out, uint32_t{ 0 });
+    }
+    std::size_t offsets = out.size();
+    out.resize(out.size() + blocks * sizeof(uint64_t));
+    std::size_t start = out.size();
+    for (uint32_t i = 0; i < count; i++) {
+        std::size_t shared = 0;
+        if (i % BLOCK_SIZE == 0) {
+            uint64_t offset = out.size() - start;
+            memcpy(&out[offsets + i / BLOCK_SIZE * sizeof(uint64_t)], &offset, sizeof(offset));
+        }
+        else {
+            const std::string& prev = paths[i - 1];
+            while (shared < prev.size() && shared < paths[i].size() && prev[shared] == paths[i][shared]) shared++;
+        }
+        put_varint(out, shared);
+        put_varint(out, paths[i].size() - shared);
+        out.append(paths[i], shared, std::string::npos);
+    }
+    return out;
+}
+
+/**
+ * @brief Write a document table.
+ * @param filename The table file.
+ * @param paths The paths of the documents, empty for documents removed by compaction.
+ * @param documents The metadata of the documents, in the same order.
+ */
+void DocTable::save(const std::filesystem::path& filename, const std::vector<std::string>& paths, const std::vector<Document>& documents) {
+    std::string table = encode(paths, documents);
+    std::ofstream output(filename, std::ios::binary);
+    output.write(table.data(), table.size());
+}
+
+/**
+ * @brief Decode the path of a document.
+ * @param i The index of the document in the table.
+ * @return The path, empty for a document removed by compaction.
+ *
+ * The block of the document is decoded from its first path, so this takes at most BLOCK_SIZE steps.
+ */
+std::string DocTable::path(uint32_t i) const {
+    if (i >= count) return std::string();
+    const char* start = data() + HEADER_BYTES + std::size_t(count) * RECORD_BYTES + std::size_t(blocks) * sizeof(uint64_t);
+    const char* end = data() + bytes();
+    uint64_t offset;
+    memcpy(&offset, data() + HEADER_BYTES + std::size_t(count) * RECORD_BYTES + std::size_t(i / BLOCK_SIZE) * sizeof(uint64_t), sizeof(offset));
+    const char* pos = start + std::min<uint64_t>(offset, end - start);
+    std::string path;
+    for (uint32_t j = i / BLOCK_SIZE * BLOCK_SIZE; j <= i && pos < end; j++) {
+        uint64_t shared = get_varint(pos, end);
+        uint64_t suffix = std::min<uint64_t>(get_varint(pos, end), end - pos);
+        path.resize(std::min<uint64_t>(shared, path.size()));
+        path.append(pos, suffix);
+        pos += suffix;
+    }
+    return path;
+}
+
+/**
+ * @brief Get the metadata of a document.
+ * @param i The index of the document in the table.
+ * @return The metadata, all 0 if the table was built from a list file.
+ */
+DocTable::Document DocTable::document(uint32_t i) const {
+    Document document;
+    if (i >= count) return document;
+    const char* record = data() + HEADER_BYTES + std::size_t(i) * RECORD_BYTES;
+    memcpy(&document.size, record, sizeof(document.size));
+    memcpy(&document.mtime, record + 8, sizeof(document.mtime));
+    memcpy(&document.length, record + 16, sizeof(document.length));
+    return document;
+}
+
+/**
+ * @brief Get the heap memory of the table.
+ * @return The bytes, 0 unless the table was built from a list file.
+ */
+uint64_t DocTable::memory_usage() const {
+    return heap_size(buffer);
+}
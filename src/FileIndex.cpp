@@ -1,375 +1,693 @@
-#include "FileIndex.h"
-#include "StopFilter.h"
-#include "utils.h"
-
-#include <iostream>
-#include <fstream>
-
-using namespace std;
-
-/**
- * @brief Adds the content of a file to the index.
- *
- * This function reads tokens from the specified file and updates the index accordingly.
- * It increments the frequency count of each token and records the document ID in which
- * the token appears.
- *
- * @param filename The name of the file to be added to the index.
- * @param id The unique identifier for the document being indexed.
- * @param filter An optional pointer to a StopFilter instance to filter out stop words.
- */
-void FileIndex::add_file(const std::filesystem::path& filename, uint32_t id, StopFilter* filter) {
-    ifstream file(filename);
-    string token;
-    while (file) {
-        token = tokenize(file);
-        if (token.empty()) {
-            continue;
-        }
-        // Skip stop words
-        if (filter && filter->is_stop(token)) {
-            continue;
-        }
-        auto& entry = index[token];
-        // Add document ID to the list of documents containing the token
-        if (entry.docs.empty() || entry.docs.back() != id) {
-            entry.docs.push_back(id);
-        }
-        entry.freq++;
-    }
-}
-
-/**
- * @brief Adds all files from a specified directory to the index.
- *
- * This function retrieves all files in the specified directory and adds each file's content
- * to the index using a unique document ID starting from id_start. It supports large datasets
- * by processing files sequentially instead of loading all file contents into memory.
- *
- * @param dir The directory containing files to be indexed.
- * @param id_start The starting unique identifier for documents. Defaults to 0.
- * @param filter An optional pointer to a StopFilter instance to filter out stop words.
- * @return The next available document ID after indexing the files in the directory.
- */
-uint32_t FileIndex::add_dir(const std::filesystem::path& dir, uint32_t id_start, StopFilter* filter) {
-    vector<string> files = get_files(dir);
-    for (uint32_t i = 0; i < files.size(); i++) {
-        // Process files sequentially
-        this->add_file(files[i], id_start + i, filter);
-    }
-    // Return the next available document ID
-    return static_cast<uint32_t>(files.size()) + id_start;
-}
-
-/**
- * @brief Clears the index.
- *
- * This function resets the index by clearing all stored data, preparing the index for
- * new data to be added. It is essential for memory management, especially when handling
- * large datasets.
- */
-void FileIndex::clear() {
-    index.clear();
-}
-
-/**
- * @brief Serializes the index to a binary output stream.
- *
- * This function converts the in-memory index into a binary format for storage.
- * The binary format consists of a size header followed by entries for each word.
- * Each entry includes the frequency of the word, the length of the word,
- * the word itself, the number of documents that contain the word,
- * and the list of document IDs.
- *
- * The binary format of the index is as follows:
- * - uint32_t size: The number of entries in the index.
- * - Entry[] entries: An array of Entry structures, each containing the serialized data for a word.
- * - For the binary format of Entry, see the `write_entry` function.
- *
- * @param output The output stream to write the serialized index to.
- */
-void FileIndex::serialize(ostream& output) {
-    uint32_t size = static_cast<uint32_t>(index.size()); // Get the size of the index
-    output.write(reinterpret_cast<const char*>(&size), sizeof(size)); // Write size header
-    for (const auto& [word, entry] : index) {
-        write_entry(output, word, entry); // Serialize each entry
-    }
-}
-
-/**
- * @brief Saves the serialized index to a file.
- *
- * This function opens a binary output file stream for the specified filename
- * and calls the serialize method to write the index to the file.
- * It ensures that the output file is properly closed after writing.
- *
- * @param filename The name of the file where the index will be saved.
- */
-void FileIndex::save(const std::filesystem::path& filename) {
-    ofstream output(filename, ios::binary); // Open output file in binary mode
-    serialize(output); // Serialize the index to the file
-    output.close(); // Close the file
-}
-
-/**
- * @brief Reads a serialized index from a file.
- *
- * This function opens a binary input file stream for the specified filename,
- * calls the deserialize method to read and reconstruct the index,
- * and ensures the input file is properly closed after reading.
- *
- * @param filename The name of the file from which the index will be read.
- * @return The FileIndex object reconstructed from the file.
- */
-FileIndex FileIndex::deserialize(istream& input) {
-    FileIndex index;
-    uint32_t size; // Variable to store the number of entries in the index
-    input.read(reinterpret_cast<char*>(&size), sizeof(size)); // Read size header
-    for (uint32_t i = 0; i < size; i++) {
-        string word;
-        Entry entry;
-        read_entry(input, word, entry); // Deserialize each entry
-        index.index[word] = entry;
-    }
-    return index;
-}
-
-/**
- * @brief Reads a serialized index from a file.
- *
- * This function opens a binary input file stream for the specified filename,
- * calls the deserialize method to read and reconstruct the index,
- * and ensures the input file is properly closed after reading.
- *
- * @param filename The name of the file from which the index will be read.
- * @return The FileIndex object reconstructed from the file.
- */
-FileIndex FileIndex::read(const std::string& filename) {
-    FileIndex index;
-    ifstream input(filename, ios::binary);
-    index = deserialize(input); // Deserialize the index from the file
-    input.close();
-    return index;
-}
-
-/**
- * @brief Prints the index to an output stream.
- * This function iterates over the index and prints each word and its corresponding entry.
- * The entry is printed in the format "word(freq): doc1 doc2 ...", where "word" is the word, "freq" is the frequency of the word, and "doc1 doc2 ..." is the list of document IDs that contain the word.
- * @param output The output stream to which the index will be printed.
- */
-void FileIndex::print(ostream& output) {
-    for (const auto& [word, entry] : index) {
-        print_entry(output, word, entry);
-    }
-}
-
-/**
- * @overload
- * @brief Prints the index to a file.
- * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
- * It ensures that the file is properly closed after printing.
- * @param filename The name of the file where the index will be printed.
- */
-void FileIndex::print(const std::filesystem::path& filename) {
-    ofstream output(filename);
-    print(output);
-    output.close();
-}
-
-/**
- * @brief Prints the index to a file.
- * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
- * It ensures that the file is properly closed after printing.
- * @param filename The name of the file where the index will be printed.
- * @param output The output stream to which the index will be printed.
- */
-void FileIndex::print_file(const std::string& filename, std::ostream& output) {
-    uint32_t size;
-    ifstream input(filename, ios::binary);
-    input.read(reinterpret_cast<char*>(&size), sizeof(size)); // Read size header
-    for (uint32_t i = 0; i < size; i++) {
-        string word;
-        Entry entry;
-        read_entry(input, word, entry); // Deserialize each entry
-        output << word << ":";
-        for (uint32_t doc : entry.docs) {
-            output << " " << doc;
-        }
-        output << endl;
-    }
-}
-
-/**
- * @brief Merge two indexes from two streams into one stream.
- * Merge two indexes from two streams into one stream.
- * This function avoid read all the data into memory.
- * So it can handle large files.
- * @param input1 The first input stream.
- * @param input2 The second input stream.
- * @param output The output stream.
- */
-void FileIndex::merge_files(
-    const std::filesystem::path& filename1,
-    const std::filesystem::path& filename2,
-    const std::filesystem::path& output_filename
-) {
-    ifstream input1(filename1, ios::binary);
-    ifstream input2(filename2, ios::binary);
-    ofstream output(output_filename, ios::binary);
-
-    uint32_t size1, size2; // size of index
-    input1.read(reinterpret_cast<char*>(&size1), sizeof(size1));
-    input2.read(reinterpret_cast<char*>(&size2), sizeof(size2));
-
-    string word1, word2;
-    Entry entry1, entry2;
-    if (size1 > 0) { // if index1 is not empty
-        read_entry(input1, word1, entry1);
-    }
-    if (size2 > 0) { // if index2 is not empty
-        read_entry(input2, word2, entry2);
-    }
-
-    uint32_t size_merged = 0;
-    std::streampos pos_size = output.tellp(); // save position for size
-    output.write(reinterpret_cast<const char*>(&size_merged), sizeof(size_merged)); // placeholder for size, update later
-
-    while (size1 > 0 || size2 > 0) { // merge until one of the index is empty
-        if (size1 > 0 && (size2 == 0 || word1 < word2)) {
-            // if index1 is not empty and index2 is empty or word1 < word2, write word1 to output
-            write_entry(output, word1, entry1);
-            size_merged++;
-            read_entry(input1, word1, entry1); // read next word
-            size1--;
-        }
-        else if (size2 > 0 && (size1 == 0 || word2 < word1)) {
-            // if index2 is not empty and index1 is empty or word2 < word1, write word2 to output
-            write_entry(output, word2, entry2);
-            size_merged++;
-            read_entry(input2, word2, entry2); // read next word
-            size2--;
-        }
-        else { // both not empty and have same word
-            Entry merged = merge_entries(entry1, entry2);
-            write_entry(output, word1, merged);
-            size_merged++;
-            read_entry(input1, word1, entry1); // read next word
-            read_entry(input2, word2, entry2); // read next word
-            size1--;
-            size2--;
-        }
-    }
-
-    output.seekp(pos_size); // go back to position for size
-    output.write(reinterpret_cast<const char*>(&size_merged), sizeof(size_merged)); // update size
-}
-
-/**
- * @brief Read an entry from the input stream.
- * Read a word and an entry from the input stream.
- * @param input The input stream.
- * @param word The word of the entry.
- * @param entry The entry to be read.
- */
-bool FileIndex::read_entry(istream& input, string& word, Entry& entry) {
-    uint32_t word_len; // length of word
-    if (!input.read(reinterpret_cast<char*>(&word_len), sizeof(word_len))) {
-        return false;
-    }
-
-    word.resize(word_len); // resize word to word_len
-    input.read(&word[0], word_len);
-
-    uint32_t freq;
-    input.read(reinterpret_cast<char*>(&freq), sizeof(freq));
-    entry.freq = freq;
-
-    uint32_t num_doc;
-    input.read(reinterpret_cast<char*>(&num_doc), sizeof(num_doc)); // read number of docs
-    entry.docs.resize(num_doc); // resize docs to num_doc
-    input.read(reinterpret_cast<char*>(entry.docs.data()), num_doc * sizeof(uint32_t));
-    return true;
-}
-
-/**
- * @brief Write an entry to the output stream.
- * Write a word and an entry to the output stream.
- * The binary format is:
- * - word_len (uint32_t): length of word
- * - word (char[word_len]): the word
- * - freq (uint32_t): frequency of the word
- * - num_doc (uint32_t): number of documents
- * - docs (uint32_t[num_doc]): the documents
- */
-void FileIndex::write_entry(ostream& output, const string& word, const Entry& entry) {
-    // write word
-    uint32_t word_len = static_cast<uint32_t>(word.size());
-    output.write(reinterpret_cast<const char*>(&word_len), sizeof(word_len));
-    output.write(word.c_str(), word_len);
-
-    // write freq
-    uint32_t freq = entry.freq;
-    output.write(reinterpret_cast<const char*>(&freq), sizeof(freq));
-
-    // write docs
-    uint32_t num_doc = static_cast<uint32_t>(entry.docs.size());
-    output.write(reinterpret_cast<const char*>(&num_doc), sizeof(num_doc));
-    output.write(reinterpret_cast<const char*>(entry.docs.data()), num_doc * sizeof(uint32_t));
-}
-
-/**
- * @brief Print an entry to the output stream.
- * Print a word and an entry to the output stream.
- * The format is:
- * word(freq): doc1 doc2 ...
- * For example:
- * hello(3): 1 2 3
- * hello is the word, 3 is the frequency, 1 2 3 are the documents.
- *
- * @param output The output stream.
- * @param word The word of the entry.
- * @param entry The entry to be printed.
- */
-void FileIndex::print_entry(ostream& output, const string& word, const Entry& entry) {
-    output << word << "(" << entry.freq << ")" << ":";
-    for (auto& doc : entry.docs) {
-        output << " " << doc;
-    }
-    output << endl;
-}
-
-/**
- * @brief Merge two entries.
- * Merge two entries into one.
- * The merged entry has the sum of the frequencies and the union of the documents.
- * The documents are sorted in ascending order.
- * @param entry1 The first entry.
- * @param entry2 The second entry.
- * @return The merged entry.
- */
-FileIndex::Entry FileIndex::merge_entries(const Entry& entry1, const Entry& entry2) {
-    Entry merged;
-    merged.freq = entry1.freq + entry2.freq; // sum of frequencies
-    auto& docs1 = entry1.docs;
-    auto& docs2 = entry2.docs;
-    size_t i = 0, j = 0;
-    while (i < docs1.size() || j < docs2.size()) { // merge docs1 and docs2
-        if (i < docs1.size() && (j >= docs2.size() || docs1[i] < docs2[j])) {
-            // if docs1[i] < docs2[j], add docs1[i] to merged
-            merged.docs.push_back(docs1[i]);
-            i++;
-        }
-        else if (j < docs2.size() && (i >= docs1.size() || docs2[j] < docs1[i])) {
-            // if docs2[j] < docs1[i], add docs2[j] to merged
-            merged.docs.push_back(docs2[j]);
-            j++;
-        }
-        else { // docs1[i] == docs2[j]
-            merged.docs.push_back(docs1[i]);
-            i++;
-            j++;
-        }
-    }
-    return merged;
-}
\ No newline at end of file
+#include "FileIndex.h"
+#include "IndexProfile.h"
+#include "Manifest.h"
+#include "MappedFile.h"
+#include "MemoryUsage.h"
+#include "StopFilter.h"
+#include "utils.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    /**
+     * @brief A file buffer that attributes the time of its reads to the READ phase of a profile,
+     * and can hash the bytes it reads.
+     *
+     * The time before each read is first attributed to TOKENIZE, since reads happen in the
+     * middle of tokenizing, so the caller's next TOKENIZE lap only counts the time after it.
+     */
+    class ProfiledFileBuf : public filebuf {
+    public:
+        ProfiledFileBuf(IndexProfile::Laps& laps, uint64_t* hash) : laps(laps), hash(hash) {}
+
+    protected:
+        int_type underflow() override {
+            laps.lap(IndexProfile::TOKENIZE);
+            int_type result = filebuf::underflow();
+            if (!traits_type::eq_int_type(result, traits_type::eof())) {
+                laps.count(IndexProfile::BYTES_READ, static_cast<uint64_t>(egptr() - gptr()));
+                if (hash) *hash = Manifest::hash_bytes(*hash, gptr(), static_cast<size_t>(egptr() - gptr()));
+            }
+            laps.lap(IndexProfile::READ);
+            return result;
+        }
+
+    private:
+        IndexProfile::Laps& laps; ///< The laps of the file being read.
+        uint64_t* hash; ///< The hash of the bytes read, nullptr if not needed.
+    };
+
+    /**
+     * @brief Read an entry of a run, see FileIndex::save_run.
+     * @return false at the end of the input.
+     */
+    bool read_run_entry(istream& input, uint32_t& id, FileIndex::Entry& entry) {
+        uint32_t num_doc;
+        if (!input.read(reinterpret_cast<char*>(&id), sizeof(id))) return false;
+        input.read(reinterpret_cast<char*>(&entry.freq), sizeof(entry.freq));
+        input.read(reinterpret_cast<char*>(&num_doc), sizeof(num_doc));
+        entry.docs.resize(num_doc);
+        input.read(reinterpret_cast<char*>(entry.docs.data()), num_doc * sizeof(uint32_t));
+        return true;
+    }
+
+    /**
+     * @brief Write an entry of a run, see FileIndex::save_run.
+     * @return The number of bytes written.
+     */
+    size_t write_run_entry(ostream& output, uint32_t id, const FileIndex::Entry& entry) {
+        uint32_t num_doc = static_cast<uint32_t>(entry.docs.size());
+        output.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        output.write(reinterpret_cast<const char*>(&entry.freq), sizeof(entry.freq));
+        output.write(reinterpret_cast<const char*>(&num_doc), sizeof(num_doc));
+        output.write(reinterpret_cast<const char*>(entry.docs.data()), num_doc * sizeof(uint32_t));
+        return 3 * sizeof(uint32_t) + num_doc * sizeof(uint32_t);
+    }
+}
+
+/**
+ * @brief Adds the content of a file to the index.
+ *
+ * This function reads tokens from the specified file and updates the index accordingly.
+ * It increments the frequency count of each token and records the document ID in which
+ * the token appears.
+ *
+ * @param filename The name of the file to be added to the index.
+ * @param id The unique identifier for the document being indexed.
+ * @param filter An optional pointer to a StopFilter instance to filter out stop words.
+ * @param hash If not nullptr, the Manifest::hash_bytes hash it holds is extended with the bytes read.
+ * @return The number of tokens added, stop words excluded, i.e. the length of the document.
+ */
+uint32_t FileIndex::add_file(const std::filesystem::path& filename, uint32_t id, StopFilter* filter, uint64_t* hash) {
+    IndexProfile* profile = IndexProfile::active();
+    IndexProfile::Laps laps(profile); // the time of each step, if the build is profiled
+    auto start = profile ? IndexProfile::clock::now() : IndexProfile::clock::time_point();
+    ProfiledFileBuf buffer(laps, hash);
+    buffer.open(filename, ios::in);
+    istream file(&buffer);
+    string token;
+    uint32_t length = 0;
+    while (file) {
+        bool found = next_token(file, token); // token keeps its capacity, so known words allocate nothing
+        laps.lap(IndexProfile::TOKENIZE);
+        if (!found) {
+            continue;
+        }
+        stem_in_place(token);
+        laps.lap(IndexProfile::STEM);
+        laps.count(IndexProfile::TOKENS);
+        // Skip stop words
+        if (filter) {
+            bool stop = filter->is_stop(token);
+            laps.lap(IndexProfile::STOP_FILTER);
+            if (stop) {
+                laps.count(IndexProfile::STOP_WORDS);
+                continue;
+            }
+        }
+        add_token(token, id);
+        length++;
+        laps.lap(IndexProfile::INVERT);
+    }
+    laps.count(IndexProfile::FILES);
+    if (profile && profile->is_tracing()) {
+        profile->trace_event(filename.string(), "file", start, IndexProfile::clock::now());
+    }
+    return length;
+}
+
+/**
+ * @brief Adds one occurrence of a token to the index.
+ *
+ * The tokens of a document must be added before those of any later document, so the
+ * posting lists stay sorted.
+ *
+ * @param token The stemmed token.
+ * @param id The unique identifier of the document containing the token.
+ * @param count The number of occurrences to add.
+ */
+void FileIndex::add_token(const std::string& token, uint32_t id, uint32_t count) {
+    auto& entry = index[token];
+    // Add document ID to the list of documents containing the token
+    if (entry.docs.empty() || entry.docs.back() != id) {
+        entry.docs.push_back(id);
+    }
+    entry.freq += count;
+}
+
+/**
+ * @brief Adds the postings of a word, after those it already has.
+ *
+ * Adding words in lexicographic order costs no search of the index, see SortInverter.
+ *
+ * @param word The stemmed word.
+ * @param entry The frequency and the documents of the word, the documents must not be before those it already has.
+ */
+void FileIndex::add_entry(const std::string& word, Entry&& entry) {
+    auto it = index.empty() || index.rbegin()->first < word ? index.end() : index.lower_bound(word);
+    if (it == index.end() || it->first != word) {
+        index.emplace_hint(it, word, std::move(entry));
+        return;
+    }
+    Entry& existing = it->second;
+    existing.freq += entry.freq;
+    auto first = entry.docs.begin();
+    if (first != entry.docs.end() && !existing.docs.empty() && existing.docs.back() == *first) ++first; // the document of both
+    existing.docs.insert(existing.docs.end(), first, entry.docs.end());
+}
+
+/**
+ * @brief Adds all files from a specified directory to the index.
+ *
+ * This function retrieves all files in the specified directory and adds each file's content
+ * to the index using a unique document ID starting from id_start. It supports large datasets
+ * by processing files sequentially instead of loading all file contents into memory.
+ *
+ * @param dir The directory containing files to be indexed.
+ * @param id_start The starting unique identifier for documents. Defaults to 0.
+ * @param filter An optional pointer to a StopFilter instance to filter out stop words.
+ * @return The next available document ID after indexing the files in the directory.
+ */
+uint32_t FileIndex::add_dir(const std::filesystem::path& dir, uint32_t id_start, StopFilter* filter) {
+    vector<string> files = get_files(dir);
+    for (uint32_t i = 0; i < files.size(); i++) {
+        // Process files sequentially
+        this->add_file(files[i], id_start + i, filter);
+    }
+    // Return the next available document ID
+    return static_cast<uint32_t>(files.size()) + id_start;
+}
+
+/**
+ * @brief Clears the index.
+ *
+ * This function resets the index by clearing all stored data, preparing the index for
+ * new data to be added. It is essential for memory management, especially when handling
+ * large datasets.
+ */
+void FileIndex::clear() {
+    index.clear();
+}
+
+/**
+ * @brief Finds the entry of a word.
+ *
+ * @param word The word to look up.
+ * @return A pointer to the entry, or nullptr if the word is not in the index.
+ */
+const FileIndex::Entry* FileIndex::find(const std::string& word) const {
+    auto it = index.find(word);
+    return it == index.end() ? nullptr : &it->second;
+}
+
+/**
+ * @brief Estimate the heap memory of the index.
+ * @return The bytes of the words, the posting lists and the map nodes, see MemoryUsage.
+ */
+uint64_t FileIndex::memory_usage() const {
+    uint64_t bytes = index.size() * (32 + sizeof(std::pair<const std::string, Entry>)); // the tree nodes, as in heap_size
+    for (auto& [word, entry] : index) {
+        bytes += heap_size(word) + heap_size(entry.docs);
+    }
+    return bytes;
+}
+
+/**
+ * @brief Serializes the index to a binary output stream.
+ *
+ * This function converts the in-memory index into a binary format for storage.
+ * The binary format consists of a size header followed by entries for each word.
+ * Each entry includes the frequency of the word, the length of the word,
+ * the word itself, the number of documents that contain the word,
+ * and the list of document IDs.
+ *
+ * The binary format of the index is as follows:
+ * - uint32_t size: The number of entries in the index.
+ * - Entry[] entries: An array of Entry structures, each containing the serialized data for a word.
+ * - For the binary format of Entry, see the `write_entry` function.
+ *
+ * @param output The output stream to write the serialized index to.
+ */
+void FileIndex::serialize(ostream& output) const {
+    uint32_t size = static_cast<uint32_t>(index.size()); // Get the size of the index
+    output.write(reinterpret_cast<const char*>(&size), sizeof(size)); // Write size header
+    for (const auto& [word, entry] : index) {
+        write_entry(output, word, entry); // Serialize each entry
+    }
+}
+
+/**
+ * @brief Saves the serialized index to a file.
+ *
+ * This function opens a binary output file stream for the specified filename
+ * and calls the serialize method to write the index to the file.
+ * It ensures that the output file is properly closed after writing.
+ *
+ * @param filename The name of the file where the index will be saved.
+ */
+void FileIndex::save(const std::filesystem::path& filename) const {
+    IndexProfile::Scope scope(IndexProfile::SERIALIZE, "save " + filename.filename().string());
+    ofstream output(filename, ios::binary); // Open output file in binary mode
+    serialize(output); // Serialize the index to the file
+    if (IndexProfile* profile = IndexProfile::active()) {
+        profile->add(IndexProfile::BYTES_WRITTEN, static_cast<uint64_t>(output.tellp()));
+    }
+    output.close(); // Close the file
+}
+
+/**
+ * @brief Saves the index as a run of term IDs, for merge_runs.
+ *
+ * A run has the layout of an index file, except that each entry starts with the ID of its
+ * word in the dictionary instead of the word, and entries are sorted by ID.
+ *
+ * @param filename The name of the run file.
+ * @param dictionary The dictionary, new words are added to it.
+ */
+void FileIndex::save_run(const std::filesystem::path& filename, TermDictionary& dictionary) const {
+    IndexProfile::Scope scope(IndexProfile::SERIALIZE, "save " + filename.filename().string());
+    vector<pair<uint32_t, const Entry*>> entries;
+    entries.reserve(index.size());
+    for (const auto& [word, entry] : index) {
+        entries.push_back({ dictionary.id(word), &entry });
+    }
+    sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    ofstream output(filename, ios::binary);
+    uint32_t size = static_cast<uint32_t>(entries.size());
+    output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    for (const auto& [id, entry] : entries) {
+        write_run_entry(output, id, *entry);
+    }
+}
+
+/**
+ * @brief Reads a serialized index from a file.
+ *
+ * This function opens a binary input file stream for the specified filename,
+ * calls the deserialize method to read and reconstruct the index,
+ * and ensures the input file is properly closed after reading.
+ *
+ * @param filename The name of the file from which the index will be read.
+ * @return The FileIndex object reconstructed from the file.
+ */
+FileIndex FileIndex::deserialize(istream& input) {
+    FileIndex index;
+    uint32_t size; // Variable to store the number of entries in the index
+    input.read(reinterpret_cast<char*>(&size), sizeof(size)); // Read size header
+    for (uint32_t i = 0; i < size; i++) {
+        string word;
+        Entry entry;
+        read_entry(input, word, entry); // Deserialize each entry
+        index.index[word] = entry;
+    }
+    return index;
+}
+
+/**
+ * @brief Reads a serialized index from a file.
+ *
+ * This function opens a binary input file stream for the specified filename,
+ * calls the deserialize method to read and reconstruct the index,
+ * and ensures the input file is properly closed after reading.
+ *
+ * @param filename The name of the file from which the index will be read.
+ * @return The FileIndex object reconstructed from the file.
+ */
+FileIndex FileIndex::read(const std::string& filename) {
+    FileIndex index;
+    ifstream input(filename, ios::binary);
+    index = deserialize(input); // Deserialize the index from the file
+    input.close();
+    return index;
+}
+
+/**
+ * @brief Prints the index to an output stream.
+ * This function iterates over the index and prints each word and its corresponding entry.
+ * The entry is printed in the format "word(freq): doc1 doc2 ...", where "word" is the word, "freq" is the frequency of the word, and "doc1 doc2 ..." is the list of document IDs that contain the word.
+ * @param output The output stream to which the index will be printed.
+ */
+void FileIndex::print(ostream& output) {
+    for (const auto& [word, entry] : index) {
+        print_entry(output, word, entry);
+    }
+}
+
+/**
+ * @overload
+ * @brief Prints the index to a file.
+ * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
+ * It ensures that the file is properly closed after printing.
+ * @param filename The name of the file where the index will be printed.
+ */
+void FileIndex::print(const std::filesystem::path& filename) {
+    ofstream output(filename);
+    print(output);
+    output.close();
+}
+
+/**
+ * @brief Prints the index to a file.
+ * This function opens a file stream for the specified filename and calls the print method to print the index to the file.
+ * It ensures that the file is properly closed after printing.
+ * @param filename The name of the file where the index will be printed.
+ * @param output The output stream to which the index will be printed.
+ */
+void FileIndex::print_file(const std::string& filename, std::ostream& output) {
+    uint32_t size;
+    ifstream input(filename, ios::binary);
+    input.read(reinterpret_cast<char*>(&size), sizeof(size)); // Read size header
+    for (uint32_t i = 0; i < size; i++) {
+        string word;
+        Entry entry;
+        read_entry(input, word, entry); // Deserialize each entry
+        output << word << ":";
+        for (uint32_t doc : entry.docs) {
+            output << " " << doc;
+        }
+        output << endl;
+    }
+}
+
+/**
+ * @brief Merge two indexes from two streams into one stream.
+ * Merge two indexes from two streams into one stream.
+ * This function avoid read all the data into memory.
+ * So it can handle large files.
+ * @param input1 The first input stream.
+ * @param input2 The second input stream.
+ * @param output The output stream.
+ * @param on_write Called with the size of each entry written, e.g. to throttle the merge. Optional.
+ */
+void FileIndex::merge_files(
+    const std::filesystem::path& filename1,
+    const std::filesystem::path& filename2,
+    const std::filesystem::path& output_filename,
+    const std::function<void(std::size_t)>& on_write
+) {
+    IndexProfile::Scope scope(IndexProfile::MERGE, "merge into " + output_filename.filename().string());
+    ifstream input1(filename1, ios::binary);
+    ifstream input2(filename2, ios::binary);
+    ofstream output(output_filename, ios::binary);
+
+    uint32_t size1, size2; // size of index
+    input1.read(reinterpret_cast<char*>(&size1), sizeof(size1));
+    input2.read(reinterpret_cast<char*>(&size2), sizeof(size2));
+
+    string word1, word2;
+    Entry entry1, entry2;
+    if (size1 > 0) { // if index1 is not empty
+        read_entry(input1, word1, entry1);
+    }
+    if (size2 > 0) { // if index2 is not empty
+        read_entry(input2, word2, entry2);
+    }
+
+    uint32_t size_merged = 0;
+    std::streampos pos_size = output.tellp(); // save position for size
+    output.write(reinterpret_cast<const char*>(&size_merged), sizeof(size_merged)); // placeholder for size, update later
+
+    while (size1 > 0 || size2 > 0) { // merge until one of the index is empty
+        if (size1 > 0 && (size2 == 0 || word1 < word2)) {
+            // if index1 is not empty and index2 is empty or word1 < word2, write word1 to output
+            write_entry(output, word1, entry1);
+            if (on_write) on_write(3 * sizeof(uint32_t) + word1.size() + entry1.docs.size() * sizeof(uint32_t));
+            size_merged++;
+            read_entry(input1, word1, entry1); // read next word
+            size1--;
+        }
+        else if (size2 > 0 && (size1 == 0 || word2 < word1)) {
+            // if index2 is not empty and index1 is empty or word2 < word1, write word2 to output
+            write_entry(output, word2, entry2);
+            if (on_write) on_write(3 * sizeof(uint32_t) + word2.size() + entry2.docs.size() * sizeof(uint32_t));
+            size_merged++;
+            read_entry(input2, word2, entry2); // read next word
+            size2--;
+        }
+        else { // both not empty and have same word
+            Entry merged = merge_entries(entry1, entry2);
+            write_entry(output, word1, merged);
+            if (on_write) on_write(3 * sizeof(uint32_t) + word1.size() + merged.docs.size() * sizeof(uint32_t));
+            size_merged++;
+            read_entry(input1, word1, entry1); // read next word
+            read_entry(input2, word2, entry2); // read next word
+            size1--;
+            size2--;
+        }
+    }
+
+    output.seekp(pos_size); // go back to position for size
+    output.write(reinterpret_cast<const char*>(&size_merged), sizeof(size_merged)); // update size
+    if (IndexProfile* profile = IndexProfile::active()) {
+        output.seekp(0, ios::end);
+        profile->add(IndexProfile::MERGES, 1);
+        profile->add(IndexProfile::BYTES_WRITTEN, static_cast<uint64_t>(output.tellp()));
+    }
+}
+
+/**
+ * @brief Merge two runs saved by save_run into one run.
+ * Like merge_files, but entries are matched by comparing term IDs, and only IDs are copied.
+ * @param filename1 The first run.
+ * @param filename2 The second run.
+ * @param output_filename The merged run.
+ * @param on_write Called with the size of each entry written, e.g. to throttle the merge. Optional.
+ */
+void FileIndex::merge_runs(
+    const std::filesystem::path& filename1,
+    const std::filesystem::path& filename2,
+    const std::filesystem::path& output_filename,
+    const std::function<void(std::size_t)>& on_write
+) {
+    IndexProfile::Scope scope(IndexProfile::MERGE, "merge into " + output_filename.filename().string());
+    ifstream input1(filename1, ios::binary);
+    ifstream input2(filename2, ios::binary);
+    ofstream output(output_filename, ios::binary);
+
+    uint32_t size1 = 0, size2 = 0; // size of run
+    input1.read(reinterpret_cast<char*>(&size1), sizeof(size1));
+    input2.read(reinterpret_cast<char*>(&size2), sizeof(size2));
+
+    uint32_t id1 = 0, id2 = 0;
+    Entry entry1, entry2;
+    if (size1 > 0) read_run_entry(input1, id1, entry1);
+    if (size2 > 0) read_run_entry(input2, id2, entry2);
+
+    uint32_t size_merged = 0;
+    output.write(reinterpret_cast<const char*>(&size_merged), sizeof(size_merged)); // placeholder for size, update later
+
+    while (size1 > 0 || size2 > 0) {
+        size_t written;
+        if (size1 > 0 && (size2 == 0 || id1 < id2)) {
+            written = write_run_entry(output, id1, entry1);
+            read_run_entry(input1, id1, entry1);
+            size1--;
+        }
+        else if (size2 > 0 && (size1 == 0 || id2 < id1)) {
+            written = write_run_entry(output, id2, entry2);
+            read_run_entry(input2, id2, entry2);
+            size2--;
+        }
+        else { // same term
+            written = write_run_entry(output, id1, merge_entries(entry1, entry2));
+            read_run_entry(input1, id1, entry1);
+            read_run_entry(input2, id2, entry2);
+            size1--;
+            size2--;
+        }
+        if (on_write) on_write(written);
+        size_merged++;
+    }
+
+    output.seekp(0);
+    output.write(reinterpret_cast<const char*>(&size_merged), sizeof(size_merged)); // update size
+    if (IndexProfile* profile = IndexProfile::active()) {
+        output.seekp(0, ios::end);
+        profile->add(IndexProfile::MERGES, 1);
+        profile->add(IndexProfile::BYTES_WRITTEN, static_cast<uint64_t>(output.tellp()));
+    }
+}
+
+/**
+ * @brief Write a run as an index file, its words in lexicographic order.
+ * The run is mapped and its entries are copied in the order of dictionary.sorted_ids(), with
+ * each ID replaced by its word, so the index file is the same as with merge_files.
+ * @param run The run, e.g. all the runs of a build merged by merge_runs.
+ * @param dictionary The dictionary of the run.
+ * @param output_filename The index file.
+ */
+void FileIndex::run_to_index(const std::filesystem::path& run, const TermDictionary& dictionary, const std::filesystem::path& output_filename) {
+    IndexProfile::Scope scope(IndexProfile::SERIALIZE, "write " + output_filename.filename().string());
+    MappedFile mapped(run);
+    const char* data = mapped.data();
+    uint32_t size = 0;
+    if (mapped.size() >= sizeof(size)) memcpy(&size, data, sizeof(size));
+
+    // the offset of the entry of each ID, in one scan of the run
+    const uint64_t absent = UINT64_MAX;
+    vector<uint64_t> offsets(dictionary.size(), absent);
+    uint64_t pos = sizeof(size);
+    for (uint32_t i = 0; i < size && pos + 3 * sizeof(uint32_t) <= mapped.size(); i++) {
+        uint32_t id, num_doc;
+        memcpy(&id, data + pos, sizeof(id));
+        memcpy(&num_doc, data + pos + 2 * sizeof(uint32_t), sizeof(num_doc));
+        if (id < offsets.size()) offsets[id] = pos;
+        pos += 3 * sizeof(uint32_t) + uint64_t(num_doc) * sizeof(uint32_t);
+    }
+
+    ofstream output(output_filename, ios::binary);
+    output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    for (uint32_t id : dictionary.sorted_ids()) {
+        if (offsets[id] == absent) continue;
+        const string& word = dictionary.term(id);
+        uint32_t word_len = static_cast<uint32_t>(word.size()), num_doc;
+        memcpy(&num_doc, data + offsets[id] + 2 * sizeof(uint32_t), sizeof(num_doc));
+        output.write(reinterpret_cast<const char*>(&word_len), sizeof(word_len));
+        output.write(word.data(), word_len);
+        // freq, num_doc and docs are laid out as in write_entry
+        output.write(data + offsets[id] + sizeof(uint32_t), 2 * sizeof(uint32_t) + uint64_t(num_doc) * sizeof(uint32_t));
+    }
+}
+
+/**
+ * @brief Read an entry from the input stream.
+ * Read a word and an entry from the input stream.
+ * @param input The input stream.
+ * @param word The word of the entry.
+ * @param entry The entry to be read.
+ */
+bool FileIndex::read_entry(istream& input, string& word, Entry& entry) {
+    uint32_t word_len; // length of word
+    if (!input.read(reinterpret_cast<char*>(&word_len), sizeof(word_len))) {
+        return false;
+    }
+
+    word.resize(word_len); // resize word to word_len
+    input.read(&word[0], word_len);
+
+    uint32_t freq;
+    input.read(reinterpret_cast<char*>(&freq), sizeof(freq));
+    entry.freq = freq;
+
+    uint32_t num_doc;
+    input.read(reinterpret_cast<char*>(&num_doc), sizeof(num_doc)); // read number of docs
+    entry.docs.resize(num_doc); // resize docs to num_doc
+    input.read(reinterpret_cast<char*>(entry.docs.data()), num_doc * sizeof(uint32_t));
+    return true;
+}
+
+/**
+ * @brief Decode an entry from memory, e.g. from a memory-mapped index file.
+ * The binary format is the same as read_entry.
+ * @param data The start of the entry.
+ * @param size The number of bytes available from data.
+ * @param word The word of the entry.
+ * @param entry The entry to be decoded.
+ * @return The number of bytes the entry takes, or 0 if it is truncated.
+ */
+std::size_t FileIndex::decode_entry(const char* data, std::size_t size, string& word, Entry& entry) {
+    std::size_t pos = 0;
+    uint32_t word_len, num_doc;
+    if (size < sizeof(word_len)) return 0;
+    memcpy(&word_len, data, sizeof(word_len)); // length of word
+    pos += sizeof(word_len);
+    if (size - pos < word_len + sizeof(entry.freq) + sizeof(num_doc)) return 0;
+    word.assign(data + pos, word_len);
+    pos += word_len;
+    memcpy(&entry.freq, data + pos, sizeof(entry.freq));
+    pos += sizeof(entry.freq);
+    memcpy(&num_doc, data + pos, sizeof(num_doc)); // number of docs
+    pos += sizeof(num_doc);
+    if ((size - pos) / sizeof(uint32_t) < num_doc) return 0;
+    entry.docs.resize(num_doc);
+    memcpy(entry.docs.data(), data + pos, num_doc * sizeof(uint32_t));
+    pos += num_doc * sizeof(uint32_t);
+    return pos;
+}
+
+/**
+ * @brief Write an entry to the output stream.
+ * Write a word and an entry to the output stream.
+ * The binary format is:
+ * - word_len (uint32_t): length of word
+ * - word (char[word_len]): the word
+ * - freq (uint32_t): frequency of the word
+ * - num_doc (uint32_t): number of documents
+ * - docs (uint32_t[num_doc]): the documents
+ */
+void FileIndex::write_entry(ostream& output, const string& word, const Entry& entry) {
+    // write word
+    uint32_t word_len = static_cast<uint32_t>(word.size());
+    output.write(reinterpret_cast<const char*>(&word_len), sizeof(word_len));
+    output.write(word.c_str(), word_len);
+
+    // write freq
+    uint32_t freq = entry.freq;
+    output.write(reinterpret_cast<const char*>(&freq), sizeof(freq));
+
+    // write docs
+    uint32_t num_doc = static_cast<uint32_t>(entry.docs.size());
+    output.write(reinterpret_cast<const char*>(&num_doc), sizeof(num_doc));
+    output.write(reinterpret_cast<const char*>(entry.docs.data()), num_doc * sizeof(uint32_t));
+}
+
+/**
+ * @brief Print an entry to the output stream.
+ * Print a word and an entry to the output stream.
+ * The format is:
+ * word(freq): doc1 doc2 ...
+ * For example:
+ * hello(3): 1 2 3
+ * hello is the word, 3 is the frequency, 1 2 3 are the documents.
+ *
+ * @param output The output stream.
+ * @param word The word of the entry.
+ * @param entry The entry to be printed.
+ */
+void FileIndex::print_entry(ostream& output, const string& word, const Entry& entry) {
+    output << word << "(" << entry.freq << ")" << ":";
+    for (auto& doc : entry.docs) {
+        output << " " << doc;
+    }
+    output << endl;
+}
+
+/**
+ * @brief Merge two entries.
+ * Merge two entries into one.
+ * The merged entry has the sum of the frequencies and the union of the documents.
+ * The documents are sorted in ascending order.
+ * @param entry1 The first entry.
+ * @param entry2 The second entry.
+ * @return The merged entry.
+ */
+FileIndex::Entry FileIndex::merge_entries(const Entry& entry1, const Entry& entry2) {
+    Entry merged;
+    merged.freq = entry1.freq + entry2.freq; // sum of frequencies
+    auto& docs1 = entry1.docs;
+    auto& docs2 = entry2.docs;
+    size_t i = 0, j = 0;
+    while (i < docs1.size() || j < docs2.size()) { // merge docs1 and docs2
+        if (i < docs1.size() && (j >= docs2.size() || docs1[i] < docs2[j])) {
+            // if docs1[i] < docs2[j], add docs1[i] to merged
+            merged.docs.push_back(docs1[i]);
+            i++;
+        }
+        else if (j < docs2.size() && (i >= docs1.size() || docs2[j] < docs1[i])) {
+            // if docs2[j] < docs1[i], add docs2[j] to merged
+            merged.docs.push_back(docs2[j]);
+            j++;
+        }
+        else { // docs1[i] == docs2[j]
+            merged.docs.push_back(docs1[i]);
+            i++;
+            j++;
+        }
+    }
+    return merged;
+}
@@ -0,0 +1,135 @@
+#include "HotSwapEngine.h"
+
+#include <iostream>
+
+#include "utils.h"
+
+namespace {
+    /**
+     * @brief Load the published generation of a target directory.
+     * @param dir The target directory.
+     * @param memory_limit The memory ceiling of the engine, 0 for no limit.
+     * @return The engine.
+     */
+    std::shared_ptr<const SearchEngine> load_engine(const std::filesystem::path& dir, uint64_t memory_limit) {
+        auto engine = std::make_shared<SearchEngine>(dir);
+        engine->set_memory_limit(memory_limit);
+        return engine;
+    }
+}
+
+/**
+ * @brief Load the generation currently published for a target directory.
+ * @param dir The target directory, see SearchEngine::SearchEngine.
+ * @param memory_limit The memory ceiling of every loaded engine, see SearchEngine::set_memory_limit. 0 for no limit.
+ */
+HotSwapEngine::HotSwapEngine(const std::filesystem::path& dir, uint64_t memory_limit)
+    : dir(dir), memory_limit(memory_limit), engine(load_engine(dir, memory_limit)) {}
+
+/**
+ * @brief Stop the watcher thread, if any.
+ */
+HotSwapEngine::~HotSwapEngine() {
+    {
+        std::lock_guard<std::mutex> lock(watcher_mutex);
+        stopping = true;
+    }
+    watcher_cv.notify_all();
+    if (watcher.joinable()) watcher.join();
+}
+
+/**
+ * @brief Get the current engine.
+ * @return A reference that keeps its generation alive while it is held.
+ */
+std::shared_ptr<const SearchEngine> HotSwapEngine::acquire() const {
+    return std::atomic_load(&engine);
+}
+
+/**
+ * @brief Run a query on the current engine and delta.
+ * @param query The query, see SearchEngine::search.
+ * @param output The output stream to write the result to.
+ * @param options The options of the query, see SearchEngine::search. Its delta is replaced by the current one.
+ *
+ * The delta holds the engine it was built on, so the query uses that pair even if a newer
+ * engine was swapped in and the delta was not rebuilt on top of it yet.
+ */
+void HotSwapEngine::search(const std::string& query, std::ostream& output, const SearchEngine::SearchOptions& options) const {
+    SearchEngine::SearchOptions pinned = options;
+    std::shared_ptr<const DeltaIndex> current = acquire_delta();
+    pinned.delta = current.get();
+    if (current) current->engine()->search(query, output, pinned);
+    else acquire()->search(query, output, pinned);
+}
+
+/**
+ * @brief Get the current delta.
+ * @return The delta, nullptr if none was published.
+ */
+std::shared_ptr<const DeltaIndex> HotSwapEngine::acquire_delta() const {
+    return std::atomic_load(&delta);
+}
+
+/**
+ * @brief Publish a new delta, replacing the current one.
+ * @param delta The delta, nullptr to remove it.
+ */
+void HotSwapEngine::publish_delta(std::shared_ptr<const DeltaIndex> delta) {
+    std::atomic_store(&this->delta, std::move(delta));
+}
+
+/**
+ * @brief Load and swap in the published generation if it differs from the current one.
+ * @return true if a new generation was swapped in.
+ *
+ * The current engine keeps serving queries while the new one loads. If the new generation
+ * cannot be loaded, or does not fit in the memory limit, the current engine is kept.
+ */
+bool HotSwapEngine::reload() {
+    std::lock_guard<std::mutex> lock(reload_mutex);
+    std::filesystem::path published = index_dir(dir);
+    if (published == acquire()->index_path() || published == rejected) {
+        return false; // nothing new was published
+    }
+    auto next = load_engine(dir, memory_limit); // the slow part, readers are not blocked
+    if (!next->is_loaded()) {
+        return false; // e.g. the generation was replaced again while loading, retry later
+    }
+    if (memory_limit && next->memory_budget() == 0) {
+        std::cerr << "Warning: " << next->index_path().string() << " needs " << next->memory_usage().total()
+            << " bytes, over the memory limit of " << memory_limit << ", keeping the current generation" << std::endl;
+        rejected = published;
+        return false;
+    }
+    std::atomic_store(&engine, std::shared_ptr<const SearchEngine>(next));
+    // the old engine is destroyed when the last query using it drops its reference
+    return true;
+}
+
+/**
+ * @brief Start a background thread that reloads when a new generation is published.
+ * @param interval How often to check the CURRENT pointer file, 0 to only reload on request_reload().
+ *
+ * The thread wakes up every 100 ms to notice request_reload(), and checks the pointer
+ * file whenever interval has elapsed.
+ */
+void HotSwapEngine::watch(std::chrono::milliseconds interval) {
+    if (watcher.joinable()) return; // already watching
+    watcher = std::thread([this, interval] {
+        auto last_check = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(watcher_mutex);
+        while (!stopping) {
+            watcher_cv.wait_for(lock, std::chrono::milliseconds(100));
+            if (stopping) break;
+            auto now = std::chrono::steady_clock::now();
+            bool due = interval.count() > 0 && now - last_check >= interval;
+            if (reload_requested.exchange(false) || due) {
+                last_check = now;
+                lock.unlock(); // do not hold the lock while loading
+                reload();
+                lock.lock();
+            }
+        }
+    });
+}
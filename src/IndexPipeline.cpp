@@ -0,0 +1,634 @@
+#include "IndexPipeline.h"
+
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <cctype>
+#include <cstring>
+
+#include "ArchiveReader.h"
+#include "BoundedQueue.h"
+#include "IndexProfile.h"
+#include "ThreadPool.h"
+#include "utils.h"
+
+namespace {
+    /**
+     * @brief A part of a file, in a buffer owned by a reader.
+     */
+    struct Chunk {
+        std::string data; ///< The buffer, of Options::chunk_bytes.
+        std::size_t size = 0; ///< The number of bytes read into the buffer.
+        bool last = false; ///< Whether this is the last chunk of the file.
+        Manifest::Entry file; ///< The state of the file when opened, hashed up to the end of this chunk.
+    };
+
+    /**
+     * @brief The buffers of a reader thread: the free ones, and the ones waiting for the tokenizer.
+     *
+     * Every reader has its own buffers, so a reader that runs ahead cannot starve the reader of
+     * the file the tokenizer needs next.
+     */
+    struct Reader {
+        explicit Reader(std::size_t buffers) : free(buffers), filled(buffers) {}
+        BoundedQueue<std::string> free; ///< The buffers ready to be read into.
+        BoundedQueue<Chunk> filled; ///< The chunks read, in file order.
+    };
+
+    /**
+     * @brief The tokens of a part of a file, in a recycled batch.
+     */
+    struct Batch {
+        std::vector<std::string> tokens; ///< The token buffers, of Options::batch_tokens.
+        std::vector<uint32_t> counts; ///< The occurrences of each token, if counted.
+        bool counted = false; ///< Whether the tokens are distinct and counted, instead of occurring once each.
+        std::size_t size = 0; ///< The number of tokens in the batch.
+        uint32_t file = 0; ///< The position of the file in the input.
+        bool last = false; ///< Whether this is the last batch of the file.
+        Manifest::Entry entry; ///< The state of the file, in its last batch.
+    };
+
+    /**
+     * @brief A stream buffer over the chunks of one file, which recycles each chunk once it is consumed.
+     *
+     * The time spent waiting for a chunk is attributed to the TOKENIZE_STALL phase.
+     */
+    class ChunkBuf : public std::streambuf {
+    public:
+        ChunkBuf(Reader& reader, IndexProfile::Laps& laps, IndexPipeline::clock::duration& stalled, Chunk first)
+            : reader(reader), laps(laps), stalled(stalled), chunk(std::move(first)), held(true) {
+            setg(&chunk.data[0], &chunk.data[0], &chunk.data[0] + chunk.size);
+        }
+        ~ChunkBuf() override { release(); }
+
+        /**
+         * @brief Get the state of the file, hashed up to the end of the current chunk.
+         */
+        const Manifest::Entry& file() const { return chunk.file; }
+
+    protected:
+        int_type underflow() override {
+            while (gptr() == egptr()) {
+                if (chunk.last) return traits_type::eof();
+                release();
+                laps.lap(IndexProfile::TOKENIZE);
+                bool ok = reader.filled.pop(chunk, &stalled);
+                laps.lap(IndexProfile::TOKENIZE_STALL);
+                if (!ok) { // the pipeline is stopping
+                    chunk.last = true;
+                    return traits_type::eof();
+                }
+                held = true;
+                setg(&chunk.data[0], &chunk.data[0], &chunk.data[0] + chunk.size);
+            }
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        /**
+         * @brief Give the buffer of the current chunk back to its reader.
+         */
+        void release() {
+            if (!held) return;
+            setg(nullptr, nullptr, nullptr);
+            reader.free.push(std::move(chunk.data));
+            held = false;
+        }
+
+        Reader& reader; ///< The reader of the file.
+        IndexProfile::Laps& laps; ///< The laps of the tokenizer.
+        IndexPipeline::clock::duration& stalled; ///< The time the tokenizer waited for chunks.
+        Chunk chunk; ///< The current chunk.
+        bool held = false; ///< Whether the buffer of chunk must be given back.
+    };
+
+    using Counts = std::unordered_map<std::string, uint32_t>; ///< The occurrences of each token.
+
+    /**
+     * @brief Count the tokens of a span as next_token reads them, starting outside a tag.
+     * @param p The start of the span.
+     * @param end The end of the span.
+     * @param filter The stop filter, nullptr if none.
+     * @param counts The occurrences of each stemmed token, stop words excluded, added to.
+     * @param laps The laps of the calling thread.
+     * @return Whether the span ends inside a tag.
+     */
+    bool count_tokens(const char* p, const char* end, StopFilter* filter, Counts& counts, IndexProfile::Laps& laps) {
+        std::string token;
+        while (p < end) {
+            char ch = *p++;
+            if (ch == '<') { // skip the tag
+                p = static_cast<const char*>(memchr(p, '>', static_cast<std::size_t>(end - p)));
+                if (!p) return true;
+                p++;
+                continue;
+            }
+            if (!isalnum(ch)) continue;
+            const char* start = p - 1;
+            while (p < end && isalnum(*p)) p++;
+            token.assign(start, p);
+            if (p < end) p++; // the character ending a token is consumed with it, as by next_token
+            laps.lap(IndexProfile::TOKENIZE);
+            stem_in_place(token);
+            laps.lap(IndexProfile::STEM);
+            laps.count(IndexProfile::TOKENS);
+            if (filter) {
+                bool stop = filter->is_stop(token);
+                laps.lap(IndexProfile::STOP_FILTER);
+                if (stop) {
+                    laps.count(IndexProfile::STOP_WORDS);
+                    continue;
+                }
+            }
+            counts[token]++;
+        }
+        laps.lap(IndexProfile::TOKENIZE);
+        return false;
+    }
+
+    /**
+     * @brief Tokenizes a large file by several threads, a window of the file at a time.
+     *
+     * A window is split into one piece per thread, each ending after a character that is not
+     * alphanumeric, so no token spans two pieces, but a tag may. next_token is outside a tag
+     * after any '>', so the tokens of a piece after its first '>' do not depend on where the
+     * piece starts. Those before it count only if the piece starts outside a tag, which is known
+     * once the pieces before it are tokenized. The file gives the same tokens as next_token.
+     */
+    class WindowTokenizer {
+    public:
+        WindowTokenizer(ThreadPool& pool, StopFilter* filter, IndexProfile* profile, std::size_t window_bytes)
+            : pool(pool), filter(filter), profile(profile), window_bytes(window_bytes), pieces(pool.size()) {}
+
+        /**
+         * @brief Append the next bytes of the file, and tokenize the window once it is full.
+         */
+        void append(const char* data, std::size_t size) {
+            window.append(data, size);
+            if (window.size() >= window_bytes) tokenize(false);
+        }
+
+        /**
+         * @brief Tokenize the rest of the file.
+         * @return The occurrences of each token of the file, stop words excluded.
+         */
+        Counts& finish() {
+            tokenize(true);
+            return counts;
+        }
+
+    private:
+        /**
+         * @brief The tokens of a piece of a window.
+         */
+        struct Piece {
+            std::size_t begin = 0; ///< The start of the piece in the window.
+            std::size_t end = 0; ///< The end of the piece in the window.
+            Counts head; ///< The tokens before the first '>', if the piece starts outside a tag.
+            Counts tail; ///< The tokens after the first '>'.
+            bool closes = false; ///< Whether the piece has a '>'.
+            bool ends_in_tag = false; ///< Whether the piece ends inside a tag: always if it has no '>' and starts inside one.
+        };
+
+        /**
+         * @brief Move a position of the window back after a character that is not alphanumeric.
+         * @return The position, floor if there is none after floor.
+         */
+        std::size_t boundary(std::size_t pos, std::size_t floor) const {
+            while (pos > floor && isalnum(window[pos - 1])) pos--;
+            return pos;
+        }
+
+        /**
+         * @brief Tokenize the window up to its last boundary, or all of it at the end of the file.
+         */
+        void tokenize(bool last) {
+            std::size_t cut = last ? window.size() : boundary(window.size(), 0);
+            if (cut == 0) return; // a single token fills the window, wait for its end
+            std::size_t n = pieces.size();
+            for (std::size_t k = 0, begin = 0; k < n; k++) {
+                Piece& piece = pieces[k];
+                piece.begin = begin;
+                piece.end = k + 1 == n ? cut : boundary(std::max(begin, cut * (k + 1) / n), begin);
+                begin = piece.end;
+                pool.submit([this, &piece] {
+                    IndexProfile::Laps laps(profile);
+                    const char* data = window.data();
+                    const char* close = static_cast<const char*>(memchr(data + piece.begin, '>', piece.end - piece.begin));
+                    piece.closes = close != nullptr;
+                    const char* head_end = piece.closes ? close + 1 : data + piece.end;
+                    piece.ends_in_tag = count_tokens(data + piece.begin, head_end, filter, piece.head, laps);
+                    if (piece.closes) piece.ends_in_tag = count_tokens(head_end, data + piece.end, filter, piece.tail, laps);
+                });
+            }
+            pool.wait();
+
+            for (Piece& piece : pieces) { // chain the pieces in order
+                if (!in_tag) add(piece.head);
+                else piece.head.clear();
+                if (piece.closes) add(piece.tail);
+                if (piece.closes || !in_tag) in_tag = piece.ends_in_tag;
+            }
+            window.erase(0, cut);
+        }
+
+        /**
+         * @brief Add the tokens of a piece to those of the file, and clear them.
+         */
+        void add(Counts& piece) {
+            for (auto& [token, count] : piece) counts[token] += count;
+            piece.clear();
+        }
+
+        ThreadPool& pool; ///< The threads tokenizing the pieces.
+        StopFilter* filter; ///< The stop filter, nullptr if none.
+        IndexProfile* profile; ///< The active profile, nullptr if none.
+        std::size_t window_bytes; ///< The size of a window.
+        std::string window; ///< The bytes of the file not tokenized yet.
+        std::vector<Piece> pieces; ///< The pieces of the window, one per thread.
+        bool in_tag = false; ///< Whether the tokenized part of the file ends inside a tag.
+        Counts counts; ///< The tokens of the tokenized part of the file.
+    };
+}
+
+/**
+ * @brief Where the readers of the pipeline get the files and their contents.
+ *
+ * Reader r opens files r, r + readers(), ... in turn and reads each to its end before opening
+ * the next. Any thread can get the name of a file with file().
+ */
+class IndexPipeline::Input {
+public:
+    virtual ~Input() = default;
+
+    /**
+     * @brief Get the number of reader threads.
+     */
+    virtual unsigned readers() const = 0;
+
+    /**
+     * @brief Get the name of a file, waiting until it is known if needed.
+     * @return false if there are i files or fewer.
+     */
+    virtual bool file(std::size_t i, std::string& name) = 0;
+
+    /**
+     * @brief Start reading a file.
+     * @param r The reader.
+     * @param i The position of the file.
+     * @param name The name of the file.
+     * @param entry The size and mtime of the file, taken before it is read.
+     * @return false if there are i files or fewer.
+     */
+    virtual bool open(unsigned r, std::size_t i, std::string& name, Manifest::Entry& entry) = 0;
+
+    /**
+     * @brief Read the file opened by a reader.
+     * @return The number of bytes read, less than size only at the end of the file.
+     */
+    virtual std::size_t read(unsigned r, char* buffer, std::size_t size) = 0;
+};
+
+namespace {
+    /**
+     * @brief Files on disk, read by any number of readers.
+     */
+    class FileInput : public IndexPipeline::Input {
+    public:
+        FileInput(const IndexPipeline::FileSource& source, unsigned readers) : source(source), streams(readers) {}
+
+        unsigned readers() const override { return static_cast<unsigned>(streams.size()); }
+
+        bool file(std::size_t i, std::string& name) override { return source(i, name); }
+
+        bool open(unsigned r, std::size_t i, std::string& name, Manifest::Entry& entry) override {
+            if (!source(i, name)) return false;
+            entry = Manifest::stat_only(name, 0); // before reading, so a later change shows in the mtime
+            streams[r] = std::ifstream(name, std::ios::binary); // a file that cannot be opened reads as empty
+            return true;
+        }
+
+        std::size_t read(unsigned r, char* buffer, std::size_t size) override {
+            if (!streams[r].is_open()) return 0;
+            streams[r].read(buffer, static_cast<std::streamsize>(size));
+            return static_cast<std::size_t>(streams[r].gcount());
+        }
+
+    private:
+        const IndexPipeline::FileSource& source; ///< The files.
+        std::vector<std::ifstream> streams; ///< The file opened by each reader.
+    };
+
+    /**
+     * @brief The documents of an archive, read in one pass by one reader.
+     *
+     * The names are only known as the reader reaches them, so they are kept for the other stages.
+     */
+    class ArchiveInput : public IndexPipeline::Input {
+    public:
+        explicit ArchiveInput(ArchiveReader& archive) : archive(archive) {}
+
+        unsigned readers() const override { return 1; }
+
+        bool file(std::size_t i, std::string& name) override {
+            std::unique_lock<std::mutex> lock(mutex);
+            known.wait(lock, [this, i] { return i < names.size() || done; });
+            if (i >= names.size()) return false;
+            name = names[i];
+            return true;
+        }
+
+        bool open(unsigned, std::size_t, std::string& name, Manifest::Entry& entry) override {
+            bool found = archive.next(name);
+            entry = Manifest::Entry();
+            entry.size = archive.size();
+            entry.hash = Manifest::HASH_BASIS;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (found) names.push_back(name);
+                else done = true;
+            }
+            known.notify_all();
+            return found;
+        }
+
+        std::size_t read(unsigned, char* buffer, std::size_t size) override { return archive.read(buffer, size); }
+
+    private:
+        ArchiveReader& archive; ///< The archive.
+        std::mutex mutex; ///< Protects names and done.
+        std::condition_variable known; ///< Signaled when a name is known or the archive ends.
+        std::vector<std::string> names; ///< The names of the documents reached so far.
+        bool done = false; ///< Whether the archive ended.
+    };
+}
+
+/**
+ * @brief Create a pipeline.
+ * @param index The index the files are added to.
+ * @param filter The stop filter, nullptr if no stop filter is needed.
+ * @param options The options.
+ */
+IndexPipeline::IndexPipeline(FileIndex& index, StopFilter* filter, const Options& options)
+    : index(index), filter(filter), options(options) {}
+
+/**
+ * @brief Index files.
+ * @param source The files, a file that cannot be opened is indexed as an empty document.
+ * @param first_id The document ID of the first file, the others follow.
+ * @param on_document Called after each file is added to the index.
+ * @return The statistics of the run.
+ */
+IndexPipeline::Stats IndexPipeline::run(const FileSource& source, uint32_t first_id, const DocumentCallback& on_document) {
+    if (options.readers == 0) {
+        Stats stats;
+        std::string file;
+        for (uint32_t i = 0; source(i, file); i++) {
+            Manifest::Entry entry = Manifest::stat_only(file, first_id + i);
+            uint32_t length = index.add_file(file, first_id + i, filter, &entry.hash);
+            on_document(i, file, length, entry);
+            stats.files++;
+        }
+        return stats;
+    }
+    FileInput input(source, options.readers);
+    return run(input, first_id, on_document);
+}
+
+/**
+ * @brief Index the documents of an archive.
+ * @param archive The archive, read by one reader thread whatever Options::readers.
+ * @param first_id The document ID of the first document, the others follow.
+ * @param on_document Called after each document is added to the index.
+ * @return The statistics of the run.
+ */
+IndexPipeline::Stats IndexPipeline::run(ArchiveReader& archive, uint32_t first_id, const DocumentCallback& on_document) {
+    ArchiveInput input(archive);
+    return run(input, first_id, on_document);
+}
+
+/**
+ * @brief Run the stages of the pipeline.
+ * @param input The files and their contents.
+ * @param first_id The document ID of the first file, the others follow.
+ * @param on_document Called after each file is added to the index.
+ * @return The statistics of the run.
+ *
+ * Reader r reads files r, r + readers, ..., so the tokenizer knows which reader holds the next
+ * file and takes its chunks in order, without reordering. The pipeline holds at most
+ * readers * read_ahead chunks and batches batches of tokens at any time.
+ */
+IndexPipeline::Stats IndexPipeline::run(Input& input, uint32_t first_id, const DocumentCallback& on_document) {
+    Stats stats;
+    IndexProfile* profile = IndexProfile::active();
+    std::size_t chunk_bytes = std::max<std::size_t>(options.chunk_bytes, 1);
+    std::size_t batch_tokens = std::max<std::size_t>(options.batch_tokens, 1);
+    std::size_t read_ahead = std::max<std::size_t>(options.read_ahead, 1);
+    std::size_t batch_count = std::max<std::size_t>(options.batches, 1);
+    std::vector<std::unique_ptr<Reader>> readers;
+    for (unsigned r = 0; r < input.readers(); r++) {
+        readers.push_back(std::make_unique<Reader>(read_ahead));
+        for (std::size_t k = 0; k < read_ahead; k++) readers[r]->free.push(std::string(chunk_bytes, '\0'));
+    }
+    BoundedQueue<Batch> free_batches(batch_count), filled_batches(batch_count);
+    for (std::size_t k = 0; k < batch_count; k++) {
+        Batch batch;
+        batch.tokens.resize(batch_tokens);
+        free_batches.push(std::move(batch));
+    }
+    std::vector<clock::duration> read_stalls(readers.size());
+    std::vector<uint64_t> read_bytes(readers.size());
+
+    std::unique_ptr<SortInverter> sorter;
+    if (options.inversion == SORT) sorter = std::make_unique<SortInverter>(options.sort);
+    std::unique_ptr<ThreadPool> split_pool; // the threads tokenizing large files, started by the first one
+    ThreadPool pool(input.readers() + 1);
+    for (unsigned r = 0; r < input.readers(); r++) {
+        pool.submit([&, r] {
+            Reader& reader = *readers[r];
+            IndexProfile::Laps laps(profile);
+            std::string name;
+            Manifest::Entry file;
+            for (std::size_t i = r; input.open(r, i, name, file); i += readers.size()) {
+                auto start = profile ? clock::now() : clock::time_point();
+                for (bool last = false; !last;) {
+                    Chunk chunk;
+                    laps.lap(IndexProfile::READ);
+                    if (!reader.free.pop(chunk.data, &read_stalls[r])) return;
+                    laps.lap(IndexProfile::READ_STALL);
+                    chunk.size = input.read(r, &chunk.data[0], chunk.data.size());
+                    last = chunk.last = chunk.size < chunk.data.size();
+                    file.hash = Manifest::hash_bytes(file.hash, chunk.data.data(), chunk.size); // on the reader, off the inverter thread
+                    chunk.file = file;
+                    read_bytes[r] += chunk.size;
+                    laps.count(IndexProfile::BYTES_READ, chunk.size);
+                    laps.lap(IndexProfile::READ);
+                    if (!reader.filled.push(std::move(chunk))) return;
+                }
+                laps.count(IndexProfile::FILES);
+                if (profile && profile->is_tracing()) {
+                    profile->trace_event(name, IndexProfile::phase_name(IndexProfile::READ), start, clock::now());
+                }
+            }
+        });
+    }
+    pool.submit([&] {
+        IndexProfile::Laps laps(profile);
+        std::string token;
+        Batch batch;
+        auto next_batch = [&] {
+            laps.lap(IndexProfile::TOKENIZE);
+            bool ok = free_batches.pop(batch, &stats.tokenize_output_stall);
+            laps.lap(IndexProfile::TOKENIZE_STALL);
+            batch.size = 0;
+            batch.counted = false;
+            return ok;
+        };
+        auto send = [&](uint32_t i, bool last, const Manifest::Entry& entry = Manifest::Entry()) {
+            batch.file = i;
+            batch.last = last;
+            batch.entry = entry;
+            laps.lap(IndexProfile::TOKENIZE);
+            bool ok = filled_batches.push(std::move(batch), &stats.tokenize_output_stall);
+            laps.lap(IndexProfile::TOKENIZE_STALL);
+            return ok;
+        };
+        std::string name;
+        for (uint32_t i = 0; input.file(i, name); i++) {
+            stats.files++;
+            Reader& reader = *readers[i % readers.size()];
+            Chunk chunk;
+            laps.lap(IndexProfile::TOKENIZE);
+            bool ok = reader.filled.pop(chunk, &stats.tokenize_input_stall);
+            laps.lap(IndexProfile::TOKENIZE_STALL);
+            if (!ok) return;
+            if (options.split_bytes > 0 && chunk.file.size > options.split_bytes) {
+                if (!split_pool) split_pool = std::make_unique<ThreadPool>(options.split_threads);
+                stats.split_files++;
+                WindowTokenizer tokenizer(*split_pool, filter, profile, options.split_bytes);
+                while (true) {
+                    tokenizer.append(chunk.data.data(), chunk.size);
+                    laps.skip(); // the threads of the pieces time themselves
+                    bool last = chunk.last;
+                    reader.free.push(std::move(chunk.data));
+                    if (last) break;
+                    ok = reader.filled.pop(chunk, &stats.tokenize_input_stall);
+                    laps.lap(IndexProfile::TOKENIZE_STALL);
+                    if (!ok) return;
+                }
+                Counts& counts = tokenizer.finish();
+                laps.skip();
+                if (!next_batch()) return;
+                for (auto& [token, count] : counts) {
+                    if (batch.counts.size() < batch.tokens.size()) batch.counts.resize(batch.tokens.size());
+                    batch.counted = true;
+                    batch.tokens[batch.size] = token;
+                    batch.counts[batch.size++] = count;
+                    if (batch.size == batch.tokens.size() && (!send(i, false) || !next_batch())) return;
+                }
+                if (!send(i, true, chunk.file)) return; // the data of the last chunk is recycled, its entry is kept
+                continue;
+            }
+            ChunkBuf buffer(reader, laps, stats.tokenize_input_stall, std::move(chunk));
+            std::istream input(&buffer);
+            if (!next_batch()) return;
+            while (input) {
+                bool found = next_token(input, token);
+                laps.lap(IndexProfile::TOKENIZE);
+                if (!found) {
+                    continue;
+                }
+                stem_in_place(token);
+                laps.lap(IndexProfile::STEM);
+                laps.count(IndexProfile::TOKENS);
+                if (filter) {
+                    bool stop = filter->is_stop(token);
+                    laps.lap(IndexProfile::STOP_FILTER);
+                    if (stop) {
+                        laps.count(IndexProfile::STOP_WORDS);
+                        continue;
+                    }
+                }
+                batch.tokens[batch.size++].swap(token); // both buffers keep their capacity
+                if (batch.size == batch.tokens.size() && (!send(i, false) || !next_batch())) return;
+            }
+            if (!send(i, true, buffer.file())) return;
+        }
+        filled_batches.close(); // the inverter stops once it has taken the last batch
+    });
+
+    auto stop = [&] {
+        for (auto& reader : readers) {
+            reader->free.close();
+            reader->filled.close();
+        }
+        free_batches.close();
+        filled_batches.close();
+        pool.wait();
+    };
+    try {
+        IndexProfile::Laps laps(profile);
+        Batch batch;
+        std::string name;
+        uint32_t length = 0;
+        while (filled_batches.pop(batch, &stats.invert_stall)) {
+            laps.lap(IndexProfile::INVERT_STALL);
+            uint32_t doc = first_id + batch.file;
+            for (std::size_t k = 0; k < batch.size; k++) {
+                uint32_t count = batch.counted ? batch.counts[k] : 1;
+                if (sorter) sorter->add_token(batch.tokens[k], doc, count);
+                else index.add_token(batch.tokens[k], doc, count);
+                length += count;
+            }
+            laps.lap(IndexProfile::INVERT);
+            uint32_t file = batch.file;
+            bool last = batch.last;
+            Manifest::Entry entry = batch.entry;
+            free_batches.push(std::move(batch));
+            if (!last) continue;
+            input.file(file, name); // already known, so this does not wait
+            entry.doc = doc;
+            on_document(file, name, length, entry);
+            laps.skip(); // the callback times itself, e.g. with an IndexProfile::Scope
+            length = 0;
+        }
+    }
+    catch (...) {
+        stop(); // unblock the other stages before they are destroyed
+        throw;
+    }
+    pool.wait();
+    if (sorter) {
+        IndexProfile::Laps laps(profile);
+        sorter->finish(index);
+        laps.lap(IndexProfile::INVERT);
+        stats.sorts = sorter->sorts();
+    }
+
+    for (std::size_t r = 0; r < readers.size(); r++) {
+        stats.read_stall += read_stalls[r];
+        stats.bytes += read_bytes[r];
+    }
+    return stats;
+}
+
+/**
+ * @brief Index a list of files.
+ * @param files The files, a file that cannot be opened is indexed as an empty document.
+ * @param first_id The document ID of the first file, the others follow.
+ * @param on_document Called after each file is added to the index.
+ * @return The statistics of the run.
+ */
+IndexPipeline::Stats IndexPipeline::run(const std::vector<std::string>& files, uint32_t first_id, const DocumentCallback& on_document) {
+    return run([&files](std::size_t i, std::string& file) {
+        if (i >= files.size()) return false;
+        file = files[i];
+        return true;
+    }, first_id, on_document);
+}
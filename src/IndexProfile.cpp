@@ -0,0 +1,187 @@
+#include "IndexProfile.h"
+
+#include <fstream>
+#include <iomanip>
+
+std::atomic<IndexProfile*> IndexProfile::current{ nullptr };
+
+namespace {
+    /**
+     * @brief Get a small ID of the calling thread, for trace events.
+     * @return The ID, 1 for the first thread that asks.
+     */
+    uint32_t thread_id() {
+        static std::atomic<uint32_t> next{ 1 };
+        thread_local uint32_t id = next++;
+        return id;
+    }
+
+    /**
+     * @brief Write a string as a JSON string literal.
+     * @param output The output stream.
+     * @param text The string.
+     */
+    void write_json_string(std::ostream& output, const std::string& text) {
+        output << '"';
+        for (char ch : text) {
+            if (ch == '"' || ch == '\\') output << '\\' << ch;
+            else if (static_cast<unsigned char>(ch) < 0x20) output << ' ';
+            else output << ch;
+        }
+        output << '"';
+    }
+}
+
+/**
+ * @brief Add the accumulated times and counts to the profile.
+ */
+IndexProfile::Laps::~Laps() {
+    if (!profile) return;
+    for (int i = 0; i < PHASES; i++) {
+        if (times[i].count()) profile->add_time(static_cast<Phase>(i), times[i]);
+    }
+    for (int i = 0; i < COUNTERS; i++) {
+        if (counts[i]) profile->add(static_cast<Counter>(i), counts[i]);
+    }
+}
+
+/**
+ * @brief Start timing a coarse phase on the active profile.
+ * @param phase The phase.
+ * @param name The name of the trace event, the name of the phase if empty.
+ */
+IndexProfile::Scope::Scope(Phase phase, const std::string& name) : profile(active()), phase(phase) {
+    if (!profile) return;
+    if (profile->tracing) this->name = name.empty() ? phase_name(phase) : name;
+    start = clock::now();
+}
+
+/**
+ * @brief Add the time of the phase, and record its trace event.
+ */
+IndexProfile::Scope::~Scope() {
+    if (!profile) return;
+    clock::time_point end = clock::now();
+    profile->add_time(phase, end - start);
+    profile->trace_event(name, phase_name(phase), start, end);
+}
+
+/**
+ * @brief Make a profile the active one.
+ * @param profile The profile.
+ */
+IndexProfile::Activation::Activation(IndexProfile& profile) : profile(profile), previous(current.exchange(&profile)), start(clock::now()) {}
+
+/**
+ * @brief Restore the previously active profile and record the active time.
+ */
+IndexProfile::Activation::~Activation() {
+    profile.total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+    current.store(previous);
+}
+
+/**
+ * @brief Construct an empty profile.
+ * @param trace Whether to record trace events.
+ */
+IndexProfile::IndexProfile(bool trace) : tracing(trace), origin(clock::now()) {}
+
+/**
+ * @brief Get the name of a phase.
+ * @param phase The phase.
+ * @return The name, e.g. "stop_filter".
+ */
+const char* IndexProfile::phase_name(Phase phase) {
+    static const char* names[PHASES] = { "walk", "read", "tokenize", "stem", "stop_filter", "invert", "serialize", "merge", "read_stall", "tokenize_stall", "invert_stall" };
+    return names[phase];
+}
+
+/**
+ * @brief Get the name of a counter.
+ * @param counter The counter.
+ * @return The name, e.g. "bytes_read".
+ */
+const char* IndexProfile::counter_name(Counter counter) {
+    static const char* names[COUNTERS] = { "files", "bytes_read", "tokens", "stop_words", "unique_terms", "merges", "bytes_written" };
+    return names[counter];
+}
+
+void IndexProfile::add_time(Phase phase, clock::duration time) {
+    times[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+void IndexProfile::add(Counter counter, uint64_t value) {
+    counters[counter] += value;
+}
+
+void IndexProfile::set(Counter counter, uint64_t value) {
+    counters[counter] = value;
+}
+
+IndexProfile::clock::duration IndexProfile::time(Phase phase) const {
+    return std::chrono::nanoseconds(times[phase].load());
+}
+
+uint64_t IndexProfile::count(Counter counter) const {
+    return counters[counter].load();
+}
+
+/**
+ * @brief Record a trace event, if tracing.
+ * @param name The name of the event.
+ * @param category The category of the event, e.g. the name of a phase.
+ * @param start The start time.
+ * @param end The end time.
+ */
+void IndexProfile::trace_event(const std::string& name, const char* category, clock::time_point start, clock::time_point end) {
+    if (!tracing) return;
+    using std::chrono::microseconds;
+    Event event{ name, category, thread_id(),
+        std::chrono::duration_cast<microseconds>(start - origin).count(),
+        std::chrono::duration_cast<microseconds>(end - start).count() };
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.push_back(std::move(event));
+}
+
+/**
+ * @brief Write the summary of the build as JSON.
+ * @param output The output stream.
+ *
+ * The format is `{"total_ms": t, "phases_ms": {"walk": t, ...}, "counters": {"files": n, ...}}`.
+ * Phase times are summed over threads, so they may add up to more than the total.
+ */
+void IndexProfile::write_summary(std::ostream& output) const {
+    auto ms = [](int64_t ns) { return static_cast<double>(ns) / 1e6; };
+    output << std::fixed << std::setprecision(3);
+    output << "{\n  \"total_ms\": " << ms(total_ns.load()) << ",\n  \"phases_ms\": {";
+    for (int i = 0; i < PHASES; i++) {
+        output << (i ? ", " : "") << "\"" << phase_name(static_cast<Phase>(i)) << "\": " << ms(times[i].load());
+    }
+    output << "},\n  \"counters\": {";
+    for (int i = 0; i < COUNTERS; i++) {
+        output << (i ? ", " : "") << "\"" << counter_name(static_cast<Counter>(i)) << "\": " << counters[i].load();
+    }
+    output << "}\n}" << std::endl;
+    output.unsetf(std::ios::fixed);
+}
+
+/**
+ * @brief Write the trace events in the Chrome trace event format.
+ * @param filename The trace file.
+ * @return false if the file cannot be written.
+ */
+bool IndexProfile::write_trace(const std::filesystem::path& filename) const {
+    std::ofstream output(filename);
+    if (!output) return false;
+    std::lock_guard<std::mutex> lock(events_mutex);
+    output << "{\"traceEvents\": [\n";
+    for (std::size_t i = 0; i < events.size(); i++) {
+        const Event& e = events[i];
+        output << "  {\"name\": ";
+        write_json_string(output, e.name);
+        output << ", \"cat\": \"" << e.category << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+            << ", \"ts\": " << e.start_us << ", \"dur\": " << e.duration_us << "}" << (i + 1 < events.size() ? "," : "") << "\n";
+    }
+    output << "], \"displayTimeUnit\": \"ms\"}\n";
+    return static_cast<bool>(output);
+}
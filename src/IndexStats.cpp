@@ -0,0 +1,241 @@
+#include "IndexStats.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+    /**
+     * @brief Get the bit length of a value.
+     * @param value The value, at least 1.
+     * @return The number of bits up to the highest set bit, e.g. 3 for 5.
+     */
+    unsigned bit_length(uint64_t value) {
+        return 64 - static_cast<unsigned>(__builtin_clzll(value));
+    }
+
+    /**
+     * @brief Get a part of a whole in percent.
+     * @param part The part.
+     * @param whole The whole.
+     * @return The percentage, 0 if the whole is 0.
+     */
+    double percent(uint64_t part, uint64_t whole) {
+        return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    }
+}
+
+/**
+ * @brief Get the name of a codec.
+ * @param codec The codec.
+ * @return The name, e.g. "vbyte".
+ */
+const char* IndexStats::codec_name(Codec codec) {
+    static const char* names[CODECS] = { "raw", "vbyte", "gamma", "bitpack" };
+    return names[codec];
+}
+
+/**
+ * @brief Add the entries of an index file.
+ * @param filename The index file, in the format written by FileIndex::serialize.
+ * @return false if the file cannot be read or is truncated, the entries read so far are kept.
+ *
+ * The file is read once from start to end. The posting lists are read in chunks, so even
+ * the list of a term found in every document does not need to fit in memory.
+ */
+bool IndexStats::add_file(const std::filesystem::path& filename) {
+    std::ifstream input(filename, std::ios::binary);
+    uint32_t size;
+    if (!input.read(reinterpret_cast<char*>(&size), sizeof(size))) return false; // read size header
+    std::error_code ec;
+    file_count++;
+    total_bytes += std::filesystem::file_size(filename, ec);
+
+    std::string word;
+    std::vector<uint32_t> chunk(4096);
+    List list;
+    for (uint32_t i = 0; i < size; i++) {
+        uint32_t word_len, freq, num_doc;
+        if (!input.read(reinterpret_cast<char*>(&word_len), sizeof(word_len))) return false;
+        word.resize(word_len);
+        input.read(&word[0], word_len); // the word itself is not needed, only its length
+        input.read(reinterpret_cast<char*>(&freq), sizeof(freq));
+        if (!input.read(reinterpret_cast<char*>(&num_doc), sizeof(num_doc))) return false;
+
+        list = List();
+        for (uint32_t read = 0; read < num_doc;) {
+            uint32_t count = std::min<uint32_t>(num_doc - read, static_cast<uint32_t>(chunk.size()));
+            if (!input.read(reinterpret_cast<char*>(chunk.data()), count * sizeof(uint32_t))) return false;
+            for (uint32_t j = 0; j < count; j++) add_doc(list, chunk[j]);
+            read += count;
+        }
+        end_list(list);
+
+        term_count++;
+        posting_count += num_doc;
+        occurrence_count += freq;
+        word_bytes += word_len;
+        df_terms[num_doc]++;
+        df_word_bytes[num_doc] += word_len;
+    }
+    return true;
+}
+
+/**
+ * @brief Account for a document ID of a posting list.
+ * @param list The posting list.
+ * @param doc The document ID, larger than the previous one.
+ *
+ * The first gap of a list is the document ID plus one, so every gap is at least 1.
+ */
+void IndexStats::add_doc(List& list, uint32_t doc) {
+    uint64_t next = static_cast<uint64_t>(doc) + 1;
+    uint64_t gap = next > list.last ? next - list.last : 1; // not ascending, count it as the smallest gap
+    list.last = next;
+    unsigned bits = bit_length(gap);
+    gap_bits[bits]++;
+    codec_bytes[RAW] += sizeof(uint32_t);
+    codec_bytes[VBYTE] += (bits + 6) / 7;
+    list.gamma_bits += 2 * bits - 1;
+    list.block[list.block_size++] = gap;
+    if (list.block_size == BLOCK) flush_block(list);
+}
+
+/**
+ * @brief Account for the end of a posting list.
+ * @param list The posting list.
+ */
+void IndexStats::end_list(List& list) {
+    if (list.block_size) flush_block(list);
+    codec_bytes[GAMMA] += (list.gamma_bits + 7) / 8;
+}
+
+/**
+ * @brief Account for a BITPACK block.
+ * @param list The posting list whose block is written.
+ */
+void IndexStats::flush_block(List& list) {
+    uint64_t largest = *std::max_element(list.block.begin(), list.block.begin() + list.block_size);
+    uint64_t bits = static_cast<uint64_t>(bit_length(largest)) * list.block_size;
+    codec_bytes[BITPACK] += 1 + (bits + 7) / 8;
+    list.block_size = 0;
+}
+
+/**
+ * @brief Get a percentile of the document frequencies.
+ * @param percent The percentile, e.g. 99.
+ * @return The document frequency, 0 if there are no terms.
+ */
+uint32_t IndexStats::doc_freq_percentile(double percent) const {
+    if (term_count == 0) return 0;
+    auto rank = static_cast<uint64_t>(std::ceil(percent / 100 * static_cast<double>(term_count)));
+    rank = std::max<uint64_t>(1, std::min(rank, term_count));
+    uint64_t seen = 0;
+    for (auto& [df, terms] : df_terms) {
+        seen += terms;
+        if (seen >= rank) return df;
+    }
+    return df_terms.rbegin()->first;
+}
+
+/**
+ * @brief Get the bytes of the entries of the terms with the longest posting lists.
+ * @param ratio The ratio of terms, e.g. 0.01 for the top 1%.
+ * @return The bytes of their entries in the current format.
+ *
+ * The number of terms is rounded up, so any non-empty index has a top term. When the terms
+ * of a document frequency are only partly in the top, their words are counted at the mean length.
+ */
+uint64_t IndexStats::top_bytes(double ratio) const {
+    auto left = static_cast<uint64_t>(std::ceil(ratio * static_cast<double>(term_count)));
+    uint64_t bytes = 0;
+    for (auto it = df_terms.rbegin(); it != df_terms.rend() && left > 0; ++it) {
+        uint64_t taken = std::min(left, it->second);
+        uint64_t fixed = 3 * sizeof(uint32_t) + static_cast<uint64_t>(it->first) * sizeof(uint32_t); // word_len, freq, num_doc and docs
+        bytes += taken * fixed + df_word_bytes.at(it->first) * taken / it->second;
+        left -= taken;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Get the entropy of the document ID gaps.
+ * @return The bits per gap, assuming gaps of the same bit length are equally likely.
+ *
+ * This is the entropy of the bit length of the gaps, plus the bits below the highest set bit.
+ * It estimates the size of the gaps under an ideal entropy coder of their bit lengths.
+ */
+double IndexStats::gap_entropy() const {
+    if (posting_count == 0) return 0;
+    double entropy = 0;
+    for (unsigned bits = 1; bits < gap_bits.size(); bits++) {
+        if (gap_bits[bits] == 0) continue;
+        double p = static_cast<double>(gap_bits[bits]) / static_cast<double>(posting_count);
+        entropy += p * (static_cast<double>(bits - 1) - std::log2(p));
+    }
+    return entropy;
+}
+
+/**
+ * @brief Get the projected size of the index files under a codec.
+ * @param codec The codec of the posting lists.
+ * @return The bytes, the words and the other fields of the entries staying as they are.
+ */
+uint64_t IndexStats::projected_size(Codec codec) const {
+    uint64_t fixed = file_count * sizeof(uint32_t) + term_count * 3 * sizeof(uint32_t) + word_bytes;
+    return fixed + codec_bytes[codec];
+}
+
+/**
+ * @brief Print the statistics.
+ * @param output The output stream to print to.
+ */
+void IndexStats::print(std::ostream& output) const {
+    std::ios::fmtflags flags = output.flags();
+    std::streamsize precision = output.precision();
+    output << std::fixed << std::setprecision(1);
+    output << "Index files: " << file_count << ", " << total_bytes << " bytes" << std::endl;
+    output << "Vocabulary: " << term_count << " terms, " << posting_count << " postings, " << occurrence_count << " occurrences" << std::endl;
+    if (term_count == 0) {
+        output.flags(flags);
+        output.precision(precision);
+        return;
+    }
+
+    uint64_t once = df_terms.count(1) ? df_terms.at(1) : 0;
+    output << "Document frequency: mean " << static_cast<double>(posting_count) / static_cast<double>(term_count)
+        << ", median " << doc_freq_percentile(50) << ", p90 " << doc_freq_percentile(90) << ", p99 " << doc_freq_percentile(99)
+        << ", max " << df_terms.rbegin()->first << ", " << once << " terms (" << percent(once, term_count) << "%) in a single document" << std::endl;
+
+    // posting list lengths in power of two ranges
+    output << "Posting list lengths:" << std::endl;
+    auto it = df_terms.begin();
+    for (uint64_t low = 1; it != df_terms.end(); low *= 2) {
+        uint64_t terms = 0, postings = 0;
+        for (; it != df_terms.end() && it->first < 2 * low; ++it) {
+            terms += it->second;
+            postings += it->second * it->first;
+        }
+        if (terms == 0) continue;
+        std::string range = low == 1 ? "1" : std::to_string(low) + "-" + std::to_string(2 * low - 1);
+        output << "  " << std::left << std::setw(12) << range << std::right << std::setw(12) << terms << " terms (" << std::setw(5) << percent(terms, term_count)
+            << "%)" << std::setw(14) << postings << " postings (" << std::setw(5) << percent(postings, posting_count) << "%)" << std::endl;
+    }
+
+    uint64_t top = top_bytes(0.01);
+    output << "Top 1% of terms by posting list length: " << top << " bytes (" << percent(top, total_bytes) << "% of the index)" << std::endl;
+    output << "Document ID gaps: entropy " << std::setprecision(2) << gap_entropy() << " bits per gap" << std::setprecision(1) << std::endl;
+
+    output << "Projected size by posting codec:" << std::endl;
+    for (int i = 0; i < CODECS; i++) {
+        Codec codec = static_cast<Codec>(i);
+        double bits = posting_count ? 8.0 * static_cast<double>(codec_bytes[codec]) / static_cast<double>(posting_count) : 0.0;
+        output << "  " << std::left << std::setw(8) << codec_name(codec) << std::right << std::setw(14) << projected_size(codec) << " bytes ("
+            << std::setw(5) << percent(projected_size(codec), projected_size(RAW)) << "%), " << std::setprecision(2) << bits << " bits per posting" << std::setprecision(1) << std::endl;
+    }
+    output.flags(flags);
+    output.precision(precision);
+}
@@ -0,0 +1,161 @@
+#include "LevenshteinAutomaton.h"
+
+#include <algorithm>
+
+/**
+ * @brief Construct an automaton for a word.
+ * @param word The word to match against.
+ * @param max_edits The maximum edit distance accepted, usually 1 or 2.
+ */
+LevenshteinAutomaton::LevenshteinAutomaton(const std::string& word, uint32_t max_edits)
+    : word(word), max_edits(max_edits) {}
+
+/**
+ * @brief Get the start state, which corresponds to the empty prefix.
+ * @return The start state.
+ *
+ * Reaching the i-th character of the word from the empty string costs i deletions.
+ */
+LevenshteinAutomaton::State LevenshteinAutomaton::start() const {
+    State state(word.size() + 1);
+    for (std::size_t i = 0; i < state.size(); i++) {
+        state[i] = std::min<uint32_t>(static_cast<uint32_t>(i), max_edits + 1); // cap the distance
+    }
+    return state;
+}
+
+/**
+ * @brief Feed a character to the automaton.
+ * @param state The current state.
+ * @param ch The character to feed.
+ * @return The next state.
+ *
+ * This computes the next row of the edit distance table. Values are capped at max_edits + 1
+ * so that the number of distinct states stays finite.
+ */
+LevenshteinAutomaton::State LevenshteinAutomaton::step(const State& state, char ch) const {
+    State next(state.size());
+    next[0] = std::min(state[0] + 1, max_edits + 1); // insert ch
+    for (std::size_t i = 1; i < state.size(); i++) {
+        uint32_t cost = (word[i - 1] == ch) ? 0 : 1;
+        uint32_t value = std::min({
+            next[i - 1] + 1,        // delete word[i - 1]
+            state[i] + 1,           // insert ch
+            state[i - 1] + cost     // substitute or match
+        });
+        next[i] = std::min(value, max_edits + 1); // cap the distance
+    }
+    return next;
+}
+
+/**
+ * @brief Check if the string read so far is accepted.
+ * @param state The current state.
+ * @return true if the edit distance is within max_edits.
+ */
+bool LevenshteinAutomaton::is_match(const State& state) const {
+    return state.back() <= max_edits;
+}
+
+/**
+ * @brief Check if any continuation of the string read so far can be accepted.
+ * @param state The current state.
+ * @return false if the state is dead.
+ *
+ * Values in a row never decrease along a path, so if every value already exceeds
+ * max_edits, no suffix can be accepted.
+ */
+bool LevenshteinAutomaton::can_match(const State& state) const {
+    return *std::min_element(state.begin(), state.end()) <= max_edits;
+}
+
+/**
+ * @brief Get the edit distance between the word and the string read so far.
+ * @param state The current state.
+ * @return The edit distance, or max_edits + 1 if it exceeds max_edits.
+ */
+uint32_t LevenshteinAutomaton::distance(const State& state) const {
+    return state.back();
+}
+
+/**
+ * @brief Intersect the automaton with a sorted lexicon.
+ * @param terms The lexicon, must be sorted in ascending order.
+ * @return The (index in terms, edit distance) pairs of all accepted terms, in lexicon order.
+ *
+ * The lexicon is walked like a trie: the states of the common prefix with the previous term
+ * are reused, and when a prefix becomes dead all terms starting with it are skipped
+ * with a binary search.
+ */
+std::vector<std::pair<std::size_t, uint32_t>> LevenshteinAutomaton::intersect(const std::vector<std::string>& terms) const {
+    std::vector<std::pair<std::size_t, uint32_t>> result;
+    std::vector<State> states = { start() }; // states[k] is the state after reading prefix[0..k)
+    std::string prefix;
+
+    std::size_t i = 0;
+    while (i < terms.size()) {
+        const std::string& term = terms[i];
+
+        // reuse the states of the common prefix with the previous term
+        std::size_t common = 0;
+        while (common < prefix.size() && common < term.size() && prefix[common] == term[common]) {
+            common++;
+        }
+        prefix.resize(common);
+        states.resize(common + 1);
+
+        bool dead = false;
+        while (prefix.size() < term.size()) {
+            char ch = term[prefix.size()];
+            states.push_back(step(states.back(), ch));
+            prefix.push_back(ch);
+            if (!can_match(states.back())) { // no term with this prefix can be accepted
+                dead = true;
+                break;
+            }
+        }
+
+        if (!dead) {
+            if (is_match(states.back())) {
+                result.push_back({ i, distance(states.back()) });
+            }
+            i++;
+            continue;
+        }
+
+        // skip every term starting with the dead prefix, the bound is the smallest string after them
+        std::string bound = prefix;
+        while (!bound.empty() && static_cast<unsigned char>(bound.back()) == 0xFF) {
+            bound.pop_back();
+        }
+        if (bound.empty()) break; // the dead prefix covers the rest of the lexicon
+        bound.back()++;
+        i = std::lower_bound(terms.begin() + i + 1, terms.end(), bound) - terms.begin();
+    }
+    return result;
+}
+
+/**
+ * @brief Compute the edit distance between two strings directly.
+ * @param a The first string.
+ * @param b The second string.
+ * @return The Levenshtein distance between a and b.
+ *
+ * This is the brute force reference used by tests and benchmarks.
+ */
+uint32_t edit_distance(const std::string& a, const std::string& b) {
+    std::vector<uint32_t> row(b.size() + 1);
+    for (std::size_t j = 0; j <= b.size(); j++) {
+        row[j] = static_cast<uint32_t>(j);
+    }
+    for (std::size_t i = 1; i <= a.size(); i++) {
+        uint32_t diag = row[0]; // value of row[j - 1] in the previous row
+        row[0] = static_cast<uint32_t>(i);
+        for (std::size_t j = 1; j <= b.size(); j++) {
+            uint32_t up = row[j];
+            row[j] = std::min({ row[j - 1] + 1, up + 1, diag + (a[i - 1] == b[j - 1] ? 0u : 1u) });
+            diag = up;
+        }
+    }
+    return row[b.size()];
+}
@@ -0,0 +1,105 @@
+#include "Manifest.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Record the current state of a file.
+ * @param path The file.
+ * @param doc The document ID of the file.
+ * @return The entry of the file.
+ */
+Manifest::Entry Manifest::stat_file(const std::filesystem::path& path, uint32_t doc) {
+    Entry entry;
+    entry.doc = doc;
+    entry.size = fs::file_size(path);
+    entry.mtime = static_cast<int64_t>(fs::last_write_time(path).time_since_epoch().count());
+    entry.hash = hash_file(path);
+    return entry;
+}
+
+/**
+ * @brief Record the size and modification time of a file, before it is read.
+ * @param path The file.
+ * @param doc The document ID of the file.
+ * @return The entry of the file, with the hash of no bytes; size and mtime are 0 if the file cannot be stat'ed.
+ */
+Manifest::Entry Manifest::stat_only(const std::filesystem::path& path, uint32_t doc) {
+    Entry entry;
+    entry.doc = doc;
+    entry.hash = HASH_BASIS;
+    std::error_code error;
+    uint64_t size = fs::file_size(path, error);
+    if (error) return entry;
+    fs::file_time_type mtime = fs::last_write_time(path, error);
+    if (error) return entry;
+    entry.size = size;
+    entry.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    return entry;
+}
+
+/**
+ * @brief Add bytes to a hash.
+ * @param hash The hash of the bytes before, HASH_BASIS at the start of a file.
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @return The 64-bit FNV-1a hash of the bytes before followed by these ones.
+ */
+uint64_t Manifest::hash_bytes(uint64_t hash, const char* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL; // FNV prime
+    }
+    return hash;
+}
+
+/**
+ * @brief Hash the content of a file.
+ * @param path The file.
+ * @return The 64-bit FNV-1a hash of the content.
+ */
+uint64_t Manifest::hash_file(const std::filesystem::path& path) {
+    uint64_t hash = HASH_BASIS;
+    std::ifstream input(path, std::ios::binary);
+    char buffer[1 << 16];
+    while (input.read(buffer, sizeof(buffer)) || input.gcount() > 0) {
+        hash = hash_bytes(hash, buffer, static_cast<std::size_t>(input.gcount()));
+    }
+    return hash;
+}
+
+/**
+ * @brief Read a manifest file.
+ * @param filename The manifest file.
+ * @return The manifest, empty if the file does not exist.
+ */
+Manifest Manifest::read(const std::filesystem::path& filename) {
+    Manifest manifest;
+    std::ifstream input(filename);
+    std::string line;
+    while (std::getline(input, line)) {
+        std::istringstream ss(line);
+        Entry entry;
+        std::string path;
+        if (!(ss >> entry.doc >> entry.size >> entry.mtime >> entry.hash)) continue; // skip malformed lines
+        ss.get(); // the space before the path
+        std::getline(ss, path);
+        manifest.files[path] = entry;
+    }
+    return manifest;
+}
+
+/**
+ * @brief Save the manifest to a file.
+ * @param filename The manifest file.
+ *
+ * The format is one line per file: `doc size mtime hash path`, with the path last so it may contain spaces.
+ */
+void Manifest::save(const std::filesystem::path& filename) const {
+    std::ofstream output(filename);
+    for (const auto& [path, entry] : files) {
+        output << entry.doc << " " << entry.size << " " << entry.mtime << " " << entry.hash << " " << path << "\n";
+    }
+}
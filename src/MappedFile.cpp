@@ -0,0 +1,66 @@
+#include "MappedFile.h"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Map a file.
+ * @param filename The file to map.
+ *
+ * If the file cannot be opened or mapped, the mapping is empty.
+ */
+MappedFile::MappedFile(const std::filesystem::path& filename) {
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            bytes = static_cast<const char*>(addr);
+            length = static_cast<std::size_t>(st.st_size);
+        }
+    }
+    close(fd); // the mapping keeps the file alive
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+/**
+ * @brief Check which pages of a range are in the page cache, without touching them.
+ * @param offset The offset of the range.
+ * @param count The number of bytes of the range.
+ * @return The number of resident pages and the number of pages of the range.
+ */
+std::pair<std::size_t, std::size_t> MappedFile::residency(std::size_t offset, std::size_t count) const {
+    if (!bytes || offset >= length || count == 0) return { 0, 0 };
+    count = std::min(count, length - offset);
+    static const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t first = offset / page_size, last = (offset + count - 1) / page_size;
+    std::vector<unsigned char> pages(last - first + 1);
+    if (mincore(const_cast<char*>(bytes) + first * page_size, pages.size() * page_size, pages.data()) != 0) {
+        return { 0, pages.size() };
+    }
+    std::size_t resident = 0;
+    for (unsigned char page : pages) resident += page & 1;
+    return { resident, pages.size() };
+}
@@ -0,0 +1,29 @@
+#include "MemoryUsage.h"
+
+#include <iomanip>
+
+/**
+ * @brief Get the heap bytes of all components.
+ * @return The sum of the components.
+ */
+uint64_t MemoryUsage::total() const {
+    uint64_t bytes = 0;
+    for (auto& component : components) bytes += component.second;
+    return bytes;
+}
+
+/**
+ * @brief Print the usage of every component, the total and the mapped index files.
+ * @param output The output stream to print to.
+ *
+ * The format is one `name: bytes` line per component, e.g. `  lexicon: 1048576 bytes`.
+ */
+void MemoryUsage::print(std::ostream& output) const {
+    output << "Memory:" << std::endl;
+    for (auto& [name, bytes] : components) {
+        output << "  " << std::left << std::setw(20) << name + ":" << std::right << std::setw(12) << bytes << " bytes" << std::endl;
+    }
+    output << "  " << std::left << std::setw(20) << "total:" << std::right << std::setw(12) << total() << " bytes" << std::endl;
+    output << "  " << std::left << std::setw(20) << "mapped index:" << std::right << std::setw(12) << mapped << " bytes, "
+        << resident << " in the page cache" << std::endl;
+}
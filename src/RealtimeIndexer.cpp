@@ -0,0 +1,188 @@
+#include "RealtimeIndexer.h"
+
+#include <iostream>
+#include <cstring>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "utils.h"
+
+/**
+ * @brief Create an indexer for an engine, the thread is started by start().
+ * @param engine The engine to publish deltas to, it must outlive the indexer.
+ * @param options The options of the indexer.
+ */
+RealtimeIndexer::RealtimeIndexer(HotSwapEngine& engine, const Options& options)
+    : hot(engine), options(options), dir(std::filesystem::absolute(engine.target())) {}
+
+/**
+ * @brief Stop the thread and flush the delta, if it changes anything.
+ */
+RealtimeIndexer::~RealtimeIndexer() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+    if (inotify_fd >= 0) close(inotify_fd);
+}
+
+/**
+ * @brief Start watching the target directory.
+ * @return false if inotify is not available, the reason is printed to stderr.
+ *
+ * The watches are added before start() returns, so any change made after it is seen.
+ */
+bool RealtimeIndexer::start() {
+    if (worker.joinable()) return true; // already started
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        std::cerr << "Error: inotify_init1: " << strerror(errno) << std::endl;
+        return false;
+    }
+    delta = std::make_shared<DeltaIndex>(hot.acquire());
+    add_watches(".");
+    changes.clear(); // the files already there are in the index
+    worker = std::thread(&RealtimeIndexer::run, this);
+    return true;
+}
+
+/**
+ * @brief The main loop of the thread.
+ *
+ * The thread wakes up at least every 100 ms to notice stop requests and new generations.
+ */
+void RealtimeIndexer::run() {
+    while (!stopping) {
+        pollfd pfd{ inotify_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) > 0) read_events();
+
+        auto now = std::chrono::steady_clock::now();
+        if (!changes.empty() && now - last_event >= options.debounce) apply();
+        if (hot.acquire() != delta->engine()) rebase(); // another process published a generation
+    }
+    if (!changes.empty()) apply();
+    if (!delta->empty()) flush(); // keep the buffered changes, the manifest does not know them yet
+}
+
+/**
+ * @brief Watch a directory and its subdirectories, queueing their files.
+ * @param name The directory name relative to the target directory, e.g. `./sub`.
+ *
+ * Files created in a new directory before its watch was added would be missed, so all
+ * files found while adding the watches are queued.
+ */
+void RealtimeIndexer::add_watches(const std::string& name) {
+    std::filesystem::path path = dir / name;
+    std::string filename = path.filename().string(), suffix = BASE_DIR;
+    if (filename.size() >= suffix.size() && filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return; // the index itself, or the index of an archive
+    }
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_DELETE_SELF;
+    int wd = inotify_add_watch(inotify_fd, path.c_str(), mask | IN_ONLYDIR);
+    if (wd < 0) return; // e.g. removed meanwhile
+    watches[wd] = name;
+    std::error_code ec;
+    for (auto& entry : std::filesystem::directory_iterator(path, ec)) {
+        std::string child = name + "/" + entry.path().filename().string();
+        if (entry.is_directory(ec)) add_watches(child);
+        else if (entry.path().extension() == ".html") changes.insert(child);
+    }
+}
+
+/**
+ * @brief Read the pending inotify events into changes.
+ */
+void RealtimeIndexer::read_events() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t n = read(inotify_fd, buffer, sizeof(buffer));
+        if (n <= 0) break; // EAGAIN: no more events
+        last_event = std::chrono::steady_clock::now();
+        for (char* p = buffer; p < buffer + n; ) {
+            inotify_event* event = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) { // events were lost, look at every file again
+                for (auto& file : get_files(dir)) {
+                    changes.insert("." + file.substr(dir.string().size()));
+                }
+                continue;
+            }
+            auto it = watches.find(event->wd);
+            if (it == watches.end()) continue;
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                watches.erase(it);
+                continue;
+            }
+            if (event->len == 0) continue;
+            std::string name = it->second + "/" + event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) add_watches(name);
+            }
+            else if (std::filesystem::path(name).extension() == ".html") {
+                changes.insert(name);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Index the queued changes into a new delta and publish it.
+ *
+ * The current delta may be in use by queries, so the changes go into a copy.
+ */
+void RealtimeIndexer::apply() {
+    auto next = std::make_shared<DeltaIndex>(*delta);
+    for (auto& name : changes) {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(dir / name, ec)) {
+            next->add_file(name, dir / name, next->engine()->stop_words());
+        }
+        else {
+            next->remove_file(name);
+        }
+    }
+    changes.clear();
+    delta = next;
+    hot.publish_delta(delta);
+    if (delta->engine()->index_path() != budget_generation) { // walking the engine is slow, do it once per generation
+        budget_generation = delta->engine()->index_path();
+        budget = delta->engine()->memory_budget();
+    }
+    if (delta->buffered_bytes() >= options.flush_bytes || delta->memory_usage() >= budget) flush();
+}
+
+/**
+ * @brief Write the delta to disk as a segment and start an empty one.
+ *
+ * Queries keep using the full delta until the engine loaded from the new generation and an
+ * empty delta on top of it are published.
+ */
+void RealtimeIndexer::flush() {
+    try {
+        if (!SearchEngine::flush_delta(dir, *delta)) {
+            rebase(); // another generation was published first
+            return;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Flush failed: " << e.what() << std::endl;
+        return; // keep buffering, retried at the next batch
+    }
+    hot.reload();
+    delta = std::make_shared<DeltaIndex>(hot.acquire());
+    hot.publish_delta(delta);
+}
+
+/**
+ * @brief Rebuild the delta on top of the current engine.
+ *
+ * The files the delta changed are read again, so the new delta holds their current version.
+ */
+void RealtimeIndexer::rebase() {
+    hot.reload(); // make sure the engine is the published generation
+    auto next = std::make_shared<DeltaIndex>(hot.acquire());
+    for (auto& name : delta->changed()) changes.insert(name);
+    delta = next;
+    if (!changes.empty()) apply();
+    else hot.publish_delta(delta);
+}
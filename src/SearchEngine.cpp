@@ -1,227 +1,1416 @@
-#include "SearchEngine.h"
-
-#include <fstream>
-#include <iostream>
-#include <filesystem>
-#include <sstream>
-#include <algorithm>
-#include <cstdint>
-
-#include "FileIndex.h"
-#include "utils.h"
-
-namespace fs = std::filesystem;
-
-/**
- * @brief Construct a new Search Engine:: Search Engine object
- * @param dir The target directory to search in.
- *
- * This directory should contain a index folder built using SearchEngine::gen_index(_large).
- * The index folder's name is specified by macro BASE_DIR in utils.h.
- */
-SearchEngine::SearchEngine(const std::filesystem::path& dir) {
-    this->dir = dir;
-    std::string line;
-    std::ifstream list_fs(dir / BASE_DIR / LIST_FILE_NAME); // this file contains a list of indexed files
-    while (std::getline(list_fs, line)) {
-        if (line.empty()) continue;
-        file_list.push_back(line);
-    }
-    list_fs.close();
-
-    if (fs::exists(dir / BASE_DIR / STOP_FILE_NAME)) {
-        this->stop_filter = new StopFilter(dir / BASE_DIR / STOP_FILE_NAME); // load stop words list from file
-    }
-    else {
-        this->stop_filter = nullptr; // fix bug on 9.29, if not initialized to nullptr, it will crash
-    }
-
-    uint32_t size;
-    std::ifstream input(dir / BASE_DIR / INDEX_FILE_NAME, std::ios::binary);
-    input.read(reinterpret_cast<char*>(&size), sizeof(size)); // read the number of indexed words
-    for (uint32_t i = 0; i < size; i++) {
-        std::string word;
-        FileIndex::Entry entry;
-        std::streampos entry_pos = input.tellg(); // record the offset of the entry in the index file
-        FileIndex::read_entry(input, word, entry);
-        words.insert({ word, static_cast<Offset>(entry_pos) }); // insert the word and its offset into the map
-    }
-    input.close();
-}
-
-/**
- * @brief Generate an index for the target directory.
- * @param dir The target directory to index.
- * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
- * @param quiet If true, do not print any output to stdout.
- */
-void SearchEngine::gen_index(const std::filesystem::path& dir, StopFilter* stop_filter, bool quiet) {
-    fs::path prev = fs::current_path(); // store the current working directory
-    fs::current_path(dir); // change to the target directory
-    fs::create_directory(BASE_DIR); // make sure the index folder exists
-    fs::path base(BASE_DIR);
-    std::vector<std::string> files = get_files("."); // get all files in the directory
-    std::ofstream list_fs(base / LIST_FILE_NAME);
-    for (auto& file : files) {
-        list_fs << file << std::endl;
-    }
-    list_fs.close();
-
-    if (stop_filter) {
-        std::ofstream stop_fs(base / STOP_FILE_NAME);
-        stop_filter->print(stop_fs); // print stop words list to file
-        stop_fs.close();
-    }
-
-    FileIndex index;
-    for (uint32_t i = 0; i < files.size(); i++) {
-        if (!quiet) std::cout << "Indexing " << fs::canonical(files[i]) << std::endl;
-        // canonical() returns the absolute path of the file. For prettier printing.
-        index.add_file(files[i], i, stop_filter);
-    }
-    index.save(base / INDEX_FILE_NAME); // save the index to file
-    fs::current_path(prev); // return to the original directory
-}
-
-/**
- * @brief BNUNS: Generate an index for the target directory, but do most operations on dick to prevent running out of memory.
- * @param dir The target directory to index.
- * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
- * @param quiet If true, do not print any output to stdout.
- */
-void SearchEngine::gen_index_large(const std::filesystem::path& dir, StopFilter* stop_filter, bool quiet) {
-    fs::path prev = fs::current_path(); // store the current working directory
-    fs::current_path(dir); // change to the target directory
-    fs::create_directory(BASE_DIR); // make sure the index folder exists
-    fs::path base(BASE_DIR);
-    std::vector<std::string> files = get_files("."); // get all files in the directory
-    std::ofstream list_fs(base / LIST_FILE_NAME); // write file list to file
-    for (auto& file : files) {
-        list_fs << file << std::endl;
-    }
-    list_fs.close();
-
-    FileIndex index;
-    for (uint32_t i = 0; i < files.size(); i++) {
-        if (!quiet) std::cout << "Indexing " << fs::canonical(files[i]) << std::endl;
-        // canonical() returns the absolute path of the file. For prettier printing.
-        index.add_file(files[i], i, stop_filter); // add file to index
-        std::string name;
-        name = std::string("index_part_") + std::to_string(i) + std::string("to") + std::to_string(i) + ".tmp"; // generate file name
-        // e.g. index_part_3to3.tmp
-        index.save(base / name);
-        index.clear();
-    }
-    merge_index(dir, 0, files.size() - 1, quiet); // merge all the .tmp files *on disk*
-    std::string name = std::string("index_part_") + std::to_string(0) + std::string("to") + std::to_string(files.size() - 1) + std::string(".tmp"); // generate file name
-    std::filesystem::rename(base / name, base / INDEX_FILE_NAME); // rename the merged file to index
-    fs::current_path(prev); // return to the original directory
-}
-
-/**
- * @brief Merge the index files generated by gen_index_large.
- * @param dir The target directory to index.
- * @param l The left index of the range to merge.
- * @param r The right index of the range to merge.
- * @param quiet If true, do not print any output to stdout.
- *
- * Merge a series of index file to one. The algorithm is similar to merge sort.
- * It uses recursion to split the range into two halves and merge them.
- */
-void SearchEngine::merge_index(const std::filesystem::path& dir, std::size_t l, std::size_t r, bool quiet) {
-    if (l == r) return;
-    std::size_t m = (l + r) / 2; // find the middle index
-    merge_index(dir, l, m, quiet); // merge the left half
-    merge_index(dir, m + 1, r, quiet); // merge the right half
-    std::string name1 = std::string("index_part_") + std::to_string(l) + std::string("to") + std::to_string(m) + std::string(".tmp");
-    std::string name2 = std::string("index_part_") + std::to_string(m + 1) + std::string("to") + std::to_string(r) + std::string(".tmp");
-    std::string name3 = std::string("index_part_") + std::to_string(l) + std::string("to") + std::to_string(r) + std::string(".tmp");
-    fs::path base(BASE_DIR);
-    FileIndex::merge_files(base / name1, base / name2, base / name3); // do the actual merge
-    if (!quiet) std::cout << "Merging " << name1 << " and " << name2 << " into " << name3 << std::endl; // print the merge operation
-    std::filesystem::remove(base / name1); // remove the temporary files
-    std::filesystem::remove(base / name2); // remove the temporary files
-}
-
-/**
- * @brief Search for a word in the index.
- * @param word The word to search for.
- * @param output The output stream to write the result to.
- * @param threshold The threshold for the search result.
- *
- * Threshold is a ratio from 0.0 to 1.0. It represents the percentage of terms that should be used in searching. Default value is 1.0
- * For example, if threshold is 0.8, only the top 80% less frequent terms will be used in searching.
- */
-void SearchEngine::search(const std::string& query, std::ostream& output, double threshold) const {
-    std::stringstream ss(query);
-    std::vector<std::string> words;
-    std::string token;
-
-    while (ss) {
-        token = tokenize(ss); // tokenize the query
-        if (token.empty()) continue; // ignore empty tokens
-        token = stem_word(token); // stem the word
-        if (stop_filter && stop_filter->is_stop(token)) { // if stop word filter is enabled, ignore stop words
-            output << "Stop word \"" << token << "\" is ignored." << std::endl;
-            continue;
-        }
-        words.push_back(token);
-    }
-    std::vector<std::pair<std::string, FileIndex::Entry>> entries;
-
-    // search each word separetely and then intersect the results
-    for (auto& word : words) {
-        FileIndex::Entry entry = search_word(word, output); //  search the word
-        entries.push_back({ word, entry });
-    }
-    std::sort(entries.begin(), entries.end(), [](
-        const std::pair<std::string, FileIndex::Entry>& e1,
-        const std::pair<std::string, FileIndex::Entry>& e2
-        ) {
-            return e1.second.freq < e2.second.freq;
-        }); // sort by frequency, *ascending*. It is for the querry thresholding pollicy
-    std::vector<uint32_t> res;
-    bool first = true; // true if it is processing the first set of results.
-    for (std::size_t i = 0; i < entries.size(); i++) {
-        auto& entry = entries[i];
-        if (i > entries.size() * threshold) { // if the threshold is reached, ignore the rest of the words
-            output << "\"" << entry.first << "\" is ignored due to threshold." << std::endl;
-        }
-        else {
-            if (first) { // if it is the first set of results, just assign it to the result
-                res = entry.second.docs;
-                first = false; // set the flag to false
-            }
-            else {
-                res = intersect(res, entry.second.docs); // intersect the results
-            }
-        }
-    }
-    if (res.empty()) { // if the result is empty, print "No results found."
-        output << "No results found." << std::endl;
-    }
-    else for (auto& doc : res) {
-        output << file_list[doc] << std::endl; // print the result
-    }
-}
-
-/**
- * @brief Search for a word in the index.
- * @param word The word to search for.
- * @param output The output stream to write the result to.
- * @return The entry of the word in the index. Retrived from the file.
- */
-FileIndex::Entry SearchEngine::search_word(const std::string& word, std::ostream& output) const {
-    auto it = words.find(word); // find the word in the index
-    if (it == words.end()) return FileIndex::Entry(); // if the word is not found, return an empty entry
-    Offset offset = it->second; // get the offset of the word in the index
-
-    std::ifstream index(dir / BASE_DIR / INDEX_FILE_NAME, std::ios::binary);
-    index.seekg(offset); // seek to the offset of the word in the index
-    FileIndex::Entry entry; // create an entry to store the result
-    std::string index_word; // create a string to store the word in the index
-    FileIndex::read_entry(index, index_word, entry); // read the entry from the index
-    index.close();
-
-    return entry;
-}
\ No newline at end of file
+#include "SearchEngine.h"
+
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
+#include <cstring>
+#include <tuple>
+#include <atomic>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "ArchiveReader.h"
+#include "DeltaIndex.h"
+#include "DirWalker.h"
+#include "FileIndex.h"
+#include "IndexProfile.h"
+#include "LevenshteinAutomaton.h"
+#include "Manifest.h"
+#include "TermDictionary.h"
+#include "ThreadPool.h"
+#include "Throttle.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr unsigned UPDATE_ATTEMPTS = 5; ///< The number of times update_index tries to publish before giving up.
+
+    /**
+     * @brief Flush a file or a directory to disk.
+     * @param path The file, or the directory whose entries (names, renames) are flushed.
+     */
+    void sync_path(const fs::path& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        fsync(fd);
+        close(fd);
+    }
+
+    /**
+     * @brief Record the number of terms of a finished index in the active profile, if any.
+     * @param filename The index file.
+     */
+    void profile_terms(const fs::path& filename) {
+        IndexProfile* profile = IndexProfile::active();
+        if (!profile) return;
+        uint32_t size = 0;
+        std::ifstream input(filename, std::ios::binary);
+        input.read(reinterpret_cast<char*>(&size), sizeof(size)); // the header is the number of entries
+        profile->set(IndexProfile::UNIQUE_TERMS, size);
+    }
+
+    /**
+     * @brief Get the time elapsed since a mark, and move the mark to now.
+     * @param mark The mark.
+     * @return The elapsed time in milliseconds.
+     */
+    double lap_ms(std::chrono::steady_clock::time_point& mark) {
+        auto now = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - mark).count();
+        mark = now;
+        return ms;
+    }
+
+    /**
+     * @brief Index the documents of a build: the .html files of the current directory, or an archive.
+     * @param archive The archive, empty to walk the current directory.
+     * @param index The index.
+     * @param stop_filter The stop filter, nullptr if none.
+     * @param pipeline The options of the indexing pipeline.
+     * @param walk The options of the directory walk.
+     * @param on_document Called after each document is added to the index.
+     * @param names The names of the documents, in document ID order.
+     * @return false if the archive cannot be read to its end, the error is printed.
+     */
+    bool index_documents(const fs::path& archive, FileIndex& index, StopFilter* stop_filter, const IndexPipeline::Options& pipeline,
+        const DirWalker::Options& walk, const IndexPipeline::DocumentCallback& on_document, std::vector<std::string>& names) {
+        auto record = [&](uint32_t i, const std::string& name, uint32_t length, const Manifest::Entry& entry) {
+            names.push_back(name);
+            on_document(i, name, length, entry);
+        };
+        IndexPipeline indexer(index, stop_filter, pipeline);
+        if (!archive.empty()) {
+            ArchiveReader reader(archive);
+            indexer.run(reader, 0, record);
+            if (reader.error().empty()) return true;
+            std::cerr << "Error: " << reader.error() << std::endl;
+            return false;
+        }
+        DirWalker walker(".", ".html", walk); // files are indexed while the walk goes on
+        indexer.run([&walker](std::size_t i, std::string& file) { return walker.get(i, file); }, 0, record);
+        return true;
+    }
+
+    /**
+     * @brief Change to the directory of a build target.
+     * @param target The target directory, or an archive, whose index folder is in its directory.
+     * @return The file name of the archive, empty if the target is a directory.
+     */
+    fs::path enter_target(const fs::path& target) {
+        if (!fs::is_regular_file(target)) {
+            fs::current_path(target);
+            return fs::path();
+        }
+        fs::current_path(fs::absolute(target).parent_path());
+        return target.filename();
+    }
+}
+
+/**
+ * @brief Construct a new Search Engine:: Search Engine object
+ * @param dir The target directory to search in.
+ *
+ * This directory should contain a index folder built using SearchEngine::gen_index(_large).
+ * The index folder's name is specified by macro BASE_DIR in utils.h.
+ * The engine loads the generation published when it is constructed and keeps it mapped,
+ * so it is not affected by later rebuilds.
+ */
+SearchEngine::SearchEngine(const std::filesystem::path& dir) {
+    this->dir = dir;
+    this->generation_dir = index_dir(dir); // resolve the published generation once
+
+    for (auto& [name, doc_base] : read_segments(generation_dir)) {
+        // the deletion bitmaps of the segments belong to the generation
+        segments.push_back(std::make_unique<Segment>(index_folder(dir) / name, doc_base, generation_dir / (name + DELETIONS_SUFFIX)));
+    }
+
+    for (auto& segment : segments) {
+        documents = std::max(documents, segment->doc_base() + segment->size()); // paths stay in the mapped tables
+    }
+
+    if (fs::exists(generation_dir / STOP_FILE_NAME)) {
+        this->stop_filter = new StopFilter(generation_dir / STOP_FILE_NAME); // load stop words list from file
+    }
+    else {
+        this->stop_filter = nullptr; // fix bug on 9.29, if not initialized to nullptr, it will crash
+    }
+}
+
+/**
+ * @brief Merge the word lists of all segments into the lexicon, on the first call only.
+ *
+ * Only fuzzy matching needs the lexicon, so exact queries never pay for reading every term
+ * of every segment. Safe to call from concurrent queries.
+ */
+void SearchEngine::load_lexicon() const {
+    std::call_once(lexicon_once, [this] {
+        // merge the sorted word lists of all segments into one lexicon, summing document frequencies
+        for (auto& segment : segments) {
+            std::vector<std::pair<std::string, uint32_t>> terms = segment->terms();
+            std::vector<std::string> merged_lexicon;
+            std::vector<uint32_t> merged_freqs;
+            merged_lexicon.reserve(lexicon.size() + terms.size());
+            merged_freqs.reserve(lexicon.size() + terms.size());
+            std::size_t i = 0, j = 0;
+            while (i < lexicon.size() || j < terms.size()) {
+                if (j == terms.size() || (i < lexicon.size() && lexicon[i] < terms[j].first)) {
+                    merged_lexicon.push_back(std::move(lexicon[i]));
+                    merged_freqs.push_back(doc_freqs[i++]);
+                }
+                else if (i == lexicon.size() || terms[j].first < lexicon[i]) {
+                    merged_lexicon.push_back(std::move(terms[j].first));
+                    merged_freqs.push_back(terms[j++].second);
+                }
+                else {
+                    merged_lexicon.push_back(std::move(lexicon[i]));
+                    merged_freqs.push_back(doc_freqs[i++] + terms[j++].second);
+                }
+            }
+            lexicon.swap(merged_lexicon);
+            doc_freqs.swap(merged_freqs);
+        }
+        lexicon_built = true;
+    });
+}
+
+/**
+ * @brief Find the live document of a file.
+ * @param name The document name, as indexed, e.g. `./a.html`.
+ * @param doc The document ID, if found.
+ * @return true if the file is indexed and not deleted.
+ */
+bool SearchEngine::find_document(const std::string& name, uint32_t& doc) const {
+    std::call_once(doc_ids_once, [this] {
+        for (auto& segment : segments) {
+            const DocTable& table = segment->documents();
+            for (uint32_t i = 0; i < table.size(); i++) {
+                std::string path = table.path(i);
+                if (!path.empty() && !segment->is_deleted(segment->doc_base() + i)) doc_ids[path] = segment->doc_base() + i;
+            }
+        }
+        doc_ids_built = true;
+    });
+    auto it = doc_ids.find(name);
+    if (it == doc_ids.end()) return false;
+    doc = it->second;
+    return true;
+}
+
+/**
+ * @brief Check if the index files were loaded.
+ * @return false if an index file is missing or cannot be mapped.
+ */
+bool SearchEngine::is_loaded() const {
+    for (auto& segment : segments) {
+        if (!segment->is_loaded()) return false;
+    }
+    return !segments.empty();
+}
+
+/**
+ * @brief Estimate the memory used by the engine.
+ * @return The heap bytes of each component, and the mapped and resident bytes of the index files.
+ *
+ * The components of the segments are summed over all segments.
+ */
+MemoryUsage SearchEngine::memory_usage() const {
+    MemoryUsage usage;
+    uint64_t words = 0, files = 0, deletions = 0;
+    for (auto& segment : segments) {
+        MemoryUsage part = segment->memory_usage();
+        for (auto& [name, bytes] : part.components) {
+            if (name == "words") words += bytes;
+            else if (name == "files") files += bytes;
+            else deletions += bytes;
+        }
+        usage.mapped += part.mapped;
+        usage.resident += part.resident;
+    }
+    usage.add("segment words", words);
+    usage.add("segment files", files);
+    usage.add("deletions", deletions);
+    usage.add("doc ids", doc_ids_built ? heap_size(doc_ids) : 0);
+    usage.add("lexicon", lexicon_built ? heap_size(lexicon) : 0);
+    usage.add("doc freqs", lexicon_built ? heap_size(doc_freqs) : 0);
+    usage.add("stop filter", stop_filter ? stop_filter->memory_usage() : 0);
+    return usage;
+}
+
+/**
+ * @brief Get the memory left for caches and buffers under the ceiling.
+ * @return The limit minus the memory of the loaded index, 0 if it is already over the limit,
+ * UINT64_MAX if there is no limit.
+ */
+uint64_t SearchEngine::memory_budget() const {
+    if (memory_ceiling == 0) return UINT64_MAX;
+    uint64_t used = memory_usage().total();
+    return used < memory_ceiling ? memory_ceiling - used : 0;
+}
+
+/**
+ * @brief Generate an index for the target directory.
+ * @param dir The target directory to index.
+ * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
+ * @param quiet If true, do not print any output to stdout.
+ * @param pipeline The options of the indexing pipeline, see IndexPipeline.
+ * @param walk The options of the directory walk, see DirWalker.
+ *
+ * The index is written to a new generation directory, which is published when complete.
+ */
+void SearchEngine::gen_index(const std::filesystem::path& dir, StopFilter* stop_filter, bool quiet, const IndexPipeline::Options& pipeline,
+    const DirWalker::Options& walk) {
+    fs::path prev = fs::current_path(); // store the current working directory
+    fs::path archive = enter_target(dir); // change to the target directory
+    fs::path folder = archive.empty() ? fs::path(BASE_DIR) : index_folder(archive); // an archive has its own index
+    fs::path base = begin_generation(folder); // never overwrite the published index in place
+    if (stop_filter) {
+        std::ofstream stop_fs(base / STOP_FILE_NAME);
+        stop_filter->print(stop_fs); // print stop words list to file
+        stop_fs.close();
+    }
+
+    FileIndex index;
+    Manifest manifest; // record the indexed files, for incremental updates
+    std::vector<DocTable::Document> documents;
+    std::vector<std::string> files;
+    bool complete = index_documents(archive, index, stop_filter, pipeline, walk, [&](uint32_t, const std::string& file, uint32_t length, const Manifest::Entry& entry) {
+        if (!archive.empty()) { // archive members have no manifest entry, an update rebuilds the archive
+            if (!quiet) std::cout << "Indexing " << file << std::endl;
+            documents.push_back({ 0, 0, length });
+            return;
+        }
+        if (!quiet) std::cout << "Indexing " << fs::canonical(file) << std::endl;
+        // canonical() returns the absolute path of the file. For prettier printing.
+        manifest.files[file] = entry; // stat'ed before the file was read, hashed as it was
+        documents.push_back({ entry.size, entry.mtime, length });
+    }, files);
+    if (!complete) {
+        fs::remove_all(base); // never publish part of an archive
+        fs::current_path(prev);
+        return;
+    }
+    DocTable::save(base / DOCS_FILE_NAME, files, documents);
+    index.save(base / INDEX_FILE_NAME); // save the index to file
+    profile_terms(base / INDEX_FILE_NAME);
+    if (archive.empty()) manifest.save(base / MANIFEST_FILE_NAME);
+    publish_generation(folder, base); // atomically switch readers to the new generation
+    fs::current_path(prev); // return to the original directory
+}
+
+/**
+ * @brief BNUNS: Generate an index for the target directory, but do most operations on dick to prevent running out of memory.
+ * @param dir The target directory to index.
+ * @param stop_filter The stop filter to use. nullptr if no stop filter is needed.
+ * @param quiet If true, do not print any output to stdout.
+ * @param pipeline The options of the indexing pipeline, see IndexPipeline.
+ * @param walk The options of the directory walk, see DirWalker.
+ *
+ * The index is written to a new generation directory, which is published when complete.
+ */
+void SearchEngine::gen_index_large(const std::filesystem::path& dir, StopFilter* stop_filter, bool quiet, const IndexPipeline::Options& pipeline,
+    const DirWalker::Options& walk) {
+    fs::path prev = fs::current_path(); // store the current working directory
+    fs::path archive = enter_target(dir); // change to the target directory
+    fs::path folder = archive.empty() ? fs::path(BASE_DIR) : index_folder(archive); // an archive has its own index
+    fs::path base = begin_generation(folder); // never overwrite the published index in place
+    FileIndex index;
+    TermDictionary dictionary; // the runs store term IDs, the terms are written once at the end
+    Manifest manifest; // record the indexed files, for incremental updates
+    std::vector<DocTable::Document> documents;
+    std::vector<std::string> files;
+    IndexPipeline::Options per_document = pipeline;
+    per_document.inversion = IndexPipeline::MAP; // each file is saved once inverted, there is nothing to sort
+    bool complete = index_documents(archive, index, stop_filter, per_document, walk, [&](uint32_t i, const std::string& file, uint32_t length, const Manifest::Entry& entry) {
+        // the index only holds file i, the next file is added after this returns
+        if (!archive.empty()) { // archive members have no manifest entry, an update rebuilds the archive
+            if (!quiet) std::cout << "Indexing " << file << std::endl;
+            documents.push_back({ 0, 0, length });
+        }
+        else {
+            if (!quiet) std::cout << "Indexing " << fs::canonical(file) << std::endl;
+            // canonical() returns the absolute path of the file. For prettier printing.
+            manifest.files[file] = entry; // stat'ed before the file was read, hashed as it was
+            documents.push_back({ entry.size, entry.mtime, length });
+        }
+        std::string name;
+        name = std::string("index_part_") + std::to_string(i) + std::string("to") + std::to_string(i) + ".tmp"; // generate file name
+        // e.g. index_part_3to3.tmp
+        index.save_run(base / name, dictionary);
+        index.clear();
+    }, files);
+    if (!complete) {
+        fs::remove_all(base); // never publish part of an archive
+        fs::current_path(prev);
+        return;
+    }
+    DocTable::save(base / DOCS_FILE_NAME, files, documents); // write the paths and metadata of the files
+    if (files.empty()) {
+        index.save(base / INDEX_FILE_NAME); // there are no runs to merge, the index is empty as with gen_index
+    }
+    else {
+        merge_index(base, 0, files.size() - 1, quiet, nullptr, true); // merge all the .tmp files *on disk*
+        std::string name = std::string("index_part_") + std::to_string(0) + std::string("to") + std::to_string(files.size() - 1) + std::string(".tmp"); // generate file name
+        FileIndex::run_to_index(base / name, dictionary, base / INDEX_FILE_NAME); // write the terms, in lexicographic order
+        fs::remove(base / name);
+    }
+    profile_terms(base / INDEX_FILE_NAME);
+    if (archive.empty()) manifest.save(base / MANIFEST_FILE_NAME);
+    publish_generation(folder, base); // atomically switch readers to the new generation
+    fs::current_path(prev); // return to the original directory
+}
+
+/**
+ * @brief Incrementally update the index of the target directory.
+ * @param dir The target directory to index.
+ * @param stop_filter The stop filter for a full build, used only if there is no index to update.
+ * @param quiet If true, do not print any output to stdout.
+ * @param pipeline The options of the indexing pipeline, see IndexPipeline.
+ * @param walk The options of the directory walk, see DirWalker.
+ *
+ * The files on disk are compared with the manifest of the published generation. Only added and
+ * modified files are indexed, into a new segment whose document IDs follow those of the existing
+ * segments. The new generation lists the existing segments plus the new one, and its manifest
+ * no longer contains deleted or replaced documents, which hides them from queries.
+ * The stop words of the published generation are reused. If there is no published generation
+ * with a manifest, a full build is done instead.
+ */
+bool SearchEngine::update_index(const std::filesystem::path& dir, StopFilter* stop_filter, bool quiet, const IndexPipeline::Options& pipeline,
+    const DirWalker::Options& walk) {
+    for (unsigned attempt = 1; attempt <= UPDATE_ATTEMPTS; attempt++) {
+        if (update_once(dir, stop_filter, quiet, pipeline, walk)) return true;
+        if (!quiet && attempt < UPDATE_ATTEMPTS) std::cout << "Index changed during update, retrying" << std::endl;
+    }
+    if (!quiet) std::cout << "Error: Index kept changing during update, gave up after " << UPDATE_ATTEMPTS << " attempts" << std::endl;
+    return false;
+}
+
+/**
+ * @brief Compare the files on disk with the published generation once, and publish the changes.
+ * @param dir The target directory to index.
+ * @param stop_filter The stop filter for a full build, used only if there is no index to update.
+ * @param quiet If true, do not print any output to stdout.
+ * @param pipeline The options of the indexing pipeline, see IndexPipeline.
+ * @param walk The options of the directory walk, see DirWalker.
+ * @return false if another generation was published meanwhile, the new generation is then removed.
+ */
+bool SearchEngine::update_once(const std::filesystem::path& dir, StopFilter* stop_filter, bool quiet, const IndexPipeline::Options& pipeline,
+    const DirWalker::Options& walk) {
+    fs::path current = index_dir(dir);
+    if (fs::is_regular_file(dir) || current == index_folder(dir) || !fs::exists(current / MANIFEST_FILE_NAME)) {
+        gen_index(dir, stop_filter, quiet, pipeline, walk); // nothing to update from, an archive is always rebuilt
+        return true;
+    }
+
+    fs::path prev = fs::current_path(); // store the current working directory
+    fs::current_path(dir); // change to the target directory
+    fs::path current_rel = fs::path(BASE_DIR) / current.filename();
+    Manifest old_manifest = Manifest::read(current_rel / MANIFEST_FILE_NAME);
+
+    // the segments of the published generation, and the first free document ID
+    std::vector<std::pair<std::string, uint32_t>> segment_list = read_segments(current_rel);
+    std::vector<DocTable> tables; // mapped, paths are only decoded for documents to tombstone
+    uint32_t next_doc = 0;
+    for (auto& [name, doc_base] : segment_list) {
+        tables.emplace_back(fs::path(BASE_DIR) / name);
+        next_doc = std::max(next_doc, doc_base + tables.back().size());
+    }
+
+    // compare the files on disk with the manifest
+    Manifest manifest;
+    std::vector<std::string> changed;
+    std::size_t deleted = 0;
+    DirWalker walker(".", ".html", walk);
+    for (auto& file : walker.files()) {
+        auto it = old_manifest.files.find(file);
+        if (it != old_manifest.files.end()) {
+            const Manifest::Entry& old = it->second;
+            uint64_t size = fs::file_size(file);
+            int64_t mtime = static_cast<int64_t>(fs::last_write_time(file).time_since_epoch().count());
+            if (size == old.size && mtime == old.mtime) {
+                manifest.files[file] = old; // unchanged
+                continue;
+            }
+            Manifest::Entry entry = Manifest::stat_file(file, old.doc);
+            if (entry.hash == old.hash) {
+                manifest.files[file] = entry; // touched but not modified
+                continue;
+            }
+        }
+        changed.push_back(file); // added or modified
+    }
+    for (auto& [file, entry] : old_manifest.files) {
+        if (!manifest.files.count(file) && std::find(changed.begin(), changed.end(), file) == changed.end()) {
+            deleted++;
+        }
+    }
+    std::size_t modified = 0;
+    for (auto& file : changed) {
+        if (old_manifest.files.count(file)) modified++;
+    }
+    if (!quiet) {
+        std::cout << changed.size() - modified << " added, " << modified << " modified, " << deleted << " deleted" << std::endl;
+    }
+    if (changed.empty() && deleted == 0) {
+        if (!quiet) std::cout << "Index is up to date" << std::endl;
+        fs::current_path(prev);
+        return true;
+    }
+
+    fs::path base = begin_generation(BASE_DIR); // the new generation is also the new segment
+    StopFilter* index_stop_filter = nullptr;
+    if (fs::exists(current_rel / STOP_FILE_NAME)) {
+        fs::copy_file(current_rel / STOP_FILE_NAME, base / STOP_FILE_NAME);
+        index_stop_filter = new StopFilter(base / STOP_FILE_NAME); // keep the stop words of the index
+    }
+
+    if (!changed.empty()) {
+        FileIndex index;
+        std::vector<DocTable::Document> documents(changed.size());
+        IndexPipeline(index, index_stop_filter, pipeline).run(changed, next_doc, [&](uint32_t i, const std::string& file, uint32_t length, const Manifest::Entry& entry) {
+            if (!quiet) std::cout << "Indexing " << fs::canonical(file) << std::endl;
+            manifest.files[file] = entry; // stat'ed before the file was read, hashed as it was
+            documents[i] = { entry.size, entry.mtime, length };
+        });
+        DocTable::save(base / DOCS_FILE_NAME, changed, documents);
+        index.save(base / INDEX_FILE_NAME);
+    }
+    delete index_stop_filter;
+
+    // tombstone the documents of the old segments that are no longer in the manifest
+    std::vector<bool> live(next_doc, false);
+    for (auto& [file, entry] : manifest.files) {
+        if (entry.doc < live.size()) live[entry.doc] = true;
+    }
+    for (std::size_t k = 0; k < segment_list.size(); k++) {
+        uint32_t doc_base = segment_list[k].second;
+        std::vector<bool> deletions(tables[k].size(), false);
+        bool any = false;
+        for (uint32_t i = 0; i < deletions.size(); i++) {
+            // an empty path is a document already dropped by compaction
+            deletions[i] = !live[doc_base + i] && !tables[k].path(i).empty();
+            any = any || deletions[i];
+        }
+        if (any) Segment::save_deletions(base / (segment_list[k].first + DELETIONS_SUFFIX), deletions);
+    }
+
+    if (!changed.empty()) segment_list.push_back({ base.filename().string(), next_doc });
+    write_segments(base, segment_list);
+    manifest.save(base / MANIFEST_FILE_NAME);
+    // atomically switch readers to the new generation, unless a compaction published meanwhile
+    bool published = publish_generation(BASE_DIR, base, current.filename().string());
+    std::error_code ec;
+    if (!published) fs::remove_all(base, ec); // never leave the abandoned generation behind
+    fs::current_path(prev); // return to the original directory
+    return published;
+}
+
+/**
+ * @brief Run one compaction step on the index of the target directory.
+ * @param dir The target directory.
+ * @param policy The merge policy.
+ * @param quiet If true, do not print any output to stdout.
+ * @return true if a compacted generation was published.
+ *
+ * Segments are grouped in size tiers: a segment smaller than policy.min_segment_size is in tier 0,
+ * and every tier is policy.fanout times larger than the previous one. The first run of
+ * policy.fanout adjacent segments in the same tier, lowest tier first, is merged into one
+ * segment. If there is no such run, a segment with more than policy.max_deleted of its
+ * documents deleted is rewritten alone.
+ *
+ * The postings of deleted documents are dropped while copying, the merge itself reuses
+ * merge_index and FileIndex::merge_files, and all writes go through a Throttle. Term counts per
+ * document are not stored, so term frequencies keep the occurrences in deleted documents, as
+ * they had before the compaction, and queries give the same results after it. Document IDs do
+ * not change, so the manifest and the other segments are reused as they are. The new
+ * generation is only published if no other generation was published meanwhile.
+ *
+ * Only absolute paths are used, so it is safe to call from a background thread.
+ */
+bool SearchEngine::compact_index(const std::filesystem::path& dir, const CompactionPolicy& policy, bool quiet) {
+    fs::path index_base = index_folder(fs::absolute(dir));
+    fs::path current = index_dir(fs::absolute(dir));
+    if (current == index_base || !fs::exists(current / MANIFEST_FILE_NAME)) {
+        return false; // an index built before segments existed
+    }
+
+    // the size tier and the deleted ratio of every segment
+    std::vector<std::pair<std::string, uint32_t>> segment_list = read_segments(current);
+    std::vector<std::size_t> tiers;
+    std::vector<std::vector<bool>> deletions;
+    std::vector<double> deleted_ratio;
+    for (auto& [name, doc_base] : segment_list) {
+        std::error_code ec;
+        uint64_t size = fs::file_size(index_base / name / INDEX_FILE_NAME, ec);
+        std::size_t tier = 0;
+        for (uint64_t limit = policy.min_segment_size; !ec && size >= limit && policy.fanout > 1; limit *= policy.fanout) {
+            tier++;
+        }
+        tiers.push_back(tier);
+        deletions.push_back(Segment::read_deletions(current / (name + DELETIONS_SUFFIX)));
+        std::size_t count = std::count(deletions.back().begin(), deletions.back().end(), true);
+        deleted_ratio.push_back(deletions.back().empty() ? 0.0 : static_cast<double>(count) / deletions.back().size());
+    }
+
+    std::size_t first = 0, last = 0; // the segments [first, last) to merge
+    std::size_t fanout = std::max<std::size_t>(policy.fanout, 2);
+    std::size_t best_tier = SIZE_MAX;
+    for (std::size_t i = 0; i + fanout <= segment_list.size(); i++) {
+        bool same = true;
+        for (std::size_t j = i + 1; j < i + fanout; j++) same = same && tiers[j] == tiers[i];
+        if (same && tiers[i] < best_tier) {
+            best_tier = tiers[i];
+            first = i;
+            last = i + fanout;
+        }
+    }
+    if (first == last) {
+        for (std::size_t i = 0; i < segment_list.size(); i++) {
+            if (deleted_ratio[i] > policy.max_deleted) {
+                first = i;
+                last = i + 1;
+                break;
+            }
+        }
+    }
+    if (first == last) return false; // nothing to compact
+
+    fs::path base = begin_generation(index_base); // the new generation is also the merged segment
+    Throttle throttle(policy.rate_limit);
+    std::vector<std::string> paths;
+    std::vector<DocTable::Document> documents;
+    for (std::size_t k = first; k < last; k++) {
+        const std::string& name = segment_list[k].first;
+        const std::vector<bool>& deleted = deletions[k];
+        std::string part = std::string("index_part_") + std::to_string(k - first) + "to" + std::to_string(k - first) + ".tmp";
+
+        DocTable table(index_base / name);
+        for (uint32_t i = 0; i < table.size(); i++) {
+            // deleted documents keep an empty path, so the IDs of the following ones do not change
+            bool dropped = i < deleted.size() && deleted[i];
+            paths.push_back(dropped ? std::string() : table.path(i));
+            documents.push_back(dropped ? DocTable::Document() : table.document(i));
+        }
+        if (deleted.empty()) {
+            fs::create_hard_link(index_base / name / INDEX_FILE_NAME, base / part); // nothing to drop
+            continue;
+        }
+
+        // copy the index of the segment without the postings of deleted documents
+        uint32_t doc_base = segment_list[k].second;
+        std::ifstream input(index_base / name / INDEX_FILE_NAME, std::ios::binary);
+        std::ofstream output(base / part, std::ios::binary);
+        uint32_t size = 0, kept = 0;
+        input.read(reinterpret_cast<char*>(&size), sizeof(size));
+        output.write(reinterpret_cast<const char*>(&kept), sizeof(kept)); // placeholder, updated below
+        std::string word;
+        FileIndex::Entry entry;
+        for (uint32_t i = 0; i < size && FileIndex::read_entry(input, word, entry); i++) {
+            entry.docs.erase(std::remove_if(entry.docs.begin(), entry.docs.end(), [&](uint32_t doc) {
+                return doc - doc_base < deleted.size() && deleted[doc - doc_base];
+            }), entry.docs.end());
+            // term counts per document are not stored, so the frequency is kept as it is, and so are
+            // terms left without documents: queries order and threshold terms the same as before
+            FileIndex::write_entry(output, word, entry);
+            throttle.consume(3 * sizeof(uint32_t) + word.size() + entry.docs.size() * sizeof(uint32_t));
+            kept++;
+        }
+        output.seekp(0);
+        output.write(reinterpret_cast<const char*>(&kept), sizeof(kept));
+    }
+    DocTable::save(base / DOCS_FILE_NAME, paths, documents);
+
+    merge_index(base, 0, last - first - 1, true, &throttle);
+    fs::rename(base / (std::string("index_part_0to") + std::to_string(last - first - 1) + ".tmp"), base / INDEX_FILE_NAME);
+
+    // the merged segment replaces the run, the other segments keep their deletion bitmaps
+    std::vector<std::pair<std::string, uint32_t>> compacted;
+    for (std::size_t k = 0; k < segment_list.size(); k++) {
+        if (k == first) compacted.push_back({ base.filename().string(), segment_list[first].second });
+        if (k >= first && k < last) continue;
+        compacted.push_back(segment_list[k]);
+        if (!deletions[k].empty()) {
+            fs::copy_file(current / (segment_list[k].first + DELETIONS_SUFFIX), base / (segment_list[k].first + DELETIONS_SUFFIX));
+        }
+    }
+    write_segments(base, compacted);
+    fs::copy_file(current / MANIFEST_FILE_NAME, base / MANIFEST_FILE_NAME);
+    if (fs::exists(current / STOP_FILE_NAME)) {
+        fs::copy_file(current / STOP_FILE_NAME, base / STOP_FILE_NAME);
+    }
+
+    if (!publish_generation(index_base, base, current.filename().string())) {
+        if (!quiet) std::cout << "Index changed during compaction, discarded" << std::endl;
+        return false;
+    }
+    if (!quiet) {
+        std::cout << "Compacted " << last - first << " segment(s) into " << base.filename().string() << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief Write a delta to disk as a new segment and publish it.
+ * @param dir The target directory.
+ * @param delta The delta, built on top of the published generation.
+ * @return false if another generation was published since the engine of the delta was loaded.
+ *
+ * The postings of the delta are saved as they are, and the documents it masks become
+ * tombstones: in the deletion bitmaps of the older segments, and in a bitmap of the new
+ * segment for buffered documents replaced before the flush. The manifest is updated with
+ * the current state of the changed files, so a later `index --update` does not index them again.
+ *
+ * Only absolute paths are used, so it is safe to call from a background thread.
+ */
+bool SearchEngine::flush_delta(const std::filesystem::path& dir, const DeltaIndex& delta) {
+    fs::path target = fs::absolute(dir);
+    fs::path index_base = index_folder(target);
+    fs::path current = index_dir(target);
+    if (current == index_base || current.filename() != delta.engine()->index_path().filename()) {
+        return false; // an index built before generations existed, or the delta is not on top of the published one
+    }
+
+    fs::path base = begin_generation(index_base); // the new generation is also the new segment
+    std::vector<std::pair<std::string, uint32_t>> segment_list = read_segments(current);
+    for (auto& [name, doc_base] : segment_list) {
+        std::vector<bool> deletions = Segment::read_deletions(current / (name + DELETIONS_SUFFIX));
+        uint32_t count = DocTable(index_base / name).size();
+        deletions.resize(count, false);
+        bool any = false;
+        for (uint32_t i = 0; i < count; i++) {
+            deletions[i] = deletions[i] || delta.is_masked(doc_base + i);
+            any = any || deletions[i];
+        }
+        if (any) Segment::save_deletions(base / (name + DELETIONS_SUFFIX), deletions);
+    }
+
+    Manifest manifest = Manifest::read(current / MANIFEST_FILE_NAME);
+    const std::vector<std::string>& files = delta.files();
+    if (!files.empty()) {
+        std::vector<bool> deletions(files.size(), false);
+        bool any = false;
+        for (uint32_t i = 0; i < files.size(); i++) {
+            deletions[i] = delta.is_masked(delta.doc_base() + i);
+            any = any || deletions[i];
+        }
+        if (any) Segment::save_deletions(base / (base.filename().string() + DELETIONS_SUFFIX), deletions);
+        delta.postings().save(base / INDEX_FILE_NAME);
+        segment_list.push_back({ base.filename().string(), delta.doc_base() });
+    }
+    for (auto& name : delta.changed()) {
+        manifest.files.erase(name);
+    }
+    std::vector<DocTable::Document> documents(files.size());
+    for (uint32_t i = 0; i < files.size(); i++) {
+        std::error_code ec;
+        if (!delta.is_masked(delta.doc_base() + i) && fs::exists(target / files[i], ec)) {
+            const Manifest::Entry& entry = manifest.files[files[i]] = delta.entries()[i]; // as the file was when buffered
+            documents[i] = { entry.size, entry.mtime, delta.lengths()[i] };
+        }
+    }
+    if (!files.empty()) DocTable::save(base / DOCS_FILE_NAME, files, documents);
+
+    write_segments(base, segment_list);
+    manifest.save(base / MANIFEST_FILE_NAME);
+    if (fs::exists(current / STOP_FILE_NAME)) {
+        fs::copy_file(current / STOP_FILE_NAME, base / STOP_FILE_NAME);
+    }
+    return publish_generation(index_base, base, current.filename().string());
+}
+
+/**
+ * @brief Merge the index files generated by gen_index_large.
+ * @param base The directory holding the index files.
+ * @param l The left index of the range to merge.
+ * @param r The right index of the range to merge.
+ * @param quiet If true, do not print any output to stdout.
+ * @param throttle Limits the write rate of the merge, nullptr for no limit.
+ * @param runs If true, the files are runs of term IDs (FileIndex::save_run) instead of index files.
+ *
+ * Merge a series of index file to one. The algorithm is similar to merge sort.
+ * It uses recursion to split the range into two halves and merge them.
+ */
+void SearchEngine::merge_index(const std::filesystem::path& base, std::size_t l, std::size_t r, bool quiet, Throttle* throttle, bool runs) {
+    if (l == r) return;
+    std::size_t m = (l + r) / 2; // find the middle index
+    merge_index(base, l, m, quiet, throttle, runs); // merge the left half
+    merge_index(base, m + 1, r, quiet, throttle, runs); // merge the right half
+    std::string name1 = std::string("index_part_") + std::to_string(l) + std::string("to") + std::to_string(m) + std::string(".tmp");
+    std::string name2 = std::string("index_part_") + std::to_string(m + 1) + std::string("to") + std::to_string(r) + std::string(".tmp");
+    std::string name3 = std::string("index_part_") + std::to_string(l) + std::string("to") + std::to_string(r) + std::string(".tmp");
+    auto on_write = [throttle](std::size_t bytes) {
+        if (throttle) throttle->consume(bytes);
+    };
+    if (runs) FileIndex::merge_runs(base / name1, base / name2, base / name3, on_write); // compare term IDs
+    else FileIndex::merge_files(base / name1, base / name2, base / name3, on_write); // do the actual merge
+    if (!quiet) std::cout << "Merging " << name1 << " and " << name2 << " into " << name3 << std::endl; // print the merge operation
+    std::filesystem::remove(base / name1); // remove the temporary files
+    std::filesystem::remove(base / name2); // remove the temporary files
+}
+
+/**
+ * @brief Create a new, empty generation directory.
+ * @param base The index folder, i.e. `<target_dir>/<BASE_DIR>`.
+ * @return The path of the new generation directory.
+ *
+ * Generations are numbered, the new one is numbered one more than the newest existing one.
+ * If another process creates the same generation at the same time, the next number is tried.
+ */
+std::filesystem::path SearchEngine::begin_generation(const std::filesystem::path& base) {
+    uint64_t next = 1;
+    for (auto& generation : list_generations(base)) {
+        next = std::max(next, generation.first + 1);
+    }
+    fs::create_directories(base);
+    fs::path path = base / (std::string(GENERATION_PREFIX) + std::to_string(next));
+    while (!fs::create_directory(path)) { // false if it already exists
+        path = base / (std::string(GENERATION_PREFIX) + std::to_string(++next));
+    }
+    return path;
+}
+
+/**
+ * @brief Publish a complete generation and remove old ones.
+ * @param base The index folder, i.e. `<target_dir>/<BASE_DIR>`.
+ * @param generation The generation directory to publish.
+ * @param expected The name of the generation the new one was derived from, empty to publish unconditionally.
+ * @return false if expected is not the published generation any more, the new generation is then removed.
+ *
+ * The CURRENT pointer file is written to a temporary file and renamed over the old one,
+ * so readers see either the old or the new generation, never a partial one. The files of the
+ * generation and the temporary file are flushed to disk before the rename, and the index
+ * folder after it, so after a crash CURRENT names a complete generation.
+ *
+ * Only the published and the previously published generation are kept, with the segments
+ * they use. Generations numbered above the published one are left alone: another writer may
+ * still be building them. Engines still using a removed generation keep working, since they
+ * hold a mapping of its index files.
+ *
+ * Writers (rebuilds, updates, compaction) may run in different processes, so the check of
+ * expected and the switch are done under an exclusive lock on the LOCK file of the index folder.
+ */
+bool SearchEngine::publish_generation(const std::filesystem::path& base, const std::filesystem::path& generation, const std::string& expected) {
+    std::string name = generation.filename().string();
+    int lock_fd = open((base / LOCK_FILE_NAME).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd >= 0) flock(lock_fd, LOCK_EX);
+    if (!expected.empty() && published_generation(base).filename().string() != expected) {
+        if (lock_fd >= 0) close(lock_fd); // also releases the lock
+        fs::remove_all(generation);
+        return false;
+    }
+    std::string previous = published_generation(base).filename().string();
+    for (auto& entry : fs::directory_iterator(generation)) {
+        if (entry.is_regular_file()) sync_path(entry.path());
+    }
+    sync_path(generation);
+    fs::path temporary = base / (std::string(CURRENT_FILE_NAME) + ".tmp");
+    {
+        std::ofstream current(temporary);
+        current << name << std::endl;
+    }
+    sync_path(temporary); // or a crash may leave CURRENT empty
+    fs::rename(temporary, base / CURRENT_FILE_NAME); // atomic on POSIX
+    sync_path(base);
+
+    uint64_t number = std::strtoull(name.c_str() + std::strlen(GENERATION_PREFIX), nullptr, 10);
+    std::vector<std::string> keep = { name, previous }; // and the segments they use
+    for (const std::string& kept : { name, previous }) {
+        if (!fs::is_directory(base / kept)) continue; // no previous generation
+        for (auto& segment : read_segments(base / kept)) keep.push_back(segment.first);
+    }
+    for (auto& [older, older_name] : list_generations(base)) {
+        if (older < number && std::find(keep.begin(), keep.end(), older_name) == keep.end()) {
+            fs::remove_all(base / older_name); // also partial generations of crashed writers
+        }
+    }
+    for (const char* legacy : { INDEX_FILE_NAME, LIST_FILE_NAME, STOP_FILE_NAME }) {
+        fs::remove(base / legacy); // files of an index built before generations existed
+    }
+    if (lock_fd >= 0) close(lock_fd);
+    return true;
+}
+
+/**
+ * @brief Read the segment list of a generation.
+ * @param generation The generation directory.
+ * @return The (segment directory name, first document ID) pairs, in document ID order.
+ *
+ * A generation built by an update or a compaction lists its segments in a SEGMENTS file,
+ * a full build is a single segment, the generation itself.
+ */
+std::vector<std::pair<std::string, uint32_t>> SearchEngine::read_segments(const std::filesystem::path& generation) {
+    std::vector<std::pair<std::string, uint32_t>> segment_list;
+    std::ifstream segments_fs(generation / SEGMENTS_FILE_NAME);
+    if (!segments_fs.is_open()) {
+        segment_list.push_back({ generation.filename().string(), 0 });
+        return segment_list;
+    }
+    std::string name;
+    uint32_t doc_base;
+    while (segments_fs >> name >> doc_base) segment_list.push_back({ name, doc_base });
+    return segment_list;
+}
+
+/**
+ * @brief List the index files of the published generation of a target directory.
+ * @param dir The target directory.
+ * @return The index file of every segment, in document ID order.
+ */
+std::vector<std::filesystem::path> SearchEngine::index_files(const std::filesystem::path& dir) {
+    std::vector<std::filesystem::path> files;
+    for (auto& segment : read_segments(index_dir(dir))) {
+        files.push_back(index_folder(dir) / segment.first / INDEX_FILE_NAME);
+    }
+    return files;
+}
+
+/**
+ * @brief Write the segment list of a generation.
+ * @param generation The generation directory.
+ * @param segment_list The (segment directory name, first document ID) pairs, in document ID order.
+ */
+void SearchEngine::write_segments(const std::filesystem::path& generation, const std::vector<std::pair<std::string, uint32_t>>& segment_list) {
+    std::ofstream segments_fs(generation / SEGMENTS_FILE_NAME);
+    for (auto& [name, doc_base] : segment_list) {
+        segments_fs << name << " " << doc_base << std::endl;
+    }
+}
+
+/**
+ * @brief Check if a document is masked by the deletion bitmap of its segment.
+ * @param doc The document ID.
+ * @return true if the document was deleted or replaced.
+ */
+bool SearchEngine::is_deleted(uint32_t doc) const {
+    const Segment* segment = segment_of(doc);
+    return segment && segment->is_deleted(doc);
+}
+
+/**
+ * @brief Find the segment of a document.
+ * @param doc The document ID.
+ * @return The segment whose range holds doc, nullptr if none.
+ */
+const Segment* SearchEngine::segment_of(uint32_t doc) const {
+    // the last segment starting at or before doc
+    auto it = std::upper_bound(segments.begin(), segments.end(), doc, [](uint32_t d, const std::unique_ptr<Segment>& segment) {
+        return d < segment->doc_base();
+    });
+    if (it == segments.begin()) return nullptr;
+    const Segment* segment = (it - 1)->get();
+    return doc - segment->doc_base() < segment->size() ? segment : nullptr;
+}
+
+/**
+ * @brief Get the path of a document.
+ * @param doc The document ID, must be less than document_count().
+ * @return The path, as indexed, empty for a document removed by compaction.
+ */
+std::string SearchEngine::file(uint32_t doc) const {
+    const Segment* segment = segment_of(doc);
+    return segment ? segment->file(doc) : std::string();
+}
+
+/**
+ * @brief List the generation directories of an index folder.
+ * @param base The index folder, i.e. `<target_dir>/<BASE_DIR>`.
+ * @return The (number, directory name) pairs of all generations.
+ */
+std::vector<std::pair<uint64_t, std::string>> SearchEngine::list_generations(const std::filesystem::path& base) {
+    std::vector<std::pair<uint64_t, std::string>> generations;
+    std::string prefix = GENERATION_PREFIX;
+    if (!fs::exists(base)) return generations;
+    for (auto& entry : fs::directory_iterator(base)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_directory() && name.compare(0, prefix.size(), prefix) == 0) {
+            generations.push_back({ std::strtoull(name.c_str() + prefix.size(), nullptr, 10), name });
+        }
+    }
+    return generations;
+}
+
+/**
+ * @brief Search for a word in the index with the default options.
+ * @param query The query string.
+ * @param output The output stream to write the result to.
+ */
+void SearchEngine::search(const std::string& query, std::ostream& output) const {
+    search(query, output, SearchOptions());
+}
+
+/**
+ * @brief Search for a word in the index.
+ * @param query The query string.
+ * @param output The output stream to write the result to.
+ * @param options The threshold, fuzzy distance, delta, explanation and page of the query.
+ *
+ * Threshold is a ratio from 0.0 to 1.0. It represents the percentage of terms that should be used in searching. Default value is 1.0
+ * For example, if threshold is 0.8, only the top 80% less frequent terms will be used in searching.
+ *
+ * If a delta is passed, it must have been built on top of this engine.
+ * If explain is not nullptr, the terms, reads, evaluation steps and stage times are recorded into it.
+ * Offset and limit select the page of results to print, see evaluate().
+ */
+void SearchEngine::search(const std::string& query, std::ostream& output, const SearchOptions& options) const {
+    const DeltaIndex* delta = options.delta;
+    QueryExplain* explain = options.explain;
+    std::vector<std::pair<std::string, FileIndex::Entry>> entries;
+    auto start = explain ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    auto mark = start;
+
+    // search each word separetely and then intersect the results
+    std::vector<std::string> words = parse_query(query, output);
+    if (explain) explain->parse_ms = lap_ms(mark);
+    for (auto& word : words) {
+        // a word only found in the delta is not a typo
+        std::vector<std::string> terms = (delta && delta->find(word)) ? std::vector<std::string>{ word } : expand_term(word, options.fuzzy, output);
+        QueryExplain::Term* stats = nullptr;
+        if (explain) {
+            explain->expand_ms += lap_ms(mark);
+            stats = &explain->terms.emplace_back();
+            stats->word = word;
+            stats->terms = terms;
+        }
+        FileIndex::Entry entry{};
+        for (std::size_t i = 0; i < terms.size(); i++) {
+            FileIndex::Entry term_entry = search_word(terms[i], stats);
+            const FileIndex::Entry* buffered = delta ? delta->find(terms[i]) : nullptr;
+            if (buffered) { // delta documents come after all indexed ones
+                term_entry.freq += buffered->freq;
+                term_entry.docs.insert(term_entry.docs.end(), buffered->docs.begin(), buffered->docs.end());
+                if (stats) stats->lists++;
+            }
+            entry = i == 0 ? term_entry : FileIndex::merge_entries(entry, term_entry); // union of the documents
+        }
+        if (stats) {
+            stats->doc_freq = static_cast<uint32_t>(entry.docs.size());
+            stats->freq = entry.freq;
+            stats->lookup_ms = lap_ms(mark);
+            explain->lookup_ms += stats->lookup_ms;
+        }
+        entries.push_back({ word, entry });
+    }
+    evaluate(entries, output, options);
+    if (explain) explain->total_ms = lap_ms(start);
+}
+
+/**
+ * @brief Split a query into stemmed words.
+ * @param query The query string.
+ * @param output The output stream to report ignored stop words to.
+ * @return The stemmed words of the query, stop words removed.
+ */
+std::vector<std::string> SearchEngine::parse_query(const std::string& query, std::ostream& output) const {
+    std::stringstream ss(query);
+    std::vector<std::string> words;
+    std::string token;
+
+    while (ss) {
+        token = tokenize(ss); // tokenize the query
+        if (token.empty()) continue; // ignore empty tokens
+        token = stem_word(token); // stem the word
+        if (stop_filter && stop_filter->is_stop(token)) { // if stop word filter is enabled, ignore stop words
+            output << "Stop word \"" << token << "\" is ignored." << std::endl;
+            continue;
+        }
+        words.push_back(token);
+    }
+    return words;
+}
+
+/**
+ * @brief Get the indexed terms a query word stands for.
+ * @param word The stemmed query word.
+ * @param fuzzy The maximum edit distance for a word that is not indexed, 0 to disable.
+ * @param output The output stream to write the "did you mean" suggestion to.
+ * @return The word itself, or its fuzzy matches if it is not indexed and fuzzy is enabled.
+ */
+std::vector<std::string> SearchEngine::expand_term(const std::string& word, uint32_t fuzzy, std::ostream& output) const {
+    if (fuzzy == 0) return { word };
+    load_lexicon();
+    if (std::binary_search(lexicon.begin(), lexicon.end(), word)) {
+        return { word };
+    }
+    // the word is not indexed, search all indexed words close to it instead
+    std::vector<std::string> terms;
+    std::vector<FuzzyMatch> matches = fuzzy_search(word, fuzzy);
+    if (!matches.empty()) {
+        output << "Did you mean \"" << matches.front().word << "\"?" << std::endl;
+    }
+    for (auto& match : matches) {
+        terms.push_back(match.word);
+    }
+    return terms;
+}
+
+/**
+ * @brief Intersect the entries of the query words and print the matching files.
+ * @param entries The (word, entry) pairs of the query.
+ * @param output The output stream to write the result to.
+ * @param options The threshold, delta the entries include, explanation and page, see search().
+ *
+ * The offset first results are skipped and at most limit are printed, all of them if limit is 0.
+ * The paths of the printed results are decoded from the document tables, the others are never
+ * looked at. Results are written without flushing, the output is flushed once at the end.
+ */
+void SearchEngine::evaluate(std::vector<std::pair<std::string, FileIndex::Entry>>& entries, std::ostream& output, const SearchOptions& options) const {
+    const DeltaIndex* delta = options.delta;
+    QueryExplain* explain = options.explain;
+    auto mark = explain ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    std::sort(entries.begin(), entries.end(), [](
+        const std::pair<std::string, FileIndex::Entry>& e1,
+        const std::pair<std::string, FileIndex::Entry>& e2
+        ) {
+            return e1.second.freq < e2.second.freq;
+        }); // sort by frequency, *ascending*. It is for the querry thresholding pollicy
+    std::vector<uint32_t> res;
+    bool first = true; // true if it is processing the first set of results.
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        auto& entry = entries[i];
+        if (i > entries.size() * options.threshold) { // if the threshold is reached, ignore the rest of the words
+            output << "\"" << entry.first << "\" is ignored due to threshold." << std::endl;
+            if (explain) explain->ignored.push_back(entry.first);
+        }
+        else {
+            if (first) { // if it is the first set of results, just assign it to the result
+                // mask deleted documents here: this is the shortest list, the others are only intersected with it
+                res.reserve(entry.second.docs.size());
+                for (uint32_t doc : entry.second.docs) {
+                    if (delta && delta->is_masked(doc)) continue; // changed since the generation was published
+                    if (doc < documents && is_deleted(doc)) continue;
+                    res.push_back(doc);
+                }
+                if (explain) explain->masked = entry.second.docs.size() - res.size();
+                first = false; // set the flag to false
+            }
+            else {
+                res = intersect(res, entry.second.docs); // intersect the results
+            }
+            if (explain) explain->steps.push_back({ entry.first, res.size() });
+        }
+    }
+    if (explain) explain->evaluate_ms = lap_ms(mark);
+    if (res.empty()) { // if the result is empty, print "No results found."
+        output << "No results found." << std::endl;
+    }
+    else {
+        std::size_t first = std::min(options.offset, res.size());
+        std::size_t last = options.limit == 0 ? res.size() : std::min(res.size(), first + options.limit);
+        for (std::size_t i = first; i < last; i++) {
+            uint32_t doc = res[i];
+            output << (doc < documents ? file(doc) : delta->file(doc)) << '\n'; // print the result
+        }
+        if (options.offset != 0 || options.limit != 0) {
+            if (first == last) output << "No results from " << options.offset + 1 << ", " << res.size() << " in total." << '\n';
+            else output << "Results " << first + 1 << "-" << last << " of " << res.size() << "." << '\n';
+        }
+        output.flush();
+    }
+    if (explain) explain->output_ms = lap_ms(mark);
+}
+
+/**
+ * @brief Print the explanation.
+ * @param output The output stream to print to.
+ *
+ * Words are listed in query order with their posting list reads, then the evaluation steps in
+ * the order the lists were intersected, shortest first.
+ */
+void SearchEngine::QueryExplain::print(std::ostream& output) const {
+    output << "Explain:" << std::endl;
+    for (auto& term : terms) {
+        output << "  term \"" << term.word << "\"";
+        if (term.terms.size() != 1 || term.terms[0] != term.word) {
+            output << " ->";
+            for (auto& t : term.terms) output << " \"" << t << "\"";
+            if (term.terms.empty()) output << " (no match)";
+        }
+        output << ": df " << term.doc_freq << ", freq " << term.freq << ", " << term.lists << " posting list(s), "
+            << term.bytes_read << " bytes, page cache " << term.resident_pages << "/" << term.pages << " pages hit, "
+            << term.lookup_ms << " ms" << std::endl;
+    }
+    for (std::size_t i = 0; i < steps.size(); i++) {
+        output << "  step " << i + 1 << ": " << (i == 0 ? "start with" : "intersect") << " \"" << steps[i].word << "\" -> "
+            << steps[i].results << " result(s)";
+        if (i == 0 && masked > 0) output << " (" << masked << " deleted or changed)";
+        output << std::endl;
+    }
+    for (auto& word : ignored) {
+        output << "  \"" << word << "\" ignored due to threshold" << std::endl;
+    }
+    output << "  time: parse " << parse_ms << " ms, expand " << expand_ms << " ms, lookup " << lookup_ms
+        << " ms, evaluate " << evaluate_ms << " ms, output " << output_ms << " ms, total " << total_ms << " ms" << std::endl;
+}
+
+/**
+ * @brief Run a batch of queries in parallel.
+ * @param queries The queries to run.
+ * @param output The output stream to write the results to, in input order.
+ * @param options The options of every query, see search().
+ * @param threads The number of worker threads, 0 means one per hardware thread.
+ * @param shared If true, fetch each term once for the whole batch instead of once per query.
+ * @return The throughput and latency statistics of the batch.
+ *
+ * Queries are fanned out over a work-stealing thread pool. Each query writes to its own buffer,
+ * and the buffers are written to output in input order, each preceded by a "Query: <query>" line.
+ * The explain option is ignored: one explanation cannot hold the steps of several queries.
+ *
+ * In shared mode, all queries are parsed first, then the union of their terms is fetched from the
+ * index exactly once, in on-disk offset order, and finally every query is evaluated against the
+ * shared entries. The latency of a query then excludes the shared fetch.
+ */
+SearchEngine::BatchStats SearchEngine::search_batch(
+    const std::vector<std::string>& queries,
+    std::ostream& output,
+    const SearchOptions& options,
+    unsigned threads,
+    bool shared
+) const {
+    SearchOptions query_options = options;
+    query_options.explain = nullptr;
+    const DeltaIndex* delta = options.delta;
+    BatchStats stats;
+    stats.queries = queries.size();
+    stats.shared = shared;
+    stats.latencies.resize(queries.size());
+    std::vector<std::string> results(queries.size()); // one buffer per query, so the order is kept
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        stats.threads = static_cast<unsigned>(pool.size());
+        if (!shared) {
+            for (std::size_t i = 0; i < queries.size(); i++) {
+                pool.submit([this, &queries, &results, &stats, &query_options, i] {
+                    auto query_start = std::chrono::steady_clock::now();
+                    std::ostringstream buffer;
+                    search(queries[i], buffer, query_options);
+                    results[i] = buffer.str();
+                    stats.latencies[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - query_start).count();
+                });
+            }
+            pool.wait();
+        }
+        else {
+            // phase 1: parse all queries and find the indexed terms each word stands for
+            std::vector<std::ostringstream> buffers(queries.size());
+            std::vector<std::vector<std::pair<std::string, std::vector<std::string>>>> parsed(queries.size());
+            for (std::size_t i = 0; i < queries.size(); i++) {
+                pool.submit([this, &queries, &buffers, &parsed, &stats, delta, i, fuzzy = options.fuzzy] {
+                    auto query_start = std::chrono::steady_clock::now();
+                    for (auto& word : parse_query(queries[i], buffers[i])) {
+                        // a word only found in the delta is not a typo, see search()
+                        if (delta && delta->find(word)) parsed[i].push_back({ word, { word } });
+                        else parsed[i].push_back({ word, expand_term(word, fuzzy, buffers[i]) });
+                    }
+                    stats.latencies[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - query_start).count();
+                });
+            }
+            pool.wait();
+
+            // phase 2: fetch the union of all terms once, in on-disk offset order so the reads are sequential
+            std::vector<std::tuple<std::size_t, Offset, std::string>> terms; // (segment, offset, term)
+            for (auto& query : parsed) {
+                for (auto& [word, expanded] : query) {
+                    for (auto& term : expanded) {
+                        for (std::size_t k = 0; k < segments.size(); k++) {
+                            Offset offset;
+                            if (segments[k]->find(term, offset)) terms.push_back({ k, offset, term });
+                        }
+                    }
+                }
+            }
+            std::sort(terms.begin(), terms.end());
+            terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+            // the shared entries are a cache bounded by the memory limit: terms that do not fit are
+            // spilled, i.e. dropped from it and read again by each query that needs them
+            uint64_t budget = memory_budget();
+            std::unordered_map<std::string, FileIndex::Entry> shared_entries;
+            std::unordered_map<std::string, uint64_t> entry_bytes;
+            std::unordered_set<std::string> spilled;
+            for (auto& [k, offset, term] : terms) {
+                FileIndex::Entry part;
+                std::size_t bytes = segments[k]->read(offset, part);
+                entry_bytes[term] += bytes;
+                stats.bytes_read += bytes;
+                if (spilled.count(term)) continue;
+                uint64_t grown = part.docs.size() * sizeof(uint32_t) + (shared_entries.count(term) ? 0 : term.size() + 64); // 64 for the node
+                if (stats.cache_bytes + grown > budget) {
+                    auto it = shared_entries.find(term);
+                    if (it != shared_entries.end()) { // its other segments were cached already
+                        stats.cache_bytes -= it->second.docs.size() * sizeof(uint32_t) + term.size() + 64;
+                        shared_entries.erase(it);
+                    }
+                    spilled.insert(term);
+                    continue;
+                }
+                stats.cache_bytes += grown;
+                FileIndex::Entry& entry = shared_entries[term];
+                entry.freq += part.freq;
+                entry.docs.insert(entry.docs.end(), part.docs.begin(), part.docs.end()); // segments are in doc ID order
+            }
+            stats.spilled_terms = spilled.size();
+
+            // the per-query path reads every term of every query separately
+            for (auto& query : parsed) {
+                for (auto& [word, expanded] : query) {
+                    for (auto& term : expanded) {
+                        auto it = entry_bytes.find(term);
+                        if (it != entry_bytes.end()) stats.per_query_bytes += it->second;
+                    }
+                }
+            }
+
+            // phase 3: evaluate all queries against the shared entries, reading spilled terms again
+            std::atomic<uint64_t> reread_bytes{ 0 };
+            for (std::size_t i = 0; i < queries.size(); i++) {
+                pool.submit([this, &buffers, &parsed, &shared_entries, &spilled, &reread_bytes, &results, &stats, &query_options, delta, i] {
+                    auto query_start = std::chrono::steady_clock::now();
+                    std::vector<std::pair<std::string, FileIndex::Entry>> entries;
+                    for (auto& [word, expanded] : parsed[i]) {
+                        FileIndex::Entry entry;
+                        for (std::size_t j = 0; j < expanded.size(); j++) {
+                            FileIndex::Entry read; // empty unless the term was spilled
+                            auto it = shared_entries.find(expanded[j]);
+                            if (it == shared_entries.end() && spilled.count(expanded[j])) {
+                                QueryExplain::Term term_stats;
+                                read = search_word(expanded[j], &term_stats);
+                                reread_bytes += term_stats.bytes_read;
+                            }
+                            const FileIndex::Entry& found = it != shared_entries.end() ? it->second : read;
+                            const FileIndex::Entry* buffered = delta ? delta->find(expanded[j]) : nullptr;
+                            if (buffered) { // delta documents come after all indexed ones
+                                FileIndex::Entry term_entry = found;
+                                term_entry.freq += buffered->freq;
+                                term_entry.docs.insert(term_entry.docs.end(), buffered->docs.begin(), buffered->docs.end());
+                                entry = (j == 0) ? term_entry : FileIndex::merge_entries(entry, term_entry);
+                            }
+                            else entry = (j == 0) ? found : FileIndex::merge_entries(entry, found); // union of the documents
+                        }
+                        entries.push_back({ word, entry });
+                    }
+                    evaluate(entries, buffers[i], query_options);
+                    results[i] = buffers[i].str();
+                    stats.latencies[i] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - query_start).count();
+                });
+            }
+            pool.wait();
+            stats.bytes_read += reread_bytes;
+        }
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (std::size_t i = 0; i < queries.size(); i++) {
+        output << "Query: " << queries[i] << "\n" << results[i];
+    }
+    output.flush();
+    return stats;
+}
+
+/**
+ * @brief Get the throughput of the batch.
+ * @return The number of queries per second.
+ */
+double SearchEngine::BatchStats::qps() const {
+    return seconds > 0 ? queries / seconds : 0.0;
+}
+
+/**
+ * @brief Get a latency percentile.
+ * @param p The percentile, from 0.0 to 100.0.
+ * @return The latency in milliseconds.
+ *
+ * Uses the nearest-rank method on a sorted copy of the latencies.
+ */
+double SearchEngine::BatchStats::percentile(double p) const {
+    if (latencies.empty()) return 0.0;
+    std::vector<double> sorted = latencies;
+    std::size_t rank = static_cast<std::size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+/**
+ * @brief Print the throughput, the p50/p99 latencies and, in shared mode, the bytes read.
+ * @param output The output stream to print to.
+ */
+void SearchEngine::BatchStats::print(std::ostream& output) const {
+    output << queries << " queries in " << seconds << " s on " << threads << " threads" << std::endl;
+    output << "Throughput: " << qps() << " QPS" << std::endl;
+    output << "Latency: p50 " << percentile(50) << " ms, p99 " << percentile(99) << " ms" << std::endl;
+    if (shared) {
+        output << "Bytes read: " << bytes_read << " (per-query path: " << per_query_bytes << ")" << std::endl;
+        output << "Shared entries: " << cache_bytes << " bytes";
+        if (spilled_terms) output << ", " << spilled_terms << " terms over the memory limit read per query";
+        output << std::endl;
+    }
+}
+
+/**
+ * @brief Search for a word in the index.
+ * @param word The word to search for.
+ * @param stats If not nullptr, the posting lists, bytes and pages read are added to it.
+ * @return The entry of the word in the index. Retrived from the file.
+ */
+FileIndex::Entry SearchEngine::search_word(const std::string& word, QueryExplain::Term* stats) const {
+    FileIndex::Entry entry; // create an entry to store the result
+    for (auto& segment : segments) {
+        Offset offset;
+        if (!segment->find(word, offset)) continue; // the word is not in this segment
+        FileIndex::Entry part;
+        if (stats) {
+            auto [resident, pages] = segment->residency(offset); // before the read brings the pages in
+            stats->resident_pages += resident;
+            stats->pages += pages;
+            stats->bytes_read += segment->read(offset, part);
+            stats->lists++;
+        }
+        else segment->read(offset, part); // read the entry from the mapped index
+        entry.freq += part.freq;
+        // segments cover increasing ranges of document IDs, so appending keeps the docs sorted
+        entry.docs.insert(entry.docs.end(), part.docs.begin(), part.docs.end());
+    }
+    return entry;
+}
+
+/**
+ * @brief Find all indexed terms within an edit distance of a word.
+ * @param word The stemmed word to match.
+ * @param max_edits The maximum edit distance, usually 1 or 2.
+ * @return The matching terms, ranked by document frequency (descending), then by edit distance.
+ *
+ * A Levenshtein automaton is intersected with the sorted lexicon, so only the branches
+ * of the lexicon that can still match are visited.
+ */
+std::vector<SearchEngine::FuzzyMatch> SearchEngine::fuzzy_search(const std::string& word, uint32_t max_edits) const {
+    load_lexicon();
+    LevenshteinAutomaton automaton(word, max_edits);
+    std::vector<FuzzyMatch> matches;
+    for (auto& [i, distance] : automaton.intersect(lexicon)) {
+        matches.push_back({ lexicon[i], distance, doc_freqs[i] });
+    }
+    std::stable_sort(matches.begin(), matches.end(), [](const FuzzyMatch& m1, const FuzzyMatch& m2) {
+        if (m1.doc_freq != m2.doc_freq) return m1.doc_freq > m2.doc_freq; // more frequent terms first
+        return m1.distance < m2.distance; // closer terms first
+        }); // stable, so ties keep the lexicon order
+    return matches;
+}
+
+/**
+ * @brief Suggest a correction for a word ("did you mean").
+ * @param word The stemmed word to correct.
+ * @param max_edits The maximum edit distance, usually 1 or 2.
+ * @return The best ranked fuzzy match, or an empty string if there is none.
+ */
+std::string SearchEngine::suggest(const std::string& word, uint32_t max_edits) const {
+    std::vector<FuzzyMatch> matches = fuzzy_search(word, max_edits);
+    return matches.empty() ? std::string() : matches.front().word;
+}
@@ -0,0 +1,368 @@
+#include "SearchServer.h"
+
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <exception>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+namespace {
+    constexpr uint64_t LISTEN_ID = 0; ///< The epoll id of the listening socket.
+    constexpr uint64_t WAKE_ID = UINT64_MAX; ///< The epoll id of the wake eventfd.
+    constexpr std::size_t MAX_REQUEST_SIZE = 1 << 20; ///< Connections sending longer lines are closed.
+    constexpr std::size_t MAX_OUTPUT_SIZE = 1 << 20; ///< Stop reading a connection while this much output is unsent.
+    const char* OVERLOADED_RESPONSE = "Error: server overloaded\n\n"; ///< The response of a rejected request.
+
+    /**
+     * @brief Fill a Unix socket address.
+     * @return false if the path is too long for sockaddr_un.
+     */
+    bool make_address(const std::string& path, sockaddr_un& addr) {
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+}
+
+/**
+ * @brief Construct a server for an engine.
+ * @param engine The engine to answer queries with, it must outlive the server.
+ * @param options The options of the server.
+ */
+SearchServer::SearchServer(const HotSwapEngine& engine, const Options& options)
+    : engine(engine), options(options), pool(options.threads) {}
+
+/**
+ * @brief Close all connections and remove the socket file.
+ */
+SearchServer::~SearchServer() {
+    try {
+        pool.wait(); // workers may still report completions through wake_fd
+    }
+    catch (...) {} // a query that failed has nobody left to answer
+    for (auto& [id, conn] : connections) {
+        close(conn.fd);
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(options.socket_path.c_str());
+    }
+    if (epoll_fd >= 0) close(epoll_fd);
+    if (wake_fd >= 0) close(wake_fd);
+}
+
+/**
+ * @brief Create the socket and start listening.
+ * @return false if the socket cannot be created, the reason is printed to stderr.
+ */
+bool SearchServer::listen() {
+    sockaddr_un addr;
+    if (!make_address(options.socket_path, addr)) {
+        std::cerr << "Socket path too long: " << options.socket_path << std::endl;
+        return false;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    unlink(options.socket_path.c_str()); // remove a stale socket left by a previous server
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listen_fd, SOMAXCONN) < 0) {
+        std::cerr << "bind " << options.socket_path << ": " << std::strerror(errno) << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        std::cerr << "epoll: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = LISTEN_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.u64 = WAKE_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+    return true;
+}
+
+/**
+ * @brief Run the event loop until stop() is called.
+ */
+void SearchServer::run() {
+    std::vector<epoll_event> events(64);
+    while (!stopping) {
+        int n = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue; // interrupted by a signal, check stopping again
+            std::cerr << "epoll_wait: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                accept_connections();
+            }
+            else if (id == WAKE_ID) {
+                uint64_t count;
+                while (read(wake_fd, &count, sizeof(count)) > 0) {} // reset the eventfd
+                drain_completions();
+            }
+            else if (connections.count(id)) {
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) read_requests(id);
+                if (connections.count(id) && (events[i].events & EPOLLOUT)) flush(id);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Ask the event loop to exit.
+ *
+ * This only sets a flag and writes to an eventfd, so it is safe to call from a signal handler
+ * or from another thread.
+ */
+void SearchServer::stop() {
+    stopping = true;
+    uint64_t one = 1;
+    if (wake_fd >= 0) {
+        ssize_t written = write(wake_fd, &one, sizeof(one));
+        (void)written; // nothing useful can be done if the wake up fails
+    }
+}
+
+/**
+ * @brief Accept all pending connections.
+ */
+void SearchServer::accept_connections() {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN: no more pending connections
+        uint64_t id = next_id++;
+        Connection& conn = connections[id];
+        conn.fd = fd;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = id;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+/**
+ * @brief Read from a connection and dispatch complete requests.
+ * @param id The id of the connection.
+ *
+ * Every complete line is a request. Requests are dispatched in arrival order, which gives
+ * them increasing sequence numbers, so pipelined responses can be sent back in order.
+ */
+void SearchServer::read_requests(uint64_t id) {
+    Connection& conn = connections[id];
+    char buffer[4096];
+    while (true) {
+        ssize_t n = read(conn.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            conn.in.append(buffer, n);
+            continue;
+        }
+        if (n == 0) conn.eof = true; // the client closed its side
+        else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            close_connection(id); // broken connection, drop it
+            return;
+        }
+        break;
+    }
+
+    std::size_t begin = 0, end;
+    while ((end = conn.in.find('\n', begin)) != std::string::npos) {
+        std::string request = conn.in.substr(begin, end - begin);
+        if (!request.empty() && request.back() == '\r') request.pop_back();
+        if (!request.empty()) dispatch(id, conn, request); // ignore empty lines
+        begin = end + 1;
+    }
+    conn.in.erase(0, begin);
+    if (conn.in.size() > MAX_REQUEST_SIZE) {
+        close_connection(id); // refuse to buffer a line without end
+        return;
+    }
+    flush(id);
+}
+
+/**
+ * @brief Run one request on the workers, or reject it if too many requests are in flight.
+ * @param id The id of the connection.
+ * @param conn The connection.
+ * @param request The query.
+ */
+void SearchServer::dispatch(uint64_t id, Connection& conn, const std::string& request) {
+    uint64_t seq = conn.next_seq++;
+    if (in_flight >= options.max_pending) { // admission control
+        conn.ready[seq] = OVERLOADED_RESPONSE;
+        return;
+    }
+    in_flight++;
+    conn.in_flight++;
+    pool.submit([this, id, seq, request] {
+        std::ostringstream response;
+        try {
+            SearchEngine::SearchOptions query_options;
+            query_options.threshold = options.threshold;
+            query_options.fuzzy = options.fuzzy;
+            engine.search(request, response, query_options); // pin the current generation and delta
+        }
+        catch (const std::exception& error) { // still answer, or the responses after it are never sent
+            response.str("");
+            response << "Error: " << error.what() << "\n";
+        }
+        response << "\n"; // an empty line ends the response
+        {
+            std::lock_guard<std::mutex> lock(completions_mutex);
+            completions.push_back({ id, seq, response.str() });
+        }
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd, &one, sizeof(one));
+        (void)written; // the eventfd counter cannot overflow in practice
+    });
+}
+
+/**
+ * @brief Move worker results to their connections.
+ */
+void SearchServer::drain_completions() {
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        done.swap(completions);
+    }
+    for (auto& completion : done) {
+        in_flight--;
+        auto it = connections.find(completion.conn);
+        if (it == connections.end()) continue; // the connection was closed meanwhile
+        it->second.in_flight--;
+        it->second.ready[completion.seq] = std::move(completion.response);
+        flush(completion.conn);
+    }
+}
+
+/**
+ * @brief Queue ready responses in order and write as much as possible.
+ * @param id The id of the connection.
+ */
+void SearchServer::flush(uint64_t id) {
+    Connection& conn = connections[id];
+    for (auto it = conn.ready.begin(); it != conn.ready.end() && it->first == conn.next_send; it = conn.ready.erase(it)) {
+        conn.out += it->second;
+        conn.next_send++;
+    }
+
+    std::size_t sent = 0;
+    while (sent < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + sent, conn.out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break; // the socket buffer is full
+        close_connection(id); // the client is gone
+        return;
+    }
+    conn.out.erase(0, sent);
+
+    if (conn.eof && conn.in_flight == 0 && conn.ready.empty() && conn.out.empty()) {
+        close_connection(id); // everything the client asked for has been answered
+        return;
+    }
+    update_events(id, conn);
+}
+
+/**
+ * @brief Update the epoll interest of a connection.
+ * @param id The id of the connection.
+ * @param conn The connection.
+ *
+ * A connection is not read while too much of its output is unsent, which pushes back on
+ * clients that pipeline requests without reading responses.
+ */
+void SearchServer::update_events(uint64_t id, Connection& conn) {
+    epoll_event ev{};
+    ev.data.u64 = id;
+    if (!conn.eof && conn.out.size() < MAX_OUTPUT_SIZE) ev.events |= EPOLLIN;
+    if (!conn.out.empty()) ev.events |= EPOLLOUT;
+    if (ev.events == 0) {
+        // nothing to wait for, unregister so a hung up socket does not wake the loop again and again
+        if (conn.registered) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+        conn.registered = false;
+        return;
+    }
+    epoll_ctl(epoll_fd, conn.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn.fd, &ev);
+    conn.registered = true;
+}
+
+/**
+ * @brief Close a connection and forget it.
+ * @param id The id of the connection.
+ *
+ * Requests of the connection still running on the workers are dropped when they complete.
+ */
+void SearchServer::close_connection(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) return;
+    if (it->second.registered) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    connections.erase(it);
+}
+
+/**
+ * @brief Client mode: send one query to a server and print the response.
+ * @param socket_path The path of the server socket.
+ * @param query The query to send.
+ * @param output The output stream to print the response to.
+ * @return false if the server cannot be reached.
+ */
+bool SearchServer::query(const std::string& socket_path, const std::string& query, std::ostream& output) {
+    if (query.find_first_not_of(" \t\r\n") == std::string::npos) return true; // the server ignores empty requests
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+
+    std::string request = query + "\n";
+    for (std::size_t sent = 0; sent < request.size();) {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            close(fd);
+            return false;
+        }
+        sent += n;
+    }
+
+    // read until the empty line that ends the response
+    std::string response;
+    char buffer[4096];
+    while (response.size() < 2 || response.compare(response.size() - 2, 2, "\n\n") != 0) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        response.append(buffer, n);
+    }
+    close(fd);
+    if (response.size() >= 2 && response.compare(response.size() - 2, 2, "\n\n") == 0) {
+        response.pop_back(); // do not print the terminating empty line
+    }
+    output << response << std::flush;
+    return true;
+}
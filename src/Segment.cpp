@@ -0,0 +1,166 @@
+#include "Segment.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+
+#include "utils.h"
+
+/**
+ * @brief Load a segment.
+ * @param path The directory of the segment.
+ * @param doc_base The first document ID of the segment.
+ * @param deletions The deletion bitmap file of the segment, empty or missing if nothing is deleted.
+ *
+ * The document table and the index file are mapped. Only the offsets of the entries are kept,
+ * the posting lists are decoded from the mapping when they are searched, and the paths of the
+ * documents when they are printed.
+ */
+Segment::Segment(const std::filesystem::path& path, uint32_t doc_base, const std::filesystem::path& deletions) : dir(path), base(doc_base), docs(path) {
+    if (!deletions.empty()) {
+        deleted = read_deletions(deletions);
+        deleted.resize(docs.size(), false);
+        deleted_docs = static_cast<uint32_t>(std::count(deleted.begin(), deleted.end(), true));
+        if (deleted_docs == 0) deleted.clear();
+    }
+
+    index = MappedFile(dir / INDEX_FILE_NAME); // stays readable even if the segment is removed
+    uint32_t size = 0;
+    if (index.size() >= sizeof(size)) {
+        memcpy(&size, index.data(), sizeof(size)); // read the number of indexed words
+    }
+    std::size_t pos = sizeof(size);
+    words.reserve(size);
+    for (uint32_t i = 0; i < size; i++) {
+        std::string word;
+        FileIndex::Entry entry;
+        std::size_t length = FileIndex::decode_entry(index.data() + pos, index.size() - pos, word, entry);
+        if (length == 0) break; // truncated index file
+        words.insert({ word, static_cast<Offset>(pos) }); // insert the word and its offset into the map
+        pos += length;
+    }
+}
+
+/**
+ * @brief Find the offset of a word's entry in the index file.
+ * @param word The word to find.
+ * @param offset The offset of the entry, if found.
+ * @return true if the word is in the segment.
+ */
+bool Segment::find(const std::string& word, Offset& offset) const {
+    auto it = words.find(word);
+    if (it == words.end()) return false;
+    offset = it->second;
+    return true;
+}
+
+/**
+ * @brief Decode the entry at an offset of the index file.
+ * @param offset The offset of the entry.
+ * @param entry The decoded entry.
+ * @return The number of bytes the entry takes in the index file.
+ */
+std::size_t Segment::read(Offset offset, FileIndex::Entry& entry) const {
+    std::string word;
+    return FileIndex::decode_entry(index.data() + offset, index.size() - offset, word, entry);
+}
+
+/**
+ * @brief Check how much of the entry at an offset is in the page cache.
+ * @param offset The offset of the entry.
+ * @return The number of resident pages and the number of pages of the entry.
+ *
+ * The length of the entry is in its header, so the first page is checked before the header is
+ * read, then the rest of the entry.
+ */
+std::pair<std::size_t, std::size_t> Segment::residency(Offset offset) const {
+    std::size_t first_resident = index.residency(offset, 1).first; // before touching the entry
+    uint32_t word_len = 0, num_doc = 0;
+    if (offset + sizeof(word_len) > index.size()) return { 0, 0 };
+    memcpy(&word_len, index.data() + offset, sizeof(word_len));
+    std::size_t pos = offset + sizeof(word_len) + word_len + sizeof(uint32_t); // skip the word and the frequency
+    if (pos + sizeof(num_doc) > index.size()) return { 0, 0 };
+    memcpy(&num_doc, index.data() + pos, sizeof(num_doc));
+    std::size_t length = pos + sizeof(num_doc) + num_doc * sizeof(uint32_t) - offset;
+    auto [resident, pages] = index.residency(offset, length);
+    if (resident == 0) return { first_resident, pages }; // mincore failed, the header page was read all the same
+    return { resident - 1 + first_resident, pages }; // the first page was brought in by reading the header
+}
+
+/**
+ * @brief List the words of the segment with their document frequencies.
+ * @return The (word, document frequency) pairs, in ascending order of words.
+ *
+ * The index file is sorted, so this is a scan of the mapping in file order.
+ */
+std::vector<std::pair<std::string, uint32_t>> Segment::terms() const {
+    std::vector<std::pair<std::string, uint32_t>> result;
+    result.reserve(words.size());
+    uint32_t size = 0;
+    if (index.size() >= sizeof(size)) {
+        memcpy(&size, index.data(), sizeof(size));
+    }
+    std::size_t pos = sizeof(size);
+    for (uint32_t i = 0; i < size; i++) {
+        std::string word;
+        FileIndex::Entry entry;
+        std::size_t length = FileIndex::decode_entry(index.data() + pos, index.size() - pos, word, entry);
+        if (length == 0) break;
+        result.push_back({ word, static_cast<uint32_t>(entry.docs.size()) });
+        pos += length;
+    }
+    return result;
+}
+
+/**
+ * @brief Save a deletion bitmap.
+ * @param filename The bitmap file.
+ * @param deleted One flag per document of the segment.
+ */
+void Segment::save_deletions(const std::filesystem::path& filename, const std::vector<bool>& deleted) {
+    std::ofstream output(filename, std::ios::binary);
+    uint32_t size = static_cast<uint32_t>(deleted.size());
+    output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    std::vector<uint8_t> bytes((size + 7) / 8, 0);
+    for (uint32_t i = 0; i < size; i++) {
+        if (deleted[i]) bytes[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+    }
+    output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+/**
+ * @brief Read a deletion bitmap.
+ * @param filename The bitmap file.
+ * @return The flags, empty if the file does not exist.
+ */
+std::vector<bool> Segment::read_deletions(const std::filesystem::path& filename) {
+    std::vector<bool> deleted;
+    std::ifstream input(filename, std::ios::binary);
+    uint32_t size = 0;
+    if (!input.read(reinterpret_cast<char*>(&size), sizeof(size))) return deleted;
+    std::vector<uint8_t> bytes((size + 7) / 8, 0);
+    input.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    deleted.resize(size);
+    for (uint32_t i = 0; i < size; i++) {
+        deleted[i] = (bytes[i / 8] >> (i % 8)) & 1;
+    }
+    return deleted;
+}
+
+/**
+ * @brief Estimate the memory of the segment.
+ * @return The heap bytes of its "words", "files" and "deletions", and the mapped and resident
+ * bytes of its index file and document table.
+ */
+MemoryUsage Segment::memory_usage() const {
+    MemoryUsage usage;
+    usage.add("words", heap_size(words));
+    usage.add("files", docs.memory_usage());
+    usage.add("deletions", heap_size(deleted));
+    static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    usage.mapped = index.size() + docs.mapped_size();
+    uint64_t pages = index.residency(0, index.size()).first + docs.residency().first;
+    usage.resident = std::min<uint64_t>(pages * page_size, usage.mapped);
+    return usage;
+}
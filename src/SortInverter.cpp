@@ -0,0 +1,144 @@
+#include "SortInverter.h"
+
+#include <array>
+#include <algorithm>
+
+namespace {
+    const uint32_t NO_DOC = UINT32_MAX; ///< The last document of a term not seen since the last finish().
+    const unsigned RADIX_BITS = 8; ///< The bits sorted by each pass.
+    const std::size_t BUCKETS = std::size_t(1) << RADIX_BITS; ///< The buckets of each pass.
+    const std::size_t MIN_BLOCK = 1 << 14; ///< The smallest block worth a thread.
+}
+
+/**
+ * @brief Create an empty inverter.
+ * @param options The options.
+ */
+SortInverter::SortInverter(const Options& options)
+    : buffer_pairs(std::max<std::size_t>(options.buffer_pairs, 1)), pool(options.threads) {
+    pairs.reserve(buffer_pairs);
+}
+
+/**
+ * @brief Adds occurrences of a token, as FileIndex::add_token.
+ *
+ * The tokens of a document must be added before those of any later document.
+ *
+ * @param token The stemmed token.
+ * @param id The unique identifier of the document containing the token.
+ * @param count The number of occurrences to add.
+ */
+void SortInverter::add_token(const std::string& token, uint32_t id, uint32_t count) {
+    uint32_t term = dictionary.id(token);
+    if (term == freqs.size()) { // a new term
+        freqs.push_back(0);
+        last_docs.push_back(NO_DOC);
+        postings.emplace_back();
+    }
+    freqs[term] += count;
+    if (last_docs[term] == id) return; // the document is already in the buffer or the posting list
+    last_docs[term] = id;
+    pairs.push_back(static_cast<uint64_t>(term) << 32 | id);
+    if (pairs.size() == buffer_pairs) flush();
+}
+
+/**
+ * @brief Sort the buffer and append its pairs to the posting lists.
+ *
+ * The sorted buffer is split between the threads at term boundaries, so every posting list is
+ * appended to by one thread.
+ */
+void SortInverter::flush() {
+    if (pairs.empty()) return;
+    unsigned key_bits = 0;
+    while (key_bits < 32 && (dictionary.size() - 1) >> key_bits) key_bits++;
+    radix_sort(pairs, scratch, key_bits, pool);
+    sort_count++;
+
+    std::size_t n = pairs.size();
+    std::size_t threads = std::clamp<std::size_t>(n / MIN_BLOCK, 1, pool.size());
+    std::size_t begin = 0;
+    for (std::size_t t = 0; t < threads; t++) {
+        std::size_t end = t + 1 == threads ? n : std::max(begin, n * (t + 1) / threads);
+        while (end < n && end > begin && pairs[end] >> 32 == pairs[end - 1] >> 32) end++; // do not split a term
+        pool.submit([this, begin, end] {
+            for (std::size_t i = begin; i < end; i++) postings[pairs[i] >> 32].push_back(static_cast<uint32_t>(pairs[i]));
+        });
+        begin = end;
+    }
+    pool.wait();
+    pairs.clear();
+}
+
+/**
+ * @brief Move the posting lists built so far into an index, and start over empty.
+ * @param index The index, the documents added must be later than those it holds.
+ */
+void SortInverter::finish(FileIndex& index) {
+    flush();
+    for (uint32_t term : dictionary.sorted_ids()) {
+        FileIndex::Entry entry;
+        entry.freq = freqs[term];
+        entry.docs = std::move(postings[term]);
+        index.add_entry(dictionary.term(term), std::move(entry));
+    }
+    dictionary.clear();
+    freqs.clear();
+    last_docs.clear();
+    postings.clear();
+}
+
+/**
+ * @brief Sort (term ID, document ID) pairs by term ID, with a parallel and stable LSD radix sort.
+ * @param pairs The pairs, the term ID in the high 32 bits, sorted in place.
+ * @param scratch A buffer, resized to the size of pairs and clobbered.
+ * @param key_bits The number of significant bits of the term IDs.
+ * @param pool The threads sorting, each takes a block of the pairs.
+ *
+ * Each pass sorts by one byte of the term IDs: every thread counts the bytes of its block,
+ * the counts give every thread its offset in each bucket, then every thread moves its block
+ * to those offsets. Passes where all pairs have the same byte are skipped.
+ */
+void SortInverter::radix_sort(std::vector<uint64_t>& pairs, std::vector<uint64_t>& scratch, unsigned key_bits, ThreadPool& pool) {
+    std::size_t n = pairs.size();
+    scratch.resize(n);
+    std::size_t threads = std::clamp<std::size_t>(n / MIN_BLOCK, 1, pool.size());
+    std::vector<std::array<std::size_t, BUCKETS>> offsets(threads);
+    uint64_t* from = pairs.data();
+    uint64_t* to = scratch.data();
+    for (unsigned shift = 32; shift < 32 + key_bits; shift += RADIX_BITS) {
+        for (std::size_t t = 0; t < threads; t++) {
+            pool.submit([&, t, shift] {
+                std::array<std::size_t, BUCKETS>& count = offsets[t];
+                count.fill(0);
+                for (std::size_t i = n * t / threads; i < n * (t + 1) / threads; i++) count[(from[i] >> shift) & (BUCKETS - 1)]++;
+            });
+        }
+        pool.wait();
+
+        // bucket by bucket, and thread by thread within a bucket, so the sort is stable
+        std::size_t sum = 0;
+        bool skip = false;
+        for (std::size_t b = 0; b < BUCKETS; b++) {
+            std::size_t bucket = 0;
+            for (std::size_t t = 0; t < threads; t++) {
+                std::size_t count = offsets[t][b];
+                offsets[t][b] = sum;
+                sum += count;
+                bucket += count;
+            }
+            skip = skip || bucket == n; // every pair has the same byte
+        }
+        if (skip) continue;
+
+        for (std::size_t t = 0; t < threads; t++) {
+            pool.submit([&, t, shift] {
+                std::array<std::size_t, BUCKETS>& offset = offsets[t];
+                for (std::size_t i = n * t / threads; i < n * (t + 1) / threads; i++) to[offset[(from[i] >> shift) & (BUCKETS - 1)]++] = from[i];
+            });
+        }
+        pool.wait();
+        std::swap(from, to);
+    }
+    if (from != pairs.data()) pairs.swap(scratch);
+}
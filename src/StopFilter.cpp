@@ -1,48 +1,113 @@
-#include "StopFilter.h"
-
-#include <fstream>
-#include <iostream>
-#include <string>
-
-/**
- * @brief Constructor to load stop words from a file.
- * @param stop_words_file The path to the file containing stop words.
- *
- * This constructor reads the stop words from the specified file and inserts
- * them into the stop_words set for efficient checking.
- */
-StopFilter::StopFilter(const std::filesystem::path& stop_words_file) {
-    std::ifstream input(stop_words_file);
-    std::string word;
-
-    // Read words from the file and insert them into the stop_words set
-    while (input >> word) {
-        if (!word.empty()) {
-            stop_words.insert(word);
-        }
-    }
-}
-
-/**
- * @brief Check if a word is a stop word.
- * @param word The word to check.
- * @return true if the word is a stop word, false otherwise.
- *
- * This method checks if the word is present in the stop_words set.
- * It also considers words with less than 3 characters as stop words.
- */
-bool StopFilter::is_stop(const std::string& word) const {
-    if (word.size() < 3) return true; // Treat short words as stop words
-    return stop_words.find(word) != stop_words.end(); // Check set for stop word
-}
-
-/**
- * @brief Print the stop words set.
- * @param output The output stream to print to.
- * This method prints the stop words set to the specified output stream.
- */
-void StopFilter::print(std::ostream& output) const {
-    for (const auto& word : stop_words) {
-        output << word << std::endl;
-    }
-}
\ No newline at end of file
+#include "StopFilter.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <functional>
+
+#include "MemoryUsage.h"
+
+namespace {
+    /**
+     * @brief The bits of the Bloom filter per stop word, about 1.4% false positives with two bits set per word.
+     */
+    const std::size_t BLOOM_BITS_PER_WORD = 16;
+}
+
+/**
+ * @brief Hash a word for the table and the Bloom filter.
+ *
+ * std::hash is mixed (splitmix64 finalizer), so its low and high bits are both usable.
+ */
+uint64_t StopFilter::hash(std::string_view word) {
+    uint64_t hash = std::hash<std::string_view>{}(word);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+/**
+ * @brief Constructor to load stop words from a file.
+ * @param stop_words_file The path to the file containing stop words.
+ *
+ * This constructor reads the stop words from the specified file, then builds a table of
+ * at least twice as many slots as words, and the Bloom filter.
+ */
+StopFilter::StopFilter(const std::filesystem::path& stop_words_file) {
+    std::ifstream input(stop_words_file);
+    std::string word;
+
+    // Read words from the file, and insert them into the table, skipping duplicates
+    table.assign(16, 0);
+    auto insert = [this](uint32_t id) {
+        std::size_t mask = table.size() - 1;
+        for (std::size_t slot = hash(stop_words[id]) & mask; ; slot = (slot + 1) & mask) {
+            if (table[slot] == 0) {
+                table[slot] = id + 1;
+                return true;
+            }
+            if (stop_words[table[slot] - 1] == stop_words[id]) return false;
+        }
+    };
+    while (input >> word) {
+        if (word.empty()) continue;
+        stop_words.push_back(word);
+        if (!insert(stop_words.size() - 1)) {
+            stop_words.pop_back(); // duplicate
+            continue;
+        }
+        if (stop_words.size() * 2 > table.size()) { // keep the load at most 1/2
+            table.assign(table.size() * 2, 0);
+            for (uint32_t id = 0; id < stop_words.size(); id++) insert(id);
+        }
+    }
+
+    std::size_t bits = 64;
+    while (bits < stop_words.size() * BLOOM_BITS_PER_WORD) bits *= 2;
+    bloom.assign(bits / 64, 0);
+    for (const std::string& stop_word : stop_words) {
+        uint64_t h = hash(stop_word);
+        uint64_t a = (h >> 32) & (bits - 1), b = (h >> 8) & (bits - 1);
+        bloom[a / 64] |= uint64_t{ 1 } << (a % 64);
+        bloom[b / 64] |= uint64_t{ 1 } << (b % 64);
+    }
+}
+
+/**
+ * @brief Check if a word is a stop word.
+ * @param word The word to check.
+ * @return true if the word is a stop word, false otherwise.
+ *
+ * This method checks if the word is present in the stop words set.
+ * It also considers words with less than 3 characters as stop words.
+ */
+bool StopFilter::is_stop(std::string_view word) const {
+    if (word.size() < 3) return true; // Treat short words as stop words
+    uint64_t h = hash(word);
+    std::size_t bits = bloom.size() * 64;
+    uint64_t a = (h >> 32) & (bits - 1), b = (h >> 8) & (bits - 1);
+    if (!(bloom[a / 64] >> (a % 64) & 1) || !(bloom[b / 64] >> (b % 64) & 1)) return false; // Most words stop here
+    std::size_t mask = table.size() - 1;
+    for (std::size_t slot = h & mask; table[slot] != 0; slot = (slot + 1) & mask) {
+        if (stop_words[table[slot] - 1] == word) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Print the stop words set.
+ * @param output The output stream to print to.
+ * This method prints the stop words set to the specified output stream.
+ */
+void StopFilter::print(std::ostream& output) const {
+    for (const auto& word : stop_words) {
+        output << word << std::endl;
+    }
+}
+/**
+ * @brief Estimate the heap memory of the stop words set.
+ * @return The bytes, see MemoryUsage.
+ */
+uint64_t StopFilter::memory_usage() const {
+    return heap_size(stop_words) + heap_size(table) + heap_size(bloom);
+}
@@ -0,0 +1,44 @@
+#include "TermDictionary.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "MemoryUsage.h"
+
+/**
+ * @brief Get the ID of a term, assigning the next one if it is new.
+ * @param term The term.
+ * @return The ID of the term.
+ */
+uint32_t TermDictionary::id(const std::string& term) {
+    auto [it, added] = ids.try_emplace(term, static_cast<uint32_t>(terms.size()));
+    if (added) terms.push_back(&it->first); // the keys of an unordered_map never move
+    return it->second;
+}
+
+/**
+ * @brief Get the IDs in lexicographic order of their terms.
+ * @return The ID of the term of each lexicographic rank.
+ */
+std::vector<uint32_t> TermDictionary::sorted_ids() const {
+    std::vector<uint32_t> sorted(terms.size());
+    std::iota(sorted.begin(), sorted.end(), 0);
+    std::sort(sorted.begin(), sorted.end(), [this](uint32_t a, uint32_t b) { return *terms[a] < *terms[b]; });
+    return sorted;
+}
+
+/**
+ * @brief Remove all terms, IDs start from 0 again.
+ */
+void TermDictionary::clear() {
+    ids.clear();
+    terms.clear();
+}
+
+/**
+ * @brief Estimate the heap memory of the dictionary.
+ * @return The bytes of the terms, the hash table and the ID table, see MemoryUsage.
+ */
+uint64_t TermDictionary::memory_usage() const {
+    return heap_size(ids) + heap_size(terms);
+}
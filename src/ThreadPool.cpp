@@ -0,0 +1,143 @@
+#include "ThreadPool.h"
+
+#include <utility>
+
+namespace {
+    thread_local const ThreadPool* current_pool = nullptr; ///< The pool the current thread works for, if any.
+    thread_local std::size_t current_worker = 0; ///< The index of the current thread in current_pool.
+}
+
+/**
+ * @brief Start the worker threads.
+ * @param threads The number of worker threads, 0 means one per hardware thread.
+ */
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1; // hardware_concurrency() may be unknown
+    for (unsigned i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        this->threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+/**
+ * @brief Wait for all submitted tasks, then stop the worker threads.
+ *
+ * An exception no wait() rethrew is dropped, a destructor cannot throw.
+ */
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return pending == 0; });
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Submit a task to the pool.
+ * @param task The task to run.
+ *
+ * A task submitted from a worker thread goes to that worker's own queue.
+ */
+void ThreadPool::submit(std::function<void()> task) {
+    std::size_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++; // count the task before any worker can see it
+        id = (current_pool == this) ? current_worker : next_queue++ % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[id]->mutex);
+        queues[id]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued++;
+    }
+    work_cv.notify_one();
+}
+
+/**
+ * @brief Block until all submitted tasks have finished.
+ *
+ * If a task threw since the last wait(), the first exception is rethrown, once every task
+ * has finished.
+ */
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0; });
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+/**
+ * @brief The main loop of a worker thread.
+ * @param id The index of the worker.
+ *
+ * A worker first reserves a task by decrementing the queued counter, so it never spins
+ * on empty queues, then takes the task from its own queue or steals it.
+ */
+void ThreadPool::run(std::size_t id) {
+    current_pool = this;
+    current_worker = id;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_cv.wait(lock, [this] { return stopping || queued > 0; });
+            if (queued == 0) return; // stopping and nothing left to do
+            queued--; // reserve one task
+        }
+
+        std::function<void()> task;
+        while (!take(id, task)) {
+            std::this_thread::yield(); // the reserved task is being pushed by submit()
+        }
+        std::exception_ptr thrown;
+        try {
+            task();
+        }
+        catch (...) {
+            thrown = std::current_exception(); // still count the task as finished, or wait() blocks forever
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (thrown && !error) error = thrown;
+        if (--pending == 0) done_cv.notify_all();
+    }
+}
+
+/**
+ * @brief Take a task, from the worker's own queue first, otherwise steal one.
+ * @param id The index of the worker.
+ * @param task The task taken.
+ * @return true if a task was taken.
+ *
+ * The owner takes from the back (most recently submitted, cache friendly),
+ * thieves take from the front (oldest).
+ */
+bool ThreadPool::take(std::size_t id, std::function<void()>& task) {
+    {
+        Queue& own = *queues[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < queues.size(); i++) {
+        Queue& victim = *queues[(id + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
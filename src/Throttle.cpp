@@ -0,0 +1,23 @@
+#include "Throttle.h"
+
+#include <thread>
+
+/**
+ * @brief Create a throttle.
+ * @param bytes_per_second The maximum rate, 0 means unlimited.
+ */
+Throttle::Throttle(uint64_t bytes_per_second) : rate(bytes_per_second), start(std::chrono::steady_clock::now()) {}
+
+/**
+ * @brief Account for bytes written, and sleep if the rate is exceeded.
+ * @param bytes The number of bytes written since the last call.
+ */
+void Throttle::consume(std::size_t bytes) {
+    if (rate == 0) return;
+    total += bytes;
+    // the time the bytes written so far should have taken, minus a burst allowance of 100 ms
+    auto due = start + std::chrono::microseconds(total * 1000000 / rate) - std::chrono::milliseconds(100);
+    if (due > std::chrono::steady_clock::now()) {
+        std::this_thread::sleep_until(due);
+    }
+}
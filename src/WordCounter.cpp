@@ -1,37 +1,190 @@
-#include "WordCounter.h"
-
-#include <string>
-#include <vector>
-#include <algorithm>
-
-/**
- * @brief Add a word to the counter.
- * @param word The word to be added to the counter.
- *
- * This method increments the count of the specified word.
- */
-void WordCounter::add_word(const std::string& word) {
-    word_count[word]++;
-}
-
-
-/**
- * @brief Print the word count result.
- * @param output The output stream to print the results.
- *
- * This method prints the words and their corresponding counts in
- * descending order of frequency.
- */
-void WordCounter::print(std::ostream& output) {
-    std::vector<Entry> word_list(word_count.begin(), word_count.end());
-
-    // Sort the words by frequency in descending order
-    std::sort(word_list.begin(), word_list.end(), [](const Entry& a, const Entry& b) {
-        return b.second < a.second;
-        });
-
-    // Print each word and its count
-    for (const auto& entry : word_list) {
-        output << entry.first << ": " << entry.second << std::endl;
-    }
-}
\ No newline at end of file
+#include "WordCounter.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+
+#include "ThreadPool.h"
+#include "utils.h"
+
+namespace {
+    /**
+     * @brief Order words by descending count, then ascending word.
+     * @return true if a comes before b in the output.
+     */
+    template <typename A, typename B>
+    bool before(const A& a, const B& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    }
+
+    /**
+     * @brief The number of distinct words a thread counts locally before merging them into the shards.
+     */
+    const std::size_t LOCAL_WORDS = 1 << 16;
+}
+
+/**
+ * @brief Create an empty counter.
+ * @param shards The number of shards, at least 1.
+ */
+WordCounter::WordCounter(std::size_t shards) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(shards, 1); i++) {
+        this->shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+/**
+ * @brief Get the shard of a word.
+ * @param word The word.
+ * @return The index of its shard.
+ */
+std::size_t WordCounter::shard_of(const std::string& word) const {
+    return shards.size() == 1 ? 0 : std::hash<std::string>{}(word) % shards.size();
+}
+
+/**
+ * @brief Add a word to the counter.
+ * @param word The word to be added to the counter.
+ *
+ * This method increments the count of the specified word.
+ */
+void WordCounter::add_word(const std::string& word) {
+    shards[shard_of(word)]->counts[word]++;
+}
+
+/**
+ * @brief Add the words of a file to the counter.
+ * @param filename The file to tokenize.
+ * @return false if the file cannot be opened.
+ */
+bool WordCounter::add_file(const std::string& filename) {
+    std::ifstream input(filename);
+    if (!input.is_open()) return false;
+    std::string word; // reused, so counting known words allocates nothing
+    while (tokenize(input, word)) { // Iterate over all words in the file
+        add_word(word);
+    }
+    return true;
+}
+
+/**
+ * @brief Merge counts made by one thread, and clear them.
+ * @param local The counts, one map per shard as split by shard_of.
+ *
+ * Each shard is locked once, so threads merging at the same time rarely wait.
+ */
+void WordCounter::add_counts(std::vector<std::unordered_map<std::string, uint64_t>>& local) {
+    for (std::size_t i = 0; i < shards.size(); i++) {
+        if (local[i].empty()) continue;
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        for (auto& [word, count] : local[i]) shards[i]->counts[word] += count;
+        local[i].clear();
+    }
+}
+
+/**
+ * @brief Count the words of files with several threads.
+ * @param files The files to tokenize.
+ * @param threads The number of threads, 0 means one per hardware thread.
+ * @param failed If not nullptr, the files that cannot be opened are added to it, in input order.
+ * @return The counter, with one shard per thread.
+ *
+ * Every thread takes the next file to count, and counts into small maps of its own, split by
+ * shard. Once they hold LOCAL_WORDS distinct words, they are merged into the shared shards.
+ * The memory used on top of the final counts is thus bounded, whatever the size of the files.
+ */
+WordCounter WordCounter::count_files(const std::vector<std::string>& files, unsigned threads, std::vector<std::string>* failed) {
+    ThreadPool pool(threads);
+    WordCounter counter(pool.size());
+    std::atomic<std::size_t> next{ 0 };
+    std::vector<char> opened(files.size(), 1); // not vector<bool>, whose flags share bytes between threads
+    for (std::size_t t = 0; t < pool.size(); t++) {
+        pool.submit([&counter, &files, &next, &opened] {
+            std::vector<std::unordered_map<std::string, uint64_t>> local(counter.shards.size());
+            std::size_t local_words = 0;
+            std::string word;
+            for (std::size_t i = next++; i < files.size(); i = next++) {
+                std::ifstream input(files[i]);
+                if (!input.is_open()) {
+                    opened[i] = 0;
+                    continue;
+                }
+                while (tokenize(input, word)) {
+                    auto& count = local[counter.shard_of(word)][word];
+                    if (count++ == 0) local_words++;
+                }
+                if (local_words >= LOCAL_WORDS) {
+                    counter.add_counts(local);
+                    local_words = 0;
+                }
+            }
+            counter.add_counts(local);
+        });
+    }
+    pool.wait();
+    for (std::size_t i = 0; i < files.size(); i++) {
+        if (!opened[i] && failed) failed->push_back(files[i]);
+    }
+    return counter;
+}
+
+/**
+ * @brief Get the number of distinct words.
+ * @return The number of words counted.
+ */
+std::size_t WordCounter::size() const {
+    std::size_t words = 0;
+    for (auto& shard : shards) words += shard->counts.size();
+    return words;
+}
+
+/**
+ * @brief Get the most frequent words.
+ * @param n The number of words, 0 for all of them.
+ * @return The words and their counts, in descending order of frequency, ties in ascending order of words.
+ *
+ * The top n are selected with a heap of n entries, in O(words * log n) time, so only the words
+ * returned are copied and sorted.
+ */
+std::vector<WordCounter::Entry> WordCounter::top(std::size_t n) const {
+    if (n == 0 || n > size()) n = size();
+    std::vector<const std::pair<const std::string, uint64_t>*> heap; // the best n so far, the worst on top
+    heap.reserve(n);
+    auto worse = [](auto* a, auto* b) { return before(*a, *b); };
+    for (auto& shard : shards) {
+        for (auto& entry : shard->counts) {
+            if (heap.size() < n) {
+                heap.push_back(&entry);
+                std::push_heap(heap.begin(), heap.end(), worse);
+            }
+            else if (n > 0 && before(entry, *heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), worse);
+                heap.back() = &entry;
+                std::push_heap(heap.begin(), heap.end(), worse);
+            }
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), worse);
+    std::vector<Entry> result;
+    result.reserve(heap.size());
+    for (auto* entry : heap) result.push_back(*entry);
+    return result;
+}
+
+/**
+ * @brief Print the word count result.
+ * @param output The output stream to print the results.
+ * @param n The number of words to print, 0 for all of them.
+ *
+ * This method prints the words and their corresponding counts in
+ * descending order of frequency. Words with the same count are printed in ascending order.
+ */
+void WordCounter::print(std::ostream& output, std::size_t n) const {
+    // Print each word and its count
+    for (const auto& entry : top(n)) {
+        output << entry.first << ": " << entry.second << "\n";
+    }
+    output.flush();
+}
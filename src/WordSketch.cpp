@@ -0,0 +1,262 @@
+#include "WordSketch.h"
+
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "MemoryUsage.h"
+#include "ThreadPool.h"
+#include "utils.h"
+
+namespace {
+    /**
+     * @brief The estimated bytes of one counter: the counter, its heap slot, and its index node and bucket.
+     *
+     * Words longer than the small string buffer take their length on top of it.
+     */
+    const std::size_t COUNTER_BYTES = 128;
+
+    /**
+     * @brief The bounds of log2 of the number of HyperLogLog registers.
+     */
+    const unsigned MIN_HLL_BITS = 4, MAX_HLL_BITS = 16;
+
+    /**
+     * @brief The number of distinct words a thread counts locally before adding them to the sketch.
+     */
+    const std::size_t LOCAL_WORDS = 1 << 12;
+
+    /**
+     * @brief Mix the bits of a hash, so std::hash can feed HyperLogLog (splitmix64 finalizer).
+     */
+    uint64_t mix(uint64_t hash) {
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return hash ^ (hash >> 31);
+    }
+}
+
+/**
+ * @brief Create an empty sketch.
+ * @param memory_bytes The memory of the sketch, split between the counters and the HyperLogLog registers.
+ *
+ * The registers take about a sixteenth of the memory, with 2^4 to 2^16 registers of one byte.
+ * The counters take the rest, at least one.
+ */
+WordSketch::WordSketch(std::size_t memory_bytes) {
+    hll_bits = MIN_HLL_BITS;
+    while (hll_bits < MAX_HLL_BITS && (std::size_t{ 2 } << hll_bits) <= memory_bytes / 16) hll_bits++;
+    hll.assign(std::size_t{ 1 } << hll_bits, 0);
+    std::size_t counter_bytes = memory_bytes > hll.size() ? memory_bytes - hll.size() : 0;
+    std::size_t k = std::max<std::size_t>(counter_bytes / COUNTER_BYTES, 1);
+    counters.reserve(k);
+    heap.reserve(k);
+    index.reserve(k);
+}
+
+/**
+ * @brief Swap two positions of the heap.
+ */
+void WordSketch::swap_heap(std::size_t a, std::size_t b) {
+    std::swap(heap[a], heap[b]);
+    counters[heap[a]].position = a;
+    counters[heap[b]].position = b;
+}
+
+/**
+ * @brief Restore the heap order around a counter whose count grew.
+ * @param position The position of the counter in heap.
+ */
+void WordSketch::sift_down(std::size_t position) {
+    while (true) {
+        std::size_t smallest = position;
+        for (std::size_t child = 2 * position + 1; child <= 2 * position + 2 && child < heap.size(); child++) {
+            if (counters[heap[child]].count < counters[heap[smallest]].count) smallest = child;
+        }
+        if (smallest == position) return;
+        swap_heap(position, smallest);
+        position = smallest;
+    }
+}
+
+/**
+ * @brief Restore the heap order around a new counter.
+ * @param position The position of the counter in heap.
+ */
+void WordSketch::sift_up(std::size_t position) {
+    while (position > 0) {
+        std::size_t parent = (position - 1) / 2;
+        if (counters[heap[parent]].count <= counters[heap[position]].count) return;
+        swap_heap(position, parent);
+        position = parent;
+    }
+}
+
+/**
+ * @brief Count a word.
+ * @param word The word.
+ * @param count The number of occurrences.
+ *
+ * A tracked word has its counter incremented. Otherwise, the word takes a free counter, or
+ * the smallest one, whose count becomes its error: the word may have occurred that many times
+ * while untracked. Every update is O(log capacity()).
+ */
+void WordSketch::add_word(std::string_view word, uint64_t count) {
+    total += count;
+    uint64_t hash = mix(std::hash<std::string_view>{}(word));
+    uint64_t rest = hash << hll_bits;
+    uint8_t rank = rest == 0 ? 64 - hll_bits + 1 : __builtin_clzll(rest) + 1;
+    uint8_t& reg = hll[hash >> (64 - hll_bits)];
+    reg = std::max(reg, rank);
+
+    auto found = index.find(word);
+    if (found != index.end()) {
+        counters[found->second].count += count;
+        sift_down(counters[found->second].position);
+        return;
+    }
+    if (counters.size() < counters.capacity()) {
+        uint32_t id = counters.size();
+        counters.push_back({ std::string(word), count, 0, static_cast<uint32_t>(heap.size()) });
+        heap.push_back(id);
+        index.emplace(counters[id].word, id);
+        sift_up(heap.size() - 1);
+        return;
+    }
+    uint32_t id = heap.front();
+    Counter& smallest = counters[id];
+    index.erase(smallest.word);
+    smallest.word.assign(word);
+    smallest.error = smallest.count;
+    smallest.count += count;
+    index.emplace(smallest.word, id);
+    sift_down(0);
+}
+
+/**
+ * @brief Count the words of files with several threads.
+ * @param files The files to tokenize.
+ * @param memory_bytes The memory of the sketch, see WordSketch().
+ * @param threads The number of threads, 0 means one per hardware thread.
+ * @param failed If not nullptr, the files that cannot be opened are added to it, in input order.
+ * @return The sketch.
+ *
+ * Every thread takes the next file to count, and counts into a small map of its own. Once it
+ * holds LOCAL_WORDS distinct words, it is added to the shared sketch under a lock. Adding a
+ * word with its count keeps the guarantees of the sketch, and the memory used on top of it is
+ * bounded by the number of threads.
+ */
+WordSketch WordSketch::count_files(const std::vector<std::string>& files, std::size_t memory_bytes, unsigned threads, std::vector<std::string>* failed) {
+    ThreadPool pool(threads);
+    WordSketch sketch(memory_bytes);
+    std::mutex mutex;
+    std::atomic<std::size_t> next{ 0 };
+    std::vector<char> opened(files.size(), 1); // not vector<bool>, whose flags share bytes between threads
+    for (std::size_t t = 0; t < pool.size(); t++) {
+        pool.submit([&sketch, &mutex, &files, &next, &opened] {
+            std::unordered_map<std::string, uint64_t> local;
+            std::string token;
+            auto flush = [&] {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto& [word, count] : local) sketch.add_word(word, count);
+                local.clear();
+            };
+            for (std::size_t i = next++; i < files.size(); i = next++) {
+                std::ifstream input(files[i]);
+                if (!input.is_open()) {
+                    opened[i] = 0;
+                    continue;
+                }
+                while (tokenize(input, token)) {
+                    local[token]++;
+                    if (local.size() >= LOCAL_WORDS) flush();
+                }
+            }
+            flush();
+        });
+    }
+    pool.wait();
+    for (std::size_t i = 0; i < files.size(); i++) {
+        if (!opened[i] && failed) failed->push_back(files[i]);
+    }
+    return sketch;
+}
+
+/**
+ * @brief Estimate the number of distinct words.
+ * @return The estimate, see distinct_error() for its accuracy.
+ *
+ * This is the HyperLogLog estimate, with linear counting for small cardinalities.
+ */
+double WordSketch::distinct() const {
+    double m = hll.size();
+    double sum = 0;
+    std::size_t zeros = 0;
+    for (uint8_t reg : hll) {
+        sum += std::ldexp(1.0, -reg);
+        if (reg == 0) zeros++;
+    }
+    double alpha = hll.size() == 16 ? 0.673 : hll.size() == 32 ? 0.697 : hll.size() == 64 ? 0.709 : 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * std::log(m / zeros);
+    return estimate;
+}
+
+/**
+ * @brief Get the relative standard error of distinct().
+ * @return The error, e.g. 0.008 for 0.8%.
+ */
+double WordSketch::distinct_error() const {
+    return 1.04 / std::sqrt(static_cast<double>(hll.size()));
+}
+
+/**
+ * @brief Get the most frequent words.
+ * @param n The number of words, 0 for all tracked words.
+ * @return The words with their estimated counts and errors, in descending order of counts, ties in ascending order of words.
+ */
+std::vector<WordSketch::Entry> WordSketch::top(std::size_t n) const {
+    std::vector<const Counter*> sorted;
+    sorted.reserve(counters.size());
+    for (auto& counter : counters) sorted.push_back(&counter);
+    if (n == 0 || n > sorted.size()) n = sorted.size();
+    auto before = [](const Counter* a, const Counter* b) {
+        return a->count != b->count ? a->count > b->count : a->word < b->word;
+    };
+    std::partial_sort(sorted.begin(), sorted.begin() + n, sorted.end(), before);
+    std::vector<Entry> result;
+    result.reserve(n);
+    for (std::size_t i = 0; i < n; i++) result.push_back({ sorted[i]->word, sorted[i]->count, sorted[i]->error });
+    return result;
+}
+
+/**
+ * @brief Estimate the heap memory of the sketch.
+ * @return The bytes, see MemoryUsage.
+ */
+uint64_t WordSketch::memory_usage() const {
+    uint64_t bytes = heap_size(counters) + heap_size(heap) + heap_size(index) + heap_size(hll);
+    for (auto& counter : counters) bytes += heap_size(counter.word);
+    return bytes;
+}
+
+/**
+ * @brief Print the number of words, the distinct words and the top words with their errors.
+ * @param output The output stream to print the results.
+ * @param n The number of words to print, 0 for all tracked words.
+ *
+ * Each line is `word: count (error <= e)`, the true count is between count - e and count.
+ */
+void WordSketch::print(std::ostream& output, std::size_t n) const {
+    output << "Words: " << total << "\n";
+    output << "Distinct words: ~" << std::llround(distinct()) << " (standard error " << std::fixed << std::setprecision(1)
+        << 100 * distinct_error() << "%)" << std::defaultfloat << "\n";
+    output << "Counters: " << capacity() << ", any word more frequent than " << total / capacity() << " is listed\n";
+    for (const auto& entry : top(n)) {
+        output << entry.word << ": " << entry.count << " (error <= " << entry.error << ")\n";
+    }
+    output.flush();
+}
@@ -1,125 +1,202 @@
-#include "utils.h"
-
-#include <filesystem>
-#include <iostream>
-
-extern "C" {
-#include "stmr.h" // Include the stemmer header from the third-party library
-}
-
-/**
- * @brief Get all files from a specified directory with a given extension.
- *
- * This function retrieves all files with the specified extension from
- * the provided directory and its subdirectories. If the directory
- * does not exist, it prints an error message and returns an empty vector.
- *
- * @param directory The path to the directory to search.
- * @param extension The file extension to filter by.
- * @return A vector containing the paths of the found files.
- */
-std::vector<std::string> get_files(
-    const std::filesystem::path& directory,
-    const std::string& extension
-) {
-    std::vector<std::string> files;
-    if (!std::filesystem::exists(directory)) {
-        std::cerr << "目录不存在: " << directory << std::endl; // Directory does not exist
-        return {};
-    }
-    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
-        if (entry.is_regular_file() && entry.path().extension() == extension) {
-            files.push_back(entry.path().string()); // Add file path to vector
-        }
-    }
-    return files;
-}
-
-/**
- * @brief Stem a word to its base form.
- *
- * This function takes a word as input, converts it to lowercase,
- * and applies the stemming algorithm.
- * It uses the Porter stemming algorithm to achieve this.
- *
- * @param word The word to stem.
- * @return The stemmed version of the word.
- */
-std::string stem_word(const std::string& word) {
-    std::string s = word;
-    for (char& p : s) {
-        p = tolower(p); // Convert to lowercase
-    }
-    stem(s.data(), 0, static_cast<int>(s.size() - 1)); // Apply stemming algorithm, this is a third-party library
-    return s;
-}
-
-/**
- * @brief Tokenize a string into words.
- *
- * This function reads input from a stream and extracts a single
- * token (word) while skipping over HTML tags. It returns the
- * token in stemmed form.
- *
- * @param input The input stream to read from.
- * @return The tokenized word in stemmed form.
- */
-std::string tokenize(std::istream& input) {
-    std::string token;
-    char ch;
-
-    while (input.get(ch)) {
-        if (isalnum(ch)) {
-            token += ch; // Start of a token
-            break;
-        }
-        else if (ch == '<') { // Skip HTML tags
-            while (input.get(ch)) {
-                if (ch == '>') {
-                    break; // End of the HTML tag
-                }
-            }
-        }
-    }
-
-    while (input.get(ch)) {
-        if (!isalnum(ch)) {
-            break; // End of token
-        }
-        token += ch; // Continue adding characters to token
-    }
-
-    return stem_word(token); // Return the stemmed token
-}
-
-/**
- * @brief Intersect two **aescending** vectors of unsigned 32-bit integers.
- *
- * This function finds the intersection of two **aescending** vectors of unsigned
- * 32-bit integers and returns the result as a new vector.
- *
- * @param vec1 The first vector to intersect, must be **aescending**.
- * @param vec2 The second vector to intersect, must be **aescending**.
- * @return A new aescending vector containing the intersection of vec1 and vec2.
- */
-std::vector<uint32_t> intersect(const std::vector<uint32_t>& vec1, const std::vector<uint32_t>& vec2) {
-    std::vector<uint32_t> result;
-    auto it1 = vec1.begin();
-    auto it2 = vec2.begin();
-
-    while (it1 != vec1.end() && it2 != vec2.end()) {
-        if (*it1 == *it2) {
-            result.push_back(*it1); // Add common element to result
-            ++it1;
-            ++it2;
-        }
-        else if (*it1 < *it2) {
-            ++it1;
-        }
-        else {
-            ++it2;
-        }
-    }
-
-    return result;
-}
\ No newline at end of file
+#include "utils.h"
+#include "DirWalker.h"
+
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+
+extern "C" {
+#include "stmr.h" // Include the stemmer header from the third-party library
+}
+
+/**
+ * @brief Get all files from a specified directory with a given extension.
+ *
+ * This function retrieves all files with the specified extension from
+ * the provided directory and its subdirectories, listing directories in
+ * parallel with a DirWalker. The files are in canonical order: depth-first,
+ * the entries of every directory sorted by name, so the same tree always
+ * gives the same list. If the directory does not exist, it prints an error
+ * message and returns an empty vector.
+ *
+ * @param directory The path to the directory to search.
+ * @param extension The file extension to filter by.
+ * @return A vector containing the paths of the found files.
+ */
+std::vector<std::string> get_files(
+    const std::filesystem::path& directory,
+    const std::string& extension
+) {
+    return DirWalker(directory, extension, DirWalker::Options()).files();
+}
+
+/**
+ * @brief Get the index folder of a target.
+ * @param target The target directory, or an archive.
+ * @return `target/<BASE_DIR>` for a directory, `<archive><BASE_DIR>` for an archive, e.g. `pages.tar.gz.ADS_search_engine`.
+ */
+std::filesystem::path index_folder(const std::filesystem::path& target) {
+    if (!std::filesystem::is_regular_file(target)) return target / BASE_DIR;
+    return target.parent_path() / (target.filename().string() + BASE_DIR);
+}
+
+/**
+ * @brief Get the directory holding the published index of a target directory.
+ *
+ * The CURRENT pointer file is read on every call, so a newly published generation
+ * is picked up immediately.
+ *
+ * @param dir The target directory, or an archive.
+ * @return `index_folder(dir)/<generation>`, or `index_folder(dir)` if no generation is published.
+ */
+std::filesystem::path index_dir(const std::filesystem::path& dir) {
+    return published_generation(index_folder(dir));
+}
+
+/**
+ * @brief Get the directory holding the published generation of an index folder.
+ * @param base The index folder, see index_folder().
+ * @return `base/<generation>`, or `base` if no generation is published.
+ */
+std::filesystem::path published_generation(const std::filesystem::path& base) {
+    std::ifstream current(base / CURRENT_FILE_NAME);
+    std::string generation;
+    if (std::getline(current, generation) && !generation.empty()) {
+        return base / generation;
+    }
+    return base; // legacy layout
+}
+
+/**
+ * @brief Stem a word to its base form.
+ *
+ * This function takes a word as input, converts it to lowercase,
+ * and applies the stemming algorithm.
+ * It uses the Porter stemming algorithm to achieve this.
+ *
+ * @param word The word to stem.
+ * @return The stemmed version of the word.
+ */
+std::string stem_word(const std::string& word) {
+    std::string s = word;
+    stem_in_place(s);
+    return s;
+}
+
+/**
+ * @brief Stem a word in place.
+ * @param word The word to stem, replaced by its stemmed version.
+ */
+void stem_in_place(std::string& word) {
+    for (char& p : word) {
+        p = tolower(p); // Convert to lowercase
+    }
+    stem(word.data(), 0, static_cast<int>(word.size() - 1)); // Apply stemming algorithm, this is a third-party library
+}
+
+/**
+ * @brief Tokenize a string into words.
+ *
+ * This function reads input from a stream and extracts a single
+ * token (word) while skipping over HTML tags. It returns the
+ * token in stemmed form.
+ *
+ * @param input The input stream to read from.
+ * @return The tokenized word in stemmed form.
+ */
+std::string tokenize(std::istream& input) {
+    std::string token;
+    tokenize(input, token);
+    return token;
+}
+
+/**
+ * @brief Read the next stemmed token from a stream into a buffer.
+ * @param input The input stream to read from.
+ * @param token The buffer, replaced by the token in stemmed form.
+ * @return false at the end of the input, when the buffer is left empty.
+ */
+bool tokenize(std::istream& input, std::string& token) {
+    if (!next_token(input, token)) return false;
+    stem_in_place(token); // Stem the token in its buffer
+    return true;
+}
+
+/**
+ * @brief Read the next token from a stream, without stemming it.
+ *
+ * @param input The input stream to read from.
+ * @return The token as it appears in the input, empty at the end of the input.
+ */
+std::string next_token(std::istream& input) {
+    std::string token;
+    next_token(input, token);
+    return token;
+}
+
+/**
+ * @brief Read the next token from a stream into a buffer, without stemming it.
+ *
+ * @param input The input stream to read from.
+ * @param token The buffer, replaced by the token.
+ * @return false at the end of the input, when the buffer is left empty.
+ */
+bool next_token(std::istream& input, std::string& token) {
+    token.clear(); // Keep the capacity of the buffer
+    char ch;
+
+    while (input.get(ch)) {
+        if (isalnum(ch)) {
+            token += ch; // Start of a token
+            break;
+        }
+        else if (ch == '<') { // Skip HTML tags
+            while (input.get(ch)) {
+                if (ch == '>') {
+                    break; // End of the HTML tag
+                }
+            }
+        }
+    }
+
+    while (input.get(ch)) {
+        if (!isalnum(ch)) {
+            break; // End of token
+        }
+        token += ch; // Continue adding characters to token
+    }
+
+    return !token.empty();
+}
+
+/**
+ * @brief Intersect two **aescending** vectors of unsigned 32-bit integers.
+ *
+ * This function finds the intersection of two **aescending** vectors of unsigned
+ * 32-bit integers and returns the result as a new vector.
+ *
+ * @param vec1 The first vector to intersect, must be **aescending**.
+ * @param vec2 The second vector to intersect, must be **aescending**.
+ * @return A new aescending vector containing the intersection of vec1 and vec2.
+ */
+std::vector<uint32_t> intersect(const std::vector<uint32_t>& vec1, const std::vector<uint32_t>& vec2) {
+    std::vector<uint32_t> result;
+    auto it1 = vec1.begin();
+    auto it2 = vec2.begin();
+
+    while (it1 != vec1.end() && it2 != vec2.end()) {
+        if (*it1 == *it2) {
+            result.push_back(*it1); // Add common element to result
+            ++it1;
+            ++it2;
+        }
+        else if (*it1 < *it2) {
+            ++it1;
+        }
+        else {
+            ++it2;
+        }
+    }
+
+    return result;
+}
@@ -50,14 +50,22 @@
   * Note that only lower case sequences are stemmed. Forcing to lower case
   * should be done before stem(...) is called. */
 
+  /* The stemmer state is thread local, so that words can be stemmed
+   * concurrently from several threads. */
+#if defined(_MSC_VER)
+#define STMR_THREAD_LOCAL __declspec(thread)
+#else
+#define STMR_THREAD_LOCAL __thread
+#endif
+
   /* buffer for word to be stemmed */
-static char* b;
+static STMR_THREAD_LOCAL char* b;
 
-static int k;
-static int k0;
+static STMR_THREAD_LOCAL int k;
+static STMR_THREAD_LOCAL int k0;
 
 /* j is a general offset into the string */
-static int j;
+static STMR_THREAD_LOCAL int j;
 
 /**
  * TRUE when `b[i]` is a consonant.
@@ -0,0 +1,77 @@
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "FileIndex.h"
+#include "StopFilter.h"
+
+// This executable replaces the global operator new to count allocations, so it is kept apart
+// from the tests executable, whose tests must not run on a replaced allocator.
+
+namespace {
+    std::atomic<uint64_t> allocations{ 0 }; ///< The number of calls to operator new in this process.
+
+    void write_file(const std::string& filename, const std::string& content) {
+        std::ofstream file(filename, std::ios::binary);
+        file << content;
+    }
+}
+
+void* operator new(std::size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+int file_index_alloc_test() {
+    // The same words, a short file and one a hundred times longer, with long words and stop words
+    std::string words = "the Quick brown foxes jumped over the lazy dogs internationalization 42 and a ";
+    std::string small = "<p>" + words, large = "<p>";
+    for (int i = 0; i < 100; i++) large += words;
+    write_file("output/file_index_alloc_small.html", small + "</p>");
+    write_file("output/file_index_alloc_large.html", large + "</p>");
+    StopFilter filter("stop_words.txt");
+
+    // Once every word is known, indexing allocates per file, not per token
+    FileIndex index;
+    index.add_file("output/file_index_alloc_small.html", 0, &filter);
+    uint64_t before = allocations;
+    index.add_file("output/file_index_alloc_small.html", 0, &filter);
+    uint64_t small_allocations = allocations - before;
+    before = allocations;
+    index.add_file("output/file_index_alloc_large.html", 0, &filter);
+    uint64_t large_allocations = allocations - before;
+    assert(large_allocations == small_allocations);
+    assert(index.find("quick") && index.find("quick")->freq == 102);
+    assert(!index.find("the"));
+
+    std::remove("output/file_index_alloc_small.html");
+    std::remove("output/file_index_alloc_large.html");
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 1) {
+        std::cerr << "No test specified.\n\nUseage: alloc_tests <test_case_name>\n - see `CMakeList.txt for the test case names`" << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path testdir = std::filesystem::current_path() / "../test";
+    std::filesystem::current_path(testdir);
+
+    std::string testname = argv[1];
+
+    if (testname == "file_index_alloc") {
+        return file_index_alloc_test();
+    }
+    std::cerr << "Unknown test: " << testname << std::endl;
+    return 1;
+}
@@ -1,55 +1,294 @@
-#include <fstream>
-#include <cassert>
-
-#include "FileIndex.h"
-#include "tests.h"
-
-int build_and_print_index_test() {
-    FileIndex index;
-    index.add_dir("shakespeare/merchant");
-    std::ofstream file("output/build_and_print_index_test.txt");
-    index.print(file);
-    file.close();
-    return 0;
-}
-
-int save_and_read_index_test() {
-    FileIndex index;
-    index.add_dir("shakespeare/cymbeline");
-    index.save("output/save_and_read_index_test.dat");
-    std::ofstream file1("../");
-    index.print("output/save_and_read_index_test1.txt");
-    FileIndex index2 = FileIndex::read("output/save_and_read_index_test.dat");
-    index2.print("output/save_and_read_index_test2.txt");
-    assert(files_identical("output/save_and_read_index_test1.txt", "output/save_and_read_index_test2.txt"));
-    return 0;
-}
-
-int merge_and_print_index_file_test() {
-    std::string prefix = "output/merge_and_print_index_file_test";
-    FileIndex index;
-    uint32_t id_curr;
-
-    // save index separately
-    id_curr = 0;
-    id_curr += index.add_dir("shakespeare/richardii", id_curr);
-    index.save(prefix + "1.dat");
-    index.clear();
-    id_curr += index.add_dir("shakespeare/richardiii", id_curr);
-    index.save(prefix + "2.dat");
-    index.clear();
-
-    // save index together
-    id_curr = 0;
-    id_curr += index.add_dir("shakespeare/richardii", id_curr);
-    id_curr += index.add_dir("shakespeare/richardiii", id_curr);
-    index.save(prefix + "_direct.dat");
-    index.clear();
-
-    // merge index
-    FileIndex::merge_files(prefix + "1.dat", prefix + "2.dat", prefix + "_merged.dat");
-
-    // compare merged index with direct index
-    assert(files_identical(prefix + "_direct.dat", prefix + "_merged.dat"));
-    return 0;
-}
\ No newline at end of file
+#include <algorithm>
+#include <random>
+#include <fstream>
+#include <cassert>
+#include <sstream>
+#include <filesystem>
+
+#include "FileIndex.h"
+#include "IndexPipeline.h"
+#include "SortInverter.h"
+#include "StopFilter.h"
+#include "TermDictionary.h"
+#include "tests.h"
+
+int build_and_print_index_test() {
+    FileIndex index;
+    index.add_dir("shakespeare/merchant");
+    std::ofstream file("output/build_and_print_index_test.txt");
+    index.print(file);
+    file.close();
+    return 0;
+}
+
+int save_and_read_index_test() {
+    FileIndex index;
+    index.add_dir("shakespeare/cymbeline");
+    index.save("output/save_and_read_index_test.dat");
+    std::ofstream file1("../");
+    index.print("output/save_and_read_index_test1.txt");
+    FileIndex index2 = FileIndex::read("output/save_and_read_index_test.dat");
+    index2.print("output/save_and_read_index_test2.txt");
+    assert(files_identical("output/save_and_read_index_test1.txt", "output/save_and_read_index_test2.txt"));
+    return 0;
+}
+
+int merge_and_print_index_file_test() {
+    std::string prefix = "output/merge_and_print_index_file_test";
+    FileIndex index;
+    uint32_t id_curr;
+
+    // save index separately
+    id_curr = 0;
+    id_curr += index.add_dir("shakespeare/richardii", id_curr);
+    index.save(prefix + "1.dat");
+    index.clear();
+    id_curr += index.add_dir("shakespeare/richardiii", id_curr);
+    index.save(prefix + "2.dat");
+    index.clear();
+
+    // save index together
+    id_curr = 0;
+    id_curr += index.add_dir("shakespeare/richardii", id_curr);
+    id_curr += index.add_dir("shakespeare/richardiii", id_curr);
+    index.save(prefix + "_direct.dat");
+    index.clear();
+
+    // merge index
+    FileIndex::merge_files(prefix + "1.dat", prefix + "2.dat", prefix + "_merged.dat");
+
+    // compare merged index with direct index
+    assert(files_identical(prefix + "_direct.dat", prefix + "_merged.dat"));
+    return 0;
+}
+
+int index_pipeline_test() {
+    std::string prefix = "output/index_pipeline_test";
+    write_file(prefix + "_a.html", "<p>the alpha beta </p>");
+    write_file(prefix + "_b.html", "");
+    std::string large;
+    for (int i = 0; i < 20000; i++) {
+        // tags and tokens across every chunk boundary
+        large += "<a href=\"x" + std::to_string(i % 13) + "\">word" + std::to_string(i % 997) + " running the " + std::to_string(i) + "</a>\n";
+    }
+    write_file(prefix + "_large.html", large);
+    write_file(prefix + "_c.html", "<div>beta gamma gamma </div>");
+    std::vector<std::string> files = { prefix + "_a.html", prefix + "_b.html", prefix + "_missing.html", prefix + "_large.html", prefix + "_c.html" };
+    write_file(prefix + "_stop.txt", "the\n");
+    StopFilter filter(prefix + "_stop.txt");
+
+    // the index of add_file, file by file
+    FileIndex expected;
+    std::vector<uint32_t> expected_lengths;
+    for (uint32_t i = 0; i < files.size(); i++) expected_lengths.push_back(expected.add_file(files[i], 10 + i, &filter));
+    std::ostringstream expected_bytes;
+    expected.serialize(expected_bytes);
+
+    // tiny buffers, so every stage runs out of them and waits
+    IndexPipeline::Options options;
+    options.readers = 3;
+    options.read_ahead = 1;
+    options.chunk_bytes = 61;
+    options.batch_tokens = 3;
+    options.batches = 1;
+    FileIndex index;
+    std::vector<uint32_t> order, lengths;
+    IndexPipeline::Stats stats = IndexPipeline(index, &filter, options).run(files, 10, [&](uint32_t i, const std::string& file, uint32_t length, const Manifest::Entry& entry) {
+        assert(file == files[i]);
+        assert(entry.doc == 10 + i);
+        if (std::filesystem::exists(file)) {
+            Manifest::Entry expected_entry = Manifest::stat_file(file, 10 + i);
+            assert(entry.size == expected_entry.size && entry.mtime == expected_entry.mtime && entry.hash == expected_entry.hash);
+        }
+        else assert(entry.size == 0 && entry.hash == Manifest::HASH_BASIS);
+        order.push_back(i);
+        lengths.push_back(length);
+    });
+    std::ostringstream bytes;
+    index.serialize(bytes);
+    assert(bytes.str() == expected_bytes.str());
+    assert(lengths == expected_lengths);
+    assert((order == std::vector<uint32_t>{ 0, 1, 2, 3, 4 }));
+    assert(stats.files == files.size());
+    uint64_t total = 0;
+    for (auto& file : files) total += std::filesystem::exists(file) ? std::filesystem::file_size(file) : 0;
+    assert(stats.bytes == total);
+    assert(stats.tokenize_output_stall + stats.invert_stall > IndexPipeline::clock::duration::zero());
+
+    // without readers, files are added one by one
+    options.readers = 0;
+    FileIndex sequential;
+    IndexPipeline(sequential, &filter, options).run(files, 10, [&](uint32_t i, const std::string& file, uint32_t, const Manifest::Entry& entry) {
+        assert(entry.doc == 10 + i);
+        assert(entry.hash == (std::filesystem::exists(file) ? Manifest::hash_file(file) : Manifest::HASH_BASIS));
+    });
+    std::ostringstream sequential_bytes;
+    sequential.serialize(sequential_bytes);
+    assert(sequential_bytes.str() == expected_bytes.str());
+    for (const char* suffix : { "_a.html", "_b.html", "_large.html", "_c.html", "_stop.txt" }) std::filesystem::remove(prefix + suffix);
+    return 0;
+}
+
+int index_pipeline_split_test() {
+    std::string prefix = "output/index_pipeline_split_test";
+    // long tags, with words in them, tokens ending with '<', and runs of alphanumerics
+    std::string tags = "<p>Alpha <a href=\"beta gamma delta\">link</a>running<b>bold</b> 42<i>x</i>";
+    std::string large;
+    for (int i = 0; i < 300; i++) large += tags + "word" + std::to_string(i % 37) + " <!-- the " + std::to_string(i) + " -->\n";
+    std::mt19937 random(48);
+    const char alphabet[] = "ab1X <<>>\n\xe9.";
+    std::string noise;
+    for (int i = 0; i < 20000; i++) noise += alphabet[random() % (sizeof(alphabet) - 1)];
+    write_file(prefix + "_large.html", large);
+    write_file(prefix + "_noise.html", noise);
+    write_file(prefix + "_open.html", "one two <never closed three four " + std::string(300, 'z'));
+    write_file(prefix + "_small.html", "<p>alpha beta</p>");
+    std::vector<std::string> files = { prefix + "_large.html", prefix + "_small.html", prefix + "_noise.html", prefix + "_open.html" };
+    write_file(prefix + "_stop.txt", "the\n");
+    StopFilter filter(prefix + "_stop.txt");
+
+    FileIndex expected;
+    std::vector<uint32_t> expected_lengths;
+    for (uint32_t i = 0; i < files.size(); i++) expected_lengths.push_back(expected.add_file(files[i], i, &filter));
+    std::ostringstream expected_bytes;
+    expected.serialize(expected_bytes);
+
+    // windows and pieces cut every tag somewhere, the index stays the same
+    for (std::size_t split_bytes : { 7, 64, 1000, 1 << 16 }) {
+        for (unsigned threads : { 1u, 4u }) {
+            IndexPipeline::Options options;
+            options.chunk_bytes = 97;
+            options.batch_tokens = 5;
+            options.split_bytes = split_bytes;
+            options.split_threads = threads;
+            FileIndex index;
+            std::vector<uint32_t> lengths;
+            IndexPipeline::Stats stats = IndexPipeline(index, &filter, options).run(files, 0, [&](uint32_t, const std::string& file, uint32_t length, const Manifest::Entry& entry) {
+                assert(entry.hash == Manifest::hash_file(file)); // the windows of a split file are hashed in order
+                lengths.push_back(length);
+            });
+            std::ostringstream bytes;
+            index.serialize(bytes);
+            assert(bytes.str() == expected_bytes.str());
+            assert(lengths == expected_lengths);
+            assert(stats.split_files == (split_bytes == 7 ? 4u : split_bytes == 64 ? 3u : split_bytes == 1000 ? 2u : 0u));
+        }
+    }
+    for (const char* suffix : { "_large.html", "_noise.html", "_open.html", "_small.html", "_stop.txt" }) std::filesystem::remove(prefix + suffix);
+    return 0;
+}
+
+int term_dictionary_test() {
+    std::string prefix = "output/term_dictionary_test";
+    TermDictionary dictionary;
+    assert(dictionary.id("pear") == 0 && dictionary.id("apple") == 1 && dictionary.id("pear") == 0 && dictionary.id("fig") == 2);
+    assert(dictionary.size() == 3 && dictionary.term(1) == "apple");
+    assert((dictionary.sorted_ids() == std::vector<uint32_t>{ 1, 2, 0 }));
+
+    // runs merged by term ID give the same index file as index files merged by term
+    write_file(prefix + "_a.txt", "zebra apple pear apple");
+    write_file(prefix + "_b.txt", "mango zebra kiwi");
+    write_file(prefix + "_c.txt", "apple kiwi banana");
+    std::vector<std::string> files = { prefix + "_a.txt", prefix + "_b.txt", prefix + "_c.txt" };
+    FileIndex direct, index;
+    for (uint32_t i = 0; i < files.size(); i++) {
+        direct.add_file(files[i], i);
+        index.add_file(files[i], i);
+        index.save_run(prefix + "_run" + std::to_string(i) + ".tmp", dictionary);
+        index.clear();
+    }
+    direct.save(prefix + "_direct.dat");
+    FileIndex::merge_runs(prefix + "_run0.tmp", prefix + "_run1.tmp", prefix + "_run01.tmp");
+    FileIndex::merge_runs(prefix + "_run01.tmp", prefix + "_run2.tmp", prefix + "_run012.tmp");
+    FileIndex::run_to_index(prefix + "_run012.tmp", dictionary, prefix + "_merged.dat");
+    assert(files_identical(prefix + "_direct.dat", prefix + "_merged.dat"));
+
+    // a run only holds the IDs of its terms, and terms not in the run are not written
+    FileIndex::run_to_index(prefix + "_run1.tmp", dictionary, prefix + "_one.dat");
+    FileIndex one = FileIndex::read(prefix + "_one.dat");
+    assert(one.find("mango") && one.find("zebra") && !one.find("apple"));
+    assert(std::filesystem::file_size(prefix + "_run1.tmp") == 4 + 3 * 4 * 4);
+    for (const char* suffix : { "_a.txt", "_b.txt", "_c.txt", "_run0.tmp", "_run1.tmp", "_run2.tmp", "_run01.tmp", "_run012.tmp", "_direct.dat", "_merged.dat", "_one.dat" }) {
+        std::filesystem::remove(prefix + suffix);
+    }
+    return 0;
+}
+
+int sort_inverter_test() {
+    // the radix sort is stable, with one thread or several
+    std::mt19937 random(50);
+    std::vector<uint64_t> pairs;
+    for (uint32_t doc = 0; doc < 200000; doc++) pairs.push_back(static_cast<uint64_t>(random() % 70000) << 32 | doc);
+    std::vector<uint64_t> expected = pairs, scratch;
+    std::stable_sort(expected.begin(), expected.end(), [](uint64_t a, uint64_t b) { return a >> 32 < b >> 32; });
+    for (unsigned threads : { 1u, 4u }) {
+        ThreadPool pool(threads);
+        std::vector<uint64_t> sorted = pairs;
+        SortInverter::radix_sort(sorted, scratch, 17, pool);
+        assert(sorted == expected);
+    }
+
+    // the same index as FileIndex::add_token, with a buffer sorted many times
+    std::vector<std::string> words = { "pear", "apple", "fig", "kiwi", "banana", "zebra", "mango" };
+    FileIndex expected_index, index;
+    SortInverter::Options options;
+    options.buffer_pairs = 3;
+    options.threads = 2;
+    SortInverter inverter(options);
+    for (uint32_t doc = 0; doc < 500; doc++) {
+        for (int k = 0; k < 6; k++) {
+            const std::string& word = words[random() % words.size()];
+            uint32_t count = 1 + random() % 3;
+            expected_index.add_token(word, doc, count);
+            inverter.add_token(word, doc, count);
+        }
+    }
+    inverter.finish(index);
+    std::ostringstream expected_bytes, bytes;
+    expected_index.serialize(expected_bytes);
+    index.serialize(bytes);
+    assert(bytes.str() == expected_bytes.str());
+    assert(inverter.sorts() > 100);
+
+    // finishing again appends to the index, a document may continue across the two
+    inverter.add_token("apple", 499);
+    inverter.add_token("apple", 500);
+    inverter.add_token("aardvark", 500);
+    inverter.finish(index);
+    expected_index.add_token("apple", 499);
+    expected_index.add_token("apple", 500);
+    expected_index.add_token("aardvark", 500);
+    std::ostringstream expected_more, more;
+    expected_index.serialize(expected_more);
+    index.serialize(more);
+    assert(more.str() == expected_more.str());
+
+    // selected in the pipeline
+    std::string prefix = "output/sort_inverter_test";
+    std::vector<std::string> files;
+    for (int i = 0; i < 20; i++) {
+        files.push_back(prefix + "_" + std::to_string(i) + ".html");
+        std::string text;
+        for (int k = 0; k < 50; k++) text += "<p>" + words[random() % words.size()] + "</p> ";
+        write_file(files.back(), text);
+    }
+    FileIndex map_index, sort_index;
+    IndexPipeline::Options pipeline;
+    std::vector<uint32_t> map_lengths, sort_lengths;
+    IndexPipeline(map_index, nullptr, pipeline).run(files, 0, [&](uint32_t, const std::string&, uint32_t length, const Manifest::Entry&) {
+        map_lengths.push_back(length);
+    });
+    pipeline.inversion = IndexPipeline::SORT;
+    pipeline.sort.buffer_pairs = 64;
+    IndexPipeline::Stats stats = IndexPipeline(sort_index, nullptr, pipeline).run(files, 0, [&](uint32_t, const std::string&, uint32_t length, const Manifest::Entry&) {
+        sort_lengths.push_back(length);
+    });
+    std::ostringstream map_bytes, sort_bytes;
+    map_index.serialize(map_bytes);
+    sort_index.serialize(sort_bytes);
+    assert(sort_bytes.str() == map_bytes.str());
+    assert(sort_lengths == map_lengths && sort_lengths.size() == files.size());
+    assert(stats.sorts > 1);
+    for (auto& file : files) std::filesystem::remove(file);
+    return 0;
+}
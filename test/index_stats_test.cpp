@@ -0,0 +1,47 @@
+#include <cmath>
+#include <cassert>
+#include <sstream>
+#include <filesystem>
+
+#include "FileIndex.h"
+#include "IndexStats.h"
+#include "tests.h"
+
+int index_stats_test() {
+    std::string prefix = "output/index_stats_test";
+    write_file(prefix + "_a.txt", "alpha beta");
+    write_file(prefix + "_b.txt", "beta");
+    write_file(prefix + "_c.txt", "beta gamma");
+    FileIndex index;
+    index.add_file(prefix + "_a.txt", 0);
+    index.add_file(prefix + "_b.txt", 1);
+    index.add_file(prefix + "_c.txt", 2);
+    index.save(prefix + ".dat");
+
+    // alpha: [0], beta: [0 1 2], gamma: [2], so the gaps are 1, 1 1 1 and 3
+    IndexStats stats;
+    assert(stats.add_file(prefix + ".dat"));
+    assert(stats.terms() == 3);
+    assert(stats.postings() == 5);
+    assert(stats.occurrences() == 5);
+    assert(stats.doc_freqs().at(1) == 2 && stats.doc_freqs().at(3) == 1);
+    assert(stats.doc_freq_percentile(50) == 1);
+    assert(stats.doc_freq_percentile(100) == 3);
+    assert(stats.top_bytes(0.01) == 3 * 4 + 4 + 3 * 4); // the entry of beta
+    assert(std::fabs(stats.gap_entropy() - (0.8 * -std::log2(0.8) + 0.2 * (1 - std::log2(0.2)))) < 1e-9);
+
+    // the projection of the current format is the file itself
+    assert(stats.projected_size(IndexStats::RAW) == std::filesystem::file_size(prefix + ".dat"));
+    uint64_t fixed = stats.projected_size(IndexStats::RAW) - 5 * 4;
+    assert(stats.projected_size(IndexStats::VBYTE) == fixed + 5);
+    assert(stats.projected_size(IndexStats::GAMMA) == fixed + 3);
+    assert(stats.projected_size(IndexStats::BITPACK) == fixed + 6);
+
+    assert(!stats.add_file(prefix + "_missing.dat"));
+    std::ostringstream report;
+    stats.print(report);
+    assert(report.str().find("Vocabulary: 3 terms, 5 postings") != std::string::npos);
+
+    for (const char* suffix : { "_a.txt", "_b.txt", "_c.txt", ".dat" }) std::filesystem::remove(prefix + suffix);
+    return 0;
+}
@@ -0,0 +1,28 @@
+#include <cassert>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "LevenshteinAutomaton.h"
+#include "tests.h"
+
+int levenshtein_test() {
+    std::vector<std::string> terms = {
+        "allow", "alloy", "ally", "also", "bellow", "fellow", "follow", "hallow", "love", "lover", "low", "yellow"
+    };
+    std::sort(terms.begin(), terms.end());
+
+    // the automaton must accept exactly the terms the brute force distance accepts
+    for (std::string word : { "allow", "fllow", "lov", "xyz", "", "yelow" }) {
+        for (uint32_t max_edits : { 1u, 2u }) {
+            LevenshteinAutomaton automaton(word, max_edits);
+            std::vector<std::pair<std::size_t, uint32_t>> expected;
+            for (std::size_t i = 0; i < terms.size(); i++) {
+                uint32_t d = edit_distance(word, terms[i]);
+                if (d <= max_edits) expected.push_back({ i, d });
+            }
+            assert(automaton.intersect(terms) == expected);
+        }
+    }
+    return 0;
+}
@@ -1,32 +1,792 @@
-#include "SearchEngine.h"
-
-#include <filesystem>
-#include <cassert>
-
-#include "utils.h"
-
-namespace fs = std::filesystem;
-
-int search_engine_gen_index_test() {
-    fs::path dir = fs::current_path() / "shakespeare/asyoulikeit";
-
-    if (fs::exists(dir / BASE_DIR)) {
-        fs::remove_all(dir / BASE_DIR);
-    }
-
-    SearchEngine::gen_index(dir, nullptr, true);
-    assert(fs::exists(dir / BASE_DIR / INDEX_FILE_NAME));
-    assert(fs::exists(dir / BASE_DIR / LIST_FILE_NAME));
-    return 0;
-}
-
-int search_engine_load_and_search_test() {
-    fs::path dir = fs::current_path() / "shakespeare/asyoulikeit";
-    SearchEngine se(dir);
-    std::ofstream output(fs::current_path() / "output/search_engine_load_and_search.txt");
-    output << "searching for 'allow'..." << std::endl;
-    se.search("allow", output);
-    output << "searching for 'love'..." << std::endl;
-    se.search("love", output);
-    return 0;
-}
\ No newline at end of file
+#include "SearchEngine.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <atomic>
+
+#include "ArchiveReader.h"
+#include "DeltaIndex.h"
+#include "DirWalker.h"
+#include "HotSwapEngine.h"
+#include "IndexPipeline.h"
+#include "IndexProfile.h"
+#include "Manifest.h"
+#include "RealtimeIndexer.h"
+#include "SearchServer.h"
+#include "tests.h"
+#include "utils.h"
+
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace fs = std::filesystem;
+
+int search_engine_gen_index_test() {
+    fs::path dir = fs::current_path() / "shakespeare/asyoulikeit";
+
+    if (fs::exists(dir / BASE_DIR)) {
+        fs::remove_all(dir / BASE_DIR);
+    }
+
+    SearchEngine::gen_index(dir, nullptr, true);
+    assert(fs::exists(index_dir(dir) / INDEX_FILE_NAME));
+    assert(fs::exists(index_dir(dir) / DOCS_FILE_NAME));
+    assert(!fs::exists(index_dir(dir) / LIST_FILE_NAME)); // only read from indexes written before the document table
+    return 0;
+}
+
+int search_engine_load_and_search_test() {
+    fs::path dir = fs::current_path() / "shakespeare/asyoulikeit";
+    SearchEngine se(dir);
+    std::ofstream output(fs::current_path() / "output/search_engine_load_and_search.txt");
+    output << "searching for 'allow'..." << std::endl;
+    se.search("allow", output);
+    output << "searching for 'love'..." << std::endl;
+    se.search("love", output);
+    return 0;
+}
+
+int search_engine_hot_swap_test() {
+    fs::path dir = make_corpus("hot_swap", { { "a.html", "<p>alpha beta</p>" } });
+
+    HotSwapEngine engine(dir);
+    std::shared_ptr<const SearchEngine> old = engine.acquire(); // an in-flight query holds the old generation
+    assert(!engine.reload()); // nothing new is published
+
+    write_file(dir / "b.html", "<p>gamma</p>");
+    SearchEngine::gen_index(dir, nullptr, true);
+    SearchEngine::gen_index(dir, nullptr, true); // the generation of `old` is removed here
+    assert(engine.reload());
+
+    std::ostringstream out_old, out_new;
+    old->search("alpha gamma", out_old);
+    old->search("alpha", out_old);
+    engine.acquire()->search("gamma", out_new);
+    assert(out_old.str() == "No results found.\n./a.html\n");
+    assert(out_new.str() == "./b.html\n");
+
+    // a generation left by a crashed build is removed, not the previously published one
+    fs::path previous = index_dir(dir);
+    fs::path crashed = dir / BASE_DIR / (std::string(GENERATION_PREFIX) + "100");
+    fs::create_directory(crashed);
+    SearchEngine::gen_index(dir, nullptr, true);
+    assert(index_dir(dir).filename() == std::string(GENERATION_PREFIX) + "101");
+    assert(fs::exists(previous) && !fs::exists(crashed));
+    std::ifstream current_fs(dir / BASE_DIR / CURRENT_FILE_NAME);
+    std::string current;
+    assert(std::getline(current_fs, current) && current == std::string(GENERATION_PREFIX) + "101");
+    assert(!fs::exists(dir / BASE_DIR / (std::string(CURRENT_FILE_NAME) + ".tmp")));
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_concurrent_test() {
+    // words whose stems differ from them, so the stemmer runs on every thread
+    std::vector<std::string> words = { "running", "connections", "happiness", "generalization", "adjustable", "conditional",
+        "hopefully", "relational", "sensitivities", "troubling", "national", "agreed", "controlling", "electricity" };
+    std::vector<std::pair<std::string, std::string>> files;
+    for (std::size_t i = 0; i < 40; i++) {
+        std::string text = "<p>";
+        for (std::size_t k = 0; k < 12; k++) text += words[(i * 7 + k * k) % words.size()] + " ";
+        files.push_back({ "page" + std::to_string(i) + ".html", text + "</p>" });
+    }
+    fs::path dir = make_corpus("concurrent", files);
+
+    std::vector<std::string> queries;
+    for (std::size_t i = 0; i < words.size(); i++) queries.push_back(words[i] + " " + words[(i * 5 + 3) % words.size()]);
+    queries.push_back("runing conections"); // misspelled, for the fuzzy searches
+    SearchEngine engine(dir);
+    std::vector<std::string> expected[2];
+    for (uint32_t fuzzy : { 0u, 1u }) {
+        SearchEngine::SearchOptions options;
+        options.fuzzy = fuzzy;
+        for (auto& query : queries) {
+            std::ostringstream out;
+            engine.search(query, out, options);
+            expected[fuzzy].push_back(out.str());
+        }
+    }
+    assert(expected[0].back() == "No results found.\n" && expected[1].back() != expected[0].back());
+
+    // the same engine searched by several threads at once gives the serial results
+    std::atomic<int> mismatches{ 0 };
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 8; t++) {
+        threads.emplace_back([&, t] {
+            for (std::size_t round = 0; round < 20; round++) {
+                for (std::size_t k = 0; k < queries.size(); k++) {
+                    std::size_t q = (k + t) % queries.size(); // the threads search different words at the same time
+                    SearchEngine::SearchOptions options;
+                    options.fuzzy = (round + t) % 2;
+                    std::ostringstream out;
+                    engine.search(queries[q], out, options);
+                    if (out.str() != expected[options.fuzzy][q]) mismatches++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    assert(mismatches == 0);
+
+    // the stemmer alone, so a thread is likely preempted in the middle of a word
+    std::vector<std::string> stems;
+    for (auto& word : words) stems.push_back(stem_word(word));
+    threads.clear();
+    for (std::size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (std::size_t k = 0; k < 200000; k++) {
+                std::size_t w = (k + t) % words.size();
+                if (stem_word(words[w]) != stems[w]) mismatches++;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    assert(mismatches == 0);
+
+    std::ostringstream batch;
+    SearchEngine::SearchOptions fuzzy_options;
+    fuzzy_options.fuzzy = 1;
+    engine.search_batch(queries, batch, fuzzy_options, 4, false);
+    std::string serial;
+    for (std::size_t q = 0; q < queries.size(); q++) serial += "Query: " + queries[q] + "\n" + expected[1][q];
+    assert(batch.str() == serial);
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+namespace {
+    /**
+     * @brief Connect to a server, send requests in one write, and read a number of responses.
+     * @return The responses, each without its terminating empty line.
+     */
+    std::vector<std::string> pipeline_requests(const fs::path& socket_path, const std::string& requests, std::size_t count) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        assert(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        assert(send(fd, requests.data(), requests.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(requests.size()));
+
+        std::vector<std::string> responses;
+        std::string received;
+        char buffer[4096];
+        while (responses.size() < count) {
+            std::size_t end = received.find("\n\n");
+            if (end != std::string::npos) {
+                responses.push_back(received.substr(0, end + 1));
+                received.erase(0, end + 2);
+                continue;
+            }
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            received.append(buffer, n);
+        }
+        close(fd);
+        return responses;
+    }
+}
+
+int search_server_test() {
+    std::vector<std::pair<std::string, std::string>> files;
+    std::vector<std::string> queries;
+    for (int i = 0; i < 12; i++) {
+        std::string word = "word" + std::string(1, static_cast<char>('a' + i));
+        files.push_back({ word + ".html", "<p>" + word + " common</p>" });
+        queries.push_back(word);
+    }
+    queries.push_back("common");
+    queries.push_back("missing");
+    fs::path dir = make_corpus("search_server", files);
+    HotSwapEngine engine(dir);
+    std::vector<std::string> expected;
+    std::string requests;
+    for (auto& query : queries) {
+        std::ostringstream out;
+        engine.search(query, out);
+        expected.push_back(out.str());
+        requests += query + "\n";
+    }
+
+    // pipelined requests on one connection are answered in request order
+    SearchServer::Options options;
+    options.socket_path = (dir / "server.sock").string();
+    options.threads = 4;
+    {
+        SearchServer server(engine, options);
+        assert(server.listen());
+        std::thread loop([&server] { server.run(); });
+        for (int round = 0; round < 5; round++) assert(pipeline_requests(options.socket_path, requests, queries.size()) == expected);
+        std::ostringstream out;
+        assert(SearchServer::query(options.socket_path, "common", out) && out.str() == expected[12]);
+        server.stop(); // ends run()
+        loop.join();
+    }
+    assert(!fs::exists(options.socket_path));
+    std::ostringstream unreachable;
+    assert(!SearchServer::query(options.socket_path, "common", unreachable));
+
+    // the request over max_pending is rejected, the one admitted before it is still answered first
+    options.threads = 1;
+    options.max_pending = 1;
+    {
+        SearchServer server(engine, options);
+        assert(server.listen());
+        std::thread loop([&server] { server.run(); });
+        std::vector<std::string> responses = pipeline_requests(options.socket_path, "worda\nwordb\n", 2);
+        assert(responses.size() == 2 && responses[0] == expected[0] && responses[1] == "Error: server overloaded\n");
+        assert(pipeline_requests(options.socket_path, "wordb\n", 1) == std::vector<std::string>{ expected[1] }); // admitted again once answered
+        server.stop();
+        loop.join();
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_update_test() {
+    fs::path dir = make_corpus("update", { { "a.html", "<p>alpha beta</p>" }, { "b.html", "<p>beta gamma</p>" }, { "c.html", "<p>gamma delta</p>" } });
+
+    write_file(dir / "a.html", "<p>alpha epsilon zeta</p>"); // modified
+    fs::remove(dir / "c.html"); // deleted
+    write_file(dir / "d.html", "<p>delta epsilon</p>"); // added
+    SearchEngine::update_index(dir, nullptr, true);
+
+    SearchEngine engine(dir);
+    assert(engine.is_loaded());
+    std::ostringstream out;
+    engine.search("beta", out);
+    engine.search("epsilon", out);
+    engine.search("delta", out);
+    engine.search("gamma", out);
+    assert(out.str() == "./b.html\n./a.html\n./d.html\n./d.html\n./b.html\n");
+
+    SearchEngine::update_index(dir, nullptr, true); // nothing changed, nothing published
+    assert(index_dir(dir) == engine.index_path());
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_changed_file_test() {
+    fs::path dir = make_corpus("changed_file", { { "a.html", "<p>alpha beta</p>" }, { "b.html", "<p>beta gamma</p>" } });
+
+    // a file rewritten after it is read is recorded as it was read, for every way of reading it
+    for (unsigned readers : { 0u, 2u }) {
+        for (std::size_t split_bytes : { std::size_t(0), std::size_t(4) }) {
+            write_file(dir / "a.html", "<p>alpha beta</p>");
+            write_file(dir / "b.html", "<p>beta gamma</p>");
+            uint64_t hash = Manifest::hash_file(dir / "a.html");
+            IndexPipeline::Options options;
+            options.readers = readers;
+            options.split_bytes = split_bytes;
+            FileIndex index;
+            std::vector<Manifest::Entry> entries;
+            IndexPipeline(index, nullptr, options).run({ (dir / "a.html").string(), (dir / "b.html").string() }, 5, [&](uint32_t i, const std::string& file, uint32_t, const Manifest::Entry& entry) {
+                if (i == 0) write_file(file, "<p>omega omega omega</p>"); // between read and publish
+                entries.push_back(entry);
+            });
+            assert(entries.size() == 2 && entries[0].doc == 5 && entries[1].doc == 6);
+            assert(entries[0].hash == hash && entries[0].size == 17);
+            Manifest::Entry now = Manifest::stat_file(dir / "a.html", 5);
+            assert(now.hash != entries[0].hash && now.size != entries[0].size);
+            assert(entries[1].hash == Manifest::hash_file(dir / "b.html") && entries[1].size == 17);
+        }
+    }
+
+    // a file buffered by a delta then rewritten before the flush is indexed again by the next update
+    write_file(dir / "a.html", "<p>alpha beta</p>");
+    write_file(dir / "b.html", "<p>beta gamma</p>");
+    SearchEngine::gen_index(dir, nullptr, true);
+    auto engine = std::make_shared<const SearchEngine>(dir);
+    DeltaIndex delta(engine);
+    write_file(dir / "c.html", "<p>delta</p>");
+    delta.add_file("./c.html", dir / "c.html", nullptr);
+    // batches see the delta too, with shared fetches or not
+    SearchEngine::SearchOptions with_delta;
+    with_delta.delta = &delta;
+    std::vector<std::string> delta_queries = { "delta", "beta", "beta delta" };
+    std::string serial;
+    for (auto& query : delta_queries) {
+        std::ostringstream one;
+        engine->search(query, one, with_delta);
+        serial += "Query: " + query + "\n" + one.str();
+    }
+    assert(serial.find("./c.html") != std::string::npos);
+    for (bool shared : { false, true }) {
+        std::ostringstream batch;
+        engine->search_batch(delta_queries, batch, with_delta, 2, shared);
+        assert(batch.str() == serial);
+    }
+    write_file(dir / "c.html", "<p>epsilon epsilon</p>");
+    assert(SearchEngine::flush_delta(dir, delta));
+    SearchEngine::update_index(dir, nullptr, true);
+    SearchEngine updated(dir);
+    std::ostringstream out;
+    updated.search("epsilon", out);
+    updated.search("delta", out);
+    assert(out.str() == "./c.html\nNo results found.\n");
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_empty_test() {
+    fs::path dir = make_corpus("empty", {}, false);
+    write_file(dir / "notes.txt", "alpha"); // not indexed
+
+    for (bool large : { false, true }) {
+        if (large) SearchEngine::gen_index_large(dir, nullptr, true);
+        else SearchEngine::gen_index(dir, nullptr, true);
+        SearchEngine engine(dir);
+        assert(engine.is_loaded());
+        assert(engine.document_count() == 0);
+        std::ostringstream out;
+        engine.search("alpha", out);
+        assert(out.str() == "No results found.\n");
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_profile_test() {
+    fs::path dir = make_corpus("profile", { { "a.html", "<p>alpha beta </p>" }, { "b.html", "<p>beta gamma <b>delta </b></p>" }, { "c.html", "<p>gamma alpha </p>" } }, false);
+
+    for (bool large : { false, true }) {
+        IndexProfile profile(true);
+        {
+            IndexProfile::Activation activation(profile);
+            if (large) SearchEngine::gen_index_large(dir, nullptr, true);
+            else SearchEngine::gen_index(dir, nullptr, true);
+        }
+        assert(IndexProfile::active() == nullptr);
+        assert(profile.count(IndexProfile::FILES) == 3);
+        assert(profile.count(IndexProfile::BYTES_READ) == fs::file_size(dir / "a.html") + fs::file_size(dir / "b.html") + fs::file_size(dir / "c.html"));
+        assert(profile.count(IndexProfile::TOKENS) == 7);
+        assert(profile.count(IndexProfile::UNIQUE_TERMS) == 4);
+        assert(profile.count(IndexProfile::MERGES) == (large ? 2 : 0));
+        assert(profile.count(IndexProfile::BYTES_WRITTEN) > 0);
+        assert(profile.time(IndexProfile::INVERT).count() > 0);
+
+        std::ostringstream summary;
+        profile.write_summary(summary);
+        assert(summary.str().find("\"tokens\": 7") != std::string::npos);
+        assert(profile.write_trace(dir / "trace.json"));
+        std::ifstream trace(dir / "trace.json");
+        std::string text((std::istreambuf_iterator<char>(trace)), std::istreambuf_iterator<char>());
+        assert(text.find("\"name\": \"./b.html\"") != std::string::npos);
+        assert(text.find("\"cat\": \"walk\"") != std::string::npos);
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_compaction_test() {
+    fs::path dir = make_corpus("compaction", { { "a.html", "<p>alpha common zeta zeta zeta</p>" }, { "b.html", "<p>beta common</p>" } });
+    write_file(dir / "c.html", "<p>gamma gamma gamma common zeta</p>");
+    SearchEngine::update_index(dir, nullptr, true);
+    fs::remove(dir / "a.html");
+    write_file(dir / "b.html", "<p>beta delta common</p>");
+    SearchEngine::update_index(dir, nullptr, true);
+
+    const char* queries[] = { "common", "alpha", "beta", "delta", "gamma" };
+    std::ostringstream before;
+    SearchEngine old(dir);
+    for (const char* query : queries) old.search(query, before);
+    assert(before.str() == "./c.html\n./b.html\nNo results found.\n./b.html\n./b.html\n./c.html\n");
+    std::ostringstream ranked_before; // zeta is more frequent than gamma, counting the deleted a.html
+    SearchEngine::SearchOptions ranked;
+    ranked.threshold = 0.4;
+    old.search("zeta gamma", ranked_before, ranked);
+    assert(ranked_before.str() == "\"zeta\" is ignored due to threshold.\n./c.html\n");
+
+    SearchEngine::CompactionPolicy policy;
+    policy.fanout = 2;
+    std::size_t steps = 0;
+    while (SearchEngine::compact_index(dir, policy, true)) steps++;
+    assert(steps == 2); // three segments, merged two at a time
+    assert(!SearchEngine::compact_index(dir, policy, true));
+
+    SearchEngine engine(dir);
+    std::ostringstream after, still;
+    for (const char* query : queries) engine.search(query, after);
+    for (const char* query : queries) old.search(query, still); // the old snapshot is still readable
+    assert(after.str() == before.str());
+    assert(still.str() == before.str());
+    std::ostringstream ranked_after; // the frequencies, so the terms kept by the threshold, do not change
+    engine.search("zeta gamma", ranked_after, ranked);
+    assert(ranked_after.str() == ranked_before.str());
+    std::ifstream segments_fs(engine.index_path() / SEGMENTS_FILE_NAME);
+    std::string segment, rest;
+    assert(segments_fs >> segment >> rest && !(segments_fs >> rest)); // a single segment is left
+    assert(segment == engine.index_path().filename().string());
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+/**
+ * @brief Wait until a query on an engine returns the expected output.
+ * @return false if it did not within 5 seconds.
+ */
+static bool wait_for(const HotSwapEngine& engine, const std::string& query, const std::string& expected) {
+    for (int i = 0; i < 500; i++) {
+        std::ostringstream out;
+        engine.search(query, out);
+        if (out.str() == expected) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+int search_engine_realtime_test() {
+    fs::path dir = make_corpus("realtime", { { "a.html", "<p>alpha common</p>" }, { "sub/b.html", "<p>beta common</p>" } });
+
+    HotSwapEngine engine(dir);
+    fs::path published = index_dir(dir);
+    {
+        RealtimeIndexer::Options options;
+        options.debounce = std::chrono::milliseconds(10);
+        RealtimeIndexer indexer(engine, options);
+        assert(indexer.start());
+
+        write_file(dir / "c.html", "<p>gamma common</p>"); // added
+        assert(wait_for(engine, "gamma", "./c.html\n"));
+        write_file(dir / "sub/b.html", "<p>delta common</p>"); // modified
+        assert(wait_for(engine, "delta", "./sub/b.html\n"));
+        assert(wait_for(engine, "beta", "No results found.\n"));
+        fs::remove(dir / "a.html"); // deleted
+        assert(wait_for(engine, "common", "./c.html\n./sub/b.html\n"));
+        fs::create_directories(dir / "new");
+        write_file(dir / "new/e.html", "<p>epsilon</p>"); // in a new directory
+        assert(wait_for(engine, "epsilon", "./new/e.html\n"));
+        assert(index_dir(dir) == published); // nothing written to disk yet
+    } // stopping the indexer flushes the delta as a segment
+
+    assert(index_dir(dir) != published);
+    SearchEngine flushed(dir);
+    std::ostringstream out;
+    flushed.search("common", out);
+    flushed.search("alpha", out);
+    flushed.search("epsilon", out);
+    assert(out.str() == "./c.html\n./sub/b.html\nNo results found.\n./new/e.html\n");
+    published = index_dir(dir);
+    SearchEngine::update_index(dir, nullptr, true); // the manifest knows the flushed files
+    assert(index_dir(dir) == published);
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_explain_test() {
+    fs::path dir = make_corpus("explain", { { "a.html", "<p>alpha beta gamma </p>" }, { "b.html", "<p>beta gamma </p>" }, { "c.html", "<p>gamma gamma </p>" } });
+
+    SearchEngine engine(dir);
+    std::ostringstream plain, explained;
+    SearchEngine::QueryExplain explain;
+    SearchEngine::SearchOptions options;
+    options.explain = &explain;
+    engine.search("gamma alpha beta", plain);
+    engine.search("gamma alpha beta", explained, options);
+    assert(explained.str() == plain.str()); // explaining does not change the results
+    assert(plain.str() == "./a.html\n");
+
+    assert(explain.terms.size() == 3);
+    assert(explain.terms[0].word == "gamma");
+    assert(explain.terms[0].doc_freq == 3 && explain.terms[0].freq == 4);
+    assert(explain.terms[1].doc_freq == 1 && explain.terms[1].freq == 1);
+    for (const auto& term : explain.terms) {
+        assert(term.lists == 1);
+        assert(term.bytes_read > 0);
+        assert(term.pages >= 1 && term.resident_pages <= term.pages);
+    }
+    // Intersected from the least to the most frequent word
+    assert(explain.steps.size() == 3);
+    assert(explain.steps[0].word == "alpha" && explain.steps[0].results == 1);
+    assert(explain.steps[1].word == "beta" && explain.steps[1].results == 1);
+    assert(explain.steps[2].word == "gamma" && explain.steps[2].results == 1);
+    assert(explain.ignored.empty());
+    assert(explain.total_ms >= explain.evaluate_ms);
+
+    std::ostringstream text;
+    explain.print(text);
+    assert(text.str().find("gamma") != std::string::npos);
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_memory_test() {
+    fs::path dir = make_corpus("memory", { { "a.html", "<p>alpha beta gamma </p>" }, { "b.html", "<p>beta gamma delta </p>" }, { "c.html", "<p>gamma delta epsilon </p>" } });
+
+    SearchEngine engine(dir);
+    MemoryUsage usage = engine.memory_usage();
+    uint64_t sum = 0;
+    for (auto& [name, bytes] : usage.components) sum += bytes;
+    assert(usage.total() == sum);
+    assert(usage.total() > 0);
+    assert(usage.mapped == fs::file_size(engine.index_path() / INDEX_FILE_NAME) + fs::file_size(engine.index_path() / DOCS_FILE_NAME));
+    assert(usage.resident <= usage.mapped + 4096);
+    assert(engine.memory_budget() == UINT64_MAX);
+
+    std::vector<std::string> queries = { "gamma", "beta gamma", "delta", "alpha epsilon", "gamma delta" };
+    std::ostringstream unlimited, limited;
+    SearchEngine::BatchStats all = engine.search_batch(queries, unlimited, SearchEngine::SearchOptions(), 2, true);
+    assert(all.spilled_terms == 0 && all.cache_bytes > 0);
+
+    // room for about one posting list: the others are spilled, with the same results
+    engine.set_memory_limit(usage.total() + 80);
+    assert(engine.memory_budget() == 80);
+    SearchEngine::BatchStats capped = engine.search_batch(queries, limited, SearchEngine::SearchOptions(), 2, true);
+    assert(capped.spilled_terms > 0);
+    assert(capped.cache_bytes <= 80);
+    assert(limited.str() == unlimited.str());
+
+    engine.set_memory_limit(1);
+    assert(engine.memory_budget() == 0);
+
+    // exact queries never build the lexicon, the first fuzzy lookup does
+    auto lexicon_bytes = [&engine] {
+        for (auto& [name, bytes] : engine.memory_usage().components) {
+            if (name == "lexicon") return bytes;
+        }
+        return uint64_t(0);
+    };
+    assert(lexicon_bytes() == 0);
+    assert(!engine.fuzzy_search("gama", 1).empty());
+    assert(lexicon_bytes() > 0);
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_doc_table_test() {
+    fs::path dir = make_corpus("doc_table", {}, false);
+    fs::create_directories(dir / "segment");
+
+    // front coded paths across several blocks, with documents removed by compaction
+    std::vector<std::string> paths;
+    std::vector<DocTable::Document> documents;
+    for (uint32_t i = 0; i < 40; i++) {
+        paths.push_back(i % 7 == 3 ? std::string() : "./dir" + std::to_string(i / 10) + "/page" + std::to_string(i) + ".html");
+        documents.push_back({ 1000 + i, 42 + i, i });
+    }
+    DocTable::save(dir / "segment" / DOCS_FILE_NAME, paths, documents);
+    DocTable table(dir / "segment");
+    assert(table.size() == paths.size() && table.mapped_size() > 0);
+    for (uint32_t i = 0; i < table.size(); i++) {
+        assert(table.path(i) == paths[i]);
+        assert(table.document(i).size == 1000 + i && table.document(i).mtime == 42 + i && table.document(i).length == i);
+    }
+
+    // a segment without a table is read from its list file
+    fs::remove(dir / "segment" / DOCS_FILE_NAME);
+    std::ofstream list_fs(dir / "segment" / LIST_FILE_NAME);
+    for (auto& path : paths) list_fs << path << std::endl;
+    list_fs.close();
+    DocTable legacy(dir / "segment");
+    assert(legacy.size() == paths.size() && legacy.mapped_size() == 0);
+    for (uint32_t i = 0; i < legacy.size(); i++) assert(legacy.path(i) == paths[i] && legacy.document(i).length == 0);
+
+    // the engine resolves paths from the tables, the lengths exclude nothing without a stop filter
+    fs::path corpus = make_corpus("doc_table/corpus", { { "a.html", "<p>alpha beta gamma </p>" }, { "b.html", "<p>gamma delta </p>" }, { "c.html", "<p>gamma </p>" } });
+    SearchEngine engine(corpus);
+    assert(engine.document_count() == 3);
+    DocTable built(engine.index_path());
+    std::vector<std::string> files;
+    for (uint32_t doc = 0; doc < 3; doc++) {
+        files.push_back(engine.file(doc));
+        uint32_t found;
+        assert(engine.find_document(files[doc], found) && found == doc);
+        DocTable::Document document = built.document(doc);
+        assert(document.size == fs::file_size(corpus / files[doc]) && document.mtime != 0);
+        assert(document.length == (files[doc] == "./a.html" ? 3 : files[doc] == "./b.html" ? 2 : 1));
+    }
+
+    // pages of the results, the other paths are not printed
+    std::ostringstream all, page, past;
+    engine.search("gamma", all);
+    assert(all.str() == files[0] + "\n" + files[1] + "\n" + files[2] + "\n");
+    SearchEngine::SearchOptions options;
+    options.offset = 1;
+    options.limit = 1;
+    engine.search("gamma", page, options);
+    assert(page.str() == files[1] + "\nResults 2-2 of 3.\n");
+    options.offset = 5;
+    options.limit = 2;
+    engine.search("gamma", past, options);
+    assert(past.str() == "No results from 6, 3 in total.\n");
+
+    fs::remove_all(dir);
+    return 0;
+}
+
+int search_engine_walk_test() {
+    fs::path dir = make_corpus("walk", { { "a.html", "<p>root </p>" }, { "b/y.html", "<p>beta why </p>" }, { "b/x.html", "<p>beta ex </p>" },
+        { "a/c/d.html", "<p>alpha dee </p>" }, { "a/b.html", "<p>alpha bee </p>" }, { "a/notes.txt", "not listed" }, { "z/z.html", "<p>zed </p>" } }, false);
+    fs::create_directories(dir / "a/empty");
+    fs::create_directory_symlink(dir / "b", dir / "link"); // not followed
+
+    // depth-first, entries sorted by name, whatever the number of threads
+    std::string root = dir.string();
+    std::vector<std::string> expected = { root + "/a/b.html", root + "/a/c/d.html", root + "/a.html", root + "/b/x.html", root + "/b/y.html", root + "/z/z.html" };
+    for (unsigned threads : { 1u, 4u }) {
+        DirWalker::Options options;
+        options.threads = threads;
+        DirWalker walker(dir, ".html", options);
+        std::string file;
+        for (std::size_t i = 0; i < expected.size(); i++) assert(walker.get(i, file) && file == expected[i]);
+        assert(!walker.get(expected.size(), file));
+        assert(walker.files() == expected);
+    }
+    assert(get_files(dir) == expected);
+
+    // discovery order finds the same files
+    DirWalker::Options discovery;
+    discovery.threads = 4;
+    discovery.order = DirWalker::DISCOVERY;
+    std::vector<std::string> found = DirWalker(dir, ".html", discovery).files();
+    std::sort(found.begin(), found.end());
+    std::vector<std::string> sorted = expected;
+    std::sort(sorted.begin(), sorted.end());
+    assert(found == sorted);
+    assert(DirWalker(dir / "missing", ".html", DirWalker::Options()).files().empty());
+
+    // the same files give the same index bytes, with any number of walk threads
+    std::string bytes[2];
+    for (unsigned k = 0; k < 2; k++) {
+        DirWalker::Options options;
+        options.threads = k == 0 ? 1 : 4;
+        SearchEngine::gen_index(dir, nullptr, true, IndexPipeline::Options(), options);
+        SearchEngine engine(dir);
+        bytes[k] = read_bytes(engine.index_path() / INDEX_FILE_NAME);
+        assert(engine.document_count() == expected.size() && engine.file(1) == "./a/c/d.html");
+    }
+    assert(!bytes[0].empty() && bytes[0] == bytes[1]);
+    fs::remove_all(dir);
+    return 0;
+}
+
+namespace {
+    /**
+     * @brief A tar header block, with its checksum.
+     */
+    std::string tar_header(const std::string& name, std::size_t size, char type) {
+        std::string header(512, '\0');
+        std::memcpy(&header[0], name.data(), std::min<std::size_t>(name.size(), 100));
+        std::snprintf(&header[100], 8, "%07o", 0644);
+        std::snprintf(&header[124], 12, "%011zo", size);
+        header[156] = type;
+        std::memcpy(&header[257], "ustar", 6);
+        header.replace(148, 8, 8, ' ');
+        unsigned sum = 0;
+        for (char ch : header) sum += static_cast<unsigned char>(ch);
+        std::snprintf(&header[148], 8, "%06o", sum);
+        return header;
+    }
+
+    /**
+     * @brief A tar member: its header, its content and the padding to a block.
+     */
+    std::string tar_member(const std::string& name, const std::string& content, char type = '0') {
+        return tar_header(name, content.size(), type) + content + std::string((512 - content.size() % 512) % 512, '\0');
+    }
+}
+
+int search_engine_archive_test() {
+    std::string a = "<p>apples and pears</p>", b = "<b>banana</b> apples";
+    std::string long_name = "sub/" + std::string(120, 'l') + ".html";
+    fs::path dir = make_corpus("archive", { { "files/a.html", a }, { "files/sub/b.html", b } }, false);
+    write_file(dir / "archive.tar", tar_member("a.html", a) + tar_member("sub/", "", '5') + tar_member("notes.txt", "not indexed")
+        + tar_member("././@LongLink", long_name + '\0', 'L') + tar_member(long_name, b) + std::string(1024, '\0'));
+
+    // every member is read in order, long names included
+    ArchiveReader reader(dir / "archive.tar");
+    assert(reader.is_open() && reader.format() == ArchiveReader::TAR);
+    std::string name;
+    char buffer[8];
+    assert(reader.next(name) && name == (dir / "archive.tar").string() + ":a.html");
+    std::string content;
+    for (std::size_t n; (n = reader.read(buffer, sizeof(buffer))) > 0;) content.append(buffer, n);
+    assert(content == a);
+    assert(reader.next(name) && name == (dir / "archive.tar").string() + ":" + long_name);
+    assert(!reader.next(name) && reader.error().empty());
+
+    // an archive gives the same index as the same files in a directory
+    SearchEngine::gen_index(dir / "files", nullptr, true);
+    SearchEngine::gen_index(dir / "archive.tar", nullptr, true);
+    std::string files_index = read_bytes(index_dir(dir / "files") / INDEX_FILE_NAME);
+    assert(!files_index.empty() && read_bytes(index_dir(dir / "archive.tar") / INDEX_FILE_NAME) == files_index);
+    assert(index_folder(dir / "archive.tar") == dir / (std::string("archive.tar") + BASE_DIR) && !fs::exists(dir / BASE_DIR));
+    {
+        SearchEngine engine(dir / "archive.tar");
+        assert(engine.document_count() == 2 && engine.file(0) == "archive.tar:a.html" && engine.file(1) == "archive.tar:" + long_name);
+    }
+
+    // JSONL: escapes are decoded, and documents are named by id, url or line number
+    write_file(dir / "docs.jsonl", "{\"id\": \"first\", \"text\": \"<p>apples and pears</p>\"}\n\n"
+        "{\"meta\": {\"id\": [1, \"x\"]}, \"url\": \"http://b\", \"html\": \"<b>banana<\\/b> \\u0061pples\"}\n{\"text\": \"caf\\u00e9\"}\n");
+    SearchEngine::gen_index(dir / "docs.jsonl", nullptr, true);
+    {
+        SearchEngine engine(dir / "docs.jsonl");
+        assert(engine.document_count() == 3 && engine.file(0) == "docs.jsonl:first" && engine.file(1) == "docs.jsonl:http://b" && engine.file(2) == "docs.jsonl:4");
+    }
+    ArchiveReader jsonl(dir / "docs.jsonl");
+    assert(jsonl.format() == ArchiveReader::JSONL && jsonl.next(name) && jsonl.next(name));
+    content.clear();
+    for (std::size_t n; (n = jsonl.read(buffer, sizeof(buffer))) > 0;) content.append(buffer, n);
+    assert(content == b);
+
+    // each archive keeps its own index, apart from the others and from the index of the directory
+    SearchEngine::gen_index(dir, nullptr, true);
+    assert(SearchEngine(dir / "archive.tar").file(0) == "archive.tar:a.html" && SearchEngine(dir).file(0) == "./files/a.html");
+    SearchEngine::update_index(dir / "archive.tar", nullptr, true); // rebuilt, the others are left alone
+    assert(SearchEngine(dir / "docs.jsonl").document_count() == 3 && fs::exists(index_dir(dir) / MANIFEST_FILE_NAME));
+
+    // a malformed archive is reported, and the published index is kept
+    write_file(dir / "broken.jsonl", "{\"text\": \"fine\"}\nnot json\n");
+    SearchEngine::gen_index(dir / "broken.jsonl", nullptr, true);
+    assert(index_dir(dir / "broken.jsonl") == index_folder(dir / "broken.jsonl"));
+    write_file(dir / "broken.jsonl", "{\"text\": \"fine\"}\n");
+    SearchEngine::gen_index(dir / "broken.jsonl", nullptr, true);
+    fs::path published = index_dir(dir / "broken.jsonl");
+    write_file(dir / "broken.jsonl", "{\"text\": \"fine\"}\nnot json\n");
+    SearchEngine::gen_index(dir / "broken.jsonl", nullptr, true);
+    assert(index_dir(dir / "broken.jsonl") == published);
+    std::string corrupt = tar_member("a.html", a);
+    corrupt[0] = 'x';
+    write_file(dir / "corrupt.tar", corrupt);
+    ArchiveReader broken(dir / "corrupt.tar");
+    assert(!broken.is_open());
+    write_file(dir / "truncated.tar", tar_member("a.html", a).substr(0, 600));
+    ArchiveReader truncated(dir / "truncated.tar");
+    assert(truncated.is_open() && truncated.next(name));
+    while (truncated.read(buffer, sizeof(buffer)) > 0) {}
+    assert(!truncated.next(name) && !truncated.error().empty());
+
+#ifdef HAVE_ZLIB
+    // a compressed archive gives the same index
+    std::string tar = read_bytes(dir / "archive.tar");
+    gzFile gz = gzopen((dir / "archive.tar.gz").c_str(), "wb");
+    gzwrite(gz, tar.data(), static_cast<unsigned>(tar.size()));
+    gzclose(gz);
+    SearchEngine::gen_index(dir / "archive.tar.gz", nullptr, true);
+    assert(read_bytes(index_dir(dir / "archive.tar.gz") / INDEX_FILE_NAME) == files_index);
+#endif
+    fs::remove_all(dir);
+    return 0;
+}
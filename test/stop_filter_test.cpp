@@ -1,14 +1,22 @@
-#include <cassert>
-
-#include "StopFilter.h"
-
-int stop_filter_test() {
-    StopFilter stop_filter("stop_words.txt");
-    assert(stop_filter.is_stop("a"));
-    assert(stop_filter.is_stop("the"));
-    assert(stop_filter.is_stop("a"));
-    assert(!stop_filter.is_stop("hello"));
-    assert(!stop_filter.is_stop("world"));
-    assert(!stop_filter.is_stop("stop"));
-    return 0;
-}
\ No newline at end of file
+#include <cassert>
+#include <fstream>
+#include <string>
+
+#include "StopFilter.h"
+
+int stop_filter_test() {
+    StopFilter stop_filter("stop_words.txt");
+    assert(stop_filter.is_stop("a"));
+    assert(stop_filter.is_stop("the"));
+    assert(stop_filter.is_stop("a"));
+    assert(!stop_filter.is_stop("hello"));
+    assert(!stop_filter.is_stop("world"));
+    assert(!stop_filter.is_stop("stop"));
+
+    // Every word of the file is found, through the Bloom filter and the table
+    std::ifstream input("stop_words.txt");
+    std::string word;
+    while (input >> word) assert(stop_filter.is_stop(word));
+    for (int i = 0; i < 1000; i++) assert(!stop_filter.is_stop("word" + std::to_string(i)));
+    return 0;
+}
@@ -1,60 +1,159 @@
-#include <filesystem>
-#include <fstream>
-
-#include "tests.h"
-
-
-
-int main(int argc, char* argv[]) {
-    if (argc == 1) {
-        std::cerr << "No test specified.\n\nUseage: tests <test_case_name>\n - see `CMakeList.txt for the test case names`" << std::endl;
-        return 1;
-    }
-
-    std::filesystem::path testdir = std::filesystem::current_path() / "../test";
-    std::filesystem::current_path(testdir);
-
-    std::string testname = argv[1];
-
-    if (testname == "word_count") {
-        return word_counting_test();
-    }
-    else if (testname == "stop_filter") {
-        return stop_filter_test();
-    }
-    else if (testname == "build_and_print_index") {
-        return build_and_print_index_test();
-    }
-    else if (testname == "save_and_read_index") {
-        return save_and_read_index_test();
-    }
-    else if (testname == "merge_and_print_index_file") {
-        return merge_and_print_index_file_test();
-    }
-    else if (testname == "search_engine_gen_index") {
-        return search_engine_gen_index_test();
-    }
-    else if (testname == "search_engine_load_and_search") {
-        return search_engine_load_and_search_test();
-    }
-
-    std::cerr << "Unknown test: " << testname << std::endl;
-    return 1;
-}
-
-// Utils
-bool files_identical(const std::string& file1, const std::string& file2) {
-    std::ifstream f1(file1, std::ios::binary);
-    std::ifstream f2(file2, std::ios::binary);
-    char ch1, ch2;
-    bool has1 = static_cast<bool>(f1.get(ch1));
-    bool has2 = static_cast<bool>(f2.get(ch2));
-    while (has1 && has2) {
-        if (ch1 != ch2) {
-            return false;
-        }
-        has1 = static_cast<bool>(f1.get(ch1));
-        has2 = static_cast<bool>(f2.get(ch2));
-    }
-    return !has1 && !has2;
-}
\ No newline at end of file
+#include <filesystem>
+#include <fstream>
+
+#include "tests.h"
+#include "SearchEngine.h"
+
+
+
+int main(int argc, char* argv[]) {
+    if (argc == 1) {
+        std::cerr << "No test specified.\n\nUseage: tests <test_case_name>\n - see `CMakeList.txt for the test case names`" << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path testdir = std::filesystem::current_path() / "../test";
+    std::filesystem::current_path(testdir);
+
+    std::string testname = argv[1];
+
+    if (testname == "word_count") {
+        return word_counting_test();
+    }
+    else if (testname == "stop_filter") {
+        return stop_filter_test();
+    }
+    else if (testname == "build_and_print_index") {
+        return build_and_print_index_test();
+    }
+    else if (testname == "save_and_read_index") {
+        return save_and_read_index_test();
+    }
+    else if (testname == "merge_and_print_index_file") {
+        return merge_and_print_index_file_test();
+    }
+    else if (testname == "search_engine_gen_index") {
+        return search_engine_gen_index_test();
+    }
+    else if (testname == "search_engine_load_and_search") {
+        return search_engine_load_and_search_test();
+    }
+    else if (testname == "levenshtein") {
+        return levenshtein_test();
+    }
+    else if (testname == "thread_pool") {
+        return thread_pool_test();
+    }
+    else if (testname == "search_engine_concurrent") {
+        return search_engine_concurrent_test();
+    }
+    else if (testname == "search_engine_hot_swap") {
+        return search_engine_hot_swap_test();
+    }
+    else if (testname == "search_server") {
+        return search_server_test();
+    }
+    else if (testname == "search_engine_update") {
+        return search_engine_update_test();
+    }
+    else if (testname == "search_engine_changed_file") {
+        return search_engine_changed_file_test();
+    }
+    else if (testname == "search_engine_empty") {
+        return search_engine_empty_test();
+    }
+    else if (testname == "search_engine_profile") {
+        return search_engine_profile_test();
+    }
+    else if (testname == "search_engine_compaction") {
+        return search_engine_compaction_test();
+    }
+    else if (testname == "search_engine_realtime") {
+        return search_engine_realtime_test();
+    }
+    else if (testname == "search_engine_explain") {
+        return search_engine_explain_test();
+    }
+    else if (testname == "index_stats") {
+        return index_stats_test();
+    }
+    else if (testname == "search_engine_memory") {
+        return search_engine_memory_test();
+    }
+    else if (testname == "word_count_parallel") {
+        return word_count_parallel_test();
+    }
+    else if (testname == "word_count_approx") {
+        return word_count_approx_test();
+    }
+    else if (testname == "search_engine_doc_table") {
+        return search_engine_doc_table_test();
+    }
+    else if (testname == "index_pipeline") {
+        return index_pipeline_test();
+    }
+    else if (testname == "index_pipeline_split") {
+        return index_pipeline_split_test();
+    }
+    else if (testname == "term_dictionary") {
+        return term_dictionary_test();
+    }
+    else if (testname == "sort_inverter") {
+        return sort_inverter_test();
+    }
+    else if (testname == "search_engine_walk") {
+        return search_engine_walk_test();
+    }
+    else if (testname == "search_engine_archive") {
+        return search_engine_archive_test();
+    }
+
+    std::cerr << "Unknown test: " << testname << std::endl;
+    return 1;
+}
+
+// Utils
+bool files_identical(const std::string& file1, const std::string& file2) {
+    std::ifstream f1(file1, std::ios::binary);
+    std::ifstream f2(file2, std::ios::binary);
+    char ch1, ch2;
+    bool has1 = static_cast<bool>(f1.get(ch1));
+    bool has2 = static_cast<bool>(f2.get(ch2));
+    while (has1 && has2) {
+        if (ch1 != ch2) {
+            return false;
+        }
+        has1 = static_cast<bool>(f1.get(ch1));
+        has2 = static_cast<bool>(f2.get(ch2));
+    }
+    return !has1 && !has2;
+}
+
+void write_file(const std::string& filename, const std::string& content) {
+    std::ofstream file(filename, std::ios::binary);
+    file << content;
+}
+
+std::string read_bytes(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Create a fresh directory of files under output/, and index it.
+ * @param name The directory, relative to output/. It is removed first.
+ * @param files The (relative path, content) of each file, parent directories are created.
+ * @param build Whether to index the directory with SearchEngine::gen_index.
+ * @return The path of the directory.
+ */
+std::filesystem::path make_corpus(const std::string& name, const std::vector<std::pair<std::string, std::string>>& files, bool build) {
+    std::filesystem::path dir = std::filesystem::current_path() / "output" / name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    for (auto& [file, content] : files) {
+        std::filesystem::create_directories((dir / file).parent_path());
+        write_file(dir / file, content);
+    }
+    if (build) SearchEngine::gen_index(dir, nullptr, true);
+    return dir;
+}
@@ -1,14 +1,43 @@
-#pragma once
-#include <iostream>
-#include <string>
-#include <unordered_map>
-#include <functional>
-
-int word_counting_test();
-int stop_filter_test();
-int build_and_print_index_test();
-int save_and_read_index_test();
-int merge_and_print_index_file_test();
-int search_engine_gen_index_test();
-int search_engine_load_and_search_test();
-bool files_identical(const std::string& file1, const std::string& file2);
\ No newline at end of file
+#pragma once
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+int word_counting_test();
+int word_count_parallel_test();
+int word_count_approx_test();
+int stop_filter_test();
+int build_and_print_index_test();
+int save_and_read_index_test();
+int merge_and_print_index_file_test();
+int search_engine_gen_index_test();
+int search_engine_load_and_search_test();
+int levenshtein_test();
+int thread_pool_test();
+int search_engine_concurrent_test();
+int search_engine_hot_swap_test();
+int search_server_test();
+int search_engine_update_test();
+int search_engine_changed_file_test();
+int search_engine_empty_test();
+int search_engine_profile_test();
+int search_engine_compaction_test();
+int search_engine_realtime_test();
+int search_engine_explain_test();
+int index_stats_test();
+int search_engine_memory_test();
+int search_engine_doc_table_test();
+int index_pipeline_test();
+int index_pipeline_split_test();
+int term_dictionary_test();
+int sort_inverter_test();
+int search_engine_walk_test();
+int search_engine_archive_test();
+bool files_identical(const std::string& file1, const std::string& file2);
+void write_file(const std::string& filename, const std::string& content);
+std::string read_bytes(const std::filesystem::path& file);
+std::filesystem::path make_corpus(const std::string& name, const std::vector<std::pair<std::string, std::string>>& files, bool build = true);
@@ -0,0 +1,48 @@
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+#include "tests.h"
+
+int thread_pool_test() {
+    std::atomic<int> count{ 0 };
+    {
+        ThreadPool pool(4);
+        for (int i = 0; i < 1000; i++) {
+            pool.submit([&pool, &count] {
+                count++;
+                pool.submit([&count] { count++; }); // tasks may submit more tasks
+            });
+        }
+        pool.wait();
+        assert(count == 2000);
+
+        // the pool can be reused after wait()
+        pool.submit([&count] { count++; });
+        pool.wait();
+        assert(count == 2001);
+
+        // a task that throws is counted as finished, wait() rethrows its exception once
+        for (int i = 0; i < 100; i++) {
+            pool.submit([&count, i] {
+                if (i == 50) throw std::runtime_error("task failed");
+                count++;
+            });
+        }
+        bool thrown = false;
+        try {
+            pool.wait();
+        }
+        catch (const std::runtime_error& error) {
+            thrown = std::string(error.what()) == "task failed";
+        }
+        assert(thrown && count == 2100);
+        pool.wait(); // already rethrown
+        pool.submit([&count] { count++; });
+        pool.wait();
+        assert(count == 2101);
+    }
+    return 0;
+}
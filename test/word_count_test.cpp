@@ -1,21 +1,121 @@
-#include <iostream>
-#include <fstream>
-
-#include "WordCounter.h"
-#include "utils.h"
-
-using namespace std;
-
-int word_counting_test() {
-    WordCounter counter;
-    ifstream input("../test/shakespeare/allswell/allswell.1.1.html");
-    while (input) {
-        string token = tokenize(input);
-        if (token.empty()) break;
-        counter.add_word(token);
-    }
-    input.close();
-    ofstream output("../test/output/word_count_test.txt");
-    counter.print(output);
-    return 0;
-}
\ No newline at end of file
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cassert>
+#include <cstdio>
+#include <cmath>
+
+#include "WordCounter.h"
+#include "WordSketch.h"
+#include "tests.h"
+#include "utils.h"
+
+using namespace std;
+
+int word_counting_test() {
+    WordCounter counter;
+    ifstream input("../test/shakespeare/allswell/allswell.1.1.html");
+    while (input) {
+        string token = tokenize(input);
+        if (token.empty()) break;
+        counter.add_word(token);
+    }
+    input.close();
+    ofstream output("../test/output/word_count_test.txt");
+    counter.print(output);
+    return 0;
+}
+int word_count_parallel_test() {
+    std::vector<std::string> files;
+    for (int i = 0; i < 8; i++) {
+        std::string name = "output/word_count_parallel_" + std::to_string(i) + ".html";
+        std::string text = "<p>";
+        for (int j = 0; j <= i; j++) text += "alpha beta" + std::string(j % 2 ? " gamma" : "") + " ";
+        write_file(name, text + "delta </p>");
+        files.push_back(name);
+    }
+    files.push_back("output/word_count_parallel_missing.html");
+
+    WordCounter serial;
+    for (const std::string& file : files) serial.add_file(file);
+    std::ostringstream expected;
+    serial.print(expected);
+
+    for (unsigned threads : { 1u, 4u }) {
+        std::vector<std::string> failed;
+        WordCounter counter = WordCounter::count_files(files, threads, &failed);
+        assert(failed.size() == 1 && failed[0] == files.back());
+        std::ostringstream result;
+        counter.print(result);
+        assert(result.str() == expected.str());
+    }
+
+    // alpha and beta 36 times each, gamma 16, delta 8: ties are in word order
+    std::vector<WordCounter::Entry> top = serial.top(3);
+    assert(top.size() == 3);
+    assert(top[0] == WordCounter::Entry("alpha", 36));
+    assert(top[1] == WordCounter::Entry("beta", 36));
+    assert(top[2] == WordCounter::Entry("gamma", 16));
+    assert(serial.top(10).size() == 4);
+    std::ostringstream two;
+    serial.print(two, 2);
+    assert(two.str() == "alpha: 36\nbeta: 36\n");
+
+    for (size_t i = 0; i + 1 < files.size(); i++) std::remove(files[i].c_str());
+    return 0;
+}
+int word_count_approx_test() {
+    // A skewed stream: word i occurs 2000 / (i + 1) times, then 20000 distinct one-off words
+    WordSketch sketch(64 * 1024);
+    std::vector<uint64_t> exact(200);
+    for (int round = 0; round < 2000; round++) {
+        for (size_t i = 0; i < exact.size(); i++) {
+            if (round % (i + 1) == 0) {
+                sketch.add_word("word" + std::to_string(i));
+                exact[i]++;
+            }
+        }
+        for (int j = 0; j < 10; j++) sketch.add_word("junk" + std::to_string(round * 10 + j));
+    }
+    uint64_t tokens = 20000;
+    for (uint64_t count : exact) tokens += count;
+    assert(sketch.tokens() == tokens);
+    assert(sketch.memory_usage() <= 64 * 1024);
+
+    // Counts are never under the true count, and over it by at most their error
+    std::vector<char> tracked(exact.size(), 0);
+    for (const WordSketch::Entry& entry : sketch.top()) {
+        assert(entry.error <= tokens / sketch.capacity());
+        if (entry.word.compare(0, 4, "word") != 0) continue;
+        size_t i = std::stoul(entry.word.substr(4));
+        assert(entry.count >= exact[i] && entry.count - entry.error <= exact[i]);
+        tracked[i] = 1;
+    }
+    // Every word more frequent than tokens / capacity is tracked, the top ones come first
+    for (size_t i = 0; i < exact.size(); i++) {
+        assert(tracked[i] || exact[i] <= tokens / sketch.capacity());
+    }
+    std::vector<WordSketch::Entry> top = sketch.top(2);
+    assert(top.size() == 2 && top[0].word == "word0" && top[0].count == 2000 && top[1].word == "word1");
+
+    // About 20200 distinct words, within 4 standard errors
+    double distinct = sketch.distinct();
+    assert(std::abs(distinct - 20200) <= 4 * sketch.distinct_error() * 20200);
+
+    // Files are counted the same with several threads, small counts are exact
+    std::vector<std::string> files;
+    for (int i = 0; i < 4; i++) {
+        std::string name = "output/word_count_approx_" + std::to_string(i) + ".html";
+        write_file(name, "<p>alpha alpha beta delta </p>");
+        files.push_back(name);
+    }
+    for (unsigned threads : { 1u, 4u }) {
+        WordSketch counted = WordSketch::count_files(files, 64 * 1024, threads);
+        std::ostringstream result;
+        counted.print(result, 1);
+        assert(result.str().find("alpha: 8 (error <= 0)\n") != std::string::npos);
+        assert(std::llround(counted.distinct()) >= 3);
+    }
+    for (const std::string& file : files) std::remove(file.c_str());
+    return 0;
+}